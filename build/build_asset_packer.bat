@@ -0,0 +1,9 @@
+@echo off
+setlocal enabledelayedexpansion
+
+set cc_flags=
+for /f "delims=" %%x in (compile_flags.txt) do (set cc_flags=!cc_flags! %%x)
+
+clang!cc_flags! -O2 -Wno-nullability-completeness ../src/tools/asset_packer.cpp --output=debug/asset_packer.exe
+
+endlocal
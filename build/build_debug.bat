@@ -4,7 +4,7 @@ setlocal enabledelayedexpansion
 set cc_flags=
 for /f "delims=" %%x in (compile_flags.txt) do (set cc_flags=!cc_flags! %%x)
 
-set "l_flags=-luser32.lib -lgdi32.lib -l..\third_party\vulkan\Lib\vulkan-1.lib"
+set "l_flags=-luser32.lib -lgdi32.lib -l..\third_party\vulkan\Lib\vulkan-1.lib -l%VULKAN_SDK%\Lib\shaderc_shared.lib -l%VULKAN_SDK%\Lib\spirv-cross-c-shared.lib"
 
 clang!cc_flags! -D_DEBUG --debug -O0 -Wno-nullability-completeness ../src/main.cpp !l_flags! -Wl,-nodefaultlib:libcmt -lmsvcrtd.lib --output=debug/app.exe
 
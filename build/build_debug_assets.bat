@@ -0,0 +1,12 @@
+@echo off
+setlocal enabledelayedexpansion
+
+rem Packs compiled shaders and textures into a single archive, loaded by the app if present.
+rem Run build_asset_packer and build_debug_shaders first. Meshes in debug/meshes come from build_mesh_builder.
+set "assets=debug/first_triangle_vs.spv debug/first_triangle_ps.spv debug/bindless_triangle_ps.spv debug/depth_prepass_vs.spv"
+for %%f in (..\resources\textures\*.png) do (set assets=!assets! %%f)
+if exist debug\meshes (for %%f in (debug\meshes\*.mesh) do (set assets=!assets! %%f))
+
+debug\asset_packer -c debug/assets.pak !assets!
+
+endlocal
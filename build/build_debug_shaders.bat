@@ -3,5 +3,7 @@ setlocal enabledelayedexpansion
 
 glslc -O0 -g ../resources/shaders/first_triangle.vert -o debug/first_triangle_vs.spv
 glslc -O0 -g ../resources/shaders/first_triangle.frag -o debug/first_triangle_ps.spv
+glslc -O0 -g ../resources/shaders/bindless_triangle.frag -o debug/bindless_triangle_ps.spv
+glslc -O0 -g ../resources/shaders/depth_prepass.vert -o debug/depth_prepass_vs.spv
 
 endlocal
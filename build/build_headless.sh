@@ -0,0 +1,15 @@
+#!/bin/sh
+# Headless build for Linux (offscreen rendering, no window or swap chain).
+# Needs the Vulkan loader, shaderc and spirv-cross (e.g. the LunarG SDK, or distro packages).
+# Optimized, without validation layers, since it's meant for benchmarks. Add -D_DEBUG for validation.
+# Runs on any Vulkan device, including software ICDs: VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+set -e
+cd "$(dirname "$0")"
+mkdir -p debug
+
+cc_flags=$(grep -v -e WIN32_LEAN_AND_MEAN -e NOMINMAX -e _CRT_SECURE_NO_WARNINGS compile_flags.txt | tr '\n' ' ')
+sdk_flags=""
+if [ -n "$VULKAN_SDK" ]; then sdk_flags="-I$VULKAN_SDK/include -L$VULKAN_SDK/lib"; fi
+
+clang++ $cc_flags $sdk_flags -g -O2 -Wno-nullability-completeness ../src/main.cpp \
+    -lvulkan -lshaderc_shared -lspirv-cross-c-shared -lpthread -o debug/app_headless
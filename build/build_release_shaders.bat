@@ -0,0 +1,10 @@
+@echo off
+setlocal enabledelayedexpansion
+
+rem Optimized shaders with debug info stripped. Run build_shader_builder first.
+set "shaders="
+for %%f in (..\resources\shaders\*.vert ..\resources\shaders\*.frag) do (set shaders=!shaders! %%f)
+
+debug\shader_builder release !shaders!
+
+endlocal
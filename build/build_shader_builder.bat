@@ -0,0 +1,12 @@
+@echo off
+setlocal enabledelayedexpansion
+
+set cc_flags=
+for /f "delims=" %%x in (compile_flags.txt) do (set cc_flags=!cc_flags! %%x)
+
+rem spirv-tools and shaderc are linked from the Vulkan SDK.
+set "l_flags=-l%VULKAN_SDK%\Lib\shaderc_shared.lib -l%VULKAN_SDK%\Lib\SPIRV-Tools-opt.lib -l%VULKAN_SDK%\Lib\SPIRV-Tools.lib"
+
+clang!cc_flags! -O2 -Wno-nullability-completeness ../src/tools/shader_builder.cpp !l_flags! --output=debug/shader_builder.exe
+
+endlocal
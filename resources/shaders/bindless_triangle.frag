@@ -0,0 +1,24 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 vOut_color;
+layout (location = 1) in vec2 vOut_texCoord;
+
+// Bindless texture table, indexed by per-draw texture ID
+layout (set = 1, binding = 0) uniform texture2D bindlessTextures[];
+layout (set = 1, binding = 1) uniform sampler bindlessSampler;
+
+// Constant Buffer
+layout (push_constant) uniform constants
+{
+    mat4 model;
+    uint textureId;
+} cb_ObjData;
+
+layout (location = 0) out vec4 pOut_color;
+
+void main()
+{
+    vec3 texColor = texture(sampler2D(bindlessTextures[nonuniformEXT(cb_ObjData.textureId)], bindlessSampler), vOut_texCoord).rgb;
+    pOut_color = vec4(vOut_color * texColor, 1);
+}
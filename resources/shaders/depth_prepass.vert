@@ -0,0 +1,27 @@
+#version 460
+
+// Position only version of first_triangle.vert, for the depth pre-pass.
+// Both declare gl_Position invariant, so the color pass' EQUAL depth test matches exactly.
+
+// Inputs
+layout (location = 0) in vec3 vIn_position;
+
+// Uniforms
+layout (set = 0, binding = 0) uniform FrameData
+{
+    mat4 view;
+    mat4 proj;
+} ub_FrameData;
+
+// Constant Buffer
+layout (push_constant) uniform constants
+{
+    mat4 model;
+} cb_ObjData;
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = ub_FrameData.proj * ub_FrameData.view * cb_ObjData.model * vec4(vIn_position, 1);
+}
@@ -22,6 +22,8 @@ layout (push_constant) uniform constants
     mat4 model;
 } cb_ObjData;
 
+invariant gl_Position;      // Must match depth_prepass.vert
+
 void main()
 {
     gl_Position = ub_FrameData.proj * ub_FrameData.view * cb_ObjData.model * vec4(vIn_position, 1);
@@ -0,0 +1,232 @@
+#include <asset_archive.hpp>
+#include <string.h>
+
+bool InitAssetArchive(AssetArchive* archive, const u8* data, u64 size)
+{
+    if(!data || size < sizeof(AssetArchiveHeader)) return false;
+    const AssetArchiveHeader* header = (const AssetArchiveHeader*)data;
+    if(header->magic != ASSET_ARCHIVE_MAGIC || header->version != ASSET_ARCHIVE_VERSION) return false;
+    if(header->fileSize != size) return false;
+    if(header->tocOffset + (u64)header->entryCount * sizeof(AssetArchiveEntry) > size) return false;
+
+    const AssetArchiveEntry* entries = (const AssetArchiveEntry*)(data + header->tocOffset);
+    for(u32 i = 0; i < header->entryCount; i++)
+    {
+        if(entries[i].offset + entries[i].size > size) return false;
+        if(i > 0 && entries[i].nameHash < entries[i - 1].nameHash) return false;     // TOC must be sorted
+    }
+
+    archive->data = data;
+    archive->size = size;
+    archive->header = header;
+    archive->entries = entries;
+    return true;
+}
+
+const AssetArchiveEntry* FindAssetEntry(const AssetArchive* archive, const char* name)
+{
+    if(!archive->header) return NULL;
+    u64 nameHash = HashString(name);
+
+    // Binary search on sorted name hashes, then resolve collisions by name
+    i32 lo = 0;
+    i32 hi = (i32)archive->header->entryCount - 1;
+    while(lo <= hi)
+    {
+        i32 mid = lo + (hi - lo) / 2;
+        u64 midHash = archive->entries[mid].nameHash;
+        if(midHash < nameHash) lo = mid + 1;
+        else if(midHash > nameHash) hi = mid - 1;
+        else
+        {
+            while(mid > 0 && archive->entries[mid - 1].nameHash == nameHash) mid--;
+            for(u32 i = mid; i < archive->header->entryCount && archive->entries[i].nameHash == nameHash; i++)
+            {
+                if(strncmp(archive->entries[i].name, name, ASSET_ARCHIVE_MAX_NAME) == 0) return &archive->entries[i];
+            }
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+const char* FindMissingAssetEntry(const AssetArchive* archive, u32 nameCount, const char** names)
+{
+    for(u32 i = 0; i < nameCount; i++)
+    {
+        if(!FindAssetEntry(archive, names[i])) return names[i];
+    }
+    return NULL;
+}
+
+const u8* GetAssetEntryData(const AssetArchive* archive, const AssetArchiveEntry* entry)
+{
+    return archive->data + entry->offset;
+}
+
+bool ReadAssetEntry(const AssetArchive* archive, const AssetArchiveEntry* entry, u8* dst, u64 dstSize)
+{
+    if(dstSize < entry->uncompressedSize) return false;
+    const u8* src = GetAssetEntryData(archive, entry);
+    switch(entry->compression)
+    {
+        case ASSET_COMPRESSION_NONE:
+            {
+                memcpy(dst, src, entry->size);
+            } break;
+        case ASSET_COMPRESSION_LZ:
+            {
+                if(!AssetDecompress(src, entry->size, dst, entry->uncompressedSize)) return false;
+            } break;
+        default: return false;
+    }
+    return Hash64(dst, entry->uncompressedSize) == entry->contentHash;
+}
+
+// ========================================================
+// LZ compression
+// Stream of sequences, each one being:
+//      token       u8      high nibble: literal count, low nibble: match length - LZ_MIN_MATCH
+//      [extra literal count bytes, if nibble == 15: add bytes until one is < 255]
+//      literals
+//      offset      u16     little endian, distance back from current output position
+//      [extra match length bytes, same scheme as literal count]
+// The last sequence has only literals, and ends the stream.
+#define LZ_MIN_MATCH        4
+#define LZ_MAX_OFFSET       0xFFFF
+#define LZ_HASH_BITS        14
+#define LZ_LAST_LITERALS    5       // Stream always ends with at least this many literals
+
+static inline u32 LzRead32(const u8* p)
+{
+    u32 result;
+    memcpy(&result, p, sizeof(u32));
+    return result;
+}
+
+static inline u32 LzHash(u32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static bool LzWriteLength(u8** dst, u8* dstEnd, u64 length)
+{
+    // Length is the remainder after the 15 stored in the token nibble.
+    while(length >= 255)
+    {
+        if(*dst >= dstEnd) return false;
+        *(*dst)++ = 255;
+        length -= 255;
+    }
+    if(*dst >= dstEnd) return false;
+    *(*dst)++ = (u8)length;
+    return true;
+}
+
+static bool LzWriteSequence(u8** dst, u8* dstEnd, const u8* literals, u64 literalCount, u32 offset, u64 matchLength)
+{
+    if(*dst >= dstEnd) return false;
+    u8* token = (*dst)++;
+    u8 literalNibble = (u8)MIN(literalCount, 15);
+    u8 matchNibble = matchLength ? (u8)MIN(matchLength - LZ_MIN_MATCH, 15) : 0;
+    *token = (literalNibble << 4) | matchNibble;
+
+    if(literalNibble == 15 && !LzWriteLength(dst, dstEnd, literalCount - 15)) return false;
+    if((u64)(dstEnd - *dst) < literalCount) return false;
+    memcpy(*dst, literals, literalCount);
+    *dst += literalCount;
+
+    if(!matchLength) return true;   // Last sequence
+    if(dstEnd - *dst < 2) return false;
+    *(*dst)++ = (u8)(offset & 0xFF);
+    *(*dst)++ = (u8)(offset >> 8);
+    if(matchNibble == 15 && !LzWriteLength(dst, dstEnd, matchLength - LZ_MIN_MATCH - 15)) return false;
+    return true;
+}
+
+u64 AssetCompressBound(u64 srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+u64 AssetCompress(const u8* src, u64 srcSize, u8* dst, u64 dstCapacity)
+{
+    u8* out = dst;
+    u8* outEnd = dst + dstCapacity;
+    u32 hashTable[1 << LZ_HASH_BITS];   // Position + 1 of last occurrence, 0 if none
+    memset(hashTable, 0, sizeof(hashTable));
+
+    u64 anchor = 0;
+    u64 ip = 0;
+    if(srcSize > LZ_LAST_LITERALS + LZ_MIN_MATCH)
+    {
+        u64 matchLimit = srcSize - LZ_LAST_LITERALS;
+        while(ip + LZ_MIN_MATCH <= matchLimit)
+        {
+            u32 sequence = LzRead32(src + ip);
+            u32 h = LzHash(sequence);
+            u64 ref = hashTable[h];
+            hashTable[h] = (u32)(ip + 1);
+            if(!ref || ip - (ref - 1) > LZ_MAX_OFFSET || LzRead32(src + ref - 1) != sequence)
+            {
+                ip++;
+                continue;
+            }
+            ref--;
+
+            u64 matchLength = LZ_MIN_MATCH;
+            while(ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength]) matchLength++;
+
+            if(!LzWriteSequence(&out, outEnd, src + anchor, ip - anchor, (u32)(ip - ref), matchLength)) return 0;
+            ip += matchLength;
+            anchor = ip;
+        }
+    }
+    if(!LzWriteSequence(&out, outEnd, src + anchor, srcSize - anchor, 0, 0)) return 0;
+    return (u64)(out - dst);
+}
+
+static bool LzReadLength(const u8** src, const u8* srcEnd, u64* length)
+{
+    u8 b;
+    do
+    {
+        if(*src >= srcEnd) return false;
+        b = *(*src)++;
+        *length += b;
+    } while(b == 255);
+    return true;
+}
+
+bool AssetDecompress(const u8* src, u64 srcSize, u8* dst, u64 dstSize)
+{
+    const u8* in = src;
+    const u8* inEnd = src + srcSize;
+    u8* out = dst;
+    u8* outEnd = dst + dstSize;
+    while(in < inEnd)
+    {
+        u8 token = *in++;
+        u64 literalCount = token >> 4;
+        if(literalCount == 15 && !LzReadLength(&in, inEnd, &literalCount)) return false;
+        if((u64)(inEnd - in) < literalCount || (u64)(outEnd - out) < literalCount) return false;
+        memcpy(out, in, literalCount);
+        in += literalCount;
+        out += literalCount;
+        if(in == inEnd) break;      // Last sequence, no match
+
+        if(inEnd - in < 2) return false;
+        u32 offset = (u32)in[0] | ((u32)in[1] << 8);
+        in += 2;
+        u64 matchLength = token & 15;
+        if(matchLength == 15 && !LzReadLength(&in, inEnd, &matchLength)) return false;
+        matchLength += LZ_MIN_MATCH;
+        if(!offset || offset > (u64)(out - dst) || (u64)(outEnd - out) < matchLength) return false;
+
+        // Byte copy, since match can overlap the bytes it produces
+        const u8* match = out - offset;
+        for(u64 i = 0; i < matchLength; i++) out[i] = match[i];
+        out += matchLength;
+    }
+    return out == outEnd;
+}
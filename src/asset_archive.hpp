@@ -0,0 +1,85 @@
+#pragma once
+#include <math.hpp>
+#include <hash.hpp>
+
+// ========================================================
+// [ASSET ARCHIVE]
+// Packed asset file, built offline by tools/asset_packer and memory mapped at runtime.
+// Layout:
+//      AssetArchiveHeader
+//      AssetArchiveEntry[entryCount]       Table of contents, sorted by name hash
+//      Blobs                               Each one aligned to ASSET_ARCHIVE_BLOB_ALIGN
+// Uncompressed blobs are consumed in place from the mapping (zero-copy).
+#define ASSET_ARCHIVE_MAGIC         0x4B415048      // "HPAK"
+#define ASSET_ARCHIVE_VERSION       1
+#define ASSET_ARCHIVE_BLOB_ALIGN    64
+#define ASSET_ARCHIVE_MAX_NAME      64
+
+enum AssetType : u32
+{
+    ASSET_TYPE_RAW,
+    ASSET_TYPE_SHADER,      // SPIR-V bytecode
+    ASSET_TYPE_TEXTURE,     // AssetTextureHeader followed by pixel data
+    ASSET_TYPE_MESH,        // Mesh blob, see mesh.hpp
+};
+
+enum AssetCompression : u32
+{
+    ASSET_COMPRESSION_NONE,
+    ASSET_COMPRESSION_LZ,   // Byte oriented LZ77, see AssetCompress
+};
+
+struct AssetArchiveHeader
+{
+    u32 magic = ASSET_ARCHIVE_MAGIC;
+    u32 version = ASSET_ARCHIVE_VERSION;
+    u32 entryCount = 0;
+    u32 reserved = 0;
+    u64 tocOffset = 0;
+    u64 fileSize = 0;
+};
+
+struct AssetArchiveEntry
+{
+    u64 nameHash = 0;           // HashString(name)
+    u64 contentHash = 0;        // Hash64 of the uncompressed blob
+    u64 offset = 0;             // From start of file
+    u64 size = 0;               // Stored size
+    u64 uncompressedSize = 0;
+    AssetType type = ASSET_TYPE_RAW;
+    AssetCompression compression = ASSET_COMPRESSION_NONE;
+    char name[ASSET_ARCHIVE_MAX_NAME];
+};
+
+// Pre-baked texture blob header. Pixels are tightly packed, RGBA8 for now.
+struct AssetTextureHeader
+{
+    u32 width = 0;
+    u32 height = 0;
+    u32 channels = 0;           // Channel count of the source image
+    u32 bytesPerPixel = 4;
+};
+
+// View over an archive that is already in memory (usually a file mapping).
+struct AssetArchive
+{
+    const u8* data = NULL;
+    u64 size = 0;
+    const AssetArchiveHeader* header = NULL;
+    const AssetArchiveEntry* entries = NULL;
+
+    void* platformFile = NULL;      // Owned by whoever mapped the archive
+    void* platformMapping = NULL;
+};
+
+bool InitAssetArchive(AssetArchive* archive, const u8* data, u64 size);    // Validates header and table of contents
+const AssetArchiveEntry* FindAssetEntry(const AssetArchive* archive, const char* name);
+// An archive built before an asset was added is still valid, but can't serve it. Returns the first missing name, or NULL.
+const char* FindMissingAssetEntry(const AssetArchive* archive, u32 nameCount, const char** names);
+const u8* GetAssetEntryData(const AssetArchive* archive, const AssetArchiveEntry* entry);
+bool ReadAssetEntry(const AssetArchive* archive, const AssetArchiveEntry* entry, u8* dst, u64 dstSize);    // Decompresses if needed, verifies content hash
+
+// LZ compression. Returns compressed size, or 0 if data doesn't fit in dstCapacity.
+u64 AssetCompressBound(u64 srcSize);
+u64 AssetCompress(const u8* src, u64 srcSize, u8* dst, u64 dstCapacity);
+bool AssetDecompress(const u8* src, u64 srcSize, u8* dst, u64 dstSize);
@@ -0,0 +1,315 @@
+#include <frame_capture.hpp>
+#include <platform.hpp>
+#include <string.h>
+
+#define CAPTURE_MAX_PATH 512
+
+bool ParseCaptureSinkType(const char* name, CaptureSinkType* outType)
+{
+    if(strcmp(name, "raw") == 0) *outType = CAPTURE_SINK_RAW;
+    else if(strcmp(name, "png") == 0) *outType = CAPTURE_SINK_PNG;
+    else if(strcmp(name, "y4m") == 0) *outType = CAPTURE_SINK_Y4M;
+    else return false;
+    return true;
+}
+
+bool InitCaptureSink(CaptureSink* sink, CaptureSinkType type, const char* path, u32 frameRate)
+{
+    *sink = {};
+    sink->type = type;
+    sink->path = path;
+    sink->frameRate = frameRate;
+    if(type != CAPTURE_SINK_Y4M) return true;
+
+    sink->stream = strcmp(path, "-") == 0 ? PlatformTakeStdout() : fopen(path, "wb");
+    if(!sink->stream)
+    {
+        printf("[FRAME_CAPTURE]: Failed to open %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+void DestroyCaptureSink(CaptureSink* sink)
+{
+    if(sink->stream) fclose(sink->stream);
+    *sink = {};
+}
+
+static bool WriteCaptureFile(const char* path, const u8* data, u64 size)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    bool result = fwrite(data, 1, size, file) == size;
+    return (fclose(file) == 0) && result;
+}
+
+bool WriteCaptureFrame(CaptureSink* sink, const CaptureFrame* frame)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+    bool result = false;
+    u64 size = 0;
+    switch(sink->type)
+    {
+        case CAPTURE_SINK_RAW:
+        case CAPTURE_SINK_PNG:
+        {
+            char path[CAPTURE_MAX_PATH];
+            snprintf(path, sizeof(path), sink->path, frame->index);
+            if(sink->type == CAPTURE_SINK_PNG)
+            {
+                u8* png = NULL;
+                size = EncodePng(frame, scratchScope.arena, &png);
+                result = WriteCaptureFile(path, png, size);
+            }
+            else
+            {
+                // Drop row padding, so the file is just width * height pixels
+                u64 rowSize = (u64)frame->width * 4;
+                size = rowSize * frame->height;
+                u8* pixels = ARENA_PUSH_ARRAY(scratchScope.arena, u8, size);
+                for(u32 y = 0; y < frame->height; y++)
+                {
+                    memcpy(pixels + y * rowSize, frame->pixels + (u64)y * frame->rowPitch, rowSize);
+                }
+                result = WriteCaptureFile(path, pixels, size);
+            }
+            if(!result) printf("[FRAME_CAPTURE]: Failed to write %s\n", path);
+        } break;
+        case CAPTURE_SINK_Y4M:
+        {
+            if(!sink->frameCount)
+            {
+                sink->streamWidth = frame->width;
+                sink->streamHeight = frame->height;
+                i32 headerSize = fprintf(sink->stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+                        frame->width, frame->height, sink->frameRate);
+                sink->bytesWritten += MAX(headerSize, 0);
+            }
+            if(frame->width != sink->streamWidth || frame->height != sink->streamHeight)
+            {
+                printf("[FRAME_CAPTURE]: Frame %u is %ux%u, y4m stream is %ux%u\n",
+                        frame->index, frame->width, frame->height, sink->streamWidth, sink->streamHeight);
+                break;
+            }
+            u8* yuv = NULL;
+            u64 yuvSize = ConvertToI420(frame, scratchScope.arena, &yuv);
+            const char frameTag[] = "FRAME\n";
+            result = fwrite(frameTag, 1, sizeof(frameTag) - 1, sink->stream) == sizeof(frameTag) - 1
+                && fwrite(yuv, 1, yuvSize, sink->stream) == yuvSize;
+            size = sizeof(frameTag) - 1 + yuvSize;
+            if(!result) printf("[FRAME_CAPTURE]: Failed to write frame %u to y4m stream\n", frame->index);
+        } break;
+    }
+
+    if(result)
+    {
+        sink->frameCount++;
+        sink->bytesWritten += size;
+    }
+    else sink->failures++;
+    return result;
+}
+
+static void GetCapturePixelRGB(const CaptureFrame* frame, u32 x, u32 y, i32* r, i32* g, i32* b)
+{
+    const u8* p = frame->pixels + (u64)y * frame->rowPitch + (u64)x * 4;
+    bool bgra = frame->layout == CAPTURE_PIXEL_BGRA8;
+    *r = p[bgra ? 2 : 0];
+    *g = p[1];
+    *b = p[bgra ? 0 : 2];
+}
+
+// ========================================================
+// PNG
+
+struct CrcTable
+{
+    u32 values[256];
+};
+
+static CrcTable MakeCrcTable()
+{
+    CrcTable result;
+    for(u32 i = 0; i < 256; i++)
+    {
+        u32 c = i;
+        for(i32 k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        result.values[i] = c;
+    }
+    return result;
+}
+
+static u32 Crc32(const u8* data, u64 size)
+{
+    static const CrcTable table = MakeCrcTable();
+    u32 c = 0xFFFFFFFF;
+    for(u64 i = 0; i < size; i++)
+    {
+        c = table.values[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+}
+
+static u32 Adler32(const u8* data, u64 size)
+{
+    const u32 mod = 65521;
+    const u64 maxRun = 5552;    // Largest run that can't overflow 32 bits before taking the modulo
+    u32 a = 1, b = 0;
+    while(size)
+    {
+        u64 run = MIN(size, maxRun);
+        size -= run;
+        while(run--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= mod;
+        b %= mod;
+    }
+    return (b << 16) | a;
+}
+
+static u8* WriteBE32(u8* dst, u32 value)
+{
+    dst[0] = (u8)(value >> 24);
+    dst[1] = (u8)(value >> 16);
+    dst[2] = (u8)(value >> 8);
+    dst[3] = (u8)value;
+    return dst + 4;
+}
+
+// Chunk data must already be at dst + 8. Returns the end of the chunk.
+static u8* FinishPngChunk(u8* dst, const char* type, u32 dataSize)
+{
+    WriteBE32(dst, dataSize);
+    memcpy(dst + 4, type, 4);
+    return WriteBE32(dst + 8 + dataSize, Crc32(dst + 4, dataSize + 4));
+}
+
+#define PNG_STORED_BLOCK_MAX_SIZE 65535
+
+u64 EncodePng(const CaptureFrame* frame, Arena* arena, u8** outData)
+{
+    // Filtered image data: each scanline is a filter type byte (0, none) followed by RGB pixels
+    u64 rowSize = 1 + (u64)frame->width * 3;
+    u64 rawSize = rowSize * frame->height;
+    u64 blockCount = MAX((rawSize + PNG_STORED_BLOCK_MAX_SIZE - 1) / PNG_STORED_BLOCK_MAX_SIZE, 1);
+    u64 zlibSize = 2 + rawSize + blockCount * 5 + 4;
+    u64 resultSize = 8 + (12 + 13) + (12 + zlibSize) + 12;
+    u8* result = ARENA_PUSH_ARRAY(arena, u8, resultSize);
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u8* raw = ARENA_PUSH_ARRAY(scratchScope.arena, u8, rawSize);
+    for(u32 y = 0; y < frame->height; y++)
+    {
+        u8* row = raw + y * rowSize;
+        *row++ = 0;
+        for(u32 x = 0; x < frame->width; x++)
+        {
+            i32 r, g, b;
+            GetCapturePixelRGB(frame, x, y, &r, &g, &b);
+            *row++ = (u8)r;
+            *row++ = (u8)g;
+            *row++ = (u8)b;
+        }
+    }
+
+    const u8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    memcpy(result, signature, sizeof(signature));
+    u8* dst = result + sizeof(signature);
+
+    u8* data = WriteBE32(dst + 8, frame->width);
+    data = WriteBE32(data, frame->height);
+    *data++ = 8;    // Bit depth
+    *data++ = 2;    // Color type: RGB
+    *data++ = 0;    // Compression: deflate
+    *data++ = 0;    // Filter method
+    *data++ = 0;    // No interlacing
+    dst = FinishPngChunk(dst, "IHDR", 13);
+
+    // zlib stream of stored deflate blocks
+    data = dst + 8;
+    *data++ = 0x78;     // CMF: deflate, 32K window
+    *data++ = 0x01;     // FLG: no dictionary, fastest level, makes CMF * 256 + FLG a multiple of 31
+    u64 remaining = rawSize;
+    const u8* src = raw;
+    do
+    {
+        u32 blockSize = (u32)MIN(remaining, PNG_STORED_BLOCK_MAX_SIZE);
+        remaining -= blockSize;
+        *data++ = remaining ? 0 : 1;    // BFINAL on the last block, BTYPE 00 (stored)
+        *data++ = (u8)blockSize;
+        *data++ = (u8)(blockSize >> 8);
+        *data++ = (u8)~blockSize;
+        *data++ = (u8)(~blockSize >> 8);
+        memcpy(data, src, blockSize);
+        data += blockSize;
+        src += blockSize;
+    } while(remaining);
+    WriteBE32(data, Adler32(raw, rawSize));
+    dst = FinishPngChunk(dst, "IDAT", (u32)zlibSize);
+
+    dst = FinishPngChunk(dst, "IEND", 0);
+
+    *outData = result;
+    return resultSize;
+}
+
+// ========================================================
+// Y4M
+
+static u8 RGBToY(i32 r, i32 g, i32 b) { return (u8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+static u8 RGBToU(i32 r, i32 g, i32 b) { return (u8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+static u8 RGBToV(i32 r, i32 g, i32 b) { return (u8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+
+u64 ConvertToI420(const CaptureFrame* frame, Arena* arena, u8** outData)
+{
+    u32 chromaWidth = (frame->width + 1) / 2;
+    u32 chromaHeight = (frame->height + 1) / 2;
+    u64 lumaSize = (u64)frame->width * frame->height;
+    u64 chromaSize = (u64)chromaWidth * chromaHeight;
+    u8* result = ARENA_PUSH_ARRAY(arena, u8, lumaSize + 2 * chromaSize);
+    u8* planeY = result;
+    u8* planeU = result + lumaSize;
+    u8* planeV = planeU + chromaSize;
+
+    for(u32 y = 0; y < frame->height; y++)
+    {
+        for(u32 x = 0; x < frame->width; x++)
+        {
+            i32 r, g, b;
+            GetCapturePixelRGB(frame, x, y, &r, &g, &b);
+            planeY[(u64)y * frame->width + x] = RGBToY(r, g, b);
+        }
+    }
+
+    // Chroma from the average of each 2x2 block, edge pixels repeated for odd sizes
+    for(u32 cy = 0; cy < chromaHeight; cy++)
+    {
+        for(u32 cx = 0; cx < chromaWidth; cx++)
+        {
+            i32 sumR = 0, sumG = 0, sumB = 0;
+            for(u32 i = 0; i < 4; i++)
+            {
+                u32 x = MIN(cx * 2 + (i & 1), frame->width - 1);
+                u32 y = MIN(cy * 2 + (i >> 1), frame->height - 1);
+                i32 r, g, b;
+                GetCapturePixelRGB(frame, x, y, &r, &g, &b);
+                sumR += r;
+                sumG += g;
+                sumB += b;
+            }
+            i32 r = (sumR + 2) / 4, g = (sumG + 2) / 4, b = (sumB + 2) / 4;
+            planeU[(u64)cy * chromaWidth + cx] = RGBToU(r, g, b);
+            planeV[(u64)cy * chromaWidth + cx] = RGBToV(r, g, b);
+        }
+    }
+
+    *outData = result;
+    return lumaSize + 2 * chromaSize;
+}
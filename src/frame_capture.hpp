@@ -0,0 +1,59 @@
+#pragma once
+#include <stdio.h>
+#include <math.hpp>
+#include <memory.hpp>
+
+// ========================================================
+// [FRAME CAPTURE]
+// CPU side consumers of frames read back from the GPU: numbered raw or PNG files, or a y4m video stream.
+// Sinks only see 8-bit BGRA/RGBA pixels in host memory, the GPU copy is done by the renderer (see FrameReadback in main.cpp).
+enum CapturePixelLayout
+{
+    CAPTURE_PIXEL_BGRA8,
+    CAPTURE_PIXEL_RGBA8,
+};
+
+struct CaptureFrame
+{
+    u32 index = 0;              // Frame the image was rendered in
+    u32 width = 0;
+    u32 height = 0;
+    u32 rowPitch = 0;           // In bytes
+    CapturePixelLayout layout = CAPTURE_PIXEL_BGRA8;
+    const u8* pixels = NULL;    // Only valid during the sink call
+};
+
+enum CaptureSinkType
+{
+    CAPTURE_SINK_RAW,           // Pixels as read back, tightly packed, one file per frame
+    CAPTURE_SINK_PNG,           // One RGB PNG per frame
+    CAPTURE_SINK_Y4M,           // Single YUV4MPEG2 (I420) stream, every frame must have the same size
+};
+
+struct CaptureSink
+{
+    CaptureSinkType type = CAPTURE_SINK_RAW;
+    const char* path = NULL;    // Raw/PNG: printf format taking the frame index, e.g. "capture/frame_%05u.png".
+                                // Y4M: output file, or "-" for stdout.
+    FILE* stream = NULL;        // Y4M only
+    u32 frameRate = 60;         // Y4M header only
+    u32 streamWidth = 0;
+    u32 streamHeight = 0;
+
+    // Stats
+    u32 frameCount = 0;
+    u32 failures = 0;
+    u64 bytesWritten = 0;
+};
+
+bool ParseCaptureSinkType(const char* name, CaptureSinkType* outType);     // "raw", "png" or "y4m"
+bool InitCaptureSink(CaptureSink* sink, CaptureSinkType type, const char* path, u32 frameRate);
+void DestroyCaptureSink(CaptureSink* sink);
+// Temporaries come from the calling thread's scratch arena.
+bool WriteCaptureFrame(CaptureSink* sink, const CaptureFrame* frame);
+
+// Encoders, output is allocated from arena. Both return the output size.
+// PNG uses stored (uncompressed) deflate blocks: files are larger, but encoding keeps up with the frame rate.
+u64 EncodePng(const CaptureFrame* frame, Arena* arena, u8** outData);
+// Planar Y, U, V with 2x2 subsampled chroma, BT.601 limited range.
+u64 ConvertToI420(const CaptureFrame* frame, Arena* arena, u8** outData);
@@ -0,0 +1,32 @@
+#include <hash.hpp>
+
+#define FNV_PRIME_64 0x100000001B3ULL
+
+u64 Hash64(const void* data, u64 size, u64 seed)
+{
+    const u8* bytes = (const u8*)data;
+    u64 result = seed;
+    for(u64 i = 0; i < size; i++)
+    {
+        result ^= bytes[i];
+        result *= FNV_PRIME_64;
+    }
+    return result;
+}
+
+u64 HashString(const char* str, u64 seed)
+{
+    u64 result = seed;
+    while(*str)
+    {
+        result ^= (u8)*str++;
+        result *= FNV_PRIME_64;
+    }
+    return result;
+}
+
+u64 HashCombine(u64 a, u64 b)
+{
+    // Same mixing as boost::hash_combine, widened to 64 bits
+    return a ^ (b + 0x9E3779B97F4A7C15ULL + (a << 6) + (a >> 2));
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <math.hpp>
+
+// ========================================================
+// [HASH]
+// Non-cryptographic hashing for cache keys and content addressing (FNV-1a, 64 bit).
+#define HASH_SEED_DEFAULT 0xCBF29CE484222325ULL
+
+u64 Hash64(const void* data, u64 size, u64 seed = HASH_SEED_DEFAULT);
+u64 HashString(const char* str, u64 seed = HASH_SEED_DEFAULT);
+u64 HashCombine(u64 a, u64 b);
@@ -0,0 +1,137 @@
+#include <jobs.hpp>
+
+static void JobWorkerProc(void* param)
+{
+    JobSystem* js = (JobSystem*)param;
+    while(true)
+    {
+        PlatformLockMutex(&js->lock);
+        while(!js->queueCount && !js->shutdown)
+        {
+            PlatformWaitConditionVariable(&js->jobAvailable, &js->lock);
+        }
+        if(js->shutdown)
+        {
+            PlatformUnlockMutex(&js->lock);
+            break;
+        }
+        Job job = js->queue[js->queueHead];
+        js->queueHead = (js->queueHead + 1) % JOB_QUEUE_CAPACITY;
+        bool wasFull = js->queueCount == JOB_QUEUE_CAPACITY;
+        js->queueCount--;
+        PlatformUnlockMutex(&js->lock);
+        if(wasFull) PlatformWakeAll(&js->queueSpace);
+
+        job.proc(job.data);
+
+        PlatformLockMutex(&js->lock);
+        js->pendingJobs--;
+        bool allDone = js->pendingJobs == 0;
+        PlatformUnlockMutex(&js->lock);
+        if(allDone) PlatformWakeAll(&js->jobsDone);
+    }
+}
+
+void InitJobSystem(JobSystem* js, u32 workerCount)
+{
+    if(!workerCount)
+    {
+        workerCount = MAX(1, (i32)PlatformGetProcessorCount() - 1);
+    }
+    workerCount = MIN(workerCount, JOB_SYSTEM_MAX_WORKERS);
+
+    PlatformInitMutex(&js->lock);
+    PlatformInitConditionVariable(&js->jobAvailable);
+    PlatformInitConditionVariable(&js->jobsDone);
+    PlatformInitConditionVariable(&js->queueSpace);
+    js->queueHead = 0;
+    js->queueCount = 0;
+    js->pendingJobs = 0;
+    js->shutdown = false;
+
+    js->workerCount = workerCount;
+    for(i32 i = 0; i < workerCount; i++)
+    {
+        js->workers[i] = PlatformCreateThread(JobWorkerProc, js);
+    }
+}
+
+void DestroyJobSystem(JobSystem* js)
+{
+    WaitForJobs(js);
+
+    PlatformLockMutex(&js->lock);
+    js->shutdown = true;
+    PlatformUnlockMutex(&js->lock);
+    PlatformWakeAll(&js->jobAvailable);
+
+    for(i32 i = 0; i < js->workerCount; i++)
+    {
+        PlatformJoinThread(js->workers[i]);
+    }
+    js->workerCount = 0;
+}
+
+void PushJob(JobSystem* js, JobProc proc, void* data)
+{
+    PlatformLockMutex(&js->lock);
+    while(js->queueCount >= JOB_QUEUE_CAPACITY)
+    {
+        PlatformWaitConditionVariable(&js->queueSpace, &js->lock);
+    }
+    u32 slot = (js->queueHead + js->queueCount) % JOB_QUEUE_CAPACITY;
+    js->queue[slot] = { proc, data };
+    js->queueCount++;
+    js->pendingJobs++;
+    PlatformUnlockMutex(&js->lock);
+    PlatformWakeOne(&js->jobAvailable);
+}
+
+void WaitForJobs(JobSystem* js)
+{
+    PlatformLockMutex(&js->lock);
+    while(js->pendingJobs)
+    {
+        PlatformWaitConditionVariable(&js->jobsDone, &js->lock);
+    }
+    PlatformUnlockMutex(&js->lock);
+}
+
+void InitJobResultQueue(JobResultQueue* q)
+{
+    PlatformInitMutex(&q->lock);
+    PlatformInitConditionVariable(&q->resultAvailable);
+    PlatformInitConditionVariable(&q->resultSpace);
+    q->head = 0;
+    q->count = 0;
+}
+
+void PushJobResult(JobResultQueue* q, u32 result)
+{
+    PlatformLockMutex(&q->lock);
+    while(q->count >= JOB_QUEUE_CAPACITY)
+    {
+        // Consumer is behind, wait for it to drain the queue
+        PlatformWaitConditionVariable(&q->resultSpace, &q->lock);
+    }
+    q->results[(q->head + q->count) % JOB_QUEUE_CAPACITY] = result;
+    q->count++;
+    PlatformUnlockMutex(&q->lock);
+    PlatformWakeOne(&q->resultAvailable);
+}
+
+u32 PopJobResult(JobResultQueue* q)
+{
+    PlatformLockMutex(&q->lock);
+    while(!q->count)
+    {
+        PlatformWaitConditionVariable(&q->resultAvailable, &q->lock);
+    }
+    u32 result = q->results[q->head];
+    bool wasFull = q->count == JOB_QUEUE_CAPACITY;
+    q->head = (q->head + 1) % JOB_QUEUE_CAPACITY;
+    q->count--;
+    PlatformUnlockMutex(&q->lock);
+    if(wasFull) PlatformWakeAll(&q->resultSpace);
+    return result;
+}
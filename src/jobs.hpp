@@ -0,0 +1,56 @@
+#pragma once
+#include <platform.hpp>
+#include <math.hpp>
+
+// ========================================================
+// [JOBS]
+// Fixed pool of worker threads consuming a single FIFO job queue.
+typedef void (*JobProc)(void* data);
+
+struct Job
+{
+    JobProc proc = NULL;
+    void* data = NULL;
+};
+
+#define JOB_SYSTEM_MAX_WORKERS  32
+#define JOB_QUEUE_CAPACITY      1024
+
+struct JobSystem
+{
+    u32 workerCount = 0;
+    PlatformThread workers[JOB_SYSTEM_MAX_WORKERS];
+
+    PlatformMutex lock;
+    PlatformConditionVariable jobAvailable;    // Signaled when a job is pushed (or on shutdown)
+    PlatformConditionVariable jobsDone;        // Signaled when pending job count reaches 0
+    PlatformConditionVariable queueSpace;      // Signaled when a worker takes a job off a full queue
+
+    Job queue[JOB_QUEUE_CAPACITY];
+    u32 queueHead = 0;
+    u32 queueCount = 0;
+    u32 pendingJobs = 0;                // Queued + currently running
+    bool shutdown = false;
+};
+
+// Worker count of 0 uses one worker per logical core, minus the calling thread.
+void InitJobSystem(JobSystem* js, u32 workerCount);
+void DestroyJobSystem(JobSystem* js);
+void PushJob(JobSystem* js, JobProc proc, void* data);     // Blocks while the queue is full
+void WaitForJobs(JobSystem* js);
+
+// Blocking multi-producer queue of u32 values, used by jobs to hand results back
+// (e.g. indices of finished work items) to the thread that consumes them.
+struct JobResultQueue
+{
+    PlatformMutex lock;
+    PlatformConditionVariable resultAvailable;
+    PlatformConditionVariable resultSpace;
+    u32 results[JOB_QUEUE_CAPACITY];
+    u32 head = 0;
+    u32 count = 0;
+};
+
+void InitJobResultQueue(JobResultQueue* q);
+void PushJobResult(JobResultQueue* q, u32 result);    // Blocks while the queue is full
+u32 PopJobResult(JobResultQueue* q);    // Blocks until a result is available
@@ -1,26 +1,95 @@
-#include <windows.h>
+#include <platform.hpp>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if !_WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Headless mode renders into offscreen images instead of a window swap chain, no surface or
+// present support needed (e.g. software ICDs like lavapipe on build machines). Always on outside Win32.
+#ifndef RENDERER_HEADLESS
+#if _WIN32
+#define RENDERER_HEADLESS 0
+#else
+#define RENDERER_HEADLESS 1
+#endif
+#endif
 
+#if !RENDERER_HEADLESS
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.h>
+#if !RENDERER_HEADLESS
 #include <vulkan/vulkan_win32.h>
+#endif
 #define VMA_IMPLEMENTATION
 #include <vma/vk_mem_alloc.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 
 #include <math.hpp>
+#include <memory.hpp>
+#include <jobs.hpp>
+#include <hash.hpp>
+#include <asset_archive.hpp>
+#include <shader_compiler.hpp>
+#include <shader_reflection.hpp>
+#include <frame_capture.hpp>
+#include <vertex_format.hpp>
+#include <mesh.hpp>
+#include <range_allocator.hpp>
+
+// Image decoding allocates from the calling thread's scratch arena, callers must open a ScratchScope.
+#define STBI_MALLOC(SZ)                     ArenaPush(GetThreadScratchArena(), (SZ))
+#define STBI_REALLOC_SIZED(P, OLDSZ, NEWSZ) ArenaRealloc(GetThreadScratchArena(), (P), (OLDSZ), (NEWSZ))
+#define STBI_FREE(P)                        ((void)(P))
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
 
 #include <math.cpp>
+#include <platform.cpp>
+#include <memory.cpp>
+#include <jobs.cpp>
+#include <hash.cpp>
+#include <asset_archive.cpp>
+#include <shader_compiler.cpp>
+#include <shader_reflection.cpp>
+#include <frame_capture.cpp>
+#include <vertex_format.cpp>
+#include <mesh.cpp>
+#include <range_allocator.cpp>
 
 #define SHADER_PATH "./debug/"
+#define SHADER_SOURCE_PATH "../resources/shaders/"
+#define SHADER_CACHE_PATH "./debug/shader_cache/"
+#ifndef SHADER_RUNTIME_COMPILATION
+#define SHADER_RUNTIME_COMPILATION 1    // Compile GLSL sources at startup instead of loading prebuilt .spv files
+#endif
 #define TEXTURE_PATH "../resources/textures/"
+#define MESH_PATH "./debug/meshes/"     // Mesh blobs built by tools/mesh_builder
+#define DEFAULT_MESH_NAME "default.mesh"
+#define LOD_MAX_PIXEL_ERROR 1.f         // Coarsest mesh LOD whose simplification error stays under this on screen
+#define SCENE_CROWD_COLUMNS 16          // Extra objects (--crowd) are laid out in rows of this many, receding from the camera
+#define SCENE_PASS_DEPTH_PREPASS 0      // Render queue pass IDs, recorded in this order
+#define SCENE_PASS_MAIN 1
+#define SCENE_SORT_DISTANCE 100.f       // Draw order depth is normalized to this, the projection has no far plane
+#define ASSET_ARCHIVE_PATH "./debug/assets.pak"
+#define PIPELINE_CACHE_PATH "./debug/pipeline_cache.bin"
+#define CAPTURE_PATH "./debug/capture/"
+#define CAPTURE_FRAME_RATE 60           // Only used for the y4m stream header
+
+// Long-lived allocations (e.g. shader bytecode), never freed until shutdown.
+Arena resourceArena;
+// Per-frame temporaries, reset at the start of every frame.
+Arena frameArena;
 
 void Assert(uint64_t expr, const char* msg)
 {
     if(expr) return;
+#if _WIN32
     MessageBoxExA(
             NULL,
             msg,
@@ -29,6 +98,11 @@ void Assert(uint64_t expr, const char* msg)
             0);
     DebugBreak();
     ExitProcess(-1);
+#else
+    printf("[FAILED ASSERT]: %s\n", msg);
+    fflush(stdout);
+    abort();
+#endif
 }
 
 #define STMT(S) do { S;} while(0)
@@ -57,12 +131,14 @@ void Assert(uint64_t expr, const char* msg)
         PROCNAME = (PFN_vk##PROCNAME)vkGetDeviceProcAddr(DEVICE, "vk" STRINGIFY(PROCNAME));\
         ASSERT(PROCNAME);)
 
-HWND windowHandle;
 bool closeApp       = false;
 bool wasResized     = false;
-i32 windowWidth     = 1280;
+i32 windowWidth     = 1280;     // Offscreen target size in headless mode
 i32 windowHeight    = 720;
 
+#if !RENDERER_HEADLESS
+HWND windowHandle;
+
 LRESULT CALLBACK WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     switch(uMsg)
@@ -93,7 +169,9 @@ void ProcessWindowMessages()
         DispatchMessage(&msg);
     }
 }
+#endif
 
+#if _WIN32
 u64 GetFileSize(const char* path)
 {
     HANDLE hFile = CreateFile(
@@ -135,6 +213,226 @@ u64 ReadFileAsBinary(const char* path, u64 sizeToRead, u8* outBuffer)
     return (u64)bytesRead;
 }
 
+// Reads a whole file into arena memory. Unlike ReadFileAsBinary, a missing file is not an error:
+// returns NULL with outSize set to 0.
+u8* ReadOptionalFileToArena(Arena* arena, const char* path, u64* outSize)
+{
+    *outSize = 0;
+    HANDLE hFile = CreateFile(
+            path,
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+    if(hFile == INVALID_HANDLE_VALUE) return NULL;
+
+    DWORD fSize = ::GetFileSize(hFile, NULL);
+    ASSERT(fSize != INVALID_FILE_SIZE);
+    u8* result = ARENA_PUSH_ARRAY(arena, u8, fSize);
+    DWORD bytesRead = 0;
+    BOOL ret = ::ReadFile(hFile, result, fSize, &bytesRead, NULL);
+    CloseHandle(hFile);
+    if(!ret || bytesRead != fSize) return NULL;
+
+    *outSize = fSize;
+    return result;
+}
+
+// Writes to a temporary file first, then renames it over the destination,
+// so a crash mid-write never leaves a truncated file behind.
+bool WriteFileAtomic(const char* path, const u8* data, u64 size)
+{
+    char tmpPath[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    HANDLE hFile = CreateFile(
+            tmpPath,
+            GENERIC_WRITE,
+            0,
+            NULL,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+    if(hFile == INVALID_HANDLE_VALUE) return false;
+
+    DWORD bytesWritten = 0;
+    BOOL ret = ::WriteFile(hFile, data, (DWORD)size, &bytesWritten, NULL);
+    ret = ret && FlushFileBuffers(hFile);
+    CloseHandle(hFile);
+    if(!ret || bytesWritten != size)
+    {
+        DeleteFileA(tmpPath);
+        return false;
+    }
+    return MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+// Maps a packed asset archive read-only. On failure (archive not built, stale or corrupt) returns an archive with no data.
+AssetArchive OpenAssetArchive(const char* path)
+{
+    AssetArchive result = {};
+    HANDLE hFile = CreateFile(
+            path,
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+    if(hFile == INVALID_HANDLE_VALUE) return result;
+
+    LARGE_INTEGER fSize;
+    HANDLE hMapping = NULL;
+    const u8* data = NULL;
+    if(GetFileSizeEx(hFile, &fSize) && fSize.QuadPart)
+    {
+        hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if(hMapping) data = (const u8*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data || !InitAssetArchive(&result, data, (u64)fSize.QuadPart))
+    {
+        printf("[ASSET_ARCHIVE]: %s can't be %s, using loose files\n", path, data ? "read (stale or corrupt)" : "mapped");
+        if(data) UnmapViewOfFile(data);
+        if(hMapping) CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return {};
+    }
+    result.platformFile = hFile;
+    result.platformMapping = hMapping;
+    return result;
+}
+
+void CloseAssetArchive(AssetArchive* archive)
+{
+    if(!archive->data) return;
+    UnmapViewOfFile(archive->data);
+    CloseHandle((HANDLE)archive->platformMapping);
+    CloseHandle((HANDLE)archive->platformFile);
+    *archive = {};
+}
+
+u64 GetTimerTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return (u64)ticks.QuadPart;
+}
+
+f64 TimerTicksToMs(u64 ticks)
+{
+    static u64 frequency = 0;
+    if(!frequency)
+    {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        frequency = (u64)f.QuadPart;
+    }
+    return ((f64)ticks * 1000.0) / (f64)frequency;
+}
+#else
+u64 GetFileSize(const char* path)
+{
+    struct stat fileStat;
+    i32 ret = stat(path, &fileStat);
+    ASSERT(ret == 0);
+    return (u64)fileStat.st_size;
+}
+
+u64 ReadFileAsBinary(const char* path, u64 sizeToRead, u8* outBuffer)
+{
+    FILE* file = fopen(path, "rb");
+    ASSERT(file);
+    u64 bytesRead = fread(outBuffer, 1, sizeToRead, file);
+    ASSERT(!ferror(file));
+    fclose(file);
+    return bytesRead;
+}
+
+// Reads a whole file into arena memory. Unlike ReadFileAsBinary, a missing file is not an error:
+// returns NULL with outSize set to 0.
+u8* ReadOptionalFileToArena(Arena* arena, const char* path, u64* outSize)
+{
+    *outSize = 0;
+    FILE* file = fopen(path, "rb");
+    if(!file) return NULL;
+
+    struct stat fileStat;
+    i32 ret = fstat(fileno(file), &fileStat);
+    ASSERT(ret == 0);
+    u64 fSize = (u64)fileStat.st_size;
+    u8* result = ARENA_PUSH_ARRAY(arena, u8, fSize);
+    u64 bytesRead = fread(result, 1, fSize, file);
+    fclose(file);
+    if(bytesRead != fSize) return NULL;
+
+    *outSize = fSize;
+    return result;
+}
+
+// Writes to a temporary file first, then renames it over the destination,
+// so a crash mid-write never leaves a truncated file behind.
+bool WriteFileAtomic(const char* path, const u8* data, u64 size)
+{
+    char tmpPath[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    if(!file) return false;
+
+    bool written = fwrite(data, 1, size, file) == size;
+    written = (fclose(file) == 0) && written;
+    if(!written)
+    {
+        remove(tmpPath);
+        return false;
+    }
+    return PlatformReplaceFile(tmpPath, path);
+}
+
+// Maps a packed asset archive read-only. On failure (archive not built, stale or corrupt) returns an archive with no data.
+AssetArchive OpenAssetArchive(const char* path)
+{
+    AssetArchive result = {};
+    i32 fd = open(path, O_RDONLY);
+    if(fd < 0) return result;
+
+    struct stat fileStat;
+    const u8* data = NULL;
+    if(fstat(fd, &fileStat) == 0 && fileStat.st_size)
+    {
+        data = (const u8*)mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) data = NULL;
+    }
+    close(fd);      // Mapping stays valid after the descriptor is closed
+    if(!data || !InitAssetArchive(&result, data, (u64)fileStat.st_size))
+    {
+        printf("[ASSET_ARCHIVE]: %s can't be %s, using loose files\n", path, data ? "read (stale or corrupt)" : "mapped");
+        if(data) munmap((void*)data, fileStat.st_size);
+        return {};
+    }
+    return result;
+}
+
+void CloseAssetArchive(AssetArchive* archive)
+{
+    if(!archive->data) return;
+    munmap((void*)archive->data, archive->size);
+    *archive = {};
+}
+
+u64 GetTimerTicks()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+f64 TimerTicksToMs(u64 ticks)
+{
+    return (f64)ticks / 1000000.0;
+}
+#endif
+
 // Vulkan validation layer callback
 VKAPI_ATTR VkBool32 VKAPI_CALL RendererDebugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -153,16 +451,125 @@ VKAPI_ATTR VkBool32 VKAPI_CALL RendererDebugCallback(
 VK_DECLARE_PROC(CreateDebugUtilsMessengerEXT);
 VK_DECLARE_PROC(DestroyDebugUtilsMessengerEXT);
 #endif
+#if !RENDERER_HEADLESS
 VK_DECLARE_PROC(GetPhysicalDeviceSurfaceSupportKHR);
+VK_DECLARE_PROC(WaitForPresentKHR);
+#endif
 
 #define RENDERER_MAX_FRAMES_IN_FLIGHT 2     // Double buffering
 
+// ===================================================================
+// Samplers
+
+enum SamplerFilter
+{
+    SAMPLER_FILTER_NEAREST,
+    SAMPLER_FILTER_LINEAR,
+};
+VkFilter samplerFilterToVk[] =
+{
+    VK_FILTER_NEAREST,
+    VK_FILTER_LINEAR,
+};
+VkSamplerMipmapMode samplerFilterToVkMipmapMode[] =
+{
+    VK_SAMPLER_MIPMAP_MODE_NEAREST,
+    VK_SAMPLER_MIPMAP_MODE_LINEAR,
+};
+
+enum SamplerAddressMode
+{
+    SAMPLER_ADDRESS_MODE_REPEAT,
+    SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+    SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+};
+VkSamplerAddressMode samplerAddressModeToVk[] =
+{
+    VK_SAMPLER_ADDRESS_MODE_REPEAT,
+    VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT,
+    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+};
+
+// Note: only 4-byte members, so the struct has no padding and can be hashed/compared as raw bytes.
+struct SamplerDesc
+{
+    SamplerFilter minFilter = SAMPLER_FILTER_LINEAR;
+    SamplerFilter magFilter = SAMPLER_FILTER_LINEAR;
+    SamplerFilter mipFilter = SAMPLER_FILTER_LINEAR;
+    SamplerAddressMode addressModeU = SAMPLER_ADDRESS_MODE_REPEAT;
+    SamplerAddressMode addressModeV = SAMPLER_ADDRESS_MODE_REPEAT;
+    SamplerAddressMode addressModeW = SAMPLER_ADDRESS_MODE_REPEAT;
+    u32 anisotropyEnable = 1;       // Uses device max anisotropy when enabled
+    f32 minLod = 0.f;
+    f32 maxLod = 0.f;
+};
+
+// Samplers are immutable and shared between all textures with an identical description.
+// Open addressing hash table keyed by the hash of the sampler description.
+#define SAMPLER_CACHE_CAPACITY 64   // Must be power of 2
+struct SamplerCache
+{
+    u32 count = 0;
+    u64 hashes[SAMPLER_CACHE_CAPACITY];     // 0 marks an empty slot
+    SamplerDesc descs[SAMPLER_CACHE_CAPACITY];
+    VkSampler apiSamplers[SAMPLER_CACHE_CAPACITY];
+};
+
+// Descriptor set layouts built from shader reflection, shared by every pipeline that uses an identical set.
+// Sharing handles also makes pipeline layouts compatible, so those sets stay bound across pipeline changes.
+#define DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY 64   // Must be power of 2
+#define DESCRIPTOR_SET_LAYOUT_BINDING_KEY_SIZE 4    // Binding, type, count, stages
+struct DescriptorSetLayoutCache
+{
+    u32 count = 0;
+    u64 hashes[DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY];     // 0 marks an empty slot
+    u32 bindingCounts[DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY];
+    u32 bindingKeys[DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY][SHADER_REFLECTION_MAX_BINDINGS][DESCRIPTOR_SET_LAYOUT_BINDING_KEY_SIZE];
+    VkDescriptorSetLayout apiLayouts[DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY];
+};
+
+// GPU memory, accounted by what it's used for. Each VMA allocation carries its category as user data,
+// so frees are accounted without the caller passing it again.
+enum MemoryCategory
+{
+    MEMORY_CATEGORY_TEXTURES,
+    MEMORY_CATEGORY_GEOMETRY,
+    MEMORY_CATEGORY_UNIFORMS,
+    MEMORY_CATEGORY_ATTACHMENTS,    // Render graph transients, and headless swap chain images
+    MEMORY_CATEGORY_TRANSFER,       // Staging and readback buffers
+    MEMORY_CATEGORY_COUNT,
+};
+const char* memoryCategoryNames[] =
+{
+    "textures",
+    "geometry",
+    "uniforms",
+    "attachments",
+    "transfer",
+};
+
+// Allocations are tracked from job system workers too (e.g. texture staging buffers), so counters are behind a lock.
+struct MemoryUsage
+{
+    PlatformMutex lock;     // Initialized in place once the render context is created (see InitMemoryUsage)
+    u64 bytes[MEMORY_CATEGORY_COUNT] = {};
+    u64 peakBytes[MEMORY_CATEGORY_COUNT] = {};
+    u32 allocationCounts[MEMORY_CATEGORY_COUNT] = {};
+};
+
 struct RenderContext
 {
     VkInstance apiInstance = VK_NULL_HANDLE;
     VkSurfaceKHR apiSurface = VK_NULL_HANDLE;
     VkPhysicalDevice apiPhysicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties apiPhysicalDeviceProperties;     // Queried once at context creation
+    VkPhysicalDeviceFeatures apiPhysicalDeviceFeatures;
     VkDevice apiDevice = VK_NULL_HANDLE;
+    bool supportsBindless = false;      // VK_EXT_descriptor_indexing with update-after-bind sampled images
+    bool supportsPresentWait = false;   // VK_KHR_present_id and VK_KHR_present_wait, to time presentation
+    bool supportsMemoryBudget = false;  // VK_EXT_memory_budget, heap budgets come from the driver instead of estimates
     u32 apiCommandQueueFamily = -1;
     VkQueue apiCommandQueue = VK_NULL_HANDLE;
 #if _DEBUG
@@ -170,6 +577,7 @@ struct RenderContext
 #endif
 
     VmaAllocator apiMemoryAllocator = VK_NULL_HANDLE;
+    MemoryUsage memoryUsage;
 
     VkCommandPool apiCommandPool = VK_NULL_HANDLE;
     VkCommandBuffer apiCommandBuffers[RENDERER_MAX_FRAMES_IN_FLIGHT];
@@ -182,10 +590,26 @@ struct RenderContext
     VkFence apiImmediateFence = VK_NULL_HANDLE;
     VkCommandPool apiImmediateCommandPool = VK_NULL_HANDLE;
     VkCommandBuffer apiImmediateCommandBuffer = VK_NULL_HANDLE;
+
+    SamplerCache samplerCache;
+    DescriptorSetLayoutCache descriptorSetLayoutCache;
+
+    // Shared by all pipeline creation, persisted to disk between runs
+    VkPipelineCache apiPipelineCache = VK_NULL_HANDLE;
+    bool pipelineCacheWarm = false;     // Loaded valid data from disk
+    u32 pipelineCreationCount = 0;
+    f64 pipelineCreationMs = 0;
 };
 
+#if RENDERER_HEADLESS
+RenderContext CreateRenderContext(const char* appName, const char* engineName)
+#else
 RenderContext CreateRenderContext(const char* appName, const char* engineName, HWND osWindow, HINSTANCE osInstance)
+#endif
 {
+    Arena* scratch = GetThreadScratchArena();
+    ScratchScope scratchScope(scratch);
+
     // Detailing application info
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -200,16 +624,17 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     VkInstanceCreateInfo instanceInfo = {};
     instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     instanceInfo.pApplicationInfo = &appInfo;
-    const char* instanceExtensions[] =
-    {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-        VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+    const char* instanceExtensions[4];
+    u32 instanceExtensionCount = 0;
+#if !RENDERER_HEADLESS
+    instanceExtensions[instanceExtensionCount++] = VK_KHR_SURFACE_EXTENSION_NAME;
+    instanceExtensions[instanceExtensionCount++] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+#endif
 #if _DEBUG
-        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    instanceExtensions[instanceExtensionCount++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 #endif
-    };
-    instanceInfo.enabledExtensionCount = ARR_LEN(instanceExtensions);
-    instanceInfo.ppEnabledExtensionNames = &instanceExtensions[0];
+    instanceInfo.enabledExtensionCount = instanceExtensionCount;
+    instanceInfo.ppEnabledExtensionNames = instanceExtensionCount ? instanceExtensions : NULL;
 #if _DEBUG
     //  Enabling debug validation layer (only in debug builds)
     const char* validationLayers[] =
@@ -220,12 +645,12 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     u32 layerCount = 0;
     vkEnumerateInstanceLayerProperties(&layerCount, NULL);
     ASSERT(layerCount);
-    VkLayerProperties availableLayers[layerCount];
+    VkLayerProperties* availableLayers = ARENA_PUSH_ARRAY(scratch, VkLayerProperties, layerCount);
     vkEnumerateInstanceLayerProperties(&layerCount, availableLayers);
 
     for(i32 layerToFind = 0; layerToFind < ARR_LEN(validationLayers); layerToFind++)
     {
-        i32 match = FIND_STRING_IN_AOS(availableLayers, ARR_LEN(availableLayers), validationLayers[layerToFind], layerName);
+        i32 match = FIND_STRING_IN_AOS(availableLayers, layerCount, validationLayers[layerToFind], layerName);
         ASSERT(match != -1);
     }
     
@@ -258,6 +683,12 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     VK_ASSERT(ret);
 #endif
 
+#if RENDERER_HEADLESS
+    // Nothing is presented, so there is no surface and no swap chain extension
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    const char* deviceExtensions[1];
+    const u32 deviceExtensionCount = 0;
+#else
     // Create window surface to interface with OS window
     VkWin32SurfaceCreateInfoKHR surfaceInfo = {};
     surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
@@ -267,15 +698,18 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     ret = vkCreateWin32SurfaceKHR(instance, &surfaceInfo, NULL, &surface);
     VK_ASSERT(ret);
 
-    // Selecting physical device (currently just selecting the first device to match requirements)
     const char* deviceExtensions[] =
     {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     };
+    const u32 deviceExtensionCount = ARR_LEN(deviceExtensions);
+#endif
+
+    // Selecting physical device (currently just selecting the first device to match requirements)
     u32 physicalDeviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, NULL);
     ASSERT(physicalDeviceCount);
-    VkPhysicalDevice physicalDevices[physicalDeviceCount];
+    VkPhysicalDevice* physicalDevices = ARENA_PUSH_ARRAY(scratch, VkPhysicalDevice, physicalDeviceCount);
     vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices);
     u32 selectedDevice = -1;
     for(i32 deviceIndex = 0; deviceIndex < physicalDeviceCount; deviceIndex++)
@@ -284,30 +718,36 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
         VkPhysicalDevice physicalDevice = physicalDevices[deviceIndex];
         u32 extensionCount = 0;
         vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, NULL);
-        VkExtensionProperties extensions[extensionCount];
+        ScratchScope extensionsScope(scratch);
+        VkExtensionProperties* extensions = ARENA_PUSH_ARRAY(scratch, VkExtensionProperties, extensionCount);
         vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, extensions);
         bool supportsRequiredExtensions = true;
-        for(i32 i = 0; i < ARR_LEN(deviceExtensions); i++)
+        for(i32 i = 0; i < deviceExtensionCount; i++)
         {
             const char* extensionToFind = deviceExtensions[i];
-            i32 match = FIND_STRING_IN_AOS(extensions, ARR_LEN(extensions), extensionToFind, extensionName);
-            supportsRequiredExtensions |= match != -1;
+            i32 match = FIND_STRING_IN_AOS(extensions, extensionCount, extensionToFind, extensionName);
+            supportsRequiredExtensions &= match != -1;
         }
         if(!supportsRequiredExtensions) continue;
 
+#if !RENDERER_HEADLESS
         // Check if surface properties are supported 
         u32 surfaceFormatCount = 0, surfacePresentModeCount = 0;
         vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, NULL);
         vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &surfacePresentModeCount, NULL);
         if(!surfaceFormatCount || !surfacePresentModeCount) continue;
+#endif
 
         // Check if device supports the required features for application
         VkPhysicalDeviceProperties properties;
         VkPhysicalDeviceFeatures features;
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+#if !RENDERER_HEADLESS
+        // Headless accepts any device type, software rasterizers report VK_PHYSICAL_DEVICE_TYPE_CPU.
         if(properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
                 && features.samplerAnisotropy) continue; // Add more if needed
+#endif
 
         // Found a device matching all requirements
         selectedDevice = deviceIndex;
@@ -317,11 +757,87 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     ASSERT(selectedDevice != -1);
     VkPhysicalDevice physicalDevice = physicalDevices[selectedDevice];
 
+    // Optional device extensions, enabled only when supported
+    #define RENDER_CONTEXT_MAX_DEVICE_EXTENSIONS 8
+    const char* enabledDeviceExtensions[RENDER_CONTEXT_MAX_DEVICE_EXTENSIONS];
+    u32 enabledDeviceExtensionCount = 0;
+    for(i32 i = 0; i < deviceExtensionCount; i++)
+    {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = deviceExtensions[i];
+    }
+    u32 availableExtensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &availableExtensionCount, NULL);
+    VkExtensionProperties* availableExtensions = ARENA_PUSH_ARRAY(scratch, VkExtensionProperties, availableExtensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &availableExtensionCount, availableExtensions);
+
+    // Descriptor indexing, for bindless texture tables
+    bool supportsBindless = false;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if(FIND_STRING_IN_AOS(availableExtensions, availableExtensionCount, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, extensionName) != -1)
+    {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &descriptorIndexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        supportsBindless = descriptorIndexingFeatures.runtimeDescriptorArray
+            && descriptorIndexingFeatures.descriptorBindingPartiallyBound
+            && descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+            && descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures = {};
+    enabledDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if(supportsBindless)
+    {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME;
+        enabledDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        enabledDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    }
+
+    // Present id and present wait, to measure when frames actually reach the screen
+    bool supportsPresentWait = false;
+    VkPhysicalDevicePresentIdFeaturesKHR enabledPresentIdFeatures = {};
+    enabledPresentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR enabledPresentWaitFeatures = {};
+    enabledPresentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+#if !RENDERER_HEADLESS
+    if(FIND_STRING_IN_AOS(availableExtensions, availableExtensionCount, VK_KHR_PRESENT_ID_EXTENSION_NAME, extensionName) != -1
+            && FIND_STRING_IN_AOS(availableExtensions, availableExtensionCount, VK_KHR_PRESENT_WAIT_EXTENSION_NAME, extensionName) != -1)
+    {
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &presentIdFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        supportsPresentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+    }
+    if(supportsPresentWait)
+    {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+        enabledPresentIdFeatures.presentId = VK_TRUE;
+        enabledPresentWaitFeatures.presentWait = VK_TRUE;
+    }
+#endif
+
+    // Memory budget, so VMA reports what the driver actually grants the process per heap
+    bool supportsMemoryBudget = FIND_STRING_IN_AOS(availableExtensions, availableExtensionCount, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, extensionName) != -1;
+    if(supportsMemoryBudget)
+    {
+        enabledDeviceExtensions[enabledDeviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+
     // Finding first command queue family that supports required command types
     u32 commandQueueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &commandQueueFamilyCount, NULL);
     ASSERT(commandQueueFamilyCount);
-    VkQueueFamilyProperties commandQueueFamilyProperties[commandQueueFamilyCount];
+    VkQueueFamilyProperties* commandQueueFamilyProperties = ARENA_PUSH_ARRAY(scratch, VkQueueFamilyProperties, commandQueueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &commandQueueFamilyCount, commandQueueFamilyProperties);
     u32 commandQueueFamily = -1;
     for(i32 i = 0; i < commandQueueFamilyCount; i++)
@@ -330,11 +846,13 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
         VkQueueFamilyProperties properties = commandQueueFamilyProperties[i];
         if(!(properties.queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
 
+#if !RENDERER_HEADLESS
         // Queue family supports present commands
         VK_GET_IPROC(instance, GetPhysicalDeviceSurfaceSupportKHR);
         VkBool32 supportsPresent;
         GetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supportsPresent);
         if(supportsPresent == VK_FALSE) continue;
+#endif
 
         commandQueueFamily = i;
         break;
@@ -349,16 +867,32 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     f32 deviceQueuePriority = 1;
     queueInfo.pQueuePriorities = &deviceQueuePriority;
     
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures = {};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
 
     VkDeviceCreateInfo deviceInfo = {};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceInfo.queueCreateInfoCount = 1;
     deviceInfo.pQueueCreateInfos = &queueInfo;
     deviceInfo.pEnabledFeatures = &deviceFeatures;
-    deviceInfo.enabledExtensionCount = ARR_LEN(deviceExtensions);
-    deviceInfo.ppEnabledExtensionNames = deviceExtensions;
+    // Chaining the optional feature structs that are enabled
+    void* deviceInfoNext = NULL;
+    if(supportsPresentWait)
+    {
+        enabledPresentWaitFeatures.pNext = deviceInfoNext;
+        enabledPresentIdFeatures.pNext = &enabledPresentWaitFeatures;
+        deviceInfoNext = &enabledPresentIdFeatures;
+    }
+    if(supportsBindless)
+    {
+        enabledDescriptorIndexingFeatures.pNext = deviceInfoNext;
+        deviceInfoNext = &enabledDescriptorIndexingFeatures;
+    }
+    deviceInfo.pNext = deviceInfoNext;
+    deviceInfo.enabledExtensionCount = enabledDeviceExtensionCount;
+    deviceInfo.ppEnabledExtensionNames = enabledDeviceExtensions;
     VkDevice device;
     ret = vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device);
     VK_ASSERT(ret);
@@ -366,14 +900,20 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     // Referencing command queue created from device
     VkQueue commandQueue;
     vkGetDeviceQueue(device, commandQueueFamily, 0, &commandQueue);
+#if !RENDERER_HEADLESS
+    if(supportsPresentWait) VK_GET_DPROC(device, WaitForPresentKHR);
+#endif
 
     // Creating buffer allocator
     VmaAllocatorCreateInfo bufferAllocatorInfo = {};
     bufferAllocatorInfo.instance = instance;
     bufferAllocatorInfo.physicalDevice = physicalDevice;
     bufferAllocatorInfo.device = device;
+    bufferAllocatorInfo.vulkanApiVersion = appInfo.apiVersion;     // Budget queries use vkGetPhysicalDeviceMemoryProperties2
+    if(supportsMemoryBudget) bufferAllocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     VmaAllocator memoryAllocator;
     ret = vmaCreateAllocator(&bufferAllocatorInfo, &memoryAllocator);
+    VK_ASSERT(ret);
 
     // Creating command buffers
     VkCommandPoolCreateInfo commandPoolInfo = {};
@@ -443,7 +983,12 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
     result.apiInstance = instance;
     result.apiSurface = surface;
     result.apiPhysicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &result.apiPhysicalDeviceProperties);
+    vkGetPhysicalDeviceFeatures(physicalDevice, &result.apiPhysicalDeviceFeatures);
     result.apiDevice = device;
+    result.supportsBindless = supportsBindless;
+    result.supportsPresentWait = supportsPresentWait;
+    result.supportsMemoryBudget = supportsMemoryBudget;
     result.apiCommandQueueFamily = commandQueueFamily;
     result.apiCommandQueue = commandQueue;
 #if _DEBUG
@@ -468,6 +1013,20 @@ RenderContext CreateRenderContext(const char* appName, const char* engineName, H
 void DestroyRenderContext(RenderContext* ctx)
 {
     ASSERT(ctx);
+    if(ctx->apiPipelineCache != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineCache(ctx->apiDevice, ctx->apiPipelineCache, NULL);
+    }
+    for(i32 i = 0; i < DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY; i++)
+    {
+        if(!ctx->descriptorSetLayoutCache.hashes[i]) continue;
+        vkDestroyDescriptorSetLayout(ctx->apiDevice, ctx->descriptorSetLayoutCache.apiLayouts[i], NULL);
+    }
+    for(i32 i = 0; i < SAMPLER_CACHE_CAPACITY; i++)
+    {
+        if(!ctx->samplerCache.hashes[i]) continue;
+        vkDestroySampler(ctx->apiDevice, ctx->samplerCache.apiSamplers[i], NULL);
+    }
     for(i32 i = 0; i < RENDERER_MAX_FRAMES_IN_FLIGHT; i++)
     {
         vkDestroySemaphore(ctx->apiDevice, ctx->apiRenderSemaphores[i], NULL);
@@ -483,89 +1042,617 @@ void DestroyRenderContext(RenderContext* ctx)
     VK_GET_IPROC(ctx->apiInstance, DestroyDebugUtilsMessengerEXT);
     DestroyDebugUtilsMessengerEXT(ctx->apiInstance, ctx->apiDebugMessenger, NULL);
 #endif
+#if !RENDERER_HEADLESS
     vkDestroySurfaceKHR(ctx->apiInstance, ctx->apiSurface, NULL);
+#endif
     vkDestroyInstance(ctx->apiInstance, NULL);
 
     *ctx = {};
 }
 
-void BeginImmediateCommands(RenderContext* ctx)
+// ===================================================================
+// Memory budget
+// Every VMA allocation is tracked under a category (see MemoryCategory). Heap budgets are checked once per frame:
+// a warning is printed when a heap's usage crosses a fraction of its budget, well before allocations start failing
+// or the OS starts paging. Snapshots with VMA's detailed statistics can be written periodically as JSON lines.
+#define MEMORY_BUDGET_WARNING_PERCENT   80      // Of each heap's budget
+#define MEMORY_SNAPSHOT_INTERVAL        600     // Frames between snapshots
+
+// The render context is returned by value, so the lock is set up once it's in its final place.
+void InitMemoryUsage(RenderContext* ctx)
 {
-    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    VkResult ret = vkBeginCommandBuffer(ctx->apiImmediateCommandBuffer, &commandBufferBeginInfo);
-    VK_ASSERT(ret);
+    PlatformInitMutex(&ctx->memoryUsage.lock);
 }
 
-void SubmitImmediateCommands(RenderContext* ctx)
+void TrackAllocation(RenderContext* ctx, VmaAllocation allocation, MemoryCategory category)
 {
-    VkResult ret = vkEndCommandBuffer(ctx->apiImmediateCommandBuffer);
-    VK_ASSERT(ret);
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &ctx->apiImmediateCommandBuffer;
-    
-    ret = vkQueueSubmit(ctx->apiCommandQueue, 1, &submitInfo, ctx->apiImmediateFence);
-    VK_ASSERT(ret);
-
-    // Immediate submit waits until commands are done to proceed.
-    vkWaitForFences(ctx->apiDevice, 1, &ctx->apiImmediateFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(ctx->apiDevice, 1, &ctx->apiImmediateFence);
-    vkResetCommandPool(ctx->apiDevice, ctx->apiImmediateCommandPool, 0);
+    ASSERT(category < MEMORY_CATEGORY_COUNT);
+    vmaSetAllocationUserData(ctx->apiMemoryAllocator, allocation, (void*)(uintptr_t)category);
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(ctx->apiMemoryAllocator, allocation, &allocationInfo);
+    MemoryUsage* usage = &ctx->memoryUsage;
+    PlatformLockMutex(&usage->lock);
+    usage->bytes[category] += allocationInfo.size;
+    usage->peakBytes[category] = MAX(usage->peakBytes[category], usage->bytes[category]);
+    usage->allocationCounts[category]++;
+    PlatformUnlockMutex(&usage->lock);
 }
 
-#define SURFACE_MAX_FORMATS         16
-#define SURFACE_MAX_PRESENT_MODES   16
+// Call before the allocation is freed.
+void UntrackAllocation(RenderContext* ctx, VmaAllocation allocation)
+{
+    if(allocation == VK_NULL_HANDLE) return;
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(ctx->apiMemoryAllocator, allocation, &allocationInfo);
+    MemoryCategory category = (MemoryCategory)(uintptr_t)allocationInfo.pUserData;
+    MemoryUsage* usage = &ctx->memoryUsage;
+    PlatformLockMutex(&usage->lock);
+    ASSERT(usage->allocationCounts[category] && usage->bytes[category] >= allocationInfo.size);
+    usage->bytes[category] -= allocationInfo.size;
+    usage->allocationCounts[category]--;
+    PlatformUnlockMutex(&usage->lock);
+}
 
-struct WindowSurfaceDetails
+struct MemoryBudgetMonitor
 {
-    VkSurfaceCapabilitiesKHR capabilities;
-    u32 formatCount = -1;
-    VkSurfaceFormatKHR formats[SURFACE_MAX_FORMATS];
-    u32 presentModeCount = -1;
-    VkPresentModeKHR presentModes[SURFACE_MAX_PRESENT_MODES];
+    u32 warningPercent = MEMORY_BUDGET_WARNING_PERCENT;
+    u32 warnedHeaps = 0;                // Heaps over the threshold, warned once until they drop back under it
+    u32 warningCount = 0;
+    FILE* snapshotFile = NULL;          // JSON lines, one snapshot per line
+    u32 snapshotCount = 0;
 };
 
-WindowSurfaceDetails QueryWindowSurfaceDetails(RenderContext* ctx)
+bool InitMemoryBudgetMonitor(MemoryBudgetMonitor* monitor, u32 warningPercent, const char* snapshotPath)
 {
-    WindowSurfaceDetails result = {};
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.capabilities);
-
-    vkGetPhysicalDeviceSurfaceFormatsKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.formatCount, NULL);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.formatCount, result.formats);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.presentModeCount, NULL);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.presentModeCount, result.presentModes);
+    *monitor = {};
+    monitor->warningPercent = warningPercent;
+    if(!snapshotPath) return true;
+    monitor->snapshotFile = fopen(snapshotPath, "wb");
+    return monitor->snapshotFile != NULL;
+}
 
-    return result;
+void DestroyMemoryBudgetMonitor(MemoryBudgetMonitor* monitor)
+{
+    if(monitor->snapshotFile) fclose(monitor->snapshotFile);
+    *monitor = {};
 }
 
-#define SWAP_CHAIN_MAX_IMAGE_COUNT 4
-struct SwapChain
+// Fragmentation of a heap's free space: 0 when it's one contiguous range, towards 1 as it splits into small ones.
+f64 GetMemoryFragmentation(const VmaDetailedStatistics* stats)
 {
-    VkSwapchainKHR      apiObject = VK_NULL_HANDLE;
-    VkFormat            format;
-    VkColorSpaceKHR     colorSpace;
-    VkPresentModeKHR    presentMode;
-    VkExtent2D          extents;
-    
-    u32         imageCount = 0;
-    VkImage     apiImages[SWAP_CHAIN_MAX_IMAGE_COUNT];
-    VkImageView apiImageViews[SWAP_CHAIN_MAX_IMAGE_COUNT];
-    VkImage     apiDepthImage = VK_NULL_HANDLE;
-    VkImageView apiDepthImageView = VK_NULL_HANDLE;
-    VmaAllocation apiDepthImageAllocation;
-};
+    u64 unusedBytes = stats->statistics.blockBytes - stats->statistics.allocationBytes;
+    if(!unusedBytes || !stats->unusedRangeCount) return 0;
+    return 1.0 - (f64)stats->unusedRangeSizeMax / (f64)unusedBytes;
+}
 
-SwapChain CreateSwapChain(RenderContext* ctx)
+void WriteMemorySnapshot(RenderContext* ctx, MemoryBudgetMonitor* monitor, u32 frame)
 {
-    ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
+    ASSERT(monitor->snapshotFile);
+    FILE* file = monitor->snapshotFile;
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(ctx->apiMemoryAllocator, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(ctx->apiMemoryAllocator, budgets);
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(ctx->apiMemoryAllocator, &stats);
+
+    fprintf(file, "{\"frame\":%u,\"budgetSource\":\"%s\",\"heaps\":[", frame, ctx->supportsMemoryBudget ? "driver" : "estimate");
+    for(u32 i = 0; i < memoryProperties->memoryHeapCount; i++)
+    {
+        const VmaDetailedStatistics* heapStats = &stats.memoryHeap[i];
+        fprintf(file, "%s{\"heap\":%u,\"deviceLocal\":%s,\"size\":%llu,\"budget\":%llu,\"usage\":%llu,"
+                "\"blockCount\":%u,\"blockBytes\":%llu,\"allocationCount\":%u,\"allocationBytes\":%llu,"
+                "\"unusedRangeCount\":%u,\"largestUnusedRange\":%llu,\"fragmentation\":%.4f}",
+                i ? "," : "", i, memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "true" : "false",
+                (unsigned long long)memoryProperties->memoryHeaps[i].size,
+                (unsigned long long)budgets[i].budget, (unsigned long long)budgets[i].usage,
+                heapStats->statistics.blockCount, (unsigned long long)heapStats->statistics.blockBytes,
+                heapStats->statistics.allocationCount, (unsigned long long)heapStats->statistics.allocationBytes,
+                heapStats->unusedRangeCount, (unsigned long long)(heapStats->unusedRangeCount ? heapStats->unusedRangeSizeMax : 0),
+                GetMemoryFragmentation(heapStats));
+    }
+    fprintf(file, "],\"categories\":{");
+    MemoryUsage* usage = &ctx->memoryUsage;
+    PlatformLockMutex(&usage->lock);
+    for(u32 i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        fprintf(file, "%s\"%s\":{\"bytes\":%llu,\"peakBytes\":%llu,\"allocationCount\":%u}",
+                i ? "," : "", memoryCategoryNames[i],
+                (unsigned long long)usage->bytes[i], (unsigned long long)usage->peakBytes[i], usage->allocationCounts[i]);
+    }
+    PlatformUnlockMutex(&usage->lock);
+    fprintf(file, "}}\n");
+    fflush(file);
+    monitor->snapshotCount++;
+}
 
-    WindowSurfaceDetails surfaceDetails = QueryWindowSurfaceDetails(ctx);
+// Once per frame. Budgets are refreshed by VMA as the frame index advances.
+void UpdateMemoryBudget(RenderContext* ctx, MemoryBudgetMonitor* monitor, u32 frame)
+{
+    vmaSetCurrentFrameIndex(ctx->apiMemoryAllocator, frame);
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(ctx->apiMemoryAllocator, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(ctx->apiMemoryAllocator, budgets);
+    for(u32 i = 0; i < memoryProperties->memoryHeapCount; i++)
+    {
+        u32 heapBit = 1u << i;
+        bool isOverThreshold = budgets[i].usage * 100 >= budgets[i].budget * monitor->warningPercent;
+        if(isOverThreshold && !(monitor->warnedHeaps & heapBit))
+        {
+            printf("[MEMORY]: Warning, heap %u (%s) at %.1f%% of its %.2f MB budget (frame %u)\n",
+                    i, memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "device" : "host",
+                    budgets[i].usage * 100.0 / MAX(budgets[i].budget, 1), (f64)budgets[i].budget / (1024.0 * 1024.0), frame);
+            monitor->warningCount++;
+        }
+        monitor->warnedHeaps = isOverThreshold ? monitor->warnedHeaps | heapBit : monitor->warnedHeaps & ~heapBit;
+    }
+    if(monitor->snapshotFile && frame % MEMORY_SNAPSHOT_INTERVAL == 0) WriteMemorySnapshot(ctx, monitor, frame);
+}
 
-    // Selecting swap chain parameters based on surface support
+void PrintMemoryUsage(RenderContext* ctx, MemoryBudgetMonitor* monitor)
+{
+    MemoryUsage* usage = &ctx->memoryUsage;
+    printf("[MEMORY]: %s budget, %u warnings, %u snapshots, MB in use (peak):",
+            ctx->supportsMemoryBudget ? "Driver" : "Estimated", monitor->warningCount, monitor->snapshotCount);
+    PlatformLockMutex(&usage->lock);
+    for(u32 i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        printf(" %s %.2f (%.2f)", memoryCategoryNames[i],
+                (f64)usage->bytes[i] / (1024.0 * 1024.0), (f64)usage->peakBytes[i] / (1024.0 * 1024.0));
+    }
+    PlatformUnlockMutex(&usage->lock);
+    printf("\n");
+}
+
+// Pipeline cache data is only reusable on the exact same driver and device,
+// check the header before handing it to Vulkan.
+bool IsPipelineCacheDataValid(RenderContext* ctx, const u8* data, u64 size)
+{
+    if(size < sizeof(VkPipelineCacheHeaderVersionOne)) return false;
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data, sizeof(header));
+    VkPhysicalDeviceProperties* properties = &ctx->apiPhysicalDeviceProperties;
+    if(header.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || header.headerSize > size) return false;
+    if(header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+    if(header.vendorID != properties->vendorID) return false;
+    if(header.deviceID != properties->deviceID) return false;
+    if(memcmp(header.pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+    return true;
+}
+
+void LoadPipelineCache(RenderContext* ctx, const char* path)
+{
+    ASSERT(ctx->apiPipelineCache == VK_NULL_HANDLE);
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    u64 dataSize = 0;
+    u8* data = ReadOptionalFileToArena(scratchScope.arena, path, &dataSize);
+    if(data && !IsPipelineCacheDataValid(ctx, data, dataSize))
+    {
+        printf("[PIPELINE_CACHE]: Discarding %s, created by a different driver or device.\n", path);
+        data = NULL;
+        dataSize = 0;
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheInfo = {};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheInfo.initialDataSize = dataSize;
+    pipelineCacheInfo.pInitialData = data;
+    VkResult ret = vkCreatePipelineCache(ctx->apiDevice, &pipelineCacheInfo, NULL, &ctx->apiPipelineCache);
+    VK_ASSERT(ret);
+    ctx->pipelineCacheWarm = data != NULL;
+}
+
+void SavePipelineCache(RenderContext* ctx, const char* path)
+{
+    if(ctx->apiPipelineCache == VK_NULL_HANDLE) return;
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    size_t dataSize = 0;
+    VkResult ret = vkGetPipelineCacheData(ctx->apiDevice, ctx->apiPipelineCache, &dataSize, NULL);
+    VK_ASSERT(ret);
+    u8* data = ARENA_PUSH_ARRAY(scratchScope.arena, u8, dataSize);
+    ret = vkGetPipelineCacheData(ctx->apiDevice, ctx->apiPipelineCache, &dataSize, data);
+    VK_ASSERT(ret);
+
+    if(!WriteFileAtomic(path, data, dataSize))
+    {
+        printf("[PIPELINE_CACHE]: Failed to write %s\n", path);
+        return;
+    }
+    printf("[PIPELINE_CACHE]: Saved %llu bytes to %s\n", (unsigned long long)dataSize, path);
+}
+
+VkSampler GetSampler(RenderContext* ctx, SamplerDesc desc)
+{
+    SamplerCache* cache = &ctx->samplerCache;
+    u64 hash = Hash64(&desc, sizeof(SamplerDesc));
+    if(!hash) hash = 1;     // 0 is reserved for empty slots
+
+    u32 slot = (u32)hash & (SAMPLER_CACHE_CAPACITY - 1);
+    while(cache->hashes[slot])
+    {
+        if(cache->hashes[slot] == hash && memcmp(&cache->descs[slot], &desc, sizeof(SamplerDesc)) == 0)
+        {
+            return cache->apiSamplers[slot];
+        }
+        slot = (slot + 1) & (SAMPLER_CACHE_CAPACITY - 1);
+    }
+    ASSERT(cache->count < SAMPLER_CACHE_CAPACITY / 2);  // Keep load factor low, and below device sampler limits
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.minFilter = samplerFilterToVk[desc.minFilter];
+    samplerInfo.magFilter = samplerFilterToVk[desc.magFilter];
+    samplerInfo.mipmapMode = samplerFilterToVkMipmapMode[desc.mipFilter];
+    samplerInfo.addressModeU = samplerAddressModeToVk[desc.addressModeU];
+    samplerInfo.addressModeV = samplerAddressModeToVk[desc.addressModeV];
+    samplerInfo.addressModeW = samplerAddressModeToVk[desc.addressModeW];
+    bool anisotropyEnable = desc.anisotropyEnable && ctx->apiPhysicalDeviceFeatures.samplerAnisotropy;
+    samplerInfo.anisotropyEnable = anisotropyEnable ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = anisotropyEnable ? ctx->apiPhysicalDeviceProperties.limits.maxSamplerAnisotropy : 1.f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipLodBias = 0.f;
+    samplerInfo.minLod = desc.minLod;
+    samplerInfo.maxLod = desc.maxLod;
+    VkSampler apiSampler;
+    VkResult ret = vkCreateSampler(ctx->apiDevice, &samplerInfo, NULL, &apiSampler);
+    VK_ASSERT(ret);
+
+    cache->hashes[slot] = hash;
+    cache->descs[slot] = desc;
+    cache->apiSamplers[slot] = apiSampler;
+    cache->count++;
+    return apiSampler;
+}
+
+// Sampler bindings get the default cached sampler as immutable sampler, descriptor writes only provide image views.
+// Sets with runtime arrays (bindless) need extra binding flags, and are not built here.
+VkDescriptorSetLayout GetDescriptorSetLayout(RenderContext* ctx, ShaderReflectionSet* set)
+{
+    ASSERT(!HasRuntimeArray(set));
+    DescriptorSetLayoutCache* cache = &ctx->descriptorSetLayoutCache;
+    u32 bindingKeys[SHADER_REFLECTION_MAX_BINDINGS][DESCRIPTOR_SET_LAYOUT_BINDING_KEY_SIZE];
+    for(i32 i = 0; i < set->bindingCount; i++)
+    {
+        VkDescriptorSetLayoutBinding* binding = &set->bindings[i];
+        bindingKeys[i][0] = binding->binding;
+        bindingKeys[i][1] = (u32)binding->descriptorType;
+        bindingKeys[i][2] = binding->descriptorCount;
+        bindingKeys[i][3] = binding->stageFlags;
+    }
+    u64 bindingKeysSize = set->bindingCount * sizeof(bindingKeys[0]);
+    u64 hash = Hash64(&set->bindingCount, sizeof(u32));
+    hash = Hash64(bindingKeys, bindingKeysSize, hash);
+    if(!hash) hash = 1;
+
+    u32 slot = (u32)hash & (DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY - 1);
+    while(cache->hashes[slot])
+    {
+        if(cache->hashes[slot] == hash && cache->bindingCounts[slot] == set->bindingCount
+                && memcmp(cache->bindingKeys[slot], bindingKeys, bindingKeysSize) == 0)
+        {
+            return cache->apiLayouts[slot];
+        }
+        slot = (slot + 1) & (DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY - 1);
+    }
+    ASSERT(cache->count < DESCRIPTOR_SET_LAYOUT_CACHE_CAPACITY / 2);
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    VkDescriptorSetLayoutBinding bindings[SHADER_REFLECTION_MAX_BINDINGS];
+    for(i32 i = 0; i < set->bindingCount; i++)
+    {
+        bindings[i] = set->bindings[i];
+        if(bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER
+                || bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+        {
+            VkSampler* immutableSamplers = ARENA_PUSH_ARRAY(scratchScope.arena, VkSampler, bindings[i].descriptorCount);
+            for(i32 j = 0; j < bindings[i].descriptorCount; j++)
+            {
+                immutableSamplers[j] = GetSampler(ctx, {});
+            }
+            bindings[i].pImmutableSamplers = immutableSamplers;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {};
+    descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.bindingCount = set->bindingCount;
+    descriptorSetLayoutInfo.pBindings = bindings;
+    VkDescriptorSetLayout apiLayout;
+    VkResult ret = vkCreateDescriptorSetLayout(ctx->apiDevice, &descriptorSetLayoutInfo, NULL, &apiLayout);
+    VK_ASSERT(ret);
+
+    cache->hashes[slot] = hash;
+    cache->bindingCounts[slot] = set->bindingCount;
+    memcpy(cache->bindingKeys[slot], bindingKeys, bindingKeysSize);
+    cache->apiLayouts[slot] = apiLayout;
+    cache->count++;
+    return apiLayout;
+}
+
+void BeginImmediateCommands(RenderContext* ctx)
+{
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult ret = vkBeginCommandBuffer(ctx->apiImmediateCommandBuffer, &commandBufferBeginInfo);
+    VK_ASSERT(ret);
+}
+
+void SubmitImmediateCommands(RenderContext* ctx)
+{
+    VkResult ret = vkEndCommandBuffer(ctx->apiImmediateCommandBuffer);
+    VK_ASSERT(ret);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &ctx->apiImmediateCommandBuffer;
+    
+    ret = vkQueueSubmit(ctx->apiCommandQueue, 1, &submitInfo, ctx->apiImmediateFence);
+    VK_ASSERT(ret);
+
+    // Immediate submit waits until commands are done to proceed.
+    vkWaitForFences(ctx->apiDevice, 1, &ctx->apiImmediateFence, VK_TRUE, UINT64_MAX);
+    vkResetFences(ctx->apiDevice, 1, &ctx->apiImmediateFence);
+    vkResetCommandPool(ctx->apiDevice, ctx->apiImmediateCommandPool, 0);
+}
+
+#if !RENDERER_HEADLESS
+#define SURFACE_MAX_FORMATS         16
+#define SURFACE_MAX_PRESENT_MODES   16
+
+struct WindowSurfaceDetails
+{
+    VkSurfaceCapabilitiesKHR capabilities;
+    u32 formatCount = -1;
+    VkSurfaceFormatKHR formats[SURFACE_MAX_FORMATS];
+    u32 presentModeCount = -1;
+    VkPresentModeKHR presentModes[SURFACE_MAX_PRESENT_MODES];
+};
+
+WindowSurfaceDetails QueryWindowSurfaceDetails(RenderContext* ctx)
+{
+    WindowSurfaceDetails result = {};
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.capabilities);
+
+    vkGetPhysicalDeviceSurfaceFormatsKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.formatCount, NULL);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.formatCount, result.formats);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.presentModeCount, NULL);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(ctx->apiPhysicalDevice, ctx->apiSurface, &result.presentModeCount, result.presentModes);
+
+    return result;
+}
+#endif
+
+// ===================================================================
+// Deferred destruction
+// Objects still referenced by frames in flight (e.g. a replaced swap chain) are queued with the frame they were
+// retired in, and destroyed once that frame's fence has been waited on, instead of idling the device.
+enum DeferredObjectType
+{
+    DEFERRED_OBJECT_IMAGE,          // With its VMA allocation, if any
+    DEFERRED_OBJECT_MEMORY,         // VMA allocation not owned by a resource (e.g. memory shared by aliased images)
+    DEFERRED_OBJECT_IMAGE_VIEW,
+    DEFERRED_OBJECT_FRAMEBUFFER,
+    DEFERRED_OBJECT_RENDER_PASS,
+    DEFERRED_OBJECT_SWAP_CHAIN,
+};
+
+struct DeferredObject
+{
+    DeferredObjectType type;
+    u64 apiHandle = 0;
+    VmaAllocation apiAllocation = VK_NULL_HANDLE;
+    u64 retireFrame = 0;
+};
+
+#define DEFERRED_DESTRUCTION_CAPACITY 128
+struct DeferredDestructionQueue
+{
+    u32 count = 0;
+    DeferredObject objects[DEFERRED_DESTRUCTION_CAPACITY];
+};
+
+void DestroyDeferredObject(RenderContext* ctx, DeferredObject* object)
+{
+    switch(object->type)
+    {
+        case DEFERRED_OBJECT_IMAGE:
+            UntrackAllocation(ctx, object->apiAllocation);
+            vmaDestroyImage(ctx->apiMemoryAllocator, (VkImage)object->apiHandle, object->apiAllocation); break;
+        case DEFERRED_OBJECT_MEMORY:
+            UntrackAllocation(ctx, object->apiAllocation);
+            vmaFreeMemory(ctx->apiMemoryAllocator, object->apiAllocation); break;
+        case DEFERRED_OBJECT_IMAGE_VIEW:
+            vkDestroyImageView(ctx->apiDevice, (VkImageView)object->apiHandle, NULL); break;
+        case DEFERRED_OBJECT_FRAMEBUFFER:
+            vkDestroyFramebuffer(ctx->apiDevice, (VkFramebuffer)object->apiHandle, NULL); break;
+        case DEFERRED_OBJECT_RENDER_PASS:
+            vkDestroyRenderPass(ctx->apiDevice, (VkRenderPass)object->apiHandle, NULL); break;
+        case DEFERRED_OBJECT_SWAP_CHAIN:
+#if !RENDERER_HEADLESS
+            vkDestroySwapchainKHR(ctx->apiDevice, (VkSwapchainKHR)object->apiHandle, NULL);
+#endif
+            break;
+        default: ASSERT(0);
+    }
+}
+
+// Destroys every object retired at least RENDERER_MAX_FRAMES_IN_FLIGHT frames before frame.
+// Call after waiting on frame's fence, which guarantees all earlier frames are complete. MAX_U64 flushes everything.
+void FlushDeferredDestruction(RenderContext* ctx, DeferredDestructionQueue* queue, u64 frame)
+{
+    u32 kept = 0;
+    for(u32 i = 0; i < queue->count; i++)
+    {
+        DeferredObject* object = &queue->objects[i];
+        if(frame == MAX_U64 || object->retireFrame + RENDERER_MAX_FRAMES_IN_FLIGHT <= frame)
+        {
+            DestroyDeferredObject(ctx, object);
+        }
+        else
+        {
+            queue->objects[kept++] = *object;
+        }
+    }
+    queue->count = kept;
+}
+
+// handle is any non dispatchable Vulkan handle, passed as (u64) so one queue holds every type.
+void DeferDestroy(RenderContext* ctx, DeferredDestructionQueue* queue, DeferredObjectType type, u64 apiHandle,
+        u64 retireFrame, VmaAllocation apiAllocation = VK_NULL_HANDLE)
+{
+    if(!apiHandle) return;
+    if(queue->count == DEFERRED_DESTRUCTION_CAPACITY)
+    {
+        // Only reached when objects are retired faster than frames complete (e.g. resizing every frame)
+        vkDeviceWaitIdle(ctx->apiDevice);
+        FlushDeferredDestruction(ctx, queue, MAX_U64);
+    }
+    DeferredObject* object = &queue->objects[queue->count++];
+    object->type = type;
+    object->apiHandle = apiHandle;
+    object->apiAllocation = apiAllocation;
+    object->retireFrame = retireFrame;
+}
+
+// ===================================================================
+// Swap chain
+
+// How frames are handed to the display. Unsupported policies fall back to vsync, which every surface supports.
+enum PresentPolicy
+{
+    PRESENT_POLICY_VSYNC,           // FIFO: one frame per vertical blank, never tears. Throttles the app to the refresh rate.
+    PRESENT_POLICY_MAILBOX,         // Newest frame replaces queued ones at vertical blank: no tearing, lower latency, unthrottled
+    PRESENT_POLICY_IMMEDIATE,       // No wait for vertical blank: lowest latency, may tear
+    PRESENT_POLICY_FIFO_RELAXED,    // FIFO, but a late frame is shown right away (may tear) instead of a whole interval later
+    PRESENT_POLICY_COUNT,
+};
+VkPresentModeKHR presentPolicyToVk[] =
+{
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+};
+const char* presentPolicyNames[] =
+{
+    "vsync",
+    "mailbox",
+    "immediate",
+    "fifo-relaxed",
+};
+
+bool ParsePresentPolicy(const char* name, PresentPolicy* outPolicy)
+{
+    for(i32 i = 0; i < PRESENT_POLICY_COUNT; i++)
+    {
+        if(strcmp(name, presentPolicyNames[i]) == 0)
+        {
+            *outPolicy = (PresentPolicy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* GetPresentModeName(VkPresentModeKHR presentMode)
+{
+    for(i32 i = 0; i < PRESENT_POLICY_COUNT; i++)
+    {
+        if(presentPolicyToVk[i] == presentMode) return presentPolicyNames[i];
+    }
+    return "unknown";
+}
+
+struct PresentSettings
+{
+    PresentPolicy policy = PRESENT_POLICY_MAILBOX;
+    u32 imageCount = 0;     // 0: surface minimum + 1. Clamped to the surface limits and SWAP_CHAIN_MAX_IMAGE_COUNT.
+};
+
+#define SWAP_CHAIN_MAX_IMAGE_COUNT 4
+// In headless mode the swap chain is a ring of offscreen images owned by the app, with the same interface,
+// so render passes and the frame loop don't care where frames end up.
+struct SwapChain
+{
+    VkSwapchainKHR      apiObject = VK_NULL_HANDLE;
+    VkFormat            format;
+    VkColorSpaceKHR     colorSpace;
+    VkPresentModeKHR    presentMode;                // What settings resolved to on this surface
+    VkExtent2D          extents;
+    PresentSettings     settings;                   // As requested, kept for resizes
+    bool                supportsReadback = false;   // Images can be copied from (see FrameReadback)
+    
+    u32         imageCount = 0;
+    VkImage     apiImages[SWAP_CHAIN_MAX_IMAGE_COUNT];
+    VkImageView apiImageViews[SWAP_CHAIN_MAX_IMAGE_COUNT];
+#if RENDERER_HEADLESS
+    VmaAllocation apiImageAllocations[SWAP_CHAIN_MAX_IMAGE_COUNT];
+    u32 acquireCount = 0;
+#endif
+};
+
+#if RENDERER_HEADLESS
+// One image per frame in flight: image i is only reused after the fence of the frame that last rendered to it.
+#define HEADLESS_SWAP_CHAIN_IMAGE_COUNT RENDERER_MAX_FRAMES_IN_FLIGHT
+
+void CreateHeadlessSwapChainImages(RenderContext* ctx, SwapChain* swapChain)
+{
+    swapChain->format = VK_FORMAT_B8G8R8A8_SRGB;
+    swapChain->colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
+    swapChain->presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;     // Unused, nothing is presented
+    swapChain->extents = { (u32)windowWidth, (u32)windowHeight };
+    swapChain->imageCount = HEADLESS_SWAP_CHAIN_IMAGE_COUNT;
+    swapChain->supportsReadback = true;
+
+    for(i32 i = 0; i < swapChain->imageCount; i++)
+    {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChain->extents.width;
+        imageInfo.extent.height = swapChain->extents.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = swapChain->format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;   // Transfer src for readback
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        VmaAllocationCreateInfo allocationInfo = {};
+        allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        VkResult ret = vmaCreateImage(ctx->apiMemoryAllocator, &imageInfo, &allocationInfo,
+                &swapChain->apiImages[i], &swapChain->apiImageAllocations[i], NULL);
+        VK_ASSERT(ret);
+        TrackAllocation(ctx, swapChain->apiImageAllocations[i], MEMORY_CATEGORY_ATTACHMENTS);
+    }
+}
+#endif
+
+// oldSwapChain (optional) is the swap chain being replaced: it is handed to the new one so presentation continues
+// without a gap. Its objects are left for the caller to retire (see ResizeSwapChain).
+SwapChain CreateSwapChain(RenderContext* ctx, const PresentSettings* settings, SwapChain* oldSwapChain = NULL)
+{
+    ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
+
+#if RENDERER_HEADLESS
+    SwapChain result = {};
+    result.settings = *settings;    // Nothing is presented, so only kept for the interface
+    CreateHeadlessSwapChainImages(ctx, &result);
+#else
+    WindowSurfaceDetails surfaceDetails = QueryWindowSurfaceDetails(ctx);
+
+    // Selecting swap chain parameters based on surface support
     VkFormat format;
     VkColorSpaceKHR colorSpace;
     VkPresentModeKHR presentMode;
@@ -586,22 +1673,30 @@ SwapChain CreateSwapChain(RenderContext* ctx)
         }
     }
 
-    // Finding adequate swap chain present mode (if not found, just use FIFO)
+    // Present mode from the requested policy (if not supported, just use FIFO)
     presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR requestedPresentMode = presentPolicyToVk[settings->policy];
     for(i32 i = 0; i < surfaceDetails.presentModeCount; i++)
     {
-        if(surfaceDetails.presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
+        if(surfaceDetails.presentModes[i] == requestedPresentMode)
         {
             presentMode = surfaceDetails.presentModes[i];
             break;
         }
     }
+    if(presentMode != requestedPresentMode && !oldSwapChain)
+    {
+        printf("[SWAP_CHAIN]: Present policy %s not supported by surface, using vsync\n", presentPolicyNames[settings->policy]);
+    }
 
     // Finding swap chain image details
     ASSERT(surfaceDetails.capabilities.currentExtent.width != -1);  // Deal with this only if needed later.
     extents = surfaceDetails.capabilities.currentExtent;
-    minImageCount = surfaceDetails.capabilities.minImageCount + 1;
+    // More images let the app queue more frames ahead of the display: throughput over latency
+    minImageCount = settings->imageCount ? settings->imageCount : surfaceDetails.capabilities.minImageCount + 1;
+    minImageCount = MAX(minImageCount, surfaceDetails.capabilities.minImageCount);
     if(surfaceDetails.capabilities.maxImageCount > 0) minImageCount = MIN(minImageCount, surfaceDetails.capabilities.maxImageCount);
+    minImageCount = MIN(minImageCount, SWAP_CHAIN_MAX_IMAGE_COUNT);
 
     // Create new swap chain based on details found
     SwapChain result = {};
@@ -615,12 +1710,16 @@ SwapChain CreateSwapChain(RenderContext* ctx)
     apiObjectInfo.imageArrayLayers = 1;
     apiObjectInfo.imageExtent = extents;
     apiObjectInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // Render directly to swap chain imgs
+    if(surfaceDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+    {
+        apiObjectInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;   // For frame readback
+    }
     apiObjectInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;     // Can't be shared between queues
     apiObjectInfo.preTransform = surfaceDetails.capabilities.currentTransform;
     apiObjectInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     apiObjectInfo.presentMode = presentMode;
     apiObjectInfo.clipped = VK_TRUE;
-    apiObjectInfo.oldSwapchain = VK_NULL_HANDLE;
+    apiObjectInfo.oldSwapchain = oldSwapChain ? oldSwapChain->apiObject : VK_NULL_HANDLE;
     VkResult ret = vkCreateSwapchainKHR(ctx->apiDevice, &apiObjectInfo, NULL, &apiObject);
     VK_ASSERT(ret);
 
@@ -628,13 +1727,16 @@ SwapChain CreateSwapChain(RenderContext* ctx)
     {
         apiObject, format, colorSpace, presentMode, extents
     };
+    result.settings = *settings;
+    result.supportsReadback = apiObjectInfo.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
     // Reference images and image views for new swap chain
     ret = vkGetSwapchainImagesKHR(ctx->apiDevice, result.apiObject, &result.imageCount, NULL);
     VK_ASSERT(ret);
-    ASSERT(result.imageCount != 0);
+    ASSERT(result.imageCount != 0 && result.imageCount <= SWAP_CHAIN_MAX_IMAGE_COUNT);
     ret = vkGetSwapchainImagesKHR(ctx->apiDevice, result.apiObject, &result.imageCount, result.apiImages);
     VK_ASSERT(ret);
+#endif
     for(i32 i = 0; i < result.imageCount; i++)
     {
         VkImageViewCreateInfo apiImageViewInfo = {};
@@ -655,69 +1757,6 @@ SwapChain CreateSwapChain(RenderContext* ctx)
         VK_ASSERT(ret);
     }
 
-    // Creating depth attachment resource
-    VkImageCreateInfo depthTextureInfo = {};
-    depthTextureInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    depthTextureInfo.imageType = VK_IMAGE_TYPE_2D;
-    depthTextureInfo.extent.width = extents.width;
-    depthTextureInfo.extent.height = extents.height;
-    depthTextureInfo.extent.depth = 1;
-    depthTextureInfo.mipLevels = 1;
-    depthTextureInfo.arrayLayers = 1;
-    depthTextureInfo.format = VK_FORMAT_D32_SFLOAT;
-    depthTextureInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    depthTextureInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;    // Hardcoded
-    depthTextureInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    depthTextureInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    depthTextureInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthTextureInfo.flags = 0;
-
-    VmaAllocationCreateInfo allocationInfo = {};
-    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    //allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-    VkImage apiDepthImage;
-    VmaAllocation apiDepthImageAllocation;
-    ret = vmaCreateImage(ctx->apiMemoryAllocator, &depthTextureInfo, &allocationInfo, &apiDepthImage, &apiDepthImageAllocation, NULL);
-    VK_ASSERT(ret);
-
-    VkImageViewCreateInfo depthImageViewInfo = {};
-    depthImageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    depthImageViewInfo.image = apiDepthImage;
-    depthImageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    depthImageViewInfo.format = VK_FORMAT_D32_SFLOAT;
-    depthImageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    depthImageViewInfo.subresourceRange.baseMipLevel = 0;
-    depthImageViewInfo.subresourceRange.levelCount = 1;
-    depthImageViewInfo.subresourceRange.baseArrayLayer = 0;
-    depthImageViewInfo.subresourceRange.layerCount = 1;
-    VkImageView depthImageView;
-    ret = vkCreateImageView(ctx->apiDevice, &depthImageViewInfo, NULL, &depthImageView);
-    VK_ASSERT(ret);
-
-    // Transition the depth resource to correct layout
-    BeginImmediateCommands(ctx);
-    VkImageMemoryBarrier resourceBarrier = {};
-    resourceBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    resourceBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    resourceBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    resourceBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.image = apiDepthImage;
-    resourceBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    resourceBarrier.subresourceRange.baseMipLevel = 0;
-    resourceBarrier.subresourceRange.levelCount = 1;
-    resourceBarrier.subresourceRange.baseArrayLayer = 0;
-    resourceBarrier.subresourceRange.layerCount = 1;
-    resourceBarrier.srcAccessMask = 0;
-    resourceBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    vkCmdPipelineBarrier(ctx->apiImmediateCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            0, 0, NULL, 0, NULL, 1, &resourceBarrier);
-    SubmitImmediateCommands(ctx);
-
-    result.apiDepthImage = apiDepthImage;
-    result.apiDepthImageAllocation = apiDepthImageAllocation;
-    result.apiDepthImageView = depthImageView;
     return result;
 }
 
@@ -729,43 +1768,210 @@ void DestroySwapChain(RenderContext* ctx, SwapChain* swapChain)
     {
         vkDestroyImageView(ctx->apiDevice, swapChain->apiImageViews[i], NULL);
     }
-    vkDestroyImageView(ctx->apiDevice, swapChain->apiDepthImageView, NULL);
-    vmaDestroyImage(ctx->apiMemoryAllocator, swapChain->apiDepthImage, swapChain->apiDepthImageAllocation);
+#if RENDERER_HEADLESS
+    for(i32 i = 0; i < swapChain->imageCount; i++)
+    {
+        UntrackAllocation(ctx, swapChain->apiImageAllocations[i]);
+        vmaDestroyImage(ctx->apiMemoryAllocator, swapChain->apiImages[i], swapChain->apiImageAllocations[i]);
+    }
+#else
     vkDestroySwapchainKHR(ctx->apiDevice, swapChain->apiObject, NULL);
+#endif
 
     *swapChain = {};
 }
 
-void ResizeSwapChain(RenderContext* ctx, SwapChain* swapChain)
+// Replaces the swap chain without waiting for the device. The old swap chain's objects are retired at frame,
+// and destroyed once the frames that may still use them are complete (see FlushDeferredDestruction).
+void ResizeSwapChain(RenderContext* ctx, SwapChain* swapChain, DeferredDestructionQueue* deferred, u64 frame)
 {
     ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
     ASSERT(swapChain);
-    DestroySwapChain(ctx, swapChain);
-    *swapChain = CreateSwapChain(ctx);
+    SwapChain oldSwapChain = *swapChain;
+    *swapChain = CreateSwapChain(ctx, &oldSwapChain.settings, &oldSwapChain);
+    for(i32 i = 0; i < oldSwapChain.imageCount; i++)
+    {
+        DeferDestroy(ctx, deferred, DEFERRED_OBJECT_IMAGE_VIEW, (u64)oldSwapChain.apiImageViews[i], frame);
+    }
+    DeferDestroy(ctx, deferred, DEFERRED_OBJECT_SWAP_CHAIN, (u64)oldSwapChain.apiObject, frame);
+#if RENDERER_HEADLESS
+    for(i32 i = 0; i < oldSwapChain.imageCount; i++)
+    {
+        DeferDestroy(ctx, deferred, DEFERRED_OBJECT_IMAGE, (u64)oldSwapChain.apiImages[i], frame, oldSwapChain.apiImageAllocations[i]);
+    }
+#endif
 }
 
-// ===================================================================
-// Render pass
-
-enum RenderPassLoadOp
+// Image to render the next frame to. acquireSemaphore is signaled when the image is ready (not used in headless mode).
+// Returns VK_ERROR_OUT_OF_DATE_KHR when the swap chain has to be resized first.
+VkResult AcquireSwapChainImage(RenderContext* ctx, SwapChain* swapChain, VkSemaphore acquireSemaphore, u32* outImageIndex)
 {
-    RENDER_PASS_LOAD_OP_LOAD,
-    RENDER_PASS_LOAD_OP_CLEAR,
-    RENDER_PASS_LOAD_OP_DONT_CARE,
-};
-VkAttachmentLoadOp renderPassLoadOpToVk[] =
+#if RENDERER_HEADLESS
+    *outImageIndex = swapChain->acquireCount++ % swapChain->imageCount;
+    return VK_SUCCESS;
+#else
+    return vkAcquireNextImageKHR(ctx->apiDevice, swapChain->apiObject, UINT64_MAX, acquireSemaphore, VK_NULL_HANDLE, outImageIndex);
+#endif
+}
+
+// Queues the image for presentation after renderSemaphore is signaled. No-op in headless mode.
+// presentId (0 for none) tags the present for vkWaitForPresentKHR, when ctx->supportsPresentWait.
+VkResult PresentSwapChainImage(RenderContext* ctx, SwapChain* swapChain, VkSemaphore renderSemaphore, u32 imageIndex, u64 presentId = 0)
 {
-    VK_ATTACHMENT_LOAD_OP_LOAD,
-    VK_ATTACHMENT_LOAD_OP_CLEAR,
-    VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-};
+#if RENDERER_HEADLESS
+    return VK_SUCCESS;
+#else
+    VkPresentIdKHR presentIdInfo = {};
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &presentId;
+
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = presentId ? &presentIdInfo : NULL;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &swapChain->apiObject;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &renderSemaphore;
+    presentInfo.pImageIndices = &imageIndex;
+    return vkQueuePresentKHR(ctx->apiCommandQueue, &presentInfo);
+#endif
+}
 
-enum RenderPassStoreOp
+// Presentation timing, to pick the present policy and image count from data.
+// Acquire wait is CPU time blocked before a frame can be recorded: on the frame fence (GPU behind, or
+// the present queue full) and in vkAcquireNextImageKHR. Submit to present is from vkQueueSubmit until the
+// frame is on screen, read with vkWaitForPresentKHR polls at frame start: accurate to within a frame.
+#define PRESENT_TIMING_MAX_PENDING 8
+struct PresentTiming
 {
-    RENDER_PASS_STORE_OP_STORE,
-    RENDER_PASS_STORE_OP_DONT_CARE,
+    u64 nextPresentId = 1;                          // Present ids must increase for each present to a swap chain
+    u32 pendingCount = 0;                           // Presents not known to be on screen yet, oldest first
+    u64 pendingIds[PRESENT_TIMING_MAX_PENDING];
+    u64 pendingSubmitTicks[PRESENT_TIMING_MAX_PENDING];
+
+    u64 frameCount = 0;
+    f64 fenceWaitMs = 0;
+    f64 maxFenceWaitMs = 0;
+    f64 acquireWaitMs = 0;
+    f64 maxAcquireWaitMs = 0;
+    u64 presentCount = 0;                           // Presents whose submit to present latency was measured
+    f64 submitToPresentMs = 0;
+    f64 maxSubmitToPresentMs = 0;
 };
-VkAttachmentStoreOp renderPassStoreOpToVk[] =
+
+void RecordAcquireWait(PresentTiming* timing, u64 fenceWaitTicks, u64 acquireWaitTicks)
+{
+    f64 fenceWaitMs = TimerTicksToMs(fenceWaitTicks);
+    f64 acquireWaitMs = TimerTicksToMs(acquireWaitTicks);
+    timing->frameCount++;
+    timing->fenceWaitMs += fenceWaitMs;
+    timing->maxFenceWaitMs = MAX(timing->maxFenceWaitMs, fenceWaitMs);
+    timing->acquireWaitMs += acquireWaitMs;
+    timing->maxAcquireWaitMs = MAX(timing->maxAcquireWaitMs, acquireWaitMs);
+}
+
+// Returns the id to present with, 0 when presents can't be timed.
+u64 BeginPresentTiming(RenderContext* ctx, PresentTiming* timing, u64 submitTicks)
+{
+#if RENDERER_HEADLESS
+    return 0;
+#else
+    if(!ctx->supportsPresentWait) return 0;
+    if(timing->pendingCount == PRESENT_TIMING_MAX_PENDING)
+    {
+        // Oldest one is dropped unmeasured, only happens if presents stall for several frames
+        timing->pendingCount--;
+        memmove(timing->pendingIds, timing->pendingIds + 1, timing->pendingCount * sizeof(u64));
+        memmove(timing->pendingSubmitTicks, timing->pendingSubmitTicks + 1, timing->pendingCount * sizeof(u64));
+    }
+    u64 presentId = timing->nextPresentId++;
+    timing->pendingIds[timing->pendingCount] = presentId;
+    timing->pendingSubmitTicks[timing->pendingCount] = submitTicks;
+    timing->pendingCount++;
+    return presentId;
+#endif
+}
+
+// Collects presents that reached the screen, without blocking.
+void PollPresentTiming(RenderContext* ctx, PresentTiming* timing, SwapChain* swapChain)
+{
+#if !RENDERER_HEADLESS
+    u32 doneCount = 0;
+    while(doneCount < timing->pendingCount)
+    {
+        VkResult ret = WaitForPresentKHR(ctx->apiDevice, swapChain->apiObject, timing->pendingIds[doneCount], 0);
+        if(ret == VK_TIMEOUT) break;
+        if(ret != VK_SUCCESS)
+        {
+            doneCount = timing->pendingCount;   // Swap chain out of date, these will never be seen
+            break;
+        }
+        f64 latencyMs = TimerTicksToMs(GetTimerTicks() - timing->pendingSubmitTicks[doneCount]);
+        timing->presentCount++;
+        timing->submitToPresentMs += latencyMs;
+        timing->maxSubmitToPresentMs = MAX(timing->maxSubmitToPresentMs, latencyMs);
+        doneCount++;
+    }
+    timing->pendingCount -= doneCount;
+    memmove(timing->pendingIds, timing->pendingIds + doneCount, timing->pendingCount * sizeof(u64));
+    memmove(timing->pendingSubmitTicks, timing->pendingSubmitTicks + doneCount, timing->pendingCount * sizeof(u64));
+#endif
+}
+
+// Pending presents belong to the old swap chain and can't be waited on anymore.
+void ResetPresentTiming(PresentTiming* timing)
+{
+    timing->pendingCount = 0;
+}
+
+void PrintPresentTiming(PresentTiming* timing, SwapChain* swapChain)
+{
+#if RENDERER_HEADLESS
+    const char* modeName = "offscreen";
+#else
+    const char* modeName = GetPresentModeName(swapChain->presentMode);
+#endif
+    f64 frames = MAX(timing->frameCount, 1);
+    printf("[PRESENT]: %s, %u images, acquire wait %.2f ms/frame (fence %.2f, max %.2f; acquire %.2f, max %.2f)",
+            modeName, swapChain->imageCount,
+            (timing->fenceWaitMs + timing->acquireWaitMs) / frames,
+            timing->fenceWaitMs / frames, timing->maxFenceWaitMs,
+            timing->acquireWaitMs / frames, timing->maxAcquireWaitMs);
+    if(timing->presentCount)
+    {
+        printf(", submit to present %.2f ms (max %.2f, %llu presents)\n",
+                timing->submitToPresentMs / timing->presentCount, timing->maxSubmitToPresentMs,
+                (unsigned long long)timing->presentCount);
+    }
+    else
+    {
+        printf(", submit to present not measured\n");
+    }
+}
+
+// ===================================================================
+// Render pass
+
+enum RenderPassLoadOp
+{
+    RENDER_PASS_LOAD_OP_LOAD,
+    RENDER_PASS_LOAD_OP_CLEAR,
+    RENDER_PASS_LOAD_OP_DONT_CARE,
+};
+VkAttachmentLoadOp renderPassLoadOpToVk[] =
+{
+    VK_ATTACHMENT_LOAD_OP_LOAD,
+    VK_ATTACHMENT_LOAD_OP_CLEAR,
+    VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+};
+
+enum RenderPassStoreOp
+{
+    RENDER_PASS_STORE_OP_STORE,
+    RENDER_PASS_STORE_OP_DONT_CARE,
+};
+VkAttachmentStoreOp renderPassStoreOpToVk[] =
 {
     VK_ATTACHMENT_STORE_OP_STORE,
     VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -790,6 +1996,7 @@ enum ImageLayout
     IMAGE_LAYOUT_PRESENT_SRC,
     IMAGE_LAYOUT_TRANSFER_DST,
     IMAGE_LAYOUT_SHADER_RO,
+    IMAGE_LAYOUT_TRANSFER_SRC,
 };
 VkImageLayout imageLayoutToVk[] =
 {
@@ -798,6 +2005,14 @@ VkImageLayout imageLayoutToVk[] =
     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+};
+
+// Depth convention of a pass, which sets its depth clear value and the compare op of its pipelines (see DepthTest).
+enum DepthRange
+{
+    DEPTH_RANGE_STANDARD,       // Near is 0, far is 1
+    DEPTH_RANGE_REVERSED,       // Near is 1, far is 0 (see InfiniteReversedZPerspectiveMatrix)
 };
 
 struct RenderPassColorOutputInfo
@@ -811,13 +2026,16 @@ struct RenderPassColorOutputInfo
 
 #define RENDER_PASS_MAX_FRAME_COUNT  4     // Multiple framebuffers for double/triple-buffering support
 #define RENDER_PASS_MAX_COLOR_OUTPUTS 8
+#define RENDER_PASS_MAX_ATTACHMENTS (RENDER_PASS_MAX_COLOR_OUTPUTS * 2 + 1)    // Color, depth, multisampled color
 // This contains actual image views used in framebuffer.
 // Each color/depth output info describes one of the images in this struct.
 // Render passes with multiple frames use the same output infos between frames.
 // Note: RenderPass is not responsible for image resource ownership, only holds references.
 struct RenderPassFrameOutputs
 {
-    VkImageView apiOutputImageViews[RENDER_PASS_MAX_COLOR_OUTPUTS]; // Note: this actually contains the depth image view also, at the end.
+    // Color outputs, then depth. Multisampled passes add their multisampled color images after depth,
+    // and the color outputs become the targets they resolve to.
+    VkImageView apiOutputImageViews[RENDER_PASS_MAX_ATTACHMENTS];
     //VkImageView apiDepthImageView = VK_NULL_HANDLE;
 };
 
@@ -834,12 +2052,81 @@ struct RenderPass
 
     u32 colorOutputCount;
     RenderPassColorOutputInfo colorOutputInfo[RENDER_PASS_MAX_COLOR_OUTPUTS];
+    u32 sampleCount = 1;
+    DepthRange depthRange = DEPTH_RANGE_STANDARD;
 };
 
+// Depth is cleared to the far end of the pass' range.
+VkClearDepthStencilValue GetRenderPassDepthClearValue(RenderPass* renderPass)
+{
+    return { renderPass->depthRange == DEPTH_RANGE_REVERSED ? 0.f : 1.f, 0 };
+}
+
+// Highest sample count up to requested that color and depth framebuffers both support.
+u32 GetSupportedSampleCount(RenderContext* ctx, u32 requested)
+{
+    VkPhysicalDeviceLimits* limits = &ctx->apiPhysicalDeviceProperties.limits;
+    VkSampleCountFlags supported = limits->framebufferColorSampleCounts & limits->framebufferDepthSampleCounts;
+    u32 result = 1;
+    for(u32 count = 2; count <= 64 && count <= requested; count *= 2)
+    {
+        if(supported & count) result = count;
+    }
+    return result;
+}
+
+u32 GetRenderPassAttachmentCount(RenderPass* renderPass)
+{
+    u32 result = renderPass->colorOutputCount + 1;     // +1 for depth attachment
+    if(renderPass->sampleCount > 1) result += renderPass->colorOutputCount;
+    return result;
+}
+
+// One framebuffer per frame, over frameOutputs (see RenderPassFrameOutputs).
+void CreateRenderPassFramebuffers(RenderContext* ctx, RenderPass* renderPass, u32 frameCount, u32 width, u32 height,
+        RenderPassFrameOutputs* frameOutputs)
+{
+    ASSERT(frameCount > 0);
+    ASSERT(frameCount <= RENDER_PASS_MAX_FRAME_COUNT);
+    u32 attachmentCount = GetRenderPassAttachmentCount(renderPass);
+    for(i32 i = 0; i < frameCount; i++)
+    {
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass->apiObject;
+        framebufferInfo.attachmentCount = attachmentCount;
+        framebufferInfo.pAttachments = frameOutputs[i].apiOutputImageViews;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+
+        VkFramebuffer framebuffer;
+        VkResult ret = vkCreateFramebuffer(ctx->apiDevice, &framebufferInfo, NULL, &framebuffer);
+        VK_ASSERT(ret);
+        renderPass->apiFramebuffers[i] = framebuffer;
+        for(i32 j = 0; j < attachmentCount; j++)
+        {
+            renderPass->frameOutputs[i].apiOutputImageViews[j] = frameOutputs[i].apiOutputImageViews[j];
+        }
+    }
+    renderPass->frameCount = frameCount;
+    renderPass->outputWidth = width;
+    renderPass->outputHeight = height;
+}
+
+// sampleCount > 1 renders to multisampled color outputs that are resolved into colorOutputInfo's outputs at the end
+// of the pass, and never stored themselves (see RenderPassFrameOutputs for the image order).
+// Depth and multisampled color start and end in their attachment layouts, as should color outputs: the pass then
+// does no layout transitions of its own and needs no external subpass dependency, the render graph's barriers
+// around it synchronize every attachment (see RenderGraph).
 RenderPass CreateRenderPass(RenderContext* ctx, u32 frameCount, u32 width, u32 height,
-        u32 colorOutputCount, RenderPassColorOutputInfo* colorOutputInfo, RenderPassFrameOutputs* frameOutputs)
+        u32 colorOutputCount, RenderPassColorOutputInfo* colorOutputInfo, RenderPassFrameOutputs* frameOutputs, u32 sampleCount = 1,
+        DepthRange depthRange = DEPTH_RANGE_STANDARD)
 {
+    ASSERT(colorOutputCount <= RENDER_PASS_MAX_COLOR_OUTPUTS);
+    bool isMultisampled = sampleCount > 1;
     VkAttachmentDescription colorAttachments[RENDER_PASS_MAX_COLOR_OUTPUTS] = {0};
+    VkAttachmentDescription multisampledColorAttachments[RENDER_PASS_MAX_COLOR_OUTPUTS] = {0};
     VkAttachmentDescription depthAttachment = {};
     for(i32 i = 0; i < colorOutputCount; i++)
     {
@@ -848,25 +2135,42 @@ RenderPass CreateRenderPass(RenderContext* ctx, u32 frameCount, u32 width, u32 h
         colorAttachments[i].finalLayout = imageLayoutToVk[colorOutputInfo[i].finalLayout];
         colorAttachments[i].loadOp = renderPassLoadOpToVk[colorOutputInfo[i].loadOp];
         colorAttachments[i].storeOp = renderPassStoreOpToVk[colorOutputInfo[i].storeOp];
-        colorAttachments[i].samples = VK_SAMPLE_COUNT_1_BIT;    // No support for multisampling
+        colorAttachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
         colorAttachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        if(isMultisampled)
+        {
+            // Drawing happens on the multisampled image, which is loaded like the output would have been.
+            // The output is only written by the resolve, so its previous contents don't matter.
+            multisampledColorAttachments[i] = colorAttachments[i];
+            multisampledColorAttachments[i].samples = (VkSampleCountFlagBits)sampleCount;
+            multisampledColorAttachments[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            multisampledColorAttachments[i].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            multisampledColorAttachments[i].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            ASSERT(colorOutputInfo[i].loadOp != RENDER_PASS_LOAD_OP_LOAD);     // Would need the samples stored
+            colorAttachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        }
     }
     depthAttachment.format = VK_FORMAT_D32_SFLOAT;
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.samples = (VkSampleCountFlagBits)sampleCount;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkAttachmentReference colorOutputRefs[colorOutputCount];
+    ScratchScope scratchScope(GetThreadScratchArena());
+    VkAttachmentReference* colorOutputRefs = ARENA_PUSH_ARRAY(scratchScope.arena, VkAttachmentReference, colorOutputCount);
+    VkAttachmentReference* resolveOutputRefs = ARENA_PUSH_ARRAY(scratchScope.arena, VkAttachmentReference, colorOutputCount);
     VkAttachmentReference depthOutputRef = {};
     for(i32 i = 0; i < colorOutputCount; i++)
     {
-        colorOutputRefs[i].attachment = i;
+        // Multisampled color attachments come after depth
+        colorOutputRefs[i].attachment = isMultisampled ? colorOutputCount + 1 + i : i;
         colorOutputRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        resolveOutputRefs[i].attachment = i;
+        resolveOutputRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     }
     depthOutputRef.attachment = colorOutputCount;   // depth attachment comes after all color attachments
     depthOutputRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -876,20 +2180,17 @@ RenderPass CreateRenderPass(RenderContext* ctx, u32 frameCount, u32 width, u32 h
     subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpassDesc.colorAttachmentCount = colorOutputCount;
     subpassDesc.pColorAttachments = colorOutputRefs;
+    subpassDesc.pResolveAttachments = isMultisampled ? resolveOutputRefs : NULL;
     subpassDesc.pDepthStencilAttachment = &depthOutputRef;
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     // Creating render pass
-    VkAttachmentDescription allAttachments[colorOutputCount + 1];
+    u32 attachmentCount = colorOutputCount + 1;
+    if(isMultisampled) attachmentCount += colorOutputCount;
+    VkAttachmentDescription* allAttachments = ARENA_PUSH_ARRAY(scratchScope.arena, VkAttachmentDescription, attachmentCount);
     for(i32 i = 0; i < colorOutputCount; i++)
     {
         allAttachments[i] = colorAttachments[i];
+        if(isMultisampled) allAttachments[colorOutputCount + 1 + i] = multisampledColorAttachments[i];
     }
     allAttachments[colorOutputCount] = depthAttachment;
 
@@ -897,53 +2198,41 @@ RenderPass CreateRenderPass(RenderContext* ctx, u32 frameCount, u32 width, u32 h
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpassDesc;
-    renderPassInfo.attachmentCount = ARR_LEN(allAttachments);
+    renderPassInfo.attachmentCount = attachmentCount;
     renderPassInfo.pAttachments = allAttachments;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = 0;
     VkRenderPass renderPass;
     VkResult ret = vkCreateRenderPass(ctx->apiDevice, &renderPassInfo, NULL, &renderPass);
     VK_ASSERT(ret);
 
     RenderPass result = {};
     result.apiObject = renderPass;
-
-    // Creating output framebuffers
-    ASSERT(frameCount > 0);
-    ASSERT(frameCount <= RENDER_PASS_MAX_FRAME_COUNT);
-    for(i32 i = 0; i < frameCount; i++)
-    {
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = colorOutputCount + 1;     // +1 for depth attachment
-        framebufferInfo.pAttachments = frameOutputs[i].apiOutputImageViews;
-        framebufferInfo.width = width;
-        framebufferInfo.height = height;
-        framebufferInfo.layers = 1;
-
-        VkFramebuffer framebuffer;
-        ret = vkCreateFramebuffer(ctx->apiDevice, &framebufferInfo, NULL, &framebuffer);
-        VK_ASSERT(ret);
-        result.apiFramebuffers[i] = framebuffer;
-    }
-
-    result.frameCount = frameCount;
-    result.outputWidth = width;
-    result.outputHeight = height;
     result.colorOutputCount = colorOutputCount;
-    for(i32 i = 0; i < colorOutputCount + 1; i++)   // +1 for depth buffer
+    result.sampleCount = sampleCount;
+    result.depthRange = depthRange;
+    for(i32 i = 0; i < colorOutputCount; i++)
     {
         result.colorOutputInfo[i] = colorOutputInfo[i];
-        for(i32 j = 0; j < frameCount; j++)
-        {
-            result.frameOutputs[j].apiOutputImageViews[i] = frameOutputs[j].apiOutputImageViews[i];
-        }
     }
+    CreateRenderPassFramebuffers(ctx, &result, frameCount, width, height, frameOutputs);
 
     return result;
 }
 
+// Points the render pass at new outputs (e.g. after a swap chain resize). The VkRenderPass is kept, so pipelines
+// created against it stay valid; the old framebuffers are retired at frame (see FlushDeferredDestruction).
+void ResizeRenderPass(RenderContext* ctx, RenderPass* renderPass, u32 frameCount, u32 width, u32 height,
+        RenderPassFrameOutputs* frameOutputs, DeferredDestructionQueue* deferred, u64 frame)
+{
+    ASSERT(renderPass->apiObject != VK_NULL_HANDLE);
+    for(i32 i = 0; i < renderPass->frameCount; i++)
+    {
+        DeferDestroy(ctx, deferred, DEFERRED_OBJECT_FRAMEBUFFER, (u64)renderPass->apiFramebuffers[i], frame);
+        renderPass->apiFramebuffers[i] = VK_NULL_HANDLE;
+    }
+    CreateRenderPassFramebuffers(ctx, renderPass, frameCount, width, height, frameOutputs);
+}
+
 void DestroyRenderPass(RenderContext* ctx, RenderPass* renderPass)
 {
     ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
@@ -957,691 +2246,2628 @@ void DestroyRenderPass(RenderContext* ctx, RenderPass* renderPass)
     *renderPass = {};
 }
 
-void OnResize(RenderContext* ctx, SwapChain* swapChain, RenderPass* presentRenderPass)
+// ===================================================================
+// Render graph
+// Passes declare the images they use and how, and the graph works out everything in between: passes whose outputs
+// nothing uses are culled, barriers and layout transitions are derived from consecutive uses of each image and batched
+// into one vkCmdPipelineBarrier per pass, and transient images whose lifetimes don't overlap share memory.
+// A graph is compiled once (and again on resize), then executed every frame. Imported images (e.g. the swap chain
+// image) are owned outside the graph, and can change between executions.
+
+// How an image is used, which sets the pipeline stages and accesses to synchronize and the layout it must be in.
+enum ResourceAccess
 {
-    vkDeviceWaitIdle(ctx->apiDevice);
+    RESOURCE_ACCESS_NONE,                   // Contents not needed (e.g. before an image is first written)
+    RESOURCE_ACCESS_SWAP_CHAIN_ACQUIRE,     // Just acquired, contents not needed. Frames wait on acquire at color output.
+    RESOURCE_ACCESS_COLOR_OUTPUT,
+    RESOURCE_ACCESS_DEPTH_OUTPUT,
+    RESOURCE_ACCESS_SHADER_READ,            // Sampled in pixel shaders
+    RESOURCE_ACCESS_TRANSFER_READ,
+    RESOURCE_ACCESS_TRANSFER_WRITE,
+    RESOURCE_ACCESS_PRESENT,
+    RESOURCE_ACCESS_COUNT,
+};
 
-    // First, verify if this is a minimize and if so, wait until window size is valid.
-    WindowSurfaceDetails surfaceDetails = QueryWindowSurfaceDetails(ctx);
-    while(surfaceDetails.capabilities.currentExtent.width == 0
-    || surfaceDetails.capabilities.currentExtent.height == 0)
+struct ResourceAccessInfo
+{
+    VkPipelineStageFlags apiStages;
+    VkAccessFlags apiAccess;
+    VkImageLayout apiLayout;
+    VkImageUsageFlags apiUsage;             // Image usage the access needs
+    bool isWrite;
+};
+ResourceAccessInfo resourceAccessToVk[] =
+{
+    { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false },
+    { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false },
     {
-        WaitMessage();
-        ProcessWindowMessages();
-        surfaceDetails = QueryWindowSurfaceDetails(ctx);
-    }
-
-    ResizeSwapChain(ctx, swapChain);
-    DestroyRenderPass(ctx, presentRenderPass);
-
-    u32 presentRenderPassColorOutputCount = 1;
-    RenderPassColorOutputInfo presentRenderPassColorOutputInfo[] =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true
+    },
     {
-        {
-            RENDER_PASS_LOAD_OP_CLEAR,
-            RENDER_PASS_STORE_OP_STORE,
-            IMAGE_LAYOUT_UNDEFINED,
-            IMAGE_LAYOUT_PRESENT_SRC,
-            IMAGE_FORMAT_BGRA8_SRGB,
-        }
-    };
-    // Each swap chain image is tied to the first color output of each frame in the present pass.
-    // This can probably be improved for clarity.
-    RenderPassFrameOutputs presentRenderPassFrameOutputs[swapChain->imageCount];
-    for(i32 i = 0; i < swapChain->imageCount; i++)
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true
+    },
     {
-        for(i32 j = 0; j < presentRenderPassColorOutputCount; j++)
-        {
-            presentRenderPassFrameOutputs[i].apiOutputImageViews[j] = swapChain->apiImageViews[i];
-        }
-        presentRenderPassFrameOutputs[i].apiOutputImageViews[presentRenderPassColorOutputCount] = swapChain->apiDepthImageView;
-    }
-    *presentRenderPass = CreateRenderPass(ctx, 
-            swapChain->imageCount, swapChain->extents.width, swapChain->extents.height, 1,
-            presentRenderPassColorOutputInfo, presentRenderPassFrameOutputs);
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false
+    },
+    {
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false
+    },
+    {
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true
+    },
+    { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, false },
 };
 
-// ===================================================================
-// Graphics resources
+// Access swap chain images end each frame in. Headless images have no presentation engine to hand off to,
+// PRESENT_SRC is only valid with VK_KHR_swapchain.
+#if RENDERER_HEADLESS
+#define RESOURCE_ACCESS_SWAP_CHAIN_OUTPUT RESOURCE_ACCESS_TRANSFER_READ
+#else
+#define RESOURCE_ACCESS_SWAP_CHAIN_OUTPUT RESOURCE_ACCESS_PRESENT
+#endif
 
-// Position (v3f), Vertex color (v3f), Texture coordinates (v2f)
-f32 defaultTriangleVertices[] =
+// Synchronization state of an image between uses.
+struct ResourceState
 {
-    // Front face
-    -1.f, -1.f, 1.f, 1, 0, 0, 0.f, 1.f,   // BL
-     1.f, -1.f, 1.f, 0, 1, 0, 1.f, 1.f,   // BR
-     1.f,  1.f, 1.f, 1, 1, 1, 1.f, 0.f,   // TR
-    -1.f,  1.f, 1.f, 0, 0, 1, 0.f, 0.f,   // TL
+    VkImageLayout apiLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags apiStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;     // Of every use since the last barrier
+    VkAccessFlags apiWriteAccess = 0;                                       // Writes not yet made available
+};
 
-    // Back face
-     1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
-    -1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
-    -1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
-     1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+ResourceState GetResourceState(ResourceAccess access)
+{
+    ResourceAccessInfo* info = &resourceAccessToVk[access];
+    return { info->apiLayout, info->apiStages, info->isWrite ? info->apiAccess : 0 };
+}
 
-    // Top face
-    -1.f,  1.f,  1.f, 1, 0, 0, 0.f, 1.f,   // BL
-     1.f,  1.f,  1.f, 0, 1, 0, 1.f, 1.f,   // BR
-     1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
-    -1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+// Moves state to a new access. A barrier is needed on layout changes and around writes (read after write,
+// write after write, write after read), then it's filled in and true is returned. Reads in the same layout
+// need none, their stages are merged so a later write waits on all of them.
+bool AdvanceResourceState(ResourceState* state, ResourceAccess access,
+        VkImageMemoryBarrier* outBarrier, VkPipelineStageFlags* outSrcStages, VkPipelineStageFlags* outDstStages)
+{
+    ResourceAccessInfo* info = &resourceAccessToVk[access];
+    if(state->apiLayout == info->apiLayout && !state->apiWriteAccess && !info->isWrite)
+    {
+        state->apiStages |= info->apiStages;
+        return false;
+    }
+    *outBarrier = {};
+    outBarrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    outBarrier->oldLayout = state->apiLayout;
+    outBarrier->newLayout = info->apiLayout;
+    outBarrier->srcAccessMask = state->apiWriteAccess;
+    outBarrier->dstAccessMask = info->apiAccess;
+    outBarrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    outBarrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    outBarrier->subresourceRange.levelCount = 1;
+    outBarrier->subresourceRange.layerCount = 1;
+    *outSrcStages = state->apiStages;
+    *outDstStages = info->apiStages;
+    *state = GetResourceState(access);
+    return true;
+}
 
-    // Bottom face
-    -1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
-     1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
-     1.f, -1.f,  1.f, 1, 1, 1, 1.f, 0.f,   // TR
-    -1.f, -1.f,  1.f, 0, 0, 1, 0.f, 0.f,   // TL
+// Single image barrier between two accesses, for work outside a render graph (e.g. uploads).
+void RecordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect,
+        ResourceAccess from, ResourceAccess to)
+{
+    ResourceState state = GetResourceState(from);
+    VkImageMemoryBarrier barrier;
+    VkPipelineStageFlags srcStages, dstStages;
+    if(!AdvanceResourceState(&state, to, &barrier, &srcStages, &dstStages)) return;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
 
-    // Left face
-    -1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
-    -1.f, -1.f,  1.f, 0, 1, 0, 1.f, 1.f,   // BR
-    -1.f,  1.f,  1.f, 1, 1, 1, 1.f, 0.f,   // TR
-    -1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+#define RENDER_GRAPH_MAX_IMAGES 16
+#define RENDER_GRAPH_MAX_PASSES 16
+#define RENDER_GRAPH_MAX_PASS_USES 8
+#define RENDER_GRAPH_MAX_BARRIERS (RENDER_GRAPH_MAX_PASSES * RENDER_GRAPH_MAX_PASS_USES + RENDER_GRAPH_MAX_IMAGES)
+#define RENDER_GRAPH_NONE MAX_U32
 
-    // Right face
-     1.f, -1.f,  1.f, 1, 0, 0, 0.f, 1.f,   // BL
-     1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
-     1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
-     1.f,  1.f,  1.f, 0, 0, 1, 0.f, 0.f,   // TL
+struct RenderGraph;
+typedef void (*RenderGraphPassProc)(RenderGraph* graph, VkCommandBuffer commandBuffer, void* userData);
 
+struct RenderGraphImage
+{
+    const char* name = NULL;
+    VkFormat format;
+    VkImageAspectFlags aspect;
+    u32 sampleCount = 1;
+    bool isImported = false;
+    ResourceAccess initialAccess = RESOURCE_ACCESS_NONE;    // Imported only: access the image comes in and must leave in
+    ResourceAccess finalAccess = RESOURCE_ACCESS_NONE;
+
+    // Compiled
+    VkImageUsageFlags usage = 0;
+    u32 firstPass = RENDER_GRAPH_NONE;      // Lifetime, over passes that aren't culled
+    u32 lastPass = RENDER_GRAPH_NONE;
+    ResourceState endState;                 // After the last use, which the next frame's first use waits on
+    bool isLazy = false;                    // Lazily allocated memory, otherwise it's placed in the graph's shared memory
+    u64 memoryOffset = 0;
+    u64 memorySize = 0;
+
+    // Transients are created by the graph, imported images are set before each execution
+    VkImage apiImage = VK_NULL_HANDLE;
+    VkImageView apiImageView = VK_NULL_HANDLE;
+    VmaAllocation apiAllocation = VK_NULL_HANDLE;     // Lazily allocated images only
 };
 
-u32 defaultTriangleIndices[] =
+struct RenderGraphUse
 {
-    0, 1, 2, 0, 2, 3,
-    4, 5, 6, 4, 6, 7,
-    8, 9, 10, 8, 10, 11,
-    12, 13, 14, 12, 14, 15,
-    16, 17, 18, 16, 18, 19,
-    20, 21, 22, 20, 22, 23,
+    u32 image;
+    ResourceAccess access;
 };
 
-enum BufferType
+struct RenderGraphPass
 {
-    BUFFER_TYPE_VERTEX,
-    BUFFER_TYPE_INDEX,
-    BUFFER_TYPE_UNIFORM,
-    BUFFER_TYPE_STAGING,
+    const char* name = NULL;
+    RenderGraphPassProc proc = NULL;
+    void* userData = NULL;
+    bool hasSideEffects = false;            // Work outside the graph (e.g. readback), never culled
+    u32 useCount = 0;
+    RenderGraphUse uses[RENDER_GRAPH_MAX_PASS_USES];
+
+    bool isCulled = false;                  // Compiled
 };
-VkBufferUsageFlags bufferTypeToVk[] =
+
+// Barriers recorded before a pass (or after the last one) in a single vkCmdPipelineBarrier.
+struct RenderGraphBarrierBatch
 {
-    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VkPipelineStageFlags apiSrcStages = 0;
+    VkPipelineStageFlags apiDstStages = 0;
+    u32 firstBarrier = 0;
+    u32 barrierCount = 0;
 };
 
-struct Buffer
+struct RenderGraphBarrier
 {
-    VkBuffer apiObject;
-    VmaAllocation apiAllocation;
-    BufferType type;
-    u32 size = 0;
-    u32 stride = 0;
-    u32 count = 0;
+    u32 image;                              // Image handle is filled in at execution
+    VkImageMemoryBarrier apiBarrier;
 };
 
-Buffer CreateBuffer(RenderContext* ctx, BufferType type, u32 size, u32 count, u8* data)
+struct RenderGraph
 {
-    ASSERT(count);
-    ASSERT(size >= count);
-    // Create buffer
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = bufferTypeToVk[type];
+    u32 imageCount = 0;
+    RenderGraphImage images[RENDER_GRAPH_MAX_IMAGES];
+    u32 passCount = 0;
+    RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
 
-    //TODO(caio): Allow for changing allocation params later on
-    VmaAllocationCreateInfo allocationInfo = {};
-    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    // Compiled
+    u32 width = 0;                          // Size of transient images
+    u32 height = 0;
+    RenderGraphBarrierBatch batches[RENDER_GRAPH_MAX_PASSES + 1];   // One per pass, then final transitions of imported images
+    u32 barrierCount = 0;
+    RenderGraphBarrier barriers[RENDER_GRAPH_MAX_BARRIERS];
+
+    // Transients are kept while the graph's images stay the same and fit (e.g. when shrinking the window)
+    u64 transientHash = 0;
+    u32 transientWidth = 0;
+    u32 transientHeight = 0;
+    VmaAllocation apiTransientMemory = VK_NULL_HANDLE;
+
+    // Stats
+    u32 culledPassCount = 0;
+    u32 batchCount = 0;                     // Non-empty batches, each one vkCmdPipelineBarrier per execution
+    u32 lazyImageCount = 0;
+    u64 transientMemorySize = 0;            // Shared memory, with aliasing
+    u64 unaliasedMemorySize = 0;            // What it would take without
+};
 
-    VkBuffer buffer;
-    VmaAllocation allocation;
-    VkResult ret = vmaCreateBuffer(ctx->apiMemoryAllocator, &bufferInfo, &allocationInfo, &buffer, &allocation, NULL);
-    VK_ASSERT(ret);
+void InitRenderGraph(RenderGraph* graph)
+{
+    *graph = {};
+}
 
-    // Copy buffer data (later move to staging buffer)
-    if(data)
-    {
-        void* bufferDataMapping = NULL;
-        vmaMapMemory(ctx->apiMemoryAllocator, allocation, &bufferDataMapping);
-        memcpy(bufferDataMapping, data, size);
-        vmaUnmapMemory(ctx->apiMemoryAllocator, allocation);
-    }
+// Image owned outside the graph. Its handles are set with SetRenderGraphImage before each execution.
+u32 ImportRenderGraphImage(RenderGraph* graph, const char* name, VkFormat format, VkImageAspectFlags aspect,
+        ResourceAccess initialAccess, ResourceAccess finalAccess)
+{
+    ASSERT(graph->imageCount < RENDER_GRAPH_MAX_IMAGES);
+    RenderGraphImage* image = &graph->images[graph->imageCount];
+    *image = {};
+    image->name = name;
+    image->format = format;
+    image->aspect = aspect;
+    image->isImported = true;
+    image->initialAccess = initialAccess;
+    image->finalAccess = finalAccess;
+    return graph->imageCount++;
+}
 
-    Buffer result = {};
-    result.type = type;
-    result.apiObject = buffer;
-    result.apiAllocation = allocation;
-    result.size = size;
-    result.count = count;
-    result.stride = size / count;
-    return result;
+// Transient image, the size of the graph. Its contents don't outlive a graph execution.
+u32 AddRenderGraphImage(RenderGraph* graph, const char* name, VkFormat format, VkImageAspectFlags aspect, u32 sampleCount = 1)
+{
+    ASSERT(graph->imageCount < RENDER_GRAPH_MAX_IMAGES);
+    RenderGraphImage* image = &graph->images[graph->imageCount];
+    *image = {};
+    image->name = name;
+    image->format = format;
+    image->aspect = aspect;
+    image->sampleCount = sampleCount;
+    return graph->imageCount++;
 }
 
-void DestroyBuffer(RenderContext* ctx, Buffer buffer)
+// Passes execute in the order they are added.
+u32 AddRenderGraphPass(RenderGraph* graph, const char* name, RenderGraphPassProc proc, void* userData, bool hasSideEffects = false)
 {
-    ASSERT(ctx);
-    ASSERT(ctx->apiMemoryAllocator != VK_NULL_HANDLE);
-    vmaDestroyBuffer(ctx->apiMemoryAllocator, buffer.apiObject, buffer.apiAllocation);
+    ASSERT(graph->passCount < RENDER_GRAPH_MAX_PASSES);
+    RenderGraphPass* pass = &graph->passes[graph->passCount];
+    *pass = {};
+    pass->name = name;
+    pass->proc = proc;
+    pass->userData = userData;
+    pass->hasSideEffects = hasSideEffects;
+    return graph->passCount++;
 }
 
-enum TextureType
+// Color and depth outputs count as overwriting the image (cleared or fully covered), not reading it.
+void AddRenderGraphUse(RenderGraph* graph, u32 pass, u32 image, ResourceAccess access)
 {
-    TEXTURE_TYPE_2D,
-};
+    RenderGraphPass* graphPass = &graph->passes[pass];
+    ASSERT(graphPass->useCount < RENDER_GRAPH_MAX_PASS_USES);
+    for(u32 i = 0; i < graphPass->useCount; i++) ASSERT(graphPass->uses[i].image != image);   // One access per image and pass
+    graphPass->uses[graphPass->useCount++] = { image, access };
+}
+
+void SetRenderGraphImage(RenderGraph* graph, u32 image, VkImage apiImage, VkImageView apiImageView)
+{
+    ASSERT(graph->images[image].isImported);
+    graph->images[image].apiImage = apiImage;
+    graph->images[image].apiImageView = apiImageView;
+}
+
+VkImage GetRenderGraphImage(RenderGraph* graph, u32 image)
+{
+    return graph->images[image].apiImage;
+}
+
+VkImageView GetRenderGraphImageView(RenderGraph* graph, u32 image)
+{
+    return graph->images[image].apiImageView;
+}
+
+bool DoRenderGraphLifetimesOverlap(RenderGraphImage* a, RenderGraphImage* b)
+{
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+bool DoRenderGraphMemoryRangesOverlap(RenderGraphImage* a, u64 offset, RenderGraphImage* b)
+{
+    return offset < b->memoryOffset + b->memorySize && b->memoryOffset < offset + a->memorySize;
+}
+
+// Transients the graph created, retired at frame (NULL deferred destroys them right away).
+void ReleaseRenderGraphTransients(RenderContext* ctx, RenderGraph* graph, DeferredDestructionQueue* deferred, u64 frame)
+{
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        if(image->isImported || image->apiImage == VK_NULL_HANDLE) continue;
+        if(deferred)
+        {
+            DeferDestroy(ctx, deferred, DEFERRED_OBJECT_IMAGE_VIEW, (u64)image->apiImageView, frame);
+            DeferDestroy(ctx, deferred, DEFERRED_OBJECT_IMAGE, (u64)image->apiImage, frame, image->apiAllocation);
+        }
+        else
+        {
+            vkDestroyImageView(ctx->apiDevice, image->apiImageView, NULL);
+            UntrackAllocation(ctx, image->apiAllocation);
+            vmaDestroyImage(ctx->apiMemoryAllocator, image->apiImage, image->apiAllocation);
+        }
+        image->apiImage = VK_NULL_HANDLE;
+        image->apiImageView = VK_NULL_HANDLE;
+        image->apiAllocation = VK_NULL_HANDLE;
+    }
+    if(graph->apiTransientMemory)
+    {
+        if(deferred) DeferDestroy(ctx, deferred, DEFERRED_OBJECT_MEMORY, (u64)graph->apiTransientMemory, frame, graph->apiTransientMemory);
+        else
+        {
+            UntrackAllocation(ctx, graph->apiTransientMemory);
+            vmaFreeMemory(ctx->apiMemoryAllocator, graph->apiTransientMemory);
+        }
+        graph->apiTransientMemory = VK_NULL_HANDLE;
+    }
+    graph->transientHash = 0;
+}
+
+// Creates the transient images, at the graph's size. Images used by a single pass never leave it (not loaded, not
+// stored): where the device has lazily allocated memory (tiled GPUs) they get it, and take no real memory.
+// The rest are placed in one allocation, where images whose lifetimes don't overlap share memory.
+void CreateRenderGraphTransients(RenderContext* ctx, RenderGraph* graph)
+{
+    u32 placedCount = 0;
+    u32 placed[RENDER_GRAPH_MAX_IMAGES];
+    VkMemoryRequirements memoryRequirements = {};
+    memoryRequirements.memoryTypeBits = MAX_U32;
+    graph->lazyImageCount = 0;
+    graph->unaliasedMemorySize = 0;
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        if(image->isImported || image->firstPass == RENDER_GRAPH_NONE) continue;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = graph->width;
+        imageInfo.extent.height = graph->height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = image->format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = image->usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = (VkSampleCountFlagBits)image->sampleCount;
+
+        VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        image->isLazy = false;
+        if(image->firstPass == image->lastPass && !(image->usage & ~attachmentUsage))
+        {
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+            VmaAllocationCreateInfo allocationInfo = {};
+            allocationInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+            VkResult ret = vmaCreateImage(ctx->apiMemoryAllocator, &imageInfo, &allocationInfo,
+                    &image->apiImage, &image->apiAllocation, NULL);
+            if(ret != VK_ERROR_FEATURE_NOT_PRESENT)     // No lazily allocated memory type (most desktop GPUs)
+            {
+                VK_ASSERT(ret);
+                TrackAllocation(ctx, image->apiAllocation, MEMORY_CATEGORY_ATTACHMENTS);   // Requested size, rarely committed
+                image->isLazy = true;
+                graph->lazyImageCount++;
+            }
+        }
+        if(!image->isLazy)
+        {
+            VkResult ret = vkCreateImage(ctx->apiDevice, &imageInfo, NULL, &image->apiImage);
+            VK_ASSERT(ret);
+            VkMemoryRequirements imageRequirements;
+            vkGetImageMemoryRequirements(ctx->apiDevice, image->apiImage, &imageRequirements);
+            image->memorySize = imageRequirements.size;
+            memoryRequirements.alignment = MAX(memoryRequirements.alignment, imageRequirements.alignment);
+            memoryRequirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+            graph->unaliasedMemorySize += imageRequirements.size;
+
+            // Largest first, so small images fill the gaps
+            u32 j = placedCount++;
+            for(; j > 0 && graph->images[placed[j - 1]].memorySize < image->memorySize; j--) placed[j] = placed[j - 1];
+            placed[j] = i;
+        }
+    }
+
+    // Each image goes at the lowest offset clear of every placed image it's alive with
+    memoryRequirements.size = 0;
+    for(u32 i = 0; i < placedCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[placed[i]];
+        u64 offset = 0;
+        bool moved = true;
+        while(moved)
+        {
+            moved = false;
+            for(u32 j = 0; j < i; j++)
+            {
+                RenderGraphImage* other = &graph->images[placed[j]];
+                if(DoRenderGraphLifetimesOverlap(image, other) && DoRenderGraphMemoryRangesOverlap(image, offset, other))
+                {
+                    offset = AlignUp(other->memoryOffset + other->memorySize, memoryRequirements.alignment);
+                    moved = true;
+                }
+            }
+        }
+        image->memoryOffset = offset;
+        memoryRequirements.size = MAX(memoryRequirements.size, offset + image->memorySize);
+    }
+    graph->transientMemorySize = memoryRequirements.size;
+
+    if(placedCount)
+    {
+        ASSERT(memoryRequirements.memoryTypeBits);      // Images must share a memory type to alias
+        VmaAllocationCreateInfo allocationInfo = {};
+        allocationInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VkResult ret = vmaAllocateMemory(ctx->apiMemoryAllocator, &memoryRequirements, &allocationInfo,
+                &graph->apiTransientMemory, NULL);
+        VK_ASSERT(ret);
+        TrackAllocation(ctx, graph->apiTransientMemory, MEMORY_CATEGORY_ATTACHMENTS);
+        for(u32 i = 0; i < placedCount; i++)
+        {
+            RenderGraphImage* image = &graph->images[placed[i]];
+            ret = vmaBindImageMemory2(ctx->apiMemoryAllocator, graph->apiTransientMemory, image->memoryOffset, image->apiImage, NULL);
+            VK_ASSERT(ret);
+        }
+    }
+
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        if(image->isImported || image->apiImage == VK_NULL_HANDLE) continue;
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image->apiImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = image->format;
+        viewInfo.subresourceRange.aspectMask = image->aspect;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VkResult ret = vkCreateImageView(ctx->apiDevice, &viewInfo, NULL, &image->apiImageView);
+        VK_ASSERT(ret);
+    }
+    graph->transientWidth = graph->width;
+    graph->transientHeight = graph->height;
+}
+
+// Culls passes, computes image lifetimes and barriers, and (re)creates transient images for width x height.
+// Replaced transients are retired at frame, so recompiling (e.g. on resize) never waits on the device.
+void CompileRenderGraph(RenderContext* ctx, RenderGraph* graph, u32 width, u32 height, DeferredDestructionQueue* deferred, u64 frame)
+{
+    // Culling, from the last pass back: a pass stays if it has side effects or writes an image that is imported
+    // or read by a pass that stays.
+    bool isNeeded[RENDER_GRAPH_MAX_IMAGES] = {};
+    for(u32 i = 0; i < graph->imageCount; i++) isNeeded[i] = graph->images[i].isImported;
+    graph->culledPassCount = 0;
+    for(i32 i = graph->passCount - 1; i >= 0; i--)
+    {
+        RenderGraphPass* pass = &graph->passes[i];
+        pass->isCulled = !pass->hasSideEffects;
+        for(u32 j = 0; j < pass->useCount; j++)
+        {
+            RenderGraphUse* use = &pass->uses[j];
+            if(resourceAccessToVk[use->access].isWrite && isNeeded[use->image]) pass->isCulled = false;
+        }
+        if(pass->isCulled)
+        {
+            graph->culledPassCount++;
+            continue;
+        }
+        for(u32 j = 0; j < pass->useCount; j++)
+        {
+            RenderGraphUse* use = &pass->uses[j];
+            if(!resourceAccessToVk[use->access].isWrite) isNeeded[use->image] = true;
+        }
+    }
+
+    // Lifetimes, usage, and the state each image ends a frame in
+    VkImageMemoryBarrier unusedBarrier;
+    VkPipelineStageFlags unusedSrcStages, unusedDstStages;
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        image->usage = 0;
+        image->firstPass = RENDER_GRAPH_NONE;
+        image->lastPass = RENDER_GRAPH_NONE;
+        image->endState = GetResourceState(image->isImported ? image->initialAccess : RESOURCE_ACCESS_NONE);
+    }
+    for(u32 i = 0; i < graph->passCount; i++)
+    {
+        RenderGraphPass* pass = &graph->passes[i];
+        if(pass->isCulled) continue;
+        for(u32 j = 0; j < pass->useCount; j++)
+        {
+            RenderGraphImage* image = &graph->images[pass->uses[j].image];
+            image->usage |= resourceAccessToVk[pass->uses[j].access].apiUsage;
+            if(image->firstPass == RENDER_GRAPH_NONE) image->firstPass = i;
+            image->lastPass = i;
+            AdvanceResourceState(&image->endState, pass->uses[j].access, &unusedBarrier, &unusedSrcStages, &unusedDstStages);
+        }
+    }
+
+    // Transients are recreated when they change, or no longer fit
+    u64 transientHash = HASH_SEED_DEFAULT;
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        if(image->isImported) continue;
+        transientHash = Hash64(&image->format, sizeof(VkFormat), transientHash);
+        transientHash = Hash64(&image->sampleCount, sizeof(u32), transientHash);
+        transientHash = Hash64(&image->usage, sizeof(VkImageUsageFlags), transientHash);
+        transientHash = Hash64(&image->firstPass, sizeof(u32), transientHash);
+        transientHash = Hash64(&image->lastPass, sizeof(u32), transientHash);
+    }
+    graph->width = width;
+    graph->height = height;
+    if(transientHash != graph->transientHash || width > graph->transientWidth || height > graph->transientHeight)
+    {
+        ReleaseRenderGraphTransients(ctx, graph, deferred, frame);
+        CreateRenderGraphTransients(ctx, graph);
+        graph->transientHash = transientHash;
+    }
+
+    // Barriers. A transient's first use waits on the end of the last frame's uses of its memory,
+    // by itself or the images it's aliased with.
+    ResourceState states[RENDER_GRAPH_MAX_IMAGES];
+    for(u32 i = 0; i < graph->imageCount; i++)
+    {
+        RenderGraphImage* image = &graph->images[i];
+        states[i] = GetResourceState(image->isImported ? image->initialAccess : RESOURCE_ACCESS_NONE);
+        if(image->isImported || image->firstPass == RENDER_GRAPH_NONE) continue;
+        states[i].apiStages = image->endState.apiStages;
+        states[i].apiWriteAccess = image->endState.apiWriteAccess;
+        if(image->isLazy) continue;
+        for(u32 j = 0; j < graph->imageCount; j++)
+        {
+            RenderGraphImage* other = &graph->images[j];
+            if(j == i || other->isImported || other->isLazy || other->firstPass == RENDER_GRAPH_NONE) continue;
+            if(DoRenderGraphMemoryRangesOverlap(image, image->memoryOffset, other))
+            {
+                states[i].apiStages |= other->endState.apiStages;
+                states[i].apiWriteAccess |= other->endState.apiWriteAccess;
+            }
+        }
+    }
+    graph->barrierCount = 0;
+    graph->batchCount = 0;
+    for(u32 i = 0; i <= graph->passCount; i++)
+    {
+        RenderGraphBarrierBatch* batch = &graph->batches[i];
+        *batch = {};
+        batch->firstBarrier = graph->barrierCount;
+        bool isFinal = i == graph->passCount;
+        if(!isFinal && graph->passes[i].isCulled) continue;
+        u32 useCount = isFinal ? graph->imageCount : graph->passes[i].useCount;
+        for(u32 j = 0; j < useCount; j++)
+        {
+            u32 imageIndex = isFinal ? j : graph->passes[i].uses[j].image;
+            RenderGraphImage* image = &graph->images[imageIndex];
+            if(isFinal && !image->isImported) continue;     // Transients are left as they are
+            ResourceAccess access = isFinal ? image->finalAccess : graph->passes[i].uses[j].access;
+            RenderGraphBarrier* barrier = &graph->barriers[graph->barrierCount];
+            VkPipelineStageFlags srcStages, dstStages;
+            if(!AdvanceResourceState(&states[imageIndex], access, &barrier->apiBarrier, &srcStages, &dstStages)) continue;
+            ASSERT(graph->barrierCount < RENDER_GRAPH_MAX_BARRIERS);
+            barrier->image = imageIndex;
+            barrier->apiBarrier.subresourceRange.aspectMask = image->aspect;
+            batch->apiSrcStages |= srcStages;
+            batch->apiDstStages |= dstStages;
+            batch->barrierCount++;
+            graph->barrierCount++;
+        }
+        if(batch->barrierCount) graph->batchCount++;
+    }
+}
+
+void RecordRenderGraphBarriers(RenderGraph* graph, VkCommandBuffer commandBuffer, RenderGraphBarrierBatch* batch)
+{
+    if(!batch->barrierCount) return;
+    VkImageMemoryBarrier apiBarriers[RENDER_GRAPH_MAX_IMAGES];
+    ASSERT(batch->barrierCount <= RENDER_GRAPH_MAX_IMAGES);     // At most one per image
+    for(u32 i = 0; i < batch->barrierCount; i++)
+    {
+        RenderGraphBarrier* barrier = &graph->barriers[batch->firstBarrier + i];
+        apiBarriers[i] = barrier->apiBarrier;
+        apiBarriers[i].image = graph->images[barrier->image].apiImage;
+        ASSERT(apiBarriers[i].image != VK_NULL_HANDLE);
+    }
+    vkCmdPipelineBarrier(commandBuffer, batch->apiSrcStages, batch->apiDstStages,
+            0, 0, NULL, 0, NULL, batch->barrierCount, apiBarriers);
+}
+
+// Records every pass that wasn't culled, each after its barriers. Imported images are left in their final access.
+void ExecuteRenderGraph(RenderGraph* graph, VkCommandBuffer commandBuffer)
+{
+    for(u32 i = 0; i < graph->passCount; i++)
+    {
+        RenderGraphPass* pass = &graph->passes[i];
+        if(pass->isCulled) continue;
+        RecordRenderGraphBarriers(graph, commandBuffer, &graph->batches[i]);
+        pass->proc(graph, commandBuffer, pass->userData);
+    }
+    RecordRenderGraphBarriers(graph, commandBuffer, &graph->batches[graph->passCount]);
+}
+
+void DestroyRenderGraph(RenderContext* ctx, RenderGraph* graph)
+{
+    ReleaseRenderGraphTransients(ctx, graph, NULL, 0);
+    *graph = {};
+}
+
+void PrintRenderGraphStats(RenderGraph* graph)
+{
+    printf("[RENDER_GRAPH]: %u passes (%u culled), %u barriers in %u batches, transient memory %.2f MB (%.2f MB unaliased), %u lazily allocated images\n",
+            graph->passCount, graph->culledPassCount, graph->barrierCount, graph->batchCount,
+            (f64)graph->transientMemorySize / (1024.0 * 1024.0), (f64)graph->unaliasedMemorySize / (1024.0 * 1024.0),
+            graph->lazyImageCount);
+}
+
+// Graph images of a pass that renders to the swap chain: color is the imported swap chain image, which multisampled
+// color resolves to when the pass is multisampled. Depth and multisampled color are transients.
+struct SwapChainPassImages
+{
+    u32 color = RENDER_GRAPH_NONE;
+    u32 depth = RENDER_GRAPH_NONE;
+    u32 multisampledColor = RENDER_GRAPH_NONE;
+};
+
+// Frame outputs of a pass that renders to the swap chain: each swap chain image is tied to the color outputs
+// of its frame, with the shared depth (and multisampled color) images of the graph.
+void GetSwapChainFrameOutputs(SwapChain* swapChain, RenderGraph* graph, SwapChainPassImages* images,
+        u32 colorOutputCount, RenderPassFrameOutputs* outFrameOutputs)
+{
+    for(i32 i = 0; i < swapChain->imageCount; i++)
+    {
+        for(i32 j = 0; j < colorOutputCount; j++)
+        {
+            outFrameOutputs[i].apiOutputImageViews[j] = swapChain->apiImageViews[i];
+            if(images->multisampledColor != RENDER_GRAPH_NONE)
+            {
+                outFrameOutputs[i].apiOutputImageViews[colorOutputCount + 1 + j] = GetRenderGraphImageView(graph, images->multisampledColor);
+            }
+        }
+        outFrameOutputs[i].apiOutputImageViews[colorOutputCount] = GetRenderGraphImageView(graph, images->depth);
+    }
+}
+
+#if !RENDERER_HEADLESS
+// Recreates the swap chain, the graph's transients and the present pass framebuffers without idling the device:
+// frames still in flight finish on the old objects, which are retired at frame.
+void OnResize(RenderContext* ctx, SwapChain* swapChain, RenderGraph* graph, SwapChainPassImages* images,
+        RenderPass* presentRenderPass, DeferredDestructionQueue* deferred, u64 frame)
+{
+    // First, verify if this is a minimize and if so, wait until window size is valid.
+    WindowSurfaceDetails surfaceDetails = QueryWindowSurfaceDetails(ctx);
+    while(surfaceDetails.capabilities.currentExtent.width == 0
+    || surfaceDetails.capabilities.currentExtent.height == 0)
+    {
+        WaitMessage();
+        ProcessWindowMessages();
+        surfaceDetails = QueryWindowSurfaceDetails(ctx);
+    }
+
+    ResizeSwapChain(ctx, swapChain, deferred, frame);
+    CompileRenderGraph(ctx, graph, swapChain->extents.width, swapChain->extents.height, deferred, frame);
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    RenderPassFrameOutputs* presentRenderPassFrameOutputs = ARENA_PUSH_ARRAY(scratchScope.arena, RenderPassFrameOutputs, swapChain->imageCount);
+    GetSwapChainFrameOutputs(swapChain, graph, images, presentRenderPass->colorOutputCount, presentRenderPassFrameOutputs);
+    ResizeRenderPass(ctx, presentRenderPass,
+            swapChain->imageCount, swapChain->extents.width, swapChain->extents.height,
+            presentRenderPassFrameOutputs, deferred, frame);
+};
+#endif
+
+// ===================================================================
+// Graphics resources
+
+// Position (v3f), Vertex color (v3f), Texture coordinates (v2f)
+// Source data only, it's quantized into defaultVertexFormats before upload.
+VertexFormat defaultSourceVertexFormats[] = { VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32_FLOAT };
+// Position (half4, w = 1), Vertex color (unorm8x4, a = 1), Texture coordinates (unorm16x2): 16 bytes instead of 32.
+VertexFormat defaultVertexFormats[] = { VERTEX_FORMAT_R16G16B16A16_FLOAT, VERTEX_FORMAT_R8G8B8A8_UNORM, VERTEX_FORMAT_R16G16_UNORM };
+f32 defaultTriangleVertices[] =
+{
+    // Front face
+    -1.f, -1.f, 1.f, 1, 0, 0, 0.f, 1.f,   // BL
+     1.f, -1.f, 1.f, 0, 1, 0, 1.f, 1.f,   // BR
+     1.f,  1.f, 1.f, 1, 1, 1, 1.f, 0.f,   // TR
+    -1.f,  1.f, 1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+    // Back face
+     1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
+    -1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
+    -1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
+     1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+    // Top face
+    -1.f,  1.f,  1.f, 1, 0, 0, 0.f, 1.f,   // BL
+     1.f,  1.f,  1.f, 0, 1, 0, 1.f, 1.f,   // BR
+     1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
+    -1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+    // Bottom face
+    -1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
+     1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
+     1.f, -1.f,  1.f, 1, 1, 1, 1.f, 0.f,   // TR
+    -1.f, -1.f,  1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+    // Left face
+    -1.f, -1.f, -1.f, 1, 0, 0, 0.f, 1.f,   // BL
+    -1.f, -1.f,  1.f, 0, 1, 0, 1.f, 1.f,   // BR
+    -1.f,  1.f,  1.f, 1, 1, 1, 1.f, 0.f,   // TR
+    -1.f,  1.f, -1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+    // Right face
+     1.f, -1.f,  1.f, 1, 0, 0, 0.f, 1.f,   // BL
+     1.f, -1.f, -1.f, 0, 1, 0, 1.f, 1.f,   // BR
+     1.f,  1.f, -1.f, 1, 1, 1, 1.f, 0.f,   // TR
+     1.f,  1.f,  1.f, 0, 0, 1, 0.f, 0.f,   // TL
+
+};
+
+u32 defaultTriangleIndices[] =
+{
+    0, 1, 2, 0, 2, 3,
+    4, 5, 6, 4, 6, 7,
+    8, 9, 10, 8, 10, 11,
+    12, 13, 14, 12, 14, 15,
+    16, 17, 18, 16, 18, 19,
+    20, 21, 22, 20, 22, 23,
+};
+
+enum BufferType
+{
+    BUFFER_TYPE_VERTEX,
+    BUFFER_TYPE_INDEX,
+    BUFFER_TYPE_UNIFORM,
+    BUFFER_TYPE_STAGING,
+    BUFFER_TYPE_READBACK,
+};
+VkBufferUsageFlags bufferTypeToVk[] =
+{
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+};
+MemoryCategory bufferTypeToMemoryCategory[] =
+{
+    MEMORY_CATEGORY_GEOMETRY,
+    MEMORY_CATEGORY_GEOMETRY,
+    MEMORY_CATEGORY_UNIFORMS,
+    MEMORY_CATEGORY_TRANSFER,
+    MEMORY_CATEGORY_TRANSFER,
+};
+
+enum IndexType
+{
+    INDEX_TYPE_U16,
+    INDEX_TYPE_U32,
+};
+VkIndexType indexTypeToVk[] =
+{
+    VK_INDEX_TYPE_UINT16,
+    VK_INDEX_TYPE_UINT32,
+};
+
+struct Buffer
+{
+    VkBuffer apiObject;
+    VmaAllocation apiAllocation;
+    BufferType type;
+    IndexType indexType = INDEX_TYPE_U32;  // Index buffers only, from stride
+    u64 size = 0;
+    u64 stride = 0;
+    u64 count = 0;
+};
+
+// Copies data into a host visible buffer.
+void UploadBufferData(RenderContext* ctx, Buffer* buffer, u64 offset, const void* data, u64 size)
+{
+    ASSERT(offset <= buffer->size && size <= buffer->size - offset);
+    u8* bufferDataMapping = NULL;
+    VkResult ret = vmaMapMemory(ctx->apiMemoryAllocator, buffer->apiAllocation, (void**)&bufferDataMapping);
+    VK_ASSERT(ret);
+    memcpy(bufferDataMapping + offset, data, size);
+    vmaUnmapMemory(ctx->apiMemoryAllocator, buffer->apiAllocation);
+    vmaFlushAllocation(ctx->apiMemoryAllocator, buffer->apiAllocation, offset, size);
+}
+
+Buffer CreateBuffer(RenderContext* ctx, BufferType type, u64 size, u64 count, u8* data)
+{
+    ASSERT(count);
+    ASSERT(size >= count);
+    // Create buffer
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = bufferTypeToVk[type];
+
+    //TODO(caio): Allow for changing allocation params later on
+    VmaAllocationCreateInfo allocationInfo = {};
+    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    if(type == BUFFER_TYPE_READBACK)
+    {
+        // Read by the CPU, prefers cached host memory
+        allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+    }
+
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    VkResult ret = vmaCreateBuffer(ctx->apiMemoryAllocator, &bufferInfo, &allocationInfo, &buffer, &allocation, NULL);
+    VK_ASSERT(ret);
+    TrackAllocation(ctx, allocation, bufferTypeToMemoryCategory[type]);
+
+    Buffer result = {};
+    result.type = type;
+    result.apiObject = buffer;
+    result.apiAllocation = allocation;
+    result.size = size;
+    result.count = count;
+    result.stride = size / count;
+    if(type == BUFFER_TYPE_INDEX)
+    {
+        ASSERT(result.stride == sizeof(u16) || result.stride == sizeof(u32));
+        result.indexType = result.stride == sizeof(u16) ? INDEX_TYPE_U16 : INDEX_TYPE_U32;
+    }
+
+    // Copy buffer data (later move to staging buffer)
+    if(data)
+    {
+        UploadBufferData(ctx, &result, 0, data, size);
+    }
+    return result;
+}
+
+void DestroyBuffer(RenderContext* ctx, Buffer buffer)
+{
+    ASSERT(ctx);
+    ASSERT(ctx->apiMemoryAllocator != VK_NULL_HANDLE);
+    UntrackAllocation(ctx, buffer.apiAllocation);
+    vmaDestroyBuffer(ctx->apiMemoryAllocator, buffer.apiObject, buffer.apiAllocation);
+}
+
+// Geometry arena: large vertex and index buffers that meshes are suballocated from (and freed back to, when streaming),
+// so a whole scene draws with one vertex and one index buffer bind.
+// An arena holds a single vertex layout and index type. Ranges are in vertices and indices, which vkCmdDrawIndexed
+// takes as vertexOffset and firstIndex, so meshes keep their own local (16 bit) indices.
+#define GEOMETRY_ARENA_VERTEX_CAPACITY  (1 << 20)
+#define GEOMETRY_ARENA_INDEX_CAPACITY   (1 << 22)
+#define GEOMETRY_ARENA_MAX_ALLOCATIONS  1024
+struct GeometryArena
+{
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+};
+
+struct GeometryAllocation
+{
+    RangeAllocation vertices;
+    RangeAllocation indices;
+    u32 vertexOffset = 0;
+    u32 firstIndex = 0;
+};
+
+GeometryArena CreateGeometryArena(RenderContext* ctx, u64 vertexStride, IndexType indexType,
+        u64 vertexCapacity, u64 indexCapacity, Arena* arena)
+{
+    // vkCmdDrawIndexed takes a signed 32 bit vertexOffset
+    ASSERT(vertexCapacity <= MAX_I32 && indexCapacity <= MAX_U32);
+    u64 indexSize = indexType == INDEX_TYPE_U16 ? sizeof(u16) : sizeof(u32);
+    GeometryArena result = {};
+    result.vertexBuffer = CreateBuffer(ctx, BUFFER_TYPE_VERTEX, vertexCapacity * vertexStride, vertexCapacity, NULL);
+    result.indexBuffer = CreateBuffer(ctx, BUFFER_TYPE_INDEX, indexCapacity * indexSize, indexCapacity, NULL);
+    InitRangeAllocator(&result.vertexAllocator, vertexCapacity, GEOMETRY_ARENA_MAX_ALLOCATIONS, arena);
+    InitRangeAllocator(&result.indexAllocator, indexCapacity, GEOMETRY_ARENA_MAX_ALLOCATIONS, arena);
+    return result;
+}
+
+void DestroyGeometryArena(RenderContext* ctx, GeometryArena* geometry)
+{
+    DestroyBuffer(ctx, geometry->vertexBuffer);
+    DestroyBuffer(ctx, geometry->indexBuffer);
+    *geometry = {};
+}
+
+// Copies vertices (in the arena's layout) and indices (indexSize bytes each, converted to the arena's index type) in.
+// Returns false when the arena has no room left.
+bool AllocateGeometry(RenderContext* ctx, GeometryArena* geometry, const u8* vertexData, u64 vertexCount,
+        const void* indices, u64 indexSize, u64 indexCount, GeometryAllocation* outAllocation)
+{
+    GeometryAllocation result = {};
+    result.vertices = AllocateRange(&geometry->vertexAllocator, vertexCount);
+    result.indices = AllocateRange(&geometry->indexAllocator, indexCount);
+    if(result.vertices.block == RANGE_BLOCK_NONE || result.indices.block == RANGE_BLOCK_NONE)
+    {
+        FreeRange(&geometry->vertexAllocator, result.vertices);
+        FreeRange(&geometry->indexAllocator, result.indices);
+        return false;
+    }
+    result.vertexOffset = (u32)result.vertices.offset;
+    result.firstIndex = (u32)result.indices.offset;
+
+    Buffer* vertexBuffer = &geometry->vertexBuffer;
+    UploadBufferData(ctx, vertexBuffer, result.vertices.offset * vertexBuffer->stride, vertexData, vertexCount * vertexBuffer->stride);
+    Buffer* indexBuffer = &geometry->indexBuffer;
+    const void* convertedIndices = indices;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    if(indexSize != indexBuffer->stride)
+    {
+        void* converted = ArenaPush(scratchScope.arena, indexCount * indexBuffer->stride);
+        for(u64 i = 0; i < indexCount; i++)
+        {
+            u32 index = indexSize == sizeof(u16) ? ((const u16*)indices)[i] : ((const u32*)indices)[i];
+            if(indexBuffer->indexType == INDEX_TYPE_U16)
+            {
+                ASSERT(index <= MAX_U16);
+                ((u16*)converted)[i] = (u16)index;
+            }
+            else ((u32*)converted)[i] = index;
+        }
+        convertedIndices = converted;
+    }
+    UploadBufferData(ctx, indexBuffer, result.indices.offset * indexBuffer->stride, convertedIndices, indexCount * indexBuffer->stride);
+    *outAllocation = result;
+    return true;
+}
+
+void FreeGeometry(GeometryArena* geometry, GeometryAllocation* allocation)
+{
+    FreeRange(&geometry->vertexAllocator, allocation->vertices);
+    FreeRange(&geometry->indexAllocator, allocation->indices);
+    *allocation = {};
+}
+
+enum TextureType
+{
+    TEXTURE_TYPE_2D,
+};
 VkImageType textureTypeToVk[] =
 {
-    VK_IMAGE_TYPE_2D,
+    VK_IMAGE_TYPE_2D,
+};
+VkImageViewType textureTypeToVkView[] =
+{
+    VK_IMAGE_VIEW_TYPE_2D,
+};
+
+struct Texture
+{
+    VkImage apiObject = VK_NULL_HANDLE;
+    VmaAllocation apiAllocation;
+    VkImageView apiImageView = VK_NULL_HANDLE;  // This is just here for convenience, and should be moved in the future.
+    VkSampler apiSampler = VK_NULL_HANDLE;      // Shared, owned by the render context sampler cache.
+    TextureType type = TEXTURE_TYPE_2D;
+    ImageFormat format = IMAGE_FORMAT_RGBA8_SRGB;
+    u32 width = 0;
+    u32 height = 0;
+    u32 channels = 0;
+};
+
+// Makes GPU staging buffer for later usage as transfer src to texture resource.
+// Safe to call from worker threads: VMA is internally synchronized, and memory tracking takes its own lock.
+Buffer CreateTextureStagingBuffer(RenderContext* ctx, u8* textureData, i32 textureWidth, i32 textureHeight)
+{
+    ASSERT(textureData);
+    VkDeviceSize textureSize = (u64)textureWidth * textureHeight * 4;    // Hardcoded to RGBA8, 4 bytes per pixel
+    return CreateBuffer(ctx, BUFFER_TYPE_STAGING, textureSize, 1, textureData);
+}
+
+// Uploads staging buffer contents to a new GPU texture resource, then destroys the staging buffer.
+Texture CreateTextureFromStagingBuffer(RenderContext* ctx, Buffer stagingBuffer, i32 textureWidth, i32 textureHeight, i32 textureChannels,
+        SamplerDesc samplerDesc = {})
+{
+
+    // Now create the texture resource
+    TextureType textureType = TEXTURE_TYPE_2D;
+    ImageFormat textureFormat = IMAGE_FORMAT_RGBA8_SRGB;            // Hardcoded to RGBA8
+    VkImageCreateInfo textureCreateInfo = {};
+    textureCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    textureCreateInfo.imageType = textureTypeToVk[textureType];
+    textureCreateInfo.extent.width = (u32)textureWidth;
+    textureCreateInfo.extent.height = (u32)textureHeight;
+    textureCreateInfo.extent.depth = 1;
+    textureCreateInfo.mipLevels = 1;
+    textureCreateInfo.arrayLayers = 1;
+    textureCreateInfo.format = imageFormatToVk[textureFormat];
+    textureCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    textureCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;    // Hardcoded
+    textureCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;    // Hardcoded
+    textureCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    textureCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    textureCreateInfo.flags = 0;
+
+    VmaAllocationCreateInfo allocationInfo = {};
+    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    //allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+
+    VkImage apiObject;
+    VmaAllocation apiAllocation;
+    VkResult ret = vmaCreateImage(ctx->apiMemoryAllocator, &textureCreateInfo, &allocationInfo, &apiObject, &apiAllocation, NULL);
+    VK_ASSERT(ret);
+    TrackAllocation(ctx, apiAllocation, MEMORY_CATEGORY_TEXTURES);
+
+    // Transition the image resource layout to transfer dest
+    BeginImmediateCommands(ctx);
+    RecordImageBarrier(ctx->apiImmediateCommandBuffer, apiObject, VK_IMAGE_ASPECT_COLOR_BIT,
+            RESOURCE_ACCESS_NONE, RESOURCE_ACCESS_TRANSFER_WRITE);
+
+    // Copy data from staging buffer to image resource
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = 0;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = {0,0,0};
+    copyRegion.imageExtent = {(u32)textureWidth, (u32)textureHeight, 1};
+    vkCmdCopyBufferToImage(ctx->apiImmediateCommandBuffer, stagingBuffer.apiObject, apiObject, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // Then transition image resource layout from transfer dst to shader ro (read in pixel shaders)
+    RecordImageBarrier(ctx->apiImmediateCommandBuffer, apiObject, VK_IMAGE_ASPECT_COLOR_BIT,
+            RESOURCE_ACCESS_TRANSFER_WRITE, RESOURCE_ACCESS_SHADER_READ);
+
+    SubmitImmediateCommands(ctx);
+
+    DestroyBuffer(ctx, stagingBuffer);
+
+    // Creating image view
+    VkImageViewCreateInfo imageViewInfo = {};
+    imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewInfo.image = apiObject;
+    imageViewInfo.viewType = textureTypeToVkView[textureType];
+    imageViewInfo.format = imageFormatToVk[textureFormat];
+    imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewInfo.subresourceRange.baseMipLevel = 0;
+    imageViewInfo.subresourceRange.levelCount = 1;
+    imageViewInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewInfo.subresourceRange.layerCount = 1;
+    VkImageView apiImageView;
+    ret = vkCreateImageView(ctx->apiDevice, &imageViewInfo, NULL, &apiImageView);
+    VK_ASSERT(ret);
+
+    // Sampler comes from the shared cache, textures never own one
+    VkSampler apiSampler = GetSampler(ctx, samplerDesc);
+
+    Texture result = {};
+    result.apiObject = apiObject;
+    result.apiAllocation = apiAllocation;
+    result.apiImageView = apiImageView;
+    result.apiSampler = apiSampler;
+    result.type = textureType;
+    result.format = textureFormat;
+    result.width = textureWidth;
+    result.height = textureHeight;
+    result.channels = textureChannels;
+    return result;
+}
+
+// Uploads already decoded RGBA8 pixels to a new GPU texture resource.
+Texture CreateTextureFromPixels(RenderContext* ctx, u8* textureData, i32 textureWidth, i32 textureHeight, i32 textureChannels,
+        SamplerDesc samplerDesc = {})
+{
+    Buffer stagingBuffer = CreateTextureStagingBuffer(ctx, textureData, textureWidth, textureHeight);
+    return CreateTextureFromStagingBuffer(ctx, stagingBuffer, textureWidth, textureHeight, textureChannels, samplerDesc);
+}
+
+Texture CreateTextureFromFile(RenderContext* ctx, const char* assetPath)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    // Load texture asset to CPU
+    i32 textureWidth = -1;
+    i32 textureHeight = -1;
+    i32 textureChannels = -1;
+
+    u8* textureData = (u8*)stbi_load(assetPath, &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+    ASSERT(textureData);
+
+    return CreateTextureFromPixels(ctx, textureData, textureWidth, textureHeight, textureChannels);
+}
+
+// Batch texture loading: file reads, image decoding and staging copies run on job system workers,
+// while the calling thread uploads each texture to the GPU as soon as its staging buffer is ready.
+struct TextureLoadStats
+{
+    u32 textureCount = 0;
+    f64 ioMs = 0;           // Summed over all worker threads
+    f64 decodeMs = 0;       // Summed over all worker threads
+    f64 stagingMs = 0;      // Summed over all worker threads: staging buffer creation and pixel copy
+    f64 uploadMs = 0;       // Calling thread only
+    f64 totalMs = 0;        // Wall clock time for the whole batch
+};
+
+struct TextureDecodeJob
+{
+    RenderContext* ctx = NULL;
+    const char* assetPath = NULL;
+    JobResultQueue* doneQueue = NULL;
+    u32 index = 0;
+
+    Buffer stagingBuffer = {};
+    i32 width = -1;
+    i32 height = -1;
+    i32 channels = -1;
+    u64 ioTicks = 0;
+    u64 decodeTicks = 0;
+    u64 stagingTicks = 0;
+};
+
+void TextureDecodeJobProc(void* data)
+{
+    TextureDecodeJob* job = (TextureDecodeJob*)data;
+    // File contents and all decoder temporaries live in the worker's scratch arena,
+    // and are released as soon as pixels are copied to the staging buffer.
+    Arena* scratch = GetThreadScratchArena();
+    ScratchScope scratchScope(scratch);
+
+    u64 ioStart = GetTimerTicks();
+    u64 fileSize = GetFileSize(job->assetPath);
+    u8* fileData = ARENA_PUSH_ARRAY(scratch, u8, fileSize);
+    ReadFileAsBinary(job->assetPath, fileSize, fileData);
+    u64 decodeStart = GetTimerTicks();
+
+    u8* pixels = (u8*)stbi_load_from_memory(fileData, (i32)fileSize, &job->width, &job->height, &job->channels, STBI_rgb_alpha);
+    ASSERT(pixels);
+    u64 stagingStart = GetTimerTicks();
+    job->stagingBuffer = CreateTextureStagingBuffer(job->ctx, pixels, job->width, job->height);
+
+    job->ioTicks = decodeStart - ioStart;
+    job->decodeTicks = stagingStart - decodeStart;
+    job->stagingTicks = GetTimerTicks() - stagingStart;
+    PushJobResult(job->doneQueue, job->index);
+}
+
+void CreateTexturesFromFiles(RenderContext* ctx, JobSystem* jobSystem,
+        u32 textureCount, const char** assetPaths, Texture* outTextures, TextureLoadStats* outStats)
+{
+    ASSERT(textureCount);
+    u64 batchStart = GetTimerTicks();
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    JobResultQueue* doneQueue = ARENA_PUSH_STRUCT(scratchScope.arena, JobResultQueue);
+    InitJobResultQueue(doneQueue);
+    TextureDecodeJob* decodeJobs = ARENA_PUSH_ARRAY(scratchScope.arena, TextureDecodeJob, textureCount);
+
+    // Upload in completion order, overlapping with decodes still running on workers.
+    // Jobs are submitted as results are consumed, with no more in flight than the queues hold: otherwise workers
+    // block on a full result queue while this thread blocks on a full job queue.
+    u32 submittedCount = 0;
+    u64 ioTicks = 0, decodeTicks = 0, stagingTicks = 0, uploadTicks = 0;
+    for(i32 i = 0; i < textureCount; i++)
+    {
+        for(; submittedCount < textureCount && submittedCount - i < JOB_QUEUE_CAPACITY; submittedCount++)
+        {
+            TextureDecodeJob* job = &decodeJobs[submittedCount];
+            *job = {};
+            job->ctx = ctx;
+            job->assetPath = assetPaths[submittedCount];
+            job->doneQueue = doneQueue;
+            job->index = submittedCount;
+            PushJob(jobSystem, TextureDecodeJobProc, job);
+        }
+
+        u32 finished = PopJobResult(doneQueue);
+        TextureDecodeJob* job = &decodeJobs[finished];
+
+        u64 uploadStart = GetTimerTicks();
+        outTextures[finished] = CreateTextureFromStagingBuffer(ctx, job->stagingBuffer, job->width, job->height, job->channels);
+        uploadTicks += GetTimerTicks() - uploadStart;
+
+        ioTicks += job->ioTicks;
+        decodeTicks += job->decodeTicks;
+        stagingTicks += job->stagingTicks;
+    }
+    WaitForJobs(jobSystem);     // Workers may still be returning from pushing their results
+
+    if(outStats)
+    {
+        outStats->textureCount = textureCount;
+        outStats->ioMs = TimerTicksToMs(ioTicks);
+        outStats->decodeMs = TimerTicksToMs(decodeTicks);
+        outStats->stagingMs = TimerTicksToMs(stagingTicks);
+        outStats->uploadMs = TimerTicksToMs(uploadTicks);
+        outStats->totalMs = TimerTicksToMs(GetTimerTicks() - batchStart);
+    }
+}
+
+// Pre-baked textures are uploaded straight from the archive mapping, with no decode step.
+Texture CreateTextureFromArchive(RenderContext* ctx, AssetArchive* archive, const char* assetName)
+{
+    const AssetArchiveEntry* entry = FindAssetEntry(archive, assetName);
+    ASSERT(entry);
+    ASSERT(entry->type == ASSET_TYPE_TEXTURE);
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    const u8* blob = GetAssetEntryData(archive, entry);
+    if(entry->compression != ASSET_COMPRESSION_NONE)
+    {
+        u8* decompressed = ARENA_PUSH_ARRAY(scratchScope.arena, u8, entry->uncompressedSize);
+        bool ret = ReadAssetEntry(archive, entry, decompressed, entry->uncompressedSize);
+        ASSERT(ret);
+        blob = decompressed;
+    }
+
+    AssetTextureHeader textureHeader;
+    memcpy(&textureHeader, blob, sizeof(AssetTextureHeader));
+    ASSERT(textureHeader.bytesPerPixel == 4);   // Only RGBA8 for now
+    return CreateTextureFromPixels(ctx, (u8*)blob + sizeof(AssetTextureHeader),
+            textureHeader.width, textureHeader.height, textureHeader.channels);
+}
+
+// Mesh blobs come from the archive when it has them (in place, unless compressed), otherwise from loose files.
+// Returns false when there is no valid mesh at path.
+bool LoadMeshBlob(AssetArchive* archive, const char* path, Arena* arena, MeshBlob* outBlob)
+{
+    const char* name = path;
+    for(const char* c = path; *c; c++)
+    {
+        if(*c == '/' || *c == '\\') name = c + 1;
+    }
+
+    const u8* data = NULL;
+    u64 size = 0;
+    const AssetArchiveEntry* entry = archive->data ? FindAssetEntry(archive, name) : NULL;
+    if(entry)
+    {
+        ASSERT(entry->type == ASSET_TYPE_MESH);
+        data = GetAssetEntryData(archive, entry);
+        size = entry->uncompressedSize;
+        if(entry->compression != ASSET_COMPRESSION_NONE)
+        {
+            u8* decompressed = (u8*)ArenaPush(arena, size, MESH_BLOB_DATA_ALIGN);
+            bool ret = ReadAssetEntry(archive, entry, decompressed, size);
+            ASSERT(ret);
+            data = decompressed;
+        }
+    }
+    else
+    {
+        data = ReadOptionalFileToArena(arena, path, &size);
+    }
+    if(!data) return false;
+    if(!ReadMeshBlob(data, size, outBlob))
+    {
+        printf("[MESH]: Invalid mesh blob %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+void DestroyTexture(RenderContext* ctx, Texture texture)
+{
+    ASSERT(ctx);
+    ASSERT(ctx->apiMemoryAllocator != VK_NULL_HANDLE);
+    vkDestroyImageView(ctx->apiDevice, texture.apiImageView, NULL);
+    UntrackAllocation(ctx, texture.apiAllocation);
+    vmaDestroyImage(ctx->apiMemoryAllocator, texture.apiObject, texture.apiAllocation);
+}
+
+// ===================================================================
+// Graphics pipeline
+// VertexFormat and its sizes live in vertex_format.hpp, next to the quantizer.
+VkFormat vertexFormatToVk[] =
+{
+    VK_FORMAT_R32G32_SFLOAT,
+    VK_FORMAT_R32G32B32_SFLOAT,
+    VK_FORMAT_R32G32B32A32_SFLOAT,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_FORMAT_R16G16_SNORM,
+    VK_FORMAT_R16G16B16A16_SNORM,
+    VK_FORMAT_R16G16_UNORM,
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_R8G8B8A8_SNORM,
+    VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+};
+static_assert(ARR_LEN(vertexFormatToVk) == VERTEX_FORMAT_COUNT, "Missing vertex format translation");
+
+#define VERTEX_LAYOUT_MAX_ATTRIBUTES 8
+struct VertexLayout
+{
+    u32 index = -1;
+    VkVertexInputBindingDescription apiBindingDescription;
+
+    u32 attributeCount = 0;
+    VertexFormat attributeFormats[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+    VkVertexInputAttributeDescription apiAttributeDescriptions[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+};
+
+VertexLayout CreateVertexLayout(u32 layoutIndex, u32 attributeCount, VertexFormat* attributeFormats)
+{
+    ASSERT(attributeCount <= VERTEX_LAYOUT_MAX_ATTRIBUTES);
+    VkVertexInputAttributeDescription attributeDescriptions[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+    u32 stride = 0;
+    for(i32 i = 0; i < attributeCount; i++)
+    {
+        attributeDescriptions[i].binding = layoutIndex;
+        attributeDescriptions[i].location = i;  // Vertex attribute locations are set in order.
+        attributeDescriptions[i].format = vertexFormatToVk[attributeFormats[i]];
+        attributeDescriptions[i].offset = stride;
+        stride += vertexFormatSizeInBytes[attributeFormats[i]];
+    }
+
+    VkVertexInputBindingDescription bindingDescription = {};
+    bindingDescription.binding = layoutIndex;
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;     // No instancing supported yet.
+    bindingDescription.stride = stride;
+
+    VertexLayout result = {};
+    result.index = layoutIndex;
+    result.apiBindingDescription = bindingDescription;
+    result.attributeCount = attributeCount;
+    for(i32 i = 0; i < attributeCount; i++)
+    {
+        result.attributeFormats[i] = attributeFormats[i];
+        result.apiAttributeDescriptions[i] = attributeDescriptions[i];
+    }
+    return result;
+}
+
+enum ShaderType
+{
+    SHADER_TYPE_VERTEX,
+    SHADER_TYPE_PIXEL,
+};
+
+struct ShaderAsset
+{
+    ShaderType type;
+    u64 bytecodeSize = -1;
+    u8* bytecode = NULL;
+    u64 hash = 0;           // Hash64 of bytecode, identifies the shader in pipeline descriptions
+};
+
+#define SHADER_BYTECODE_ALIGN 4     // 4 byte alignment for shader memory
+ShaderAsset CreateShaderAsset(const char* assetPath, ShaderType type)
+{
+    u64 assetSize = GetFileSize(assetPath);
+    u8* assetData = (u8*)ArenaPush(&resourceArena, assetSize, SHADER_BYTECODE_ALIGN);
+    ReadFileAsBinary(assetPath, assetSize, assetData);
+    return
+    {
+        type, assetSize, assetData, Hash64(assetData, assetSize)
+    };
+}
+
+// Runtime compiled bytecode (see CompileShaders), referenced in place from the arena it was compiled into.
+ShaderAsset CreateShaderAssetFromBytecode(ShaderBytecode bytecode, ShaderType type)
+{
+    ASSERT(bytecode.data);
+    ASSERT(((u64)bytecode.data % SHADER_BYTECODE_ALIGN) == 0);
+    return
+    {
+        type, bytecode.size, bytecode.data, Hash64(bytecode.data, bytecode.size)
+    };
+}
+
+// Uncompressed shaders reference bytecode in place inside the archive mapping (zero-copy),
+// so the archive must outlive any pipeline creation that uses them.
+ShaderAsset CreateShaderAssetFromArchive(AssetArchive* archive, const char* assetName, ShaderType type)
+{
+    const AssetArchiveEntry* entry = FindAssetEntry(archive, assetName);
+    ASSERT(entry);
+    ASSERT(entry->type == ASSET_TYPE_SHADER);
+
+    u8* bytecode = (u8*)GetAssetEntryData(archive, entry);
+    if(entry->compression != ASSET_COMPRESSION_NONE)
+    {
+        bytecode = (u8*)ArenaPush(&resourceArena, entry->uncompressedSize, SHADER_BYTECODE_ALIGN);
+        bool ret = ReadAssetEntry(archive, entry, bytecode, entry->uncompressedSize);
+        ASSERT(ret);
+    }
+    ASSERT(((u64)bytecode % SHADER_BYTECODE_ALIGN) == 0);
+    return
+    {
+        type, entry->uncompressedSize, bytecode, entry->contentHash
+    };
+}
+
+enum PrimitiveType
+{
+    PRIMITIVE_TRIANGLE_LIST,
+};
+VkPrimitiveTopology primitiveTypeToVk[] =
+{
+    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+};
+
+enum FillMode
+{
+    FILL_MODE_SOLID,
+    FILL_MODE_LINE,
+    FILL_MODE_POINT,
+};
+VkPolygonMode fillModeToVk[] =
+{
+    VK_POLYGON_MODE_FILL,
+    VK_POLYGON_MODE_LINE,
+    VK_POLYGON_MODE_POINT,
+};
+
+enum CullMode
+{
+    CULL_MODE_NONE,
+    CULL_MODE_FRONT,
+    CULL_MODE_BACK,
+    CULL_MODE_FRONT_BACK,
+};
+VkCullModeFlagBits cullModeToVk[] =
+{
+    VK_CULL_MODE_NONE,
+    VK_CULL_MODE_FRONT_BIT,
+    VK_CULL_MODE_BACK_BIT,
+    VK_CULL_MODE_FRONT_AND_BACK,
+};
+
+enum FrontFace
+{
+    FRONT_FACE_CW,
+    FRONT_FACE_CCW,
+};
+VkFrontFace frontFaceModeToVk[] =
+{
+    VK_FRONT_FACE_CLOCKWISE,
+    VK_FRONT_FACE_COUNTER_CLOCKWISE,
+};
+
+struct InputAssemblyState
+{
+    PrimitiveType primitive = PRIMITIVE_TRIANGLE_LIST;
+};
+
+struct RasterizerState
+{
+    FillMode fillMode = FILL_MODE_SOLID;
+    CullMode cullMode = CULL_MODE_BACK;
+    FrontFace frontFace = FRONT_FACE_CW;
+};
+
+// Compare ops are relative to the render pass' DepthRange, so pipelines work with either convention.
+enum DepthTest
+{
+    DEPTH_TEST_NONE,
+    DEPTH_TEST_NEARER,          // LESS, or GREATER with reversed depth
+    DEPTH_TEST_EQUAL,           // Only the nearest surface, as laid down by a depth pre-pass
+};
+
+struct DepthState
+{
+    DepthTest test = DEPTH_TEST_NEARER;
+    bool writeEnable = true;
+};
+
+VkCompareOp GetDepthCompareOp(DepthTest test, DepthRange range)
+{
+    switch(test)
+    {
+        case DEPTH_TEST_NONE: return VK_COMPARE_OP_ALWAYS;
+        case DEPTH_TEST_NEARER: return range == DEPTH_RANGE_REVERSED ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS;
+        case DEPTH_TEST_EQUAL: return VK_COMPARE_OP_EQUAL;
+        default: ASSERT(0); return VK_COMPARE_OP_ALWAYS;
+    }
+}
+
+struct PushConstants
+{
+    m4f model = {};
+    u32 textureId = 0;      // Index into bindless texture table
+};
+
+struct GraphicsPipeline
+{
+    VkPipeline apiObject = VK_NULL_HANDLE;
+    VkPipelineLayout apiPipelineLayout = VK_NULL_HANDLE;
+
+    // Programmable pipeline
+    ShaderAsset shaderVertex;
+    ShaderAsset shaderPixel;
+
+    // Fixed pipeline
+    InputAssemblyState inputAssemblyState;
+    VertexLayout vertexLayout;  // Only one vertex layout per pipeline.
+    // TODO(caio): Add support for dynamic viewport and scissor rect
+    RasterizerState rasterizerState;
+    DepthState depthState;
+    // TODO(caio): Add support for color blend modes...
+
+    VkPushConstantRange pushConstantRange = {};     // Stages and size to use when pushing constants for this pipeline
+};
+
+GraphicsPipeline CreateGraphicsPipeline(
+        RenderContext* ctx, 
+        RenderPass* renderPass,
+        InputAssemblyState inputAssemblyState,
+        ShaderAsset vs, ShaderAsset ps, 
+        VertexLayout vertexLayout,
+        VkPipelineLayout pipelineLayout,
+        RasterizerState rasterizerState,
+        DepthState depthState)
+{
+    ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
+    ASSERT(renderPass->apiObject != VK_NULL_HANDLE);
+    VkResult ret;
+
+    // Setting up programmable stages. Without pixel shader bytecode the pipeline is depth only.
+    ASSERT(vs.bytecodeSize != -1);
+    bool depthOnly = ps.bytecode == NULL;
+    ASSERT(depthOnly || ps.bytecodeSize != -1);
+    VkShaderModuleCreateInfo vsShaderModuleInfo = {};
+    vsShaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    vsShaderModuleInfo.codeSize = vs.bytecodeSize;
+    vsShaderModuleInfo.pCode = (u32*)vs.bytecode;
+    VkShaderModuleCreateInfo psShaderModuleInfo = vsShaderModuleInfo;
+    psShaderModuleInfo.codeSize = ps.bytecodeSize;
+    psShaderModuleInfo.pCode = (u32*)ps.bytecode;
+    VkShaderModule vsShaderModule;
+    ret = vkCreateShaderModule(ctx->apiDevice, &vsShaderModuleInfo, NULL, &vsShaderModule);
+    VK_ASSERT(ret);
+    VkShaderModule psShaderModule = VK_NULL_HANDLE;
+    if(!depthOnly)
+    {
+        ret = vkCreateShaderModule(ctx->apiDevice, &psShaderModuleInfo, NULL, &psShaderModule);
+        VK_ASSERT(ret);
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.pName = "main";     // Shader entrypoint hardcoded to always be main
+    VkPipelineShaderStageCreateInfo vsShaderStageInfo = shaderStageInfo;
+    vsShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vsShaderStageInfo.module = vsShaderModule;
+    VkPipelineShaderStageCreateInfo psShaderStageInfo = shaderStageInfo;
+    psShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    psShaderStageInfo.module = psShaderModule;
+    VkPipelineShaderStageCreateInfo shaderStages[] =
+    {
+        vsShaderStageInfo, psShaderStageInfo
+    };
+    
+    // Input assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
+    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyInfo.topology = primitiveTypeToVk[inputAssemblyState.primitive];
+    inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+    // Vertex inputs
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &vertexLayout.apiBindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = vertexLayout.attributeCount;
+    vertexInputInfo.pVertexAttributeDescriptions = vertexLayout.apiAttributeDescriptions;
+
+    VkDynamicState dynamicStates[] =
+    {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = ARR_LEN(dynamicStates);
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+
+    // Viewport state (only one of each per pipeline, but can be changed on draw time)
+    VkPipelineViewportStateCreateInfo viewportStateInfo = {};
+    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateInfo.viewportCount = 1;
+    viewportStateInfo.scissorCount = 1;
+
+    // Rasterization
+    VkPipelineRasterizationStateCreateInfo rasterizationStateInfo = {};
+    rasterizationStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationStateInfo.polygonMode = fillModeToVk[rasterizerState.fillMode];
+    rasterizationStateInfo.cullMode = cullModeToVk[rasterizerState.cullMode];
+    rasterizationStateInfo.frontFace = frontFaceModeToVk[rasterizerState.frontFace];
+    rasterizationStateInfo.depthClampEnable = VK_FALSE;
+    rasterizationStateInfo.lineWidth = 1;
+    rasterizationStateInfo.depthBiasEnable = VK_FALSE;
+
+    // Blending (currently only supporting standard opaque blend)
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = depthOnly ? 0 :
+        VK_COLOR_COMPONENT_R_BIT | 
+        VK_COLOR_COMPONENT_G_BIT | 
+        VK_COLOR_COMPONENT_B_BIT | 
+        VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;    // Overwrite color
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.logicOpEnable = VK_FALSE;
+    colorBlendInfo.attachmentCount = 1;
+    colorBlendInfo.pAttachments = &colorBlendAttachment;
+
+    // Multisampling, matching the render pass
+    VkPipelineMultisampleStateCreateInfo multisampleInfo = {};
+    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleInfo.rasterizationSamples = (VkSampleCountFlagBits)renderPass->sampleCount;
+    multisampleInfo.sampleShadingEnable = VK_FALSE;
+
+    VkPipelineDepthStencilStateCreateInfo depthStateInfo = {};
+    depthStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStateInfo.depthTestEnable = depthState.test != DEPTH_TEST_NONE;
+    depthStateInfo.depthWriteEnable = depthState.writeEnable;
+    depthStateInfo.depthCompareOp = GetDepthCompareOp(depthState.test, renderPass->depthRange);
+    depthStateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStateInfo.stencilTestEnable = VK_FALSE;
+
+    // Graphics pipeline creation
+    VkGraphicsPipelineCreateInfo apiObjectInfo = {};
+    apiObjectInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    apiObjectInfo.stageCount = depthOnly ? 1 : 2;   // Vertex stage, then pixel stage if any
+    apiObjectInfo.pStages = shaderStages;
+    apiObjectInfo.pVertexInputState = &vertexInputInfo;
+    apiObjectInfo.pInputAssemblyState = &inputAssemblyInfo;
+    apiObjectInfo.pViewportState = &viewportStateInfo;
+    apiObjectInfo.pDynamicState = &dynamicStateInfo;
+    apiObjectInfo.pRasterizationState = &rasterizationStateInfo;
+    apiObjectInfo.pMultisampleState = &multisampleInfo;
+    apiObjectInfo.pColorBlendState = &colorBlendInfo;
+    apiObjectInfo.pDepthStencilState = &depthStateInfo;
+    apiObjectInfo.layout = pipelineLayout;
+    apiObjectInfo.renderPass = renderPass->apiObject;
+    apiObjectInfo.subpass = 0;      // Hardcoded to use only one subpass
+    apiObjectInfo.basePipelineHandle = VK_NULL_HANDLE;
+    apiObjectInfo.basePipelineIndex = -1;
+    VkPipeline apiObject;
+    u64 creationStart = GetTimerTicks();
+    ret = vkCreateGraphicsPipelines(ctx->apiDevice, ctx->apiPipelineCache, 1, &apiObjectInfo,
+            NULL, &apiObject);
+    VK_ASSERT(ret);
+    ctx->pipelineCreationMs += TimerTicksToMs(GetTimerTicks() - creationStart);
+    ctx->pipelineCreationCount++;
+
+    // Destroy unneeded shader modules
+    vkDestroyShaderModule(ctx->apiDevice, vsShaderModule, NULL);
+    if(psShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(ctx->apiDevice, psShaderModule, NULL);
+
+    GraphicsPipeline result =
+    {
+        apiObject, pipelineLayout, vs, ps, 
+        inputAssemblyState, vertexLayout, rasterizerState, depthState,
+    };
+    return result;
+}
+
+// Pipeline layout is not owned by the pipeline (see PipelineRegistry).
+void DestroyGraphicsPipeline(RenderContext* ctx, GraphicsPipeline* pipeline)
+{
+    vkDestroyPipeline(ctx->apiDevice, pipeline->apiObject, NULL);
+
+    *pipeline = {};
+}
+
+// Pipeline registry: pipelines are requested by description and created only once.
+// Identical descriptions return the same pipeline, and pipelines with the same
+// set layouts and push constant ranges share a single pipeline layout.
+// Both tables use open addressing keyed by description hash, 0 marks an empty slot. Hits are confirmed
+// against the stored description, so a hash collision creates a new entry instead of returning the wrong one.
+#define PIPELINE_MAX_DESCRIPTOR_SET_LAYOUTS 4
+#define PIPELINE_REGISTRY_CAPACITY          256     // Must be power of 2
+#define PIPELINE_LAYOUT_REGISTRY_CAPACITY   64      // Must be power of 2
+
+struct PipelineLayoutDesc
+{
+    u32 descriptorSetLayoutCount = 0;
+    VkDescriptorSetLayout descriptorSetLayouts[PIPELINE_MAX_DESCRIPTOR_SET_LAYOUTS];
+    VkPushConstantRange pushConstantRange = {};    // Size 0 for no push constants
 };
-VkImageViewType textureTypeToVkView[] =
+
+struct GraphicsPipelineDesc
 {
-    VK_IMAGE_VIEW_TYPE_2D,
+    RenderPass* renderPass = NULL;
+    InputAssemblyState inputAssemblyState;
+    ShaderAsset vs;
+    ShaderAsset ps;
+    VertexLayout vertexLayout;
+    PipelineLayoutDesc layout;
+    RasterizerState rasterizerState;
+    DepthState depthState;
 };
 
-struct Texture
+// Render pass state a pipeline is compiled against: pipelines stay valid for render passes recreated
+// with the same outputs (e.g. on resize).
+struct PipelineRenderPassKey
 {
-    VkImage apiObject = VK_NULL_HANDLE;
-    VmaAllocation apiAllocation;
-    VkImageView apiImageView = VK_NULL_HANDLE;  // This is just here for convenience, and should be moved in the future.
-    VkSampler apiSampler = VK_NULL_HANDLE;      // This is just here for convenience, and should be moved in the future.
-    TextureType type = TEXTURE_TYPE_2D;
-    ImageFormat format = IMAGE_FORMAT_RGBA8_SRGB;
-    u32 width = 0;
-    u32 height = 0;
-    u32 channels = 0;
+    u32 colorOutputCount = 0;
+    ImageFormat colorFormats[RENDER_PASS_MAX_COLOR_OUTPUTS];
+    u32 sampleCount = 1;
+    DepthRange depthRange = DEPTH_RANGE_STANDARD;
 };
 
-Texture CreateTextureFromFile(RenderContext* ctx, const char* assetPath)
+PipelineRenderPassKey GetPipelineRenderPassKey(RenderPass* renderPass)
 {
-    // Load texture asset to CPU
-    i32 textureWidth = -1;
-    i32 textureHeight = -1;
-    i32 textureChannels = -1;
+    PipelineRenderPassKey result = {};
+    result.colorOutputCount = renderPass->colorOutputCount;
+    for(i32 i = 0; i < renderPass->colorOutputCount; i++)
+    {
+        result.colorFormats[i] = renderPass->colorOutputInfo[i].format;
+    }
+    result.sampleCount = renderPass->sampleCount;
+    result.depthRange = renderPass->depthRange;
+    return result;
+}
 
-    u8* textureData = (u8*)stbi_load(assetPath, &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
-    ASSERT(textureData);
-    
-    // Make GPU staging buffer for later usage as transfer src to texture resource
-    VkDeviceSize textureSize = textureWidth * textureHeight * 4;    // Hardcoded to RGBA8, 4 bytes per pixel
-    Buffer stagingBuffer = CreateBuffer(ctx, BUFFER_TYPE_STAGING, (u32)textureSize, 1, textureData);
+struct PipelineRegistry
+{
+    u32 pipelineCount = 0;
+    u64 pipelineHashes[PIPELINE_REGISTRY_CAPACITY];
+    GraphicsPipeline pipelines[PIPELINE_REGISTRY_CAPACITY];
+    PipelineRenderPassKey pipelineRenderPassKeys[PIPELINE_REGISTRY_CAPACITY];
 
-    // Now create the texture resource
-    TextureType textureType = TEXTURE_TYPE_2D;
-    ImageFormat textureFormat = IMAGE_FORMAT_RGBA8_SRGB;            // Hardcoded to RGBA8
-    VkImageCreateInfo textureCreateInfo = {};
-    textureCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    textureCreateInfo.imageType = textureTypeToVk[textureType];
-    textureCreateInfo.extent.width = (u32)textureWidth;
-    textureCreateInfo.extent.height = (u32)textureHeight;
-    textureCreateInfo.extent.depth = 1;
-    textureCreateInfo.mipLevels = 1;
-    textureCreateInfo.arrayLayers = 1;
-    textureCreateInfo.format = imageFormatToVk[textureFormat];
-    textureCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    textureCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;    // Hardcoded
-    textureCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;    // Hardcoded
-    textureCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    textureCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    textureCreateInfo.flags = 0;
+    u32 layoutCount = 0;
+    u64 layoutHashes[PIPELINE_LAYOUT_REGISTRY_CAPACITY];
+    PipelineLayoutDesc layoutDescs[PIPELINE_LAYOUT_REGISTRY_CAPACITY];
+    VkPipelineLayout apiLayouts[PIPELINE_LAYOUT_REGISTRY_CAPACITY];
 
-    VmaAllocationCreateInfo allocationInfo = {};
-    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    //allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    u32 lookupCount = 0;        // Stats: total requests, to compare against created pipeline count
+};
 
-    VkImage apiObject;
-    VmaAllocation apiAllocation;
-    VkResult ret = vmaCreateImage(ctx->apiMemoryAllocator, &textureCreateInfo, &allocationInfo, &apiObject, &apiAllocation, NULL);
-    VK_ASSERT(ret);
+void InitPipelineRegistry(PipelineRegistry* registry)
+{
+    registry->pipelineCount = 0;
+    registry->layoutCount = 0;
+    registry->lookupCount = 0;
+    memset(registry->pipelineHashes, 0, sizeof(registry->pipelineHashes));
+    memset(registry->layoutHashes, 0, sizeof(registry->layoutHashes));
+}
 
-    // Transition the image resource layout to transfer dest
-    BeginImmediateCommands(ctx);
-    VkImageMemoryBarrier resourceBarrier = {};
-    resourceBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    resourceBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    resourceBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    resourceBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.image = apiObject;
-    resourceBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    resourceBarrier.subresourceRange.baseMipLevel = 0;
-    resourceBarrier.subresourceRange.levelCount = 1;
-    resourceBarrier.subresourceRange.baseArrayLayer = 0;
-    resourceBarrier.subresourceRange.layerCount = 1;
-    resourceBarrier.srcAccessMask = 0;
-    resourceBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    vkCmdPipelineBarrier(ctx->apiImmediateCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0, 0, NULL, 0, NULL, 1, &resourceBarrier);
+void DestroyPipelineRegistry(RenderContext* ctx, PipelineRegistry* registry)
+{
+    for(i32 i = 0; i < PIPELINE_REGISTRY_CAPACITY; i++)
+    {
+        if(!registry->pipelineHashes[i]) continue;
+        DestroyGraphicsPipeline(ctx, &registry->pipelines[i]);
+    }
+    for(i32 i = 0; i < PIPELINE_LAYOUT_REGISTRY_CAPACITY; i++)
+    {
+        if(!registry->layoutHashes[i]) continue;
+        vkDestroyPipelineLayout(ctx->apiDevice, registry->apiLayouts[i], NULL);
+    }
+    InitPipelineRegistry(registry);
+}
 
-    // Copy data from staging buffer to image resource
-    VkBufferImageCopy copyRegion = {};
-    copyRegion.bufferOffset = 0;
-    copyRegion.bufferRowLength = 0;
-    copyRegion.bufferImageHeight = 0;
-    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-    copyRegion.imageOffset = {0,0,0};
-    copyRegion.imageExtent = {(u32)textureWidth, (u32)textureHeight, 1};
-    vkCmdCopyBufferToImage(ctx->apiImmediateCommandBuffer, stagingBuffer.apiObject, apiObject, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+u64 HashPipelineLayoutDesc(PipelineLayoutDesc* desc)
+{
+    u64 hash = Hash64(&desc->descriptorSetLayoutCount, sizeof(u32));
+    hash = Hash64(desc->descriptorSetLayouts, desc->descriptorSetLayoutCount * sizeof(VkDescriptorSetLayout), hash);
+    hash = Hash64(&desc->pushConstantRange, sizeof(VkPushConstantRange), hash);
+    return hash ? hash : 1;
+}
 
-    // Then transition image resource layout from transfer dst to shader ro
-    resourceBarrier = {};
-    resourceBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    resourceBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    resourceBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    resourceBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    resourceBarrier.image = apiObject;
-    resourceBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    resourceBarrier.subresourceRange.baseMipLevel = 0;
-    resourceBarrier.subresourceRange.levelCount = 1;
-    resourceBarrier.subresourceRange.baseArrayLayer = 0;
-    resourceBarrier.subresourceRange.layerCount = 1;
-    resourceBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    resourceBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    vkCmdPipelineBarrier(ctx->apiImmediateCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // Hardcoded fragment shader
-            0, 0, NULL, 0, NULL, 1, &resourceBarrier);
+// Hashes every field that affects the compiled pipeline. Descriptions are hashed field by field
+// instead of as raw bytes, since they contain padding and unused array slots.
+u64 HashGraphicsPipelineDesc(GraphicsPipelineDesc* desc)
+{
+    PipelineRenderPassKey renderPassKey = GetPipelineRenderPassKey(desc->renderPass);
+    u64 hash = Hash64(&renderPassKey.colorOutputCount, sizeof(u32));
+    hash = Hash64(renderPassKey.colorFormats, renderPassKey.colorOutputCount * sizeof(ImageFormat), hash);
+    hash = Hash64(&renderPassKey.sampleCount, sizeof(u32), hash);
+    hash = Hash64(&renderPassKey.depthRange, sizeof(DepthRange), hash);
+
+    hash = Hash64(&desc->inputAssemblyState.primitive, sizeof(PrimitiveType), hash);
+    hash = HashCombine(hash, desc->vs.hash);
+    hash = HashCombine(hash, desc->ps.hash);
+
+    VertexLayout* vertexLayout = &desc->vertexLayout;
+    hash = Hash64(&vertexLayout->index, sizeof(u32), hash);
+    hash = Hash64(&vertexLayout->attributeCount, sizeof(u32), hash);
+    hash = Hash64(vertexLayout->attributeFormats, vertexLayout->attributeCount * sizeof(VertexFormat), hash);
+
+    hash = HashCombine(hash, HashPipelineLayoutDesc(&desc->layout));
+
+    RasterizerState* rasterizerState = &desc->rasterizerState;
+    hash = Hash64(&rasterizerState->fillMode, sizeof(FillMode), hash);
+    hash = Hash64(&rasterizerState->cullMode, sizeof(CullMode), hash);
+    hash = Hash64(&rasterizerState->frontFace, sizeof(FrontFace), hash);
+
+    hash = Hash64(&desc->depthState.test, sizeof(DepthTest), hash);
+    hash = Hash64(&desc->depthState.writeEnable, sizeof(bool), hash);
+    return hash ? hash : 1;
+}
 
-    SubmitImmediateCommands(ctx);
+bool ArePipelineLayoutDescsEqual(PipelineLayoutDesc* a, PipelineLayoutDesc* b)
+{
+    return a->descriptorSetLayoutCount == b->descriptorSetLayoutCount
+        && memcmp(a->descriptorSetLayouts, b->descriptorSetLayouts, a->descriptorSetLayoutCount * sizeof(VkDescriptorSetLayout)) == 0
+        && memcmp(&a->pushConstantRange, &b->pushConstantRange, sizeof(VkPushConstantRange)) == 0;
+}
 
-    DestroyBuffer(ctx, stagingBuffer);
-    free(textureData);  // Not really needed for my purposes...
+bool AreShaderAssetsEqual(ShaderAsset* a, ShaderAsset* b)
+{
+    if(a->type != b->type || a->bytecodeSize != b->bytecodeSize) return false;
+    if(a->bytecode == b->bytecode) return true;
+    return a->bytecode && b->bytecode && memcmp(a->bytecode, b->bytecode, a->bytecodeSize) == 0;
+}
 
-    // Creating image view
-    VkImageViewCreateInfo imageViewInfo = {};
-    imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    imageViewInfo.image = apiObject;
-    imageViewInfo.viewType = textureTypeToVkView[textureType];
-    imageViewInfo.format = imageFormatToVk[textureFormat];
-    imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageViewInfo.subresourceRange.baseMipLevel = 0;
-    imageViewInfo.subresourceRange.levelCount = 1;
-    imageViewInfo.subresourceRange.baseArrayLayer = 0;
-    imageViewInfo.subresourceRange.layerCount = 1;
-    VkImageView apiImageView;
-    ret = vkCreateImageView(ctx->apiDevice, &imageViewInfo, NULL, &apiImageView);
-    VK_ASSERT(ret);
+// Compares everything HashGraphicsPipelineDesc hashes against a registered pipeline.
+bool DoesGraphicsPipelineMatch(GraphicsPipeline* pipeline, PipelineRenderPassKey* pipelineRenderPassKey,
+        VkPipelineLayout pipelineLayout, GraphicsPipelineDesc* desc)
+{
+    PipelineRenderPassKey renderPassKey = GetPipelineRenderPassKey(desc->renderPass);
+    if(renderPassKey.colorOutputCount != pipelineRenderPassKey->colorOutputCount
+            || memcmp(renderPassKey.colorFormats, pipelineRenderPassKey->colorFormats, renderPassKey.colorOutputCount * sizeof(ImageFormat))
+            || renderPassKey.sampleCount != pipelineRenderPassKey->sampleCount
+            || renderPassKey.depthRange != pipelineRenderPassKey->depthRange) return false;
+    if(pipeline->inputAssemblyState.primitive != desc->inputAssemblyState.primitive) return false;
+    if(!AreShaderAssetsEqual(&pipeline->shaderVertex, &desc->vs) || !AreShaderAssetsEqual(&pipeline->shaderPixel, &desc->ps)) return false;
+    VertexLayout* vertexLayout = &pipeline->vertexLayout;
+    if(vertexLayout->index != desc->vertexLayout.index
+            || vertexLayout->attributeCount != desc->vertexLayout.attributeCount
+            || memcmp(vertexLayout->attributeFormats, desc->vertexLayout.attributeFormats, vertexLayout->attributeCount * sizeof(VertexFormat))) return false;
+    if(pipeline->apiPipelineLayout != pipelineLayout) return false;     // Layouts are unique per description
+    RasterizerState* rasterizerState = &pipeline->rasterizerState;
+    if(rasterizerState->fillMode != desc->rasterizerState.fillMode
+            || rasterizerState->cullMode != desc->rasterizerState.cullMode
+            || rasterizerState->frontFace != desc->rasterizerState.frontFace) return false;
+    return pipeline->depthState.test == desc->depthState.test && pipeline->depthState.writeEnable == desc->depthState.writeEnable;
+}
 
-    // Creating sampler for the image (hardcoded params)
-    VkSamplerCreateInfo samplerInfo = {};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(ctx->apiPhysicalDevice, &properties);
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.f;
-    samplerInfo.minLod = 0.f;
-    samplerInfo.maxLod = 0.f;
-    VkSampler apiSampler;
-    ret = vkCreateSampler(ctx->apiDevice, &samplerInfo, NULL, &apiSampler);
+VkPipelineLayout GetPipelineLayout(RenderContext* ctx, PipelineRegistry* registry, PipelineLayoutDesc* desc)
+{
+    ASSERT(desc->descriptorSetLayoutCount <= PIPELINE_MAX_DESCRIPTOR_SET_LAYOUTS);
+    u64 hash = HashPipelineLayoutDesc(desc);
+    u32 slot = (u32)hash & (PIPELINE_LAYOUT_REGISTRY_CAPACITY - 1);
+    while(registry->layoutHashes[slot])
+    {
+        if(registry->layoutHashes[slot] == hash && ArePipelineLayoutDescsEqual(&registry->layoutDescs[slot], desc))
+        {
+            return registry->apiLayouts[slot];
+        }
+        slot = (slot + 1) & (PIPELINE_LAYOUT_REGISTRY_CAPACITY - 1);
+    }
+    ASSERT(registry->layoutCount < PIPELINE_LAYOUT_REGISTRY_CAPACITY / 2);    // Keep load factor low
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = desc->descriptorSetLayoutCount;
+    pipelineLayoutInfo.pSetLayouts = desc->descriptorSetLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = desc->pushConstantRange.size ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &desc->pushConstantRange;
+    VkPipelineLayout pipelineLayout;
+    VkResult ret = vkCreatePipelineLayout(ctx->apiDevice, &pipelineLayoutInfo, NULL, &pipelineLayout);
     VK_ASSERT(ret);
 
-    Texture result = {};
-    result.apiObject = apiObject;
-    result.apiAllocation = apiAllocation;
-    result.apiImageView = apiImageView;
-    result.apiSampler = apiSampler;
-    result.type = textureType;
-    result.format = textureFormat;
-    result.width = textureWidth;
-    result.height = textureHeight;
-    result.channels = textureChannels;
-    return result;
+    registry->layoutHashes[slot] = hash;
+    registry->layoutDescs[slot] = *desc;
+    registry->apiLayouts[slot] = pipelineLayout;
+    registry->layoutCount++;
+    return pipelineLayout;
+}
+
+// Returned pointer is owned by the registry and stays valid until DestroyPipelineRegistry.
+GraphicsPipeline* GetGraphicsPipeline(RenderContext* ctx, PipelineRegistry* registry, GraphicsPipelineDesc* desc)
+{
+    registry->lookupCount++;
+    u64 hash = HashGraphicsPipelineDesc(desc);
+    VkPipelineLayout pipelineLayout = GetPipelineLayout(ctx, registry, &desc->layout);
+    u32 slot = (u32)hash & (PIPELINE_REGISTRY_CAPACITY - 1);
+    while(registry->pipelineHashes[slot])
+    {
+        if(registry->pipelineHashes[slot] == hash
+                && DoesGraphicsPipelineMatch(&registry->pipelines[slot], &registry->pipelineRenderPassKeys[slot], pipelineLayout, desc))
+        {
+            return &registry->pipelines[slot];
+        }
+        slot = (slot + 1) & (PIPELINE_REGISTRY_CAPACITY - 1);
+    }
+    ASSERT(registry->pipelineCount < PIPELINE_REGISTRY_CAPACITY / 2);
+
+    registry->pipelines[slot] = CreateGraphicsPipeline(ctx, desc->renderPass,
+            desc->inputAssemblyState, desc->vs, desc->ps,
+            desc->vertexLayout, pipelineLayout, desc->rasterizerState, desc->depthState);
+    registry->pipelines[slot].pushConstantRange = desc->layout.pushConstantRange;
+    registry->pipelineRenderPassKeys[slot] = GetPipelineRenderPassKey(desc->renderPass);
+    registry->pipelineHashes[slot] = hash;
+    registry->pipelineCount++;
+    return &registry->pipelines[slot];
+}
+
+// ======================================================================
+// Frame readback
+// Copies the final color target of a frame into a host visible buffer, and hands it to a callback once the GPU is done.
+// Copies go to a ring of persistently mapped buffers (slots). A frame's slot is handed over right after its fence wait,
+// RENDERER_MAX_FRAMES_IN_FLIGHT frames after it was recorded, and the callback runs on the job system: the render
+// thread never waits on a copy nor on the consumer, unless every slot is still busy. One consumer job at a time drains
+// the handed over slots in order, so callbacks (e.g. capture sinks) are serialized and see frames in order.
+#define FRAME_READBACK_SLOTS (RENDERER_MAX_FRAMES_IN_FLIGHT * 2)    // In flight, plus as many queued for the consumer
+typedef void (*FrameReadbackProc)(void* userData, const CaptureFrame* frame);
+
+struct FrameReadback
+{
+    RenderContext* ctx = NULL;
+    JobSystem* jobSystem = NULL;
+    u32 width = 0;
+    u32 height = 0;
+    CapturePixelLayout layout = CAPTURE_PIXEL_BGRA8;
+    Buffer buffers[FRAME_READBACK_SLOTS];
+    u8* mappings[FRAME_READBACK_SLOTS];
+    u32 slotFrameIndex[FRAME_READBACK_SLOTS];
+    i32 inFlightSlots[RENDERER_MAX_FRAMES_IN_FLIGHT];   // Slot recorded by each frame in flight, -1 for none
+
+    // Guarded by lock
+    PlatformMutex lock;
+    PlatformConditionVariable slotReleased;
+    bool slotBusy[FRAME_READBACK_SLOTS];                // From recording until the consumer is done with it
+    u32 readySlots[FRAME_READBACK_SLOTS];               // FIFO of slots handed over to the consumer
+    u32 readyHead = 0;
+    u32 readyCount = 0;
+    bool consumerRunning = false;
+
+    FrameReadbackProc callback = NULL;
+    void* userData = NULL;
+
+    // Stats, guarded by lock
+    u32 deliveredCount = 0;
+    f64 callbackMs = 0;     // Time spent in the callback, on job system workers
+};
+
+// readback must stay in place while initialized (it holds a lock).
+void InitFrameReadback(RenderContext* ctx, FrameReadback* readback, u32 width, u32 height, VkFormat format,
+        JobSystem* jobSystem, FrameReadbackProc callback, void* userData)
+{
+    ASSERT(width && height);
+    *readback = {};
+    switch(format)
+    {
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM: readback->layout = CAPTURE_PIXEL_BGRA8; break;
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM: readback->layout = CAPTURE_PIXEL_RGBA8; break;
+        default: ASSERT(0);     // Only 8-bit RGBA/BGRA targets can be read back
+    }
+    readback->ctx = ctx;
+    readback->jobSystem = jobSystem;
+    readback->width = width;
+    readback->height = height;
+    readback->callback = callback;
+    readback->userData = userData;
+    PlatformInitMutex(&readback->lock);
+    PlatformInitConditionVariable(&readback->slotReleased);
+    for(i32 i = 0; i < FRAME_READBACK_SLOTS; i++)
+    {
+        readback->buffers[i] = CreateBuffer(ctx, BUFFER_TYPE_READBACK, (u64)width * height * 4, 1, NULL);
+        void* mapping = NULL;
+        VkResult ret = vmaMapMemory(ctx->apiMemoryAllocator, readback->buffers[i].apiAllocation, &mapping);
+        VK_ASSERT(ret);
+        readback->mappings[i] = (u8*)mapping;
+        readback->slotBusy[i] = false;
+    }
+    for(i32 i = 0; i < RENDERER_MAX_FRAMES_IN_FLIGHT; i++) readback->inFlightSlots[i] = -1;
+}
+
+// Flush first (see FlushFrameReadback), so no slot is in use.
+void DestroyFrameReadback(RenderContext* ctx, FrameReadback* readback)
+{
+    for(i32 i = 0; i < FRAME_READBACK_SLOTS; i++)
+    {
+        vmaUnmapMemory(ctx->apiMemoryAllocator, readback->buffers[i].apiAllocation);
+        DestroyBuffer(ctx, readback->buffers[i]);
+    }
+    *readback = {};
+}
+
+// Blocks while every slot is busy, i.e. while the consumer is more than a few frames behind.
+u32 AcquireFrameReadbackSlot(FrameReadback* readback)
+{
+    PlatformLockMutex(&readback->lock);
+    while(true)
+    {
+        for(u32 i = 0; i < FRAME_READBACK_SLOTS; i++)
+        {
+            if(readback->slotBusy[i]) continue;
+            readback->slotBusy[i] = true;
+            PlatformUnlockMutex(&readback->lock);
+            return i;
+        }
+        PlatformWaitConditionVariable(&readback->slotReleased, &readback->lock);
+    }
 }
 
-void DestroyTexture(RenderContext* ctx, Texture texture)
+// Records the copy of image at the end of a frame. The image must be in TRANSFER_SRC layout, as the render graph
+// leaves it for a pass reading it with RESOURCE_ACCESS_TRANSFER_READ (see FrameReadbackPassProc).
+void RecordFrameReadback(RenderContext* ctx, FrameReadback* readback, VkCommandBuffer commandBuffer, u32 inFlightFrame, u32 frameIndex,
+        VkImage image)
 {
-    ASSERT(ctx);
-    ASSERT(ctx->apiMemoryAllocator != VK_NULL_HANDLE);
-    vkDestroyImageView(ctx->apiDevice, texture.apiImageView, NULL);
-    vkDestroySampler(ctx->apiDevice, texture.apiSampler, NULL);
-    vmaDestroyImage(ctx->apiMemoryAllocator, texture.apiObject, texture.apiAllocation);
+    ASSERT(inFlightFrame < RENDERER_MAX_FRAMES_IN_FLIGHT);
+    ASSERT(readback->inFlightSlots[inFlightFrame] == -1);   // Previous copy of this frame in flight must be delivered first
+    u32 slot = AcquireFrameReadbackSlot(readback);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = 0;
+    copyRegion.bufferRowLength = 0;     // Tightly packed
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = {0, 0, 0};
+    copyRegion.imageExtent = {readback->width, readback->height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            readback->buffers[slot].apiObject, 1, &copyRegion);
+
+    // Make the copy visible to host reads after the frame fence
+    VkBufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = readback->buffers[slot].apiObject;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+
+    readback->inFlightSlots[inFlightFrame] = (i32)slot;
+    readback->slotFrameIndex[slot] = frameIndex;
 }
 
-// ===================================================================
-// Graphics pipeline
-enum VertexFormat
-{
-    VERTEX_FORMAT_R32G32_FLOAT,
-    VERTEX_FORMAT_R32G32B32_FLOAT,
-};
-VkFormat vertexFormatToVk[] =
-{
-    VK_FORMAT_R32G32_SFLOAT,
-    VK_FORMAT_R32G32B32_SFLOAT,
-};
-u32 vertexFormatSizeInBytes[] =
+// Render graph pass copying image out, a side effect the graph can't see, so the pass is never culled.
+struct FrameReadbackPass
 {
-    8,
-    12,
+    RenderContext* ctx = NULL;
+    FrameReadback* readback = NULL;
+    u32 image = RENDER_GRAPH_NONE;
+    u32 inFlightFrame = 0;  // Set every frame
+    u32 frameIndex = 0;
 };
 
-#define VERTEX_LAYOUT_MAX_ATTRIBUTES 8
-struct VertexLayout
+void FrameReadbackPassProc(RenderGraph* graph, VkCommandBuffer commandBuffer, void* userData)
 {
-    u32 index = -1;
-    VkVertexInputBindingDescription apiBindingDescription;
-
-    u32 attributeCount = 0;
-    VertexFormat attributeFormats[VERTEX_LAYOUT_MAX_ATTRIBUTES];
-    VkVertexInputAttributeDescription apiAttributeDescriptions[VERTEX_LAYOUT_MAX_ATTRIBUTES];
-};
+    FrameReadbackPass* pass = (FrameReadbackPass*)userData;
+    RecordFrameReadback(pass->ctx, pass->readback, commandBuffer, pass->inFlightFrame, pass->frameIndex, GetRenderGraphImage(graph, pass->image));
+}
 
-VertexLayout CreateVertexLayout(u32 layoutIndex, u32 attributeCount, VertexFormat* attributeFormats)
+// Consumer job: runs the callback on handed over slots, oldest first, and releases them. Exits once none are left.
+void FrameReadbackJobProc(void* data)
 {
-    VkVertexInputAttributeDescription attributeDescriptions[attributeCount];
-    u32 stride = 0;
-    for(i32 i = 0; i < attributeCount; i++)
+    FrameReadback* readback = (FrameReadback*)data;
+    while(true)
     {
-        attributeDescriptions[i].binding = layoutIndex;
-        attributeDescriptions[i].location = i;  // Vertex attribute locations are set in order.
-        attributeDescriptions[i].format = vertexFormatToVk[attributeFormats[i]];
-        attributeDescriptions[i].offset = stride;
-        stride += vertexFormatSizeInBytes[attributeFormats[i]];
+        PlatformLockMutex(&readback->lock);
+        if(!readback->readyCount)
+        {
+            readback->consumerRunning = false;
+            PlatformUnlockMutex(&readback->lock);
+            PlatformWakeAll(&readback->slotReleased);
+            return;
+        }
+        u32 slot = readback->readySlots[readback->readyHead];
+        readback->readyHead = (readback->readyHead + 1) % FRAME_READBACK_SLOTS;
+        readback->readyCount--;
+        PlatformUnlockMutex(&readback->lock);
+
+        vmaInvalidateAllocation(readback->ctx->apiMemoryAllocator, readback->buffers[slot].apiAllocation, 0, VK_WHOLE_SIZE);
+        CaptureFrame frame = {};
+        frame.index = readback->slotFrameIndex[slot];
+        frame.width = readback->width;
+        frame.height = readback->height;
+        frame.rowPitch = readback->width * 4;
+        frame.layout = readback->layout;
+        frame.pixels = readback->mappings[slot];
+        u64 callbackStart = GetTimerTicks();
+        readback->callback(readback->userData, &frame);
+        f64 callbackMs = TimerTicksToMs(GetTimerTicks() - callbackStart);
+
+        PlatformLockMutex(&readback->lock);
+        readback->slotBusy[slot] = false;
+        readback->deliveredCount++;
+        readback->callbackMs += callbackMs;
+        PlatformUnlockMutex(&readback->lock);
+        PlatformWakeAll(&readback->slotReleased);
     }
+}
 
-    VkVertexInputBindingDescription bindingDescription = {};
-    bindingDescription.binding = layoutIndex;
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;     // No instancing supported yet.
-    bindingDescription.stride = stride;
+// Call once the fence of inFlightFrame has been waited on. Hands its slot to the consumer job.
+void DeliverFrameReadback(RenderContext* ctx, FrameReadback* readback, u32 inFlightFrame)
+{
+    i32 slot = readback->inFlightSlots[inFlightFrame];
+    if(slot == -1) return;
+    readback->inFlightSlots[inFlightFrame] = -1;
+
+    PlatformLockMutex(&readback->lock);
+    ASSERT(readback->readyCount < FRAME_READBACK_SLOTS);
+    readback->readySlots[(readback->readyHead + readback->readyCount) % FRAME_READBACK_SLOTS] = (u32)slot;
+    readback->readyCount++;
+    bool startConsumer = !readback->consumerRunning;
+    readback->consumerRunning = true;
+    PlatformUnlockMutex(&readback->lock);
+    if(startConsumer) PushJob(readback->jobSystem, FrameReadbackJobProc, readback);
+}
 
-    VertexLayout result = {};
-    result.index = layoutIndex;
-    result.apiBindingDescription = bindingDescription;
-    result.attributeCount = attributeCount;
-    for(i32 i = 0; i < attributeCount; i++)
+// Delivers every pending frame, oldest first, and waits for the consumer to finish them. The GPU must be idle
+// (e.g. at shutdown).
+void FlushFrameReadback(RenderContext* ctx, FrameReadback* readback)
+{
+    while(true)
     {
-        result.attributeFormats[i] = attributeFormats[i];
-        result.apiAttributeDescriptions[i] = attributeDescriptions[i];
+        i32 oldest = -1;
+        for(i32 i = 0; i < RENDERER_MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            i32 slot = readback->inFlightSlots[i];
+            if(slot == -1) continue;
+            if(oldest == -1 || readback->slotFrameIndex[slot] < readback->slotFrameIndex[readback->inFlightSlots[oldest]]) oldest = i;
+        }
+        if(oldest == -1) break;
+        DeliverFrameReadback(ctx, readback, oldest);
     }
-    return result;
+    PlatformLockMutex(&readback->lock);
+    while(readback->consumerRunning)
+    {
+        PlatformWaitConditionVariable(&readback->slotReleased, &readback->lock);
+    }
+    PlatformUnlockMutex(&readback->lock);
 }
 
-enum ShaderType
+// Flushes pending frames and recreates the buffers for a new target size (e.g. after a swap chain resize).
+void ResizeFrameReadback(RenderContext* ctx, FrameReadback* readback, u32 width, u32 height, VkFormat format)
 {
-    SHADER_TYPE_VERTEX,
-    SHADER_TYPE_PIXEL,
-};
+    vkDeviceWaitIdle(ctx->apiDevice);
+    FlushFrameReadback(ctx, readback);
+    JobSystem* jobSystem = readback->jobSystem;
+    FrameReadbackProc callback = readback->callback;
+    void* userData = readback->userData;
+    u32 deliveredCount = readback->deliveredCount;
+    f64 callbackMs = readback->callbackMs;
+    DestroyFrameReadback(ctx, readback);
+    InitFrameReadback(ctx, readback, width, height, format, jobSystem, callback, userData);
+    readback->deliveredCount = deliveredCount;
+    readback->callbackMs = callbackMs;
+}
 
-struct ShaderAsset
+// ======================================================================
+// Descriptors
+// Descriptor allocator: chain of pools that grows when the current one runs out.
+// All sets are released at once by resetting the pools, which are then reused (no per-set frees).
+// Pools are sized from the expected descriptor counts of one set, times sets per pool.
+#define DESCRIPTOR_ALLOCATOR_MAX_POOLS      64
+#define DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES 8
+#define DESCRIPTOR_ALLOCATOR_SETS_PER_POOL  256
+
+struct DescriptorAllocator
 {
-    ShaderType type;
-    u64 bytecodeSize = -1;
-    u8* bytecode = NULL;
+    u32 setsPerPool = 0;
+    u32 poolSizeCount = 0;
+    VkDescriptorPoolSize poolSizes[DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES];   // Per pool (already multiplied)
+
+    u32 poolCount = 0;
+    u32 currentPool = 0;
+    VkDescriptorPool apiPools[DESCRIPTOR_ALLOCATOR_MAX_POOLS];
+
+    u32 allocatedSets = 0;      // Since last reset
+    u32 peakSets = 0;
 };
 
-#define SHADER_BYTECODE_ALIGN 4     // 4 byte alignment for shader memory
-ShaderAsset CreateShaderAsset(const char* assetPath, ShaderType type)
+void InitDescriptorAllocator(DescriptorAllocator* allocator, u32 setsPerPool, u32 poolSizeCount, VkDescriptorPoolSize* poolSizesPerSet)
 {
-    u64 assetSize = GetFileSize(assetPath);
-    // TODO(caio)#MEMORY: Remove dynamic alloc in favor of custom resource arena allocator
-    u8* assetData = (u8*)_aligned_malloc(assetSize, SHADER_BYTECODE_ALIGN);
-    ReadFileAsBinary(assetPath, assetSize, assetData);
-    return
+    ASSERT(poolSizeCount <= DESCRIPTOR_ALLOCATOR_MAX_POOL_SIZES);
+    *allocator = {};
+    allocator->setsPerPool = setsPerPool;
+    allocator->poolSizeCount = poolSizeCount;
+    for(i32 i = 0; i < poolSizeCount; i++)
     {
-        type, assetSize, assetData
-    };
+        allocator->poolSizes[i] = { poolSizesPerSet[i].type, poolSizesPerSet[i].descriptorCount * setsPerPool };
+    }
 }
 
-enum PrimitiveType
+void DestroyDescriptorAllocator(RenderContext* ctx, DescriptorAllocator* allocator)
 {
-    PRIMITIVE_TRIANGLE_LIST,
-};
-VkPrimitiveTopology primitiveTypeToVk[] =
+    for(i32 i = 0; i < allocator->poolCount; i++)
+    {
+        vkDestroyDescriptorPool(ctx->apiDevice, allocator->apiPools[i], NULL);
+    }
+    *allocator = {};
+}
+
+// Keeps all pools for reuse, only rewinds to the first one.
+void ResetDescriptorAllocator(RenderContext* ctx, DescriptorAllocator* allocator)
 {
-    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-};
+    for(i32 i = 0; i <= allocator->currentPool && i < allocator->poolCount; i++)
+    {
+        VkResult ret = vkResetDescriptorPool(ctx->apiDevice, allocator->apiPools[i], 0);
+        VK_ASSERT(ret);
+    }
+    allocator->currentPool = 0;
+    allocator->allocatedSets = 0;
+}
 
-enum FillMode
+VkDescriptorSet AllocateDescriptorSet(RenderContext* ctx, DescriptorAllocator* allocator, VkDescriptorSetLayout layout)
 {
-    FILL_MODE_SOLID,
-    FILL_MODE_LINE,
-    FILL_MODE_POINT,
-};
-VkPolygonMode fillModeToVk[] =
+    while(true)
+    {
+        bool isNewPool = allocator->currentPool == allocator->poolCount;
+        if(isNewPool)
+        {
+            // Chain a new pool
+            ASSERT(allocator->poolCount < DESCRIPTOR_ALLOCATOR_MAX_POOLS);
+            VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+            descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            descriptorPoolInfo.poolSizeCount = allocator->poolSizeCount;
+            descriptorPoolInfo.pPoolSizes = allocator->poolSizes;
+            descriptorPoolInfo.maxSets = allocator->setsPerPool;
+            VkResult ret = vkCreateDescriptorPool(ctx->apiDevice, &descriptorPoolInfo, NULL, &allocator->apiPools[allocator->poolCount]);
+            VK_ASSERT(ret);
+            allocator->poolCount++;
+        }
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
+        descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocInfo.descriptorPool = allocator->apiPools[allocator->currentPool];
+        descriptorSetAllocInfo.descriptorSetCount = 1;
+        descriptorSetAllocInfo.pSetLayouts = &layout;
+        VkDescriptorSet result;
+        VkResult ret = vkAllocateDescriptorSets(ctx->apiDevice, &descriptorSetAllocInfo, &result);
+        if((ret == VK_ERROR_OUT_OF_POOL_MEMORY || ret == VK_ERROR_FRAGMENTED_POOL) && !isNewPool)
+        {
+            allocator->currentPool++;   // Current pool is full, move on to the next one
+            continue;
+        }
+        VK_ASSERT(ret);     // An empty pool that can't fit the set is sized for other layouts, more pools won't help
+        allocator->allocatedSets++;
+        allocator->peakSets = MAX(allocator->peakSets, allocator->allocatedSets);
+        return result;
+    }
+}
+
+// Resources to write to a descriptor set, one descriptor per binding.
+#define DESCRIPTOR_SET_MAX_RESOURCES 16
+struct DescriptorResource
 {
-    VK_POLYGON_MODE_FILL,
-    VK_POLYGON_MODE_LINE,
-    VK_POLYGON_MODE_POINT,
+    u32 binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkBuffer apiBuffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize range = 0;
+    VkImageView apiImageView = VK_NULL_HANDLE;      // Samplers are immutable, see GetDescriptorSetLayout
 };
 
-enum CullMode
+struct DescriptorSetDesc
 {
-    CULL_MODE_NONE,
-    CULL_MODE_FRONT,
-    CULL_MODE_BACK,
-    CULL_MODE_FRONT_BACK,
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    u32 resourceCount = 0;
+    DescriptorResource resources[DESCRIPTOR_SET_MAX_RESOURCES];
 };
-VkCullModeFlagBits cullModeToVk[] =
+
+void WriteDescriptorSet(RenderContext* ctx, VkDescriptorSet set, DescriptorSetDesc* desc)
 {
-    VK_CULL_MODE_NONE,
-    VK_CULL_MODE_FRONT_BIT,
-    VK_CULL_MODE_BACK_BIT,
-    VK_CULL_MODE_FRONT_AND_BACK,
-};
+    VkDescriptorBufferInfo bufferInfos[DESCRIPTOR_SET_MAX_RESOURCES];
+    VkDescriptorImageInfo imageInfos[DESCRIPTOR_SET_MAX_RESOURCES];
+    VkWriteDescriptorSet writes[DESCRIPTOR_SET_MAX_RESOURCES];
+    for(i32 i = 0; i < desc->resourceCount; i++)
+    {
+        DescriptorResource* resource = &desc->resources[i];
+        writes[i] = {};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = resource->binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = resource->type;
+        switch(resource->type)
+        {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                {
+                    bufferInfos[i] = { resource->apiBuffer, resource->offset, resource->range };
+                    writes[i].pBufferInfo = &bufferInfos[i];
+                } break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                {
+                    imageInfos[i] = { VK_NULL_HANDLE, resource->apiImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                    writes[i].pImageInfo = &imageInfos[i];
+                } break;
+            default: ASSERT(0); break;
+        }
+    }
+    vkUpdateDescriptorSets(ctx->apiDevice, desc->resourceCount, writes, 0, NULL);
+}
 
-enum FrontFace
+// Sets from per-frame allocators are valid until the allocator is reset, once the frame's fence signals.
+VkDescriptorSet AllocateWrittenDescriptorSet(RenderContext* ctx, DescriptorAllocator* allocator, DescriptorSetDesc* desc)
 {
-    FRONT_FACE_CW,
-    FRONT_FACE_CCW,
-};
-VkFrontFace frontFaceModeToVk[] =
+    VkDescriptorSet result = AllocateDescriptorSet(ctx, allocator, desc->layout);
+    WriteDescriptorSet(ctx, result, desc);
+    return result;
+}
+
+// Cache of pre-written sets for layouts used every frame: sets are allocated and written once per unique
+// layout + resources combination, then reused. Open addressing keyed by description hash, hits are confirmed
+// against the stored description.
+#define DESCRIPTOR_SET_CACHE_CAPACITY 256     // Must be power of 2
+struct DescriptorSetCache
 {
-    VK_FRONT_FACE_CLOCKWISE,
-    VK_FRONT_FACE_COUNTER_CLOCKWISE,
+    DescriptorAllocator allocator;
+    u32 count = 0;
+    u64 hashes[DESCRIPTOR_SET_CACHE_CAPACITY];      // 0 marks an empty slot
+    DescriptorSetDesc* descs = NULL;                // DESCRIPTOR_SET_CACHE_CAPACITY entries
+    VkDescriptorSet apiSets[DESCRIPTOR_SET_CACHE_CAPACITY];
 };
 
-struct InputAssemblyState
+// Stored descriptions come from arena.
+void InitDescriptorSetCache(DescriptorSetCache* cache, u32 poolSizeCount, VkDescriptorPoolSize* poolSizesPerSet, Arena* arena)
 {
-    PrimitiveType primitive = PRIMITIVE_TRIANGLE_LIST;
-};
+    InitDescriptorAllocator(&cache->allocator, DESCRIPTOR_SET_CACHE_CAPACITY / 2, poolSizeCount, poolSizesPerSet);
+    cache->count = 0;
+    memset(cache->hashes, 0, sizeof(cache->hashes));
+    cache->descs = ARENA_PUSH_ARRAY(arena, DescriptorSetDesc, DESCRIPTOR_SET_CACHE_CAPACITY);
+}
 
-struct RasterizerState
+bool AreDescriptorSetDescsEqual(DescriptorSetDesc* a, DescriptorSetDesc* b)
 {
-    FillMode fillMode = FILL_MODE_SOLID;
-    CullMode cullMode = CULL_MODE_BACK;
-    FrontFace frontFace = FRONT_FACE_CW;
-};
+    if(a->layout != b->layout || a->resourceCount != b->resourceCount) return false;
+    for(i32 i = 0; i < a->resourceCount; i++)
+    {
+        DescriptorResource* resourceA = &a->resources[i];
+        DescriptorResource* resourceB = &b->resources[i];
+        if(resourceA->binding != resourceB->binding || resourceA->type != resourceB->type
+                || resourceA->apiBuffer != resourceB->apiBuffer || resourceA->offset != resourceB->offset
+                || resourceA->range != resourceB->range || resourceA->apiImageView != resourceB->apiImageView) return false;
+    }
+    return true;
+}
 
-struct PushConstants
+void DestroyDescriptorSetCache(RenderContext* ctx, DescriptorSetCache* cache)
 {
-    m4f model = {};
-};
+    DestroyDescriptorAllocator(ctx, &cache->allocator);
+    cache->count = 0;
+    memset(cache->hashes, 0, sizeof(cache->hashes));
+}
 
-struct GraphicsPipeline
+VkDescriptorSet GetCachedDescriptorSet(RenderContext* ctx, DescriptorSetCache* cache, DescriptorSetDesc* desc)
 {
-    VkPipeline apiObject = VK_NULL_HANDLE;
-    VkPipelineLayout apiPipelineLayout = VK_NULL_HANDLE;
+    u64 hash = Hash64(&desc->layout, sizeof(VkDescriptorSetLayout));
+    for(i32 i = 0; i < desc->resourceCount; i++)
+    {
+        DescriptorResource* resource = &desc->resources[i];
+        hash = Hash64(&resource->binding, sizeof(u32), hash);
+        hash = Hash64(&resource->type, sizeof(VkDescriptorType), hash);
+        hash = Hash64(&resource->apiBuffer, sizeof(VkBuffer), hash);
+        hash = Hash64(&resource->offset, sizeof(VkDeviceSize), hash);
+        hash = Hash64(&resource->range, sizeof(VkDeviceSize), hash);
+        hash = Hash64(&resource->apiImageView, sizeof(VkImageView), hash);
+    }
+    if(!hash) hash = 1;
 
-    // Programmable pipeline
-    ShaderAsset shaderVertex;
-    ShaderAsset shaderPixel;
+    u32 slot = (u32)hash & (DESCRIPTOR_SET_CACHE_CAPACITY - 1);
+    while(cache->hashes[slot])
+    {
+        if(cache->hashes[slot] == hash && AreDescriptorSetDescsEqual(&cache->descs[slot], desc)) return cache->apiSets[slot];
+        slot = (slot + 1) & (DESCRIPTOR_SET_CACHE_CAPACITY - 1);
+    }
+    ASSERT(cache->count < DESCRIPTOR_SET_CACHE_CAPACITY / 2);
 
-    // Fixed pipeline
-    InputAssemblyState inputAssemblyState;
-    VertexLayout vertexLayout;  // Only one vertex layout per pipeline.
-    // TODO(caio): Add support for dynamic viewport and scissor rect
-    RasterizerState rasterizerState;
-    // TODO(caio): Add support for color blend modes, depth testing modes...
-};
+    VkDescriptorSet result = AllocateWrittenDescriptorSet(ctx, &cache->allocator, desc);
+    cache->hashes[slot] = hash;
+    cache->descs[slot] = *desc;
+    cache->apiSets[slot] = result;
+    cache->count++;
+    return result;
+}
 
-GraphicsPipeline CreateGraphicsPipeline(
-        RenderContext* ctx, 
-        RenderPass* renderPass,
-        InputAssemblyState inputAssemblyState,
-        ShaderAsset vs, ShaderAsset ps, 
-        VertexLayout vertexLayout,
-        VkDescriptorSetLayout descriptorSetLayout,  // TODO(caio): Remove this from here when making shader resource abstraction
-        RasterizerState rasterizerState)
+// ======================================================================
+// Render queue
+// Draws are pushed as compact items with a 64 bit sort key, radix sorted once per frame, and recorded with
+// pipeline, descriptor set and buffer binds only where consecutive items need different state.
+// Key fields, most significant first, index the queue's per frame state tables:
+//      pass        4 bits      Each pass records its own range of the sorted items
+//      pipeline    12 bits
+//      bindings    12 bits     Descriptor sets, bound from set 0
+//      geometry    12 bits     Vertex and index buffers (a geometry arena holds many meshes)
+//      depth       24 bits     Front to back, for early depth rejection
+#define RENDER_KEY_DEPTH_BITS       24
+#define RENDER_KEY_GEOMETRY_BITS    12
+#define RENDER_KEY_BINDINGS_BITS    12
+#define RENDER_KEY_PIPELINE_BITS    12
+#define RENDER_KEY_PASS_BITS        4
+#define RENDER_KEY_DEPTH_SHIFT      0
+#define RENDER_KEY_GEOMETRY_SHIFT   (RENDER_KEY_DEPTH_SHIFT + RENDER_KEY_DEPTH_BITS)
+#define RENDER_KEY_BINDINGS_SHIFT   (RENDER_KEY_GEOMETRY_SHIFT + RENDER_KEY_GEOMETRY_BITS)
+#define RENDER_KEY_PIPELINE_SHIFT   (RENDER_KEY_BINDINGS_SHIFT + RENDER_KEY_BINDINGS_BITS)
+#define RENDER_KEY_PASS_SHIFT       (RENDER_KEY_PIPELINE_SHIFT + RENDER_KEY_PIPELINE_BITS)
+#define RENDER_KEY_FIELD(KEY, FIELD) ((u32)((KEY) >> RENDER_KEY_##FIELD##_SHIFT) & ((1u << RENDER_KEY_##FIELD##_BITS) - 1))
+#define RENDER_QUEUE_MAX_STATES     64      // Entries per state table
+static_assert(RENDER_KEY_PASS_SHIFT + RENDER_KEY_PASS_BITS == 64, "Render key fields must fill 64 bits");
+
+struct RenderBindings
 {
-    ASSERT(ctx->apiDevice != VK_NULL_HANDLE);
-    ASSERT(renderPass->apiObject != VK_NULL_HANDLE);
-    VkResult ret;
-
-    // Setting up programmable stages
-    ASSERT(vs.bytecodeSize != -1);
-    ASSERT(ps.bytecodeSize != -1);
-    VkShaderModuleCreateInfo vsShaderModuleInfo = {};
-    vsShaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vsShaderModuleInfo.codeSize = vs.bytecodeSize;
-    vsShaderModuleInfo.pCode = (u32*)vs.bytecode;
-    VkShaderModuleCreateInfo psShaderModuleInfo = vsShaderModuleInfo;
-    psShaderModuleInfo.codeSize = ps.bytecodeSize;
-    psShaderModuleInfo.pCode = (u32*)ps.bytecode;
-    VkShaderModule vsShaderModule;
-    ret = vkCreateShaderModule(ctx->apiDevice, &vsShaderModuleInfo, NULL, &vsShaderModule);
-    VK_ASSERT(ret);
-    VkShaderModule psShaderModule;
-    ret = vkCreateShaderModule(ctx->apiDevice, &psShaderModuleInfo, NULL, &psShaderModule);
-    VK_ASSERT(ret);
-
-    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
-    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageInfo.pName = "main";     // Shader entrypoint hardcoded to always be main
-    VkPipelineShaderStageCreateInfo vsShaderStageInfo = shaderStageInfo;
-    vsShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vsShaderStageInfo.module = vsShaderModule;
-    VkPipelineShaderStageCreateInfo psShaderStageInfo = shaderStageInfo;
-    psShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    psShaderStageInfo.module = psShaderModule;
-    VkPipelineShaderStageCreateInfo shaderStages[] =
-    {
-        vsShaderStageInfo, psShaderStageInfo
-    };
-    
-    // Input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
-    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyInfo.topology = primitiveTypeToVk[inputAssemblyState.primitive];
-    inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+    VkDescriptorSet apiDescriptorSets[PIPELINE_MAX_DESCRIPTOR_SET_LAYOUTS];
+    u32 setCount = 0;
+};
 
-    // Vertex inputs
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &vertexLayout.apiBindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = vertexLayout.attributeCount;
-    vertexInputInfo.pVertexAttributeDescriptions = vertexLayout.apiAttributeDescriptions;
+struct RenderGeometry
+{
+    VkBuffer apiVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer apiIndexBuffer = VK_NULL_HANDLE;
+    IndexType indexType = INDEX_TYPE_U32;
+};
 
-    VkDynamicState dynamicStates[] =
-    {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR,
-    };
-    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
-    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateInfo.dynamicStateCount = ARR_LEN(dynamicStates);
-    dynamicStateInfo.pDynamicStates = dynamicStates;
+struct RenderDraw
+{
+    u32 indexCount = 0;
+    u32 firstIndex = 0;
+    i32 vertexOffset = 0;
+    const void* pushConstants = NULL;   // For the pipeline's push constant range. Must stay valid until the queue is recorded.
+};
 
-    // Viewport state (only one of each per pipeline, but can be changed on draw time)
-    VkPipelineViewportStateCreateInfo viewportStateInfo = {};
-    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateInfo.viewportCount = 1;
-    viewportStateInfo.scissorCount = 1;
+struct RenderItem
+{
+    u64 key;
+    u32 draw;           // Index into the queue's draws
+};
 
-    // Rasterization
-    VkPipelineRasterizationStateCreateInfo rasterizationStateInfo = {};
-    rasterizationStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationStateInfo.polygonMode = fillModeToVk[rasterizerState.fillMode];
-    rasterizationStateInfo.cullMode = cullModeToVk[rasterizerState.cullMode];
-    rasterizationStateInfo.frontFace = frontFaceModeToVk[rasterizerState.frontFace];
-    rasterizationStateInfo.depthClampEnable = VK_FALSE;
-    rasterizationStateInfo.lineWidth = 1;
-    rasterizationStateInfo.depthBiasEnable = VK_FALSE;
+// Binds issued. Without the queue every draw would bind everything, so draws - binds were eliminated.
+struct RenderQueueStats
+{
+    u64 draws = 0;
+    u64 pipelineBinds = 0;
+    u64 descriptorSetBinds = 0;
+    u64 geometryBinds = 0;
+};
 
-    // Blending (currently only supporting standard opaque blend)
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask = 
-        VK_COLOR_COMPONENT_R_BIT | 
-        VK_COLOR_COMPONENT_G_BIT | 
-        VK_COLOR_COMPONENT_B_BIT | 
-        VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;    // Overwrite color
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
-    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendInfo.logicOpEnable = VK_FALSE;
-    colorBlendInfo.attachmentCount = 1;
-    colorBlendInfo.pAttachments = &colorBlendAttachment;
+struct RenderQueue
+{
+    GraphicsPipeline* pipelines[RENDER_QUEUE_MAX_STATES];
+    RenderBindings bindings[RENDER_QUEUE_MAX_STATES];
+    RenderGeometry geometries[RENDER_QUEUE_MAX_STATES];
+    u32 pipelineCount = 0;
+    u32 bindingsCount = 0;
+    u32 geometryCount = 0;
+
+    RenderItem* items = NULL;
+    RenderDraw* draws = NULL;
+    u32 itemCount = 0;
+    u32 itemCapacity = 0;
+};
 
-    VkPipelineDepthStencilStateCreateInfo depthStateInfo = {};
-    depthStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStateInfo.depthTestEnable = VK_TRUE;
-    depthStateInfo.depthWriteEnable = VK_TRUE;
-    depthStateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStateInfo.depthBoundsTestEnable = VK_FALSE;
-    depthStateInfo.stencilTestEnable = VK_FALSE;
+// Empties the queue, with room for capacity draws allocated from arena (e.g. the frame arena).
+void BeginRenderQueue(RenderQueue* queue, Arena* arena, u32 capacity)
+{
+    queue->pipelineCount = 0;
+    queue->bindingsCount = 0;
+    queue->geometryCount = 0;
+    queue->items = ARENA_PUSH_ARRAY(arena, RenderItem, capacity);
+    queue->draws = ARENA_PUSH_ARRAY(arena, RenderDraw, capacity);
+    queue->itemCount = 0;
+    queue->itemCapacity = capacity;
+}
 
-    // Push constants (hardcoded)
-    VkPushConstantRange pushConstantRange = {};
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PushConstants);
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+// State table indices for sort keys. Tables are small, so lookups are linear.
+u32 GetRenderPipelineIndex(RenderQueue* queue, GraphicsPipeline* pipeline)
+{
+    for(u32 i = 0; i < queue->pipelineCount; i++)
+    {
+        if(queue->pipelines[i] == pipeline) return i;
+    }
+    ASSERT(queue->pipelineCount < RENDER_QUEUE_MAX_STATES);
+    queue->pipelines[queue->pipelineCount] = pipeline;
+    return queue->pipelineCount++;
+}
 
-    // Pipeline layout (for uniform buffers, currently empty)
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    //pipelineLayoutInfo.setLayoutCount = 0;
-    //pipelineLayoutInfo.pSetLayouts = NULL;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    VkPipelineLayout pipelineLayout;
-    ret = vkCreatePipelineLayout(ctx->apiDevice, &pipelineLayoutInfo, NULL, &pipelineLayout);
-    VK_ASSERT(ret);
+u32 GetRenderBindingsIndex(RenderQueue* queue, const VkDescriptorSet* apiDescriptorSets, u32 setCount)
+{
+    ASSERT(setCount <= PIPELINE_MAX_DESCRIPTOR_SET_LAYOUTS);
+    for(u32 i = 0; i < queue->bindingsCount; i++)
+    {
+        RenderBindings* bindings = &queue->bindings[i];
+        if(bindings->setCount == setCount && memcmp(bindings->apiDescriptorSets, apiDescriptorSets, setCount * sizeof(VkDescriptorSet)) == 0) return i;
+    }
+    ASSERT(queue->bindingsCount < RENDER_QUEUE_MAX_STATES);
+    RenderBindings* bindings = &queue->bindings[queue->bindingsCount];
+    memcpy(bindings->apiDescriptorSets, apiDescriptorSets, setCount * sizeof(VkDescriptorSet));
+    bindings->setCount = setCount;
+    return queue->bindingsCount++;
+}
 
-    // Graphics pipeline creation
-    VkGraphicsPipelineCreateInfo apiObjectInfo = {};
-    apiObjectInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    apiObjectInfo.stageCount = 2;   // Hardcoded vertex and pixel stages
-    apiObjectInfo.pStages = shaderStages;
-    apiObjectInfo.pVertexInputState = &vertexInputInfo;
-    apiObjectInfo.pInputAssemblyState = &inputAssemblyInfo;
-    apiObjectInfo.pViewportState = &viewportStateInfo;
-    apiObjectInfo.pDynamicState = &dynamicStateInfo;
-    apiObjectInfo.pRasterizationState = &rasterizationStateInfo;
-    apiObjectInfo.pColorBlendState = &colorBlendInfo;
-    apiObjectInfo.pDepthStencilState = &depthStateInfo;
-    apiObjectInfo.layout = pipelineLayout;
-    apiObjectInfo.renderPass = renderPass->apiObject;
-    apiObjectInfo.subpass = 0;      // Hardcoded to use only one subpass
-    apiObjectInfo.basePipelineHandle = VK_NULL_HANDLE;
-    apiObjectInfo.basePipelineIndex = -1;
-    VkPipeline apiObject;
-    ret = vkCreateGraphicsPipelines(ctx->apiDevice, VK_NULL_HANDLE, 1, &apiObjectInfo,
-            NULL, &apiObject);
-    VK_ASSERT(ret);
+u32 GetRenderGeometryIndex(RenderQueue* queue, GeometryArena* geometry)
+{
+    for(u32 i = 0; i < queue->geometryCount; i++)
+    {
+        if(queue->geometries[i].apiVertexBuffer == geometry->vertexBuffer.apiObject
+                && queue->geometries[i].apiIndexBuffer == geometry->indexBuffer.apiObject) return i;
+    }
+    ASSERT(queue->geometryCount < RENDER_QUEUE_MAX_STATES);
+    RenderGeometry* renderGeometry = &queue->geometries[queue->geometryCount];
+    renderGeometry->apiVertexBuffer = geometry->vertexBuffer.apiObject;
+    renderGeometry->apiIndexBuffer = geometry->indexBuffer.apiObject;
+    renderGeometry->indexType = geometry->indexBuffer.indexType;
+    return queue->geometryCount++;
+}
 
-    // Destroy unneeded shader modules
-    vkDestroyShaderModule(ctx->apiDevice, vsShaderModule, NULL);
-    vkDestroyShaderModule(ctx->apiDevice, psShaderModule, NULL);
+// depth is normalized view distance, [0, 1].
+void PushRenderDraw(RenderQueue* queue, u32 pass, u32 pipeline, u32 bindings, u32 geometry, f32 depth, RenderDraw draw)
+{
+    ASSERT(queue->itemCount < queue->itemCapacity);
+    ASSERT(pass < (1u << RENDER_KEY_PASS_BITS));
+    u64 depthBits = (u64)(CLAMP(depth, 0.f, 1.f) * ((1u << RENDER_KEY_DEPTH_BITS) - 1));
+    RenderItem* item = &queue->items[queue->itemCount];
+    item->key = ((u64)pass << RENDER_KEY_PASS_SHIFT)
+        | ((u64)pipeline << RENDER_KEY_PIPELINE_SHIFT)
+        | ((u64)bindings << RENDER_KEY_BINDINGS_SHIFT)
+        | ((u64)geometry << RENDER_KEY_GEOMETRY_SHIFT)
+        | (depthBits << RENDER_KEY_DEPTH_SHIFT);
+    item->draw = queue->itemCount;
+    queue->draws[queue->itemCount++] = draw;
+}
 
-    GraphicsPipeline result =
+// LSD radix sort, a byte per pass. Histograms for all passes are built up front,
+// and passes where every key has the same byte (e.g. unused key fields) are skipped.
+void SortRenderQueue(RenderQueue* queue)
+{
+    u32 count = queue->itemCount;
+    if(count < 2) return;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u32 histograms[8][256] = {};
+    for(u32 i = 0; i < count; i++)
     {
-        apiObject, pipelineLayout, vs, ps, 
-        inputAssemblyState, vertexLayout, rasterizerState,
-    };
-    return result;
+        u64 key = queue->items[i].key;
+        for(u32 b = 0; b < 8; b++) histograms[b][(key >> (b * 8)) & 0xFF]++;
+    }
+    RenderItem* src = queue->items;
+    RenderItem* dst = ARENA_PUSH_ARRAY(scratchScope.arena, RenderItem, count);
+    for(u32 b = 0; b < 8; b++)
+    {
+        u32* histogram = histograms[b];
+        if(histogram[(src[0].key >> (b * 8)) & 0xFF] == count) continue;
+        u32 offset = 0;
+        for(u32 i = 0; i < 256; i++)
+        {
+            u32 bucketCount = histogram[i];
+            histogram[i] = offset;
+            offset += bucketCount;
+        }
+        for(u32 i = 0; i < count; i++)
+        {
+            dst[histogram[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+        }
+        RenderItem* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if(src != queue->items) memcpy(queue->items, src, count * sizeof(RenderItem));
 }
 
-void DestroyGraphicsPipeline(RenderContext* ctx, GraphicsPipeline* pipeline)
+// Records the sorted items of one pass, skipping binds of state that is already bound.
+void RecordRenderQueue(RenderQueue* queue, VkCommandBuffer commandBuffer, u32 pass, RenderQueueStats* stats)
 {
-    vkDestroyPipeline(ctx->apiDevice, pipeline->apiObject, NULL);
-    vkDestroyPipelineLayout(ctx->apiDevice, pipeline->apiPipelineLayout, NULL);
+    GraphicsPipeline* boundPipeline = NULL;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    u32 boundBindings = MAX_U32;
+    u32 boundGeometry = MAX_U32;
+    for(u32 i = 0; i < queue->itemCount; i++)
+    {
+        const RenderItem* item = &queue->items[i];
+        if(RENDER_KEY_FIELD(item->key, PASS) != pass) continue;
+        const RenderDraw* draw = &queue->draws[item->draw];
 
-    *pipeline = {};
+        GraphicsPipeline* pipeline = queue->pipelines[RENDER_KEY_FIELD(item->key, PIPELINE)];
+        if(pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->apiObject);
+            boundPipeline = pipeline;
+            stats->pipelineBinds++;
+        }
+        // Sets stay bound across pipelines with the same layout
+        u32 bindingsIndex = RENDER_KEY_FIELD(item->key, BINDINGS);
+        if(bindingsIndex != boundBindings || pipeline->apiPipelineLayout != boundLayout)
+        {
+            const RenderBindings* bindings = &queue->bindings[bindingsIndex];
+            if(bindings->setCount)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->apiPipelineLayout, 0,
+                        bindings->setCount, bindings->apiDescriptorSets, 0, NULL);
+                stats->descriptorSetBinds++;
+            }
+            boundBindings = bindingsIndex;
+            boundLayout = pipeline->apiPipelineLayout;
+        }
+        u32 geometryIndex = RENDER_KEY_FIELD(item->key, GEOMETRY);
+        if(geometryIndex != boundGeometry)
+        {
+            const RenderGeometry* geometry = &queue->geometries[geometryIndex];
+            VkDeviceSize bufferOffset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometry->apiVertexBuffer, &bufferOffset);
+            vkCmdBindIndexBuffer(commandBuffer, geometry->apiIndexBuffer, 0, indexTypeToVk[geometry->indexType]);
+            boundGeometry = geometryIndex;
+            stats->geometryBinds++;
+        }
+
+        VkPushConstantRange* pushConstantRange = &pipeline->pushConstantRange;
+        if(pushConstantRange->size && draw->pushConstants)
+        {
+            vkCmdPushConstants(commandBuffer, pipeline->apiPipelineLayout, pushConstantRange->stageFlags,
+                    pushConstantRange->offset, pushConstantRange->size, draw->pushConstants);
+        }
+        vkCmdDrawIndexed(commandBuffer, draw->indexCount, 1, draw->firstIndex, draw->vertexOffset, 0);
+        stats->draws++;
+    }
 }
 
 // ======================================================================
@@ -1656,7 +4882,8 @@ struct FrameData
 struct FrameResources
 {
     Buffer ub_FrameData;
-    VkDescriptorSet apiFrameDescriptorSet = VK_NULL_HANDLE;
+    VkDescriptorSet apiFrameDescriptorSet = VK_NULL_HANDLE;     // With the checker texture, cached
+    DescriptorAllocator transientDescriptors;   // Reset when the frame starts, after its previous use has finished
 };
 
 
@@ -1664,107 +4891,361 @@ struct ShaderResourceData
 {
     // TODO(caio): Move these out of here when abstracting shader resources
     VkDescriptorSetLayout apiShaderDescriptorSetLayout = VK_NULL_HANDLE;
-    VkDescriptorPool apiShaderDescriptorPool = VK_NULL_HANDLE;
+    ShaderReflectionSet frameSet;
+    DescriptorSetCache descriptorSetCache;      // Constant sets only, per-frame ones come from each frame's transient allocator
 };
 
-void InitShaderResources(RenderContext* ctx, FrameResources* frameResources, u32 frameCount, ShaderResourceData* shaderResourceData, Texture checkerTexture)
+// Frame descriptor sets follow the reflected layout of set 0: uniform buffers get the frame data buffer,
+// and images the given texture.
+void GetFrameDescriptorSetDesc(ShaderResourceData* shaderResourceData, FrameResources* frame, Texture texture, DescriptorSetDesc* outDesc)
+{
+    ShaderReflectionSet* frameSet = &shaderResourceData->frameSet;
+    *outDesc = {};
+    outDesc->layout = shaderResourceData->apiShaderDescriptorSetLayout;
+    for(i32 b = 0; b < frameSet->bindingCount; b++)
+    {
+        VkDescriptorSetLayoutBinding* binding = &frameSet->bindings[b];
+        ASSERT(binding->descriptorCount == 1);
+        DescriptorResource* resource = &outDesc->resources[outDesc->resourceCount++];
+        resource->binding = binding->binding;
+        resource->type = binding->descriptorType;
+        switch(binding->descriptorType)
+        {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                {
+                    resource->apiBuffer = frame->ub_FrameData.apiObject;
+                    resource->range = frame->ub_FrameData.size;
+                } break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                {
+                    resource->apiImageView = texture.apiImageView;
+                } break;
+            default: ASSERT(0); break;     // No resources of other types to bind yet
+        }
+    }
+}
+
+void InitShaderResources(RenderContext* ctx, FrameResources* frameResources, u32 frameCount, ShaderResourceData* shaderResourceData,
+        ShaderReflectionSet* frameSet, Texture checkerTexture)
+{
+    shaderResourceData->apiShaderDescriptorSetLayout = GetDescriptorSetLayout(ctx, frameSet);
+    shaderResourceData->frameSet = *frameSet;
+
+    // Pools sized from the reflected layout
+    VkDescriptorPoolSize descriptorPoolSizes[SHADER_REFLECTION_MAX_BINDINGS];
+    u32 descriptorPoolSizeCount = GetDescriptorPoolSizes(frameSet, 1, descriptorPoolSizes);
+    InitDescriptorSetCache(&shaderResourceData->descriptorSetCache, descriptorPoolSizeCount, descriptorPoolSizes, &resourceArena);
+
+    for(i32 i = 0; i < frameCount; i++)
+    {
+        // Allocating uniform buffer
+        frameResources[i].ub_FrameData = CreateBuffer(ctx, BUFFER_TYPE_UNIFORM, sizeof(FrameData), 1, NULL);
+        InitDescriptorAllocator(&frameResources[i].transientDescriptors, DESCRIPTOR_ALLOCATOR_SETS_PER_POOL,
+                descriptorPoolSizeCount, descriptorPoolSizes);
+
+        // Checker texture frame set is the same every time this frame comes around, so it's written once and cached
+        DescriptorSetDesc frameSetDesc;
+        GetFrameDescriptorSetDesc(shaderResourceData, &frameResources[i], checkerTexture, &frameSetDesc);
+        frameResources[i].apiFrameDescriptorSet = GetCachedDescriptorSet(ctx, &shaderResourceData->descriptorSetCache, &frameSetDesc);
+    }
+}
+
+// Frame set with another texture, written into the frame's transient allocator. Valid for this frame only.
+VkDescriptorSet AllocateFrameDescriptorSet(RenderContext* ctx, FrameResources* frame, ShaderResourceData* shaderResourceData, Texture texture)
+{
+    DescriptorSetDesc frameSetDesc;
+    GetFrameDescriptorSetDesc(shaderResourceData, frame, texture, &frameSetDesc);
+    return AllocateWrittenDescriptorSet(ctx, &frame->transientDescriptors, &frameSetDesc);
+}
+
+// Descriptor set layout is owned by the render context's layout cache.
+void DestroyShaderResources(RenderContext* ctx, FrameResources* frameResources, u32 frameCount, ShaderResourceData* globalResourceData)
 {
-    // Defining descriptor set layouts
-    VkDescriptorSetLayoutBinding frameDataBinding = {};
-    frameDataBinding.binding = 0;
-    frameDataBinding.descriptorCount = 1;
-    frameDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    frameDataBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    for(i32 i = 0; i < frameCount; i++)
+    {
+        DestroyBuffer(ctx, frameResources[i].ub_FrameData);
+        DestroyDescriptorAllocator(ctx, &frameResources[i].transientDescriptors);
+    }
+    DestroyDescriptorSetCache(ctx, &globalResourceData->descriptorSetCache);
+}
+
+// Bindless texture table (requires VK_EXT_descriptor_indexing).
+// One descriptor set with a large, partially bound, update-after-bind array of sampled images,
+// plus a single immutable sampler. Shaders index the array with a per-draw texture ID, so
+// objects with different textures can be drawn without rebinding descriptor sets.
+#define BINDLESS_MAX_TEXTURES 4096
+#define BINDLESS_TEXTURES_BINDING 0
+#define BINDLESS_SAMPLER_BINDING 1
 
-    VkDescriptorSetLayoutBinding checkerTextureBinding = {};
-    checkerTextureBinding.binding = 1;
-    checkerTextureBinding.descriptorCount = 1;
-    checkerTextureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    checkerTextureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+struct BindlessTextureTable
+{
+    VkDescriptorSetLayout apiDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool apiDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet apiDescriptorSet = VK_NULL_HANDLE;
+    VkSampler apiSampler = VK_NULL_HANDLE;
+
+    u32 capacity = 0;
+    u32 usedCount = 0;                      // High-water mark of allocated indices
+    u32 freeCount = 0;
+    u32 freeIndices[BINDLESS_MAX_TEXTURES]; // Indices released by RemoveBindlessTexture
+};
 
-    VkDescriptorSetLayoutBinding bindings[] = {frameDataBinding, checkerTextureBinding};
+void InitBindlessTextureTable(RenderContext* ctx, BindlessTextureTable* table)
+{
+    ASSERT(ctx->supportsBindless);
+    VkPhysicalDeviceLimits* limits = &ctx->apiPhysicalDeviceProperties.limits;
+    u32 capacity = BINDLESS_MAX_TEXTURES;
+    capacity = MIN(capacity, limits->maxPerStageDescriptorSampledImages);
+
+    // Update-after-bind limits live in the descriptor indexing properties
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(ctx->apiPhysicalDevice, &properties2);
+    capacity = MIN(capacity, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    capacity = MIN(capacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+    ASSERT(capacity);
+
+    table->apiSampler = GetSampler(ctx, {});
+
+    VkDescriptorSetLayoutBinding texturesBinding = {};
+    texturesBinding.binding = BINDLESS_TEXTURES_BINDING;
+    texturesBinding.descriptorCount = capacity;
+    texturesBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    texturesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding samplerBinding = {};
+    samplerBinding.binding = BINDLESS_SAMPLER_BINDING;
+    samplerBinding.descriptorCount = 1;
+    samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    samplerBinding.pImmutableSamplers = &table->apiSampler;
+
+    VkDescriptorSetLayoutBinding bindings[] = {texturesBinding, samplerBinding};
+    VkDescriptorBindingFlagsEXT bindingFlags[] =
+    {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+        0,
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = ARR_LEN(bindingFlags);
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo = {};
     descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+    descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
     descriptorSetLayoutInfo.bindingCount = ARR_LEN(bindings);
     descriptorSetLayoutInfo.pBindings = bindings;
-    VkResult ret = vkCreateDescriptorSetLayout(ctx->apiDevice, &descriptorSetLayoutInfo, NULL, &shaderResourceData->apiShaderDescriptorSetLayout);
+    VkResult ret = vkCreateDescriptorSetLayout(ctx->apiDevice, &descriptorSetLayoutInfo, NULL, &table->apiDescriptorSetLayout);
     VK_ASSERT(ret);
 
-    // Allocating descriptor set
     VkDescriptorPoolSize descriptorPoolSizes[] =
     {
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, capacity},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
     };
     VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
     descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
     descriptorPoolInfo.poolSizeCount = ARR_LEN(descriptorPoolSizes);
     descriptorPoolInfo.pPoolSizes = descriptorPoolSizes;
-    descriptorPoolInfo.maxSets = 10;
-    ret = vkCreateDescriptorPool(ctx->apiDevice, &descriptorPoolInfo, NULL, &shaderResourceData->apiShaderDescriptorPool);
+    descriptorPoolInfo.maxSets = 1;
+    ret = vkCreateDescriptorPool(ctx->apiDevice, &descriptorPoolInfo, NULL, &table->apiDescriptorPool);
     VK_ASSERT(ret);
 
-    // Allocating resources and descriptor sets
-    for(i32 i = 0; i < frameCount; i++)
-    {
-        // Allocating uniform buffer
-        frameResources[i].ub_FrameData = CreateBuffer(ctx, BUFFER_TYPE_UNIFORM, sizeof(FrameData), 1, NULL);
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.descriptorPool = table->apiDescriptorPool;
+    descriptorSetAllocInfo.descriptorSetCount = 1;
+    descriptorSetAllocInfo.pSetLayouts = &table->apiDescriptorSetLayout;
+    ret = vkAllocateDescriptorSets(ctx->apiDevice, &descriptorSetAllocInfo, &table->apiDescriptorSet);
+    VK_ASSERT(ret);
 
-        // Then descriptor set to point to said buffer
-        VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
-        descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        descriptorSetAllocInfo.descriptorPool = shaderResourceData->apiShaderDescriptorPool;
-        descriptorSetAllocInfo.descriptorSetCount = 1;
-        descriptorSetAllocInfo.pSetLayouts = &shaderResourceData->apiShaderDescriptorSetLayout;
-        ret = vkAllocateDescriptorSets(ctx->apiDevice, &descriptorSetAllocInfo, &frameResources[i].apiFrameDescriptorSet);
-        VK_ASSERT(ret);
+    table->capacity = capacity;
+    table->usedCount = 0;
+    table->freeCount = 0;
+}
+
+void DestroyBindlessTextureTable(RenderContext* ctx, BindlessTextureTable* table)
+{
+    vkDestroyDescriptorPool(ctx->apiDevice, table->apiDescriptorPool, NULL);
+    vkDestroyDescriptorSetLayout(ctx->apiDevice, table->apiDescriptorSetLayout, NULL);
+    table->apiDescriptorPool = VK_NULL_HANDLE;
+    table->apiDescriptorSetLayout = VK_NULL_HANDLE;
+    table->apiDescriptorSet = VK_NULL_HANDLE;
+}
 
-        // Then bind descriptor set to buffer and texture resources
-        VkDescriptorBufferInfo descriptorBufferInfo = {};
-        descriptorBufferInfo.buffer = frameResources[i].ub_FrameData.apiObject;
-        descriptorBufferInfo.offset = 0;
-        descriptorBufferInfo.range = frameResources[i].ub_FrameData.size;
-        VkDescriptorImageInfo descriptorImageInfo = {};
-        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorImageInfo.imageView = checkerTexture.apiImageView;
-        descriptorImageInfo.sampler = checkerTexture.apiSampler;
-
-        VkWriteDescriptorSet descriptorSetWrites[2];
-        descriptorSetWrites[0] = {};
-        descriptorSetWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrites[0].dstBinding = 0;
-        descriptorSetWrites[0].dstSet = frameResources[i].apiFrameDescriptorSet;
-        descriptorSetWrites[0].descriptorCount = 1;
-        descriptorSetWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorSetWrites[0].pBufferInfo = &descriptorBufferInfo;
-
-        descriptorSetWrites[1] = {};
-        descriptorSetWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrites[1].dstBinding = 1;
-        descriptorSetWrites[1].dstSet = frameResources[i].apiFrameDescriptorSet;
-        descriptorSetWrites[1].descriptorCount = 1;
-        descriptorSetWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorSetWrites[1].pImageInfo = &descriptorImageInfo;
-
-        vkUpdateDescriptorSets(ctx->apiDevice, ARR_LEN(descriptorSetWrites), descriptorSetWrites, 0, NULL);
+// Returns the texture ID shaders use to index the table.
+// Safe to call while the table's descriptor set is bound in command buffers being recorded (update-after-bind).
+u32 AddBindlessTexture(RenderContext* ctx, BindlessTextureTable* table, Texture texture)
+{
+    u32 index;
+    if(table->freeCount) index = table->freeIndices[--table->freeCount];
+    else
+    {
+        ASSERT(table->usedCount < table->capacity);
+        index = table->usedCount++;
     }
+
+    VkDescriptorImageInfo descriptorImageInfo = {};
+    descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    descriptorImageInfo.imageView = texture.apiImageView;
+
+    VkWriteDescriptorSet descriptorSetWrite = {};
+    descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSetWrite.dstSet = table->apiDescriptorSet;
+    descriptorSetWrite.dstBinding = BINDLESS_TEXTURES_BINDING;
+    descriptorSetWrite.dstArrayElement = index;
+    descriptorSetWrite.descriptorCount = 1;
+    descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    descriptorSetWrite.pImageInfo = &descriptorImageInfo;
+    vkUpdateDescriptorSets(ctx->apiDevice, 1, &descriptorSetWrite, 0, NULL);
+
+    return index;
 }
 
-void DestroyShaderResources(RenderContext* ctx, FrameResources* frameResources, u32 frameCount, ShaderResourceData* globalResourceData)
+// Note: caller must make sure no in-flight frame still samples this index before reusing it.
+void RemoveBindlessTexture(BindlessTextureTable* table, u32 index)
 {
-    for(i32 i = 0; i < frameCount; i++)
+    ASSERT(index < table->usedCount);
+    table->freeIndices[table->freeCount++] = index;
+}
+
+// Checks that a reflected set with runtime arrays can use the bindless table's layout.
+bool IsBindlessTextureSetCompatible(ShaderReflectionSet* set)
+{
+    for(i32 i = 0; i < set->bindingCount; i++)
     {
-        DestroyBuffer(ctx, frameResources[i].ub_FrameData);
+        VkDescriptorSetLayoutBinding* binding = &set->bindings[i];
+        bool isTextures = binding->binding == BINDLESS_TEXTURES_BINDING
+            && binding->descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE && set->isRuntimeArray[i];
+        bool isSampler = binding->binding == BINDLESS_SAMPLER_BINDING
+            && binding->descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER && binding->descriptorCount == 1;
+        if(!isTextures && !isSampler) return false;
+        if(binding->stageFlags & ~VK_SHADER_STAGE_FRAGMENT_BIT) return false;
     }
-    vkDestroyDescriptorSetLayout(ctx->apiDevice, globalResourceData->apiShaderDescriptorSetLayout, NULL);
-    vkDestroyDescriptorPool(ctx->apiDevice, globalResourceData->apiShaderDescriptorPool, NULL);
+    return true;
 }
 
 // ======================================================================
 // Application main function
+void CaptureSinkReadbackProc(void* userData, const CaptureFrame* frame)
+{
+    WriteCaptureFrame((CaptureSink*)userData, frame);
+}
+
+// Scene pass of the frame graph: the sorted render queue, drawn in the present render pass
+struct ScenePass
+{
+    RenderPass* renderPass = NULL;
+    u32 framebufferIndex = 0;
+    VkClearValue clearValues[3] = {};   // Color, depth, multisampled color (see RenderPassFrameOutputs)
+    RenderQueue* queue = NULL;
+    RenderQueueStats* stats = NULL;
+    bool depthPrepass = false;
+};
+
+void ScenePassProc(RenderGraph* graph, VkCommandBuffer commandBuffer, void* userData)
+{
+    ScenePass* pass = (ScenePass*)userData;
+    RenderPass* renderPass = pass->renderPass;
+
+    // Begin render pass
+    VkRenderPassBeginInfo renderPassBeginInfo = {};
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.pNext = NULL;
+    renderPassBeginInfo.renderPass = renderPass->apiObject;
+    renderPassBeginInfo.framebuffer = renderPass->apiFramebuffers[pass->framebufferIndex];
+    renderPassBeginInfo.renderArea.offset.x = 0;
+    renderPassBeginInfo.renderArea.offset.y = 0;
+    renderPassBeginInfo.renderArea.extent = {renderPass->outputWidth, renderPass->outputHeight};
+    renderPassBeginInfo.clearValueCount = GetRenderPassAttachmentCount(renderPass);
+    renderPassBeginInfo.pClearValues = pass->clearValues;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Draw commands
+    VkViewport viewport = {};
+    // Note: viewport y and height are flipped, to match OpenGL bottom-left instead of
+    // Vulkan's default top-left coordinate system.
+    viewport.x = 0.f;
+    //viewport.y = (f32)renderPass->outputHeight;
+    viewport.y = 0.f;
+    viewport.width = (f32)renderPass->outputWidth;
+    //viewport.height = -(f32)renderPass->outputHeight;
+    viewport.height = (f32)renderPass->outputHeight;
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissorRect;
+    scissorRect.offset = {0,0};
+    scissorRect.extent = {renderPass->outputWidth, renderPass->outputHeight};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
+
+    if(pass->depthPrepass) RecordRenderQueue(pass->queue, commandBuffer, SCENE_PASS_DEPTH_PREPASS, pass->stats);
+    RecordRenderQueue(pass->queue, commandBuffer, SCENE_PASS_MAIN, pass->stats);
+
+    // End render pass
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+PresentSettings presentSettings;    // Windowed mode options, see main
+u32 msaaSampleCount = 1;            // Clamped to what the device supports
+bool depthPrepass = false;          // Lay down depth first, so color is shaded once per pixel
+u32 memoryWarningPercent = MEMORY_BUDGET_WARNING_PERCENT;
+const char* memorySnapshotPath = NULL;  // Memory snapshots are only written when set
+
+#if RENDERER_HEADLESS
+// Usage: app [--frames N] [--width W] [--height H] [--capture raw|png|y4m] [--capture-path PATH] [--mesh PATH] [--crowd N] [--msaa N] [--depth-prepass]
+//            [--memory-warning PERCENT] [--memory-snapshot PATH]
+// Renders N frames offscreen (default HEADLESS_DEFAULT_FRAME_COUNT) and prints throughput.
+// Captured frames go to numbered files (PATH is a printf format taking the frame index), or a y4m stream
+// (PATH is a file, or "-" for stdout, in which case logging goes to stderr).
+// --msaa N renders with N samples per pixel (default 1), resolved before readback.
+// --depth-prepass draws scene depth first, then shades with an EQUAL depth test.
+// --memory-warning warns when a heap goes over PERCENT of its budget (default MEMORY_BUDGET_WARNING_PERCENT),
+// --memory-snapshot writes memory statistics to PATH as JSON lines, every MEMORY_SNAPSHOT_INTERVAL frames and on exit.
+#define HEADLESS_DEFAULT_FRAME_COUNT 1000
+int main(int argc, char** argv)
+{
+    u32 frameLimit = HEADLESS_DEFAULT_FRAME_COUNT;
+    const char* captureSinkName = NULL;
+    const char* capturePath = NULL;
+    const char* meshPath = MESH_PATH DEFAULT_MESH_NAME;
+    u32 crowdCount = 0;
+    for(i32 i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if(hasValue && strcmp(argv[i], "--frames") == 0) frameLimit = (u32)atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--width") == 0) windowWidth = atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--height") == 0) windowHeight = atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--capture") == 0) captureSinkName = argv[++i];
+        else if(hasValue && strcmp(argv[i], "--capture-path") == 0) capturePath = argv[++i];
+        else if(hasValue && strcmp(argv[i], "--mesh") == 0) meshPath = argv[++i];
+        else if(hasValue && strcmp(argv[i], "--crowd") == 0) crowdCount = (u32)atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--msaa") == 0) msaaSampleCount = (u32)atoi(argv[++i]);
+        else if(strcmp(argv[i], "--depth-prepass") == 0) depthPrepass = true;
+        else if(hasValue && strcmp(argv[i], "--memory-warning") == 0) memoryWarningPercent = (u32)atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--memory-snapshot") == 0) memorySnapshotPath = argv[++i];
+        else
+        {
+            printf("Usage: %s [--frames N] [--width W] [--height H] [--capture raw|png|y4m] [--capture-path PATH] [--mesh PATH] [--crowd N] [--msaa N] [--depth-prepass]"
+                    " [--memory-warning PERCENT] [--memory-snapshot PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+    ASSERT(frameLimit > 0 && windowWidth > 0 && windowHeight > 0);
+#else
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nCmdShow)
 {
+    u32 frameLimit = 0;     // Runs until the window is closed
+    const char* captureSinkName = NULL;
+    const char* capturePath = NULL;
+    const char* meshPath = MESH_PATH DEFAULT_MESH_NAME;
+    u32 crowdCount = 0;
     // ======================================================================
     // Win32 window initialization
     const char* windowClassName = "VulkanHelloCubeWndClass";
@@ -1788,22 +5269,223 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
     ASSERT(windowHandle);
     
     ShowWindow(windowHandle, nCmdShow);
+#endif
 
     // ======================================================================
     // Render initialization
 
+    InitArena(&resourceArena, "resource", GB(4));
+    InitArena(&frameArena, "frame", MB(64));
+
+#if RENDERER_HEADLESS
+    RenderContext ctx = CreateRenderContext("Vulkan Hello Cube", "TypheusRendererVk");
+    printf("[HEADLESS]: Rendering %u frames at %dx%d on %s\n",
+            frameLimit, windowWidth, windowHeight, ctx.apiPhysicalDeviceProperties.deviceName);
+#else
     RenderContext ctx = CreateRenderContext("Vulkan Hello Cube", "TypheusRendererVk", windowHandle, hInstance);
-    SwapChain swapChain = CreateSwapChain(&ctx);
+#endif
+    InitMemoryUsage(&ctx);
+    LoadPipelineCache(&ctx, PIPELINE_CACHE_PATH);
+    SwapChain swapChain = CreateSwapChain(&ctx, &presentSettings);
+    u32 sceneSampleCount = GetSupportedSampleCount(&ctx, msaaSampleCount);
+    printf("[SWAP_CHAIN]: %u images, %ux MSAA, reversed Z, depth pre-pass %s\n", swapChain.imageCount, sceneSampleCount,
+            depthPrepass ? "on" : "off");
+    JobSystem* jobSystem = ARENA_PUSH_STRUCT(&resourceArena, JobSystem);
+    *jobSystem = {};
+    InitJobSystem(jobSystem, 0);
 
     // Resource creation
     FrameResources frameResources[RENDERER_MAX_FRAMES_IN_FLIGHT];
     ShaderResourceData globalResourceData = {};
-    Buffer defaultTriangleVertexBuffer = CreateBuffer(&ctx, BUFFER_TYPE_VERTEX,
-            sizeof(defaultTriangleVertices), sizeof(defaultTriangleVertices) / (5 * sizeof(f32)), (u8*)defaultTriangleVertices);
-    Buffer defaultTriangleIndexBuffer = CreateBuffer(&ctx, BUFFER_TYPE_INDEX,
-            sizeof(defaultTriangleIndices), sizeof(defaultTriangleIndices) / sizeof(u32), (u8*)defaultTriangleIndices);
-    Texture checkerTexture = CreateTextureFromFile(&ctx, TEXTURE_PATH"checkers.png");
-    InitShaderResources(&ctx, frameResources, RENDERER_MAX_FRAMES_IN_FLIGHT, &globalResourceData, checkerTexture);
+    u32 defaultSourceVertexSize = 0;
+    for(i32 i = 0; i < ARR_LEN(defaultSourceVertexFormats); i++) defaultSourceVertexSize += vertexFormatSizeInBytes[defaultSourceVertexFormats[i]];
+    u32 defaultTriangleVertexCount = sizeof(defaultTriangleVertices) / defaultSourceVertexSize;
+    u8* defaultTriangleQuantizedVertices = NULL;
+    QuantizeError defaultVertexErrors[ARR_LEN(defaultVertexFormats)];
+    u64 defaultTriangleQuantizedSize = QuantizeVertices((u8*)defaultTriangleVertices, defaultTriangleVertexCount, ARR_LEN(defaultVertexFormats),
+            defaultSourceVertexFormats, defaultVertexFormats, &resourceArena, &defaultTriangleQuantizedVertices, defaultVertexErrors);
+    printf("[VERTEX_QUANTIZE]: %u vertices, %llu -> %llu bytes\n", defaultTriangleVertexCount,
+            (unsigned long long)sizeof(defaultTriangleVertices), (unsigned long long)defaultTriangleQuantizedSize);
+    for(i32 i = 0; i < ARR_LEN(defaultVertexFormats); i++)
+    {
+        printf("[VERTEX_QUANTIZE]: Attribute %d %s -> %s: max error %.6f, rms %.6f, %u clamped\n", i,
+                vertexFormatNames[defaultSourceVertexFormats[i]], vertexFormatNames[defaultVertexFormats[i]],
+                defaultVertexErrors[i].maxError, defaultVertexErrors[i].rmsError, defaultVertexErrors[i].clampedCount);
+    }
+    const char* texturePaths[] =
+    {
+        TEXTURE_PATH"checkers.png",
+    };
+    Texture textures[ARR_LEN(texturePaths)];
+
+    // Assets come from the packed archive when it was built, otherwise from loose files.
+    // Archives missing any asset this run needs (e.g. built before it was added) are not used at all.
+    const char* trianglePSName = ctx.supportsBindless ? "bindless_triangle_ps.spv" : "first_triangle_ps.spv";
+    const char* archiveAssetNames[ARR_LEN(texturePaths) + 3] =
+    {
+        "first_triangle_vs.spv", trianglePSName, "depth_prepass_vs.spv",
+    };
+    for(i32 i = 0; i < ARR_LEN(texturePaths); i++) archiveAssetNames[3 + i] = texturePaths[i] + strlen(TEXTURE_PATH);
+    AssetArchive assetArchive = OpenAssetArchive(ASSET_ARCHIVE_PATH);
+    const char* missingAsset = assetArchive.data ? FindMissingAssetEntry(&assetArchive, ARR_LEN(archiveAssetNames), archiveAssetNames) : NULL;
+    if(missingAsset)
+    {
+        printf("[ASSET_ARCHIVE]: %s has no %s, using loose files\n", ASSET_ARCHIVE_PATH, missingAsset);
+        CloseAssetArchive(&assetArchive);
+    }
+    if(assetArchive.data)
+    {
+        for(i32 i = 0; i < ARR_LEN(texturePaths); i++)
+        {
+            const char* textureName = texturePaths[i] + strlen(TEXTURE_PATH);
+            textures[i] = CreateTextureFromArchive(&ctx, &assetArchive, textureName);
+        }
+    }
+    else
+    {
+        TextureLoadStats textureLoadStats = {};
+        CreateTexturesFromFiles(&ctx, jobSystem, ARR_LEN(texturePaths), texturePaths, textures, &textureLoadStats);
+        printf("[TEXTURE_LOAD]: %u textures (%u workers): io %.2fms, decode %.2fms, staging %.2fms, upload %.2fms, total %.2fms\n",
+                textureLoadStats.textureCount, jobSystem->workerCount,
+                textureLoadStats.ioMs, textureLoadStats.decodeMs, textureLoadStats.stagingMs, textureLoadStats.uploadMs, textureLoadStats.totalMs);
+    }
+    Texture checkerTexture = textures[0];
+
+    // Imported mesh, drawn instead of the cube when there is one. Normals show up as vertex colors.
+    MeshBlob meshBlob = {};
+    bool hasMesh = LoadMeshBlob(&assetArchive, meshPath, &resourceArena, &meshBlob);
+    VertexFormat meshVertexFormats[MESH_BLOB_MAX_ATTRIBUTES];
+    m4f meshFitTransform = Identity();
+    f32 meshFitScale = 1.f;
+    if(hasMesh)
+    {
+        const MeshBlobHeader* meshHeader = meshBlob.header;
+        for(u32 i = 0; i < meshHeader->attributeCount; i++) meshVertexFormats[i] = (VertexFormat)meshHeader->attributeFormats[i];
+
+        // Centered and scaled to the cube's size
+        v3f extents = meshHeader->boundsMax - meshHeader->boundsMin;
+        f32 maxExtent = MAX(extents.x, MAX(extents.y, extents.z));
+        meshFitScale = maxExtent > 0 ? 2.f / maxExtent : 1.f;
+        v3f center = (meshHeader->boundsMin + meshHeader->boundsMax) * 0.5f;
+        meshFitTransform = Transpose(TranslationMatrix(center * -1.f)) * ScaleMatrix({meshFitScale, meshFitScale, meshFitScale});
+        printf("[MESH]: %s: %u vertices, %u triangles, %u byte vertices, %u bit indices, %u chunks, %u LODs\n",
+                meshPath, meshHeader->vertexCount, meshHeader->lods[0].indexCount / 3, meshHeader->vertexStride,
+                meshHeader->indexSize * 8, meshHeader->chunkCount, meshHeader->lodCount);
+    }
+
+    // Scene geometry is suballocated from one arena in the scene's vertex layout, and drawn with a single bind.
+    // Indices are 16 bit (chunk local, see MeshBlobChunk) unless the mesh was built without splitting.
+    u64 sceneVertexStride = hasMesh ? meshBlob.header->vertexStride : defaultTriangleQuantizedSize / defaultTriangleVertexCount;
+    u64 sceneVertexCount = hasMesh ? meshBlob.header->vertexCount : defaultTriangleVertexCount;
+    u64 sceneIndexCount = hasMesh ? meshBlob.header->indexCount : ARR_LEN(defaultTriangleIndices);
+    IndexType sceneIndexType = hasMesh && meshBlob.header->indexSize == sizeof(u32) ? INDEX_TYPE_U32 : INDEX_TYPE_U16;
+    GeometryArena sceneGeometry = CreateGeometryArena(&ctx, sceneVertexStride, sceneIndexType,
+            MAX(GEOMETRY_ARENA_VERTEX_CAPACITY, sceneVertexCount), MAX(GEOMETRY_ARENA_INDEX_CAPACITY, sceneIndexCount), &resourceArena);
+    GeometryAllocation sceneAllocation = {};
+    bool sceneAllocated = hasMesh
+        ? AllocateGeometry(&ctx, &sceneGeometry, meshBlob.vertexData, sceneVertexCount,
+                meshBlob.indices, meshBlob.header->indexSize, sceneIndexCount, &sceneAllocation)
+        : AllocateGeometry(&ctx, &sceneGeometry, defaultTriangleQuantizedVertices, sceneVertexCount,
+                defaultTriangleIndices, sizeof(u32), sceneIndexCount, &sceneAllocation);
+    ASSERT(sceneAllocated);
+    printf("[GEOMETRY]: %llu/%llu vertices, %llu/%llu %u bit indices, %u allocations\n",
+            (unsigned long long)sceneGeometry.vertexAllocator.allocatedSize, (unsigned long long)sceneGeometry.vertexAllocator.size,
+            (unsigned long long)sceneGeometry.indexAllocator.allocatedSize, (unsigned long long)sceneGeometry.indexAllocator.size,
+            (u32)sceneGeometry.indexBuffer.stride * 8, sceneGeometry.vertexAllocator.allocationCount);
+
+    // Chunk ranges, moved to where the scene landed in the arena
+    u32 sceneChunkCount = hasMesh ? meshBlob.header->chunkCount : 1;
+    MeshBlobChunk* sceneChunks = ARENA_PUSH_ARRAY(&resourceArena, MeshBlobChunk, sceneChunkCount);
+    if(hasMesh)
+    {
+        memcpy(sceneChunks, meshBlob.chunks, sceneChunkCount * sizeof(MeshBlobChunk));
+    }
+    else
+    {
+        sceneChunks[0] = {};
+        sceneChunks[0].vertexCount = defaultTriangleVertexCount;
+        sceneChunks[0].lods[0] = { 0, ARR_LEN(defaultTriangleIndices), 0 };
+    }
+    for(u32 i = 0; i < sceneChunkCount; i++)
+    {
+        sceneChunks[i].vertexOffset += sceneAllocation.vertexOffset;
+        for(u32 j = 0; j < MESH_MAX_LODS; j++) sceneChunks[i].lods[j].firstIndex += sceneAllocation.firstIndex;
+    }
+    const MeshLod* sceneLods = hasMesh ? meshBlob.header->lods : sceneChunks[0].lods;
+    u32 sceneLodCount = hasMesh ? meshBlob.header->lodCount : 1;
+    u64 lodDrawCounts[MESH_MAX_LODS] = {};
+    u64 lodTrianglesDrawn = 0;
+    u64 lodFullDetailTriangles = 0;
+
+    // Bindless path: all textures go in one table, and draws select theirs through push constants.
+    BindlessTextureTable* bindlessTextures = NULL;
+    u32 textureIds[ARR_LEN(textures)];
+    if(ctx.supportsBindless)
+    {
+        bindlessTextures = ARENA_PUSH_STRUCT(&resourceArena, BindlessTextureTable);
+        *bindlessTextures = {};
+        InitBindlessTextureTable(&ctx, bindlessTextures);
+        for(i32 i = 0; i < ARR_LEN(textures); i++)
+        {
+            textureIds[i] = AddBindlessTexture(&ctx, bindlessTextures, textures[i]);
+        }
+    }
+
+    // Frame capture, through readback of the swap chain images
+    CaptureSink captureSink = {};
+    FrameReadback* readback = NULL;
+    if(captureSinkName)
+    {
+        CaptureSinkType captureSinkType;
+        bool validSink = ParseCaptureSinkType(captureSinkName, &captureSinkType);
+        ASSERT(validSink);
+        ASSERT(swapChain.supportsReadback);
+        if(!capturePath)
+        {
+            PlatformCreateDirectory(CAPTURE_PATH);
+            capturePath = captureSinkType == CAPTURE_SINK_Y4M ? "-"
+                : captureSinkType == CAPTURE_SINK_PNG ? CAPTURE_PATH"frame_%05u.png" : CAPTURE_PATH"frame_%05u.raw";
+        }
+        bool sinkReady = InitCaptureSink(&captureSink, captureSinkType, capturePath, CAPTURE_FRAME_RATE);
+        ASSERT(sinkReady);
+        readback = ARENA_PUSH_STRUCT(&resourceArena, FrameReadback);
+        InitFrameReadback(&ctx, readback, swapChain.extents.width, swapChain.extents.height, swapChain.format,
+                jobSystem, CaptureSinkReadbackProc, &captureSink);
+    }
+
+    // Frame graph: the scene pass renders to the swap chain image, which readback (when capturing) then copies out.
+    // Transitions in and out of the pass are the graph's barriers, so its outputs stay in attachment layouts.
+    RenderGraph* frameGraph = ARENA_PUSH_STRUCT(&resourceArena, RenderGraph);
+    InitRenderGraph(frameGraph);
+    SwapChainPassImages sceneImages = {};
+    sceneImages.color = ImportRenderGraphImage(frameGraph, "swap chain", swapChain.format, VK_IMAGE_ASPECT_COLOR_BIT,
+            RESOURCE_ACCESS_SWAP_CHAIN_ACQUIRE, RESOURCE_ACCESS_SWAP_CHAIN_OUTPUT);
+    sceneImages.depth = AddRenderGraphImage(frameGraph, "depth", VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, sceneSampleCount);
+    if(sceneSampleCount > 1)
+    {
+        sceneImages.multisampledColor = AddRenderGraphImage(frameGraph, "multisampled color", swapChain.format,
+                VK_IMAGE_ASPECT_COLOR_BIT, sceneSampleCount);
+    }
+    ScenePass scenePass = {};
+    scenePass.depthPrepass = depthPrepass;
+    u32 sceneGraphPass = AddRenderGraphPass(frameGraph, "scene", ScenePassProc, &scenePass);
+    AddRenderGraphUse(frameGraph, sceneGraphPass, sceneImages.color, RESOURCE_ACCESS_COLOR_OUTPUT);
+    AddRenderGraphUse(frameGraph, sceneGraphPass, sceneImages.depth, RESOURCE_ACCESS_DEPTH_OUTPUT);
+    if(sceneImages.multisampledColor != RENDER_GRAPH_NONE)
+    {
+        AddRenderGraphUse(frameGraph, sceneGraphPass, sceneImages.multisampledColor, RESOURCE_ACCESS_COLOR_OUTPUT);
+    }
+    FrameReadbackPass readbackPass = {};
+    if(readback)
+    {
+        readbackPass.ctx = &ctx;
+        readbackPass.readback = readback;
+        readbackPass.image = sceneImages.color;
+        u32 readbackGraphPass = AddRenderGraphPass(frameGraph, "readback", FrameReadbackPassProc, &readbackPass, true);
+        AddRenderGraphUse(frameGraph, readbackGraphPass, sceneImages.color, RESOURCE_ACCESS_TRANSFER_READ);
+    }
+    CompileRenderGraph(&ctx, frameGraph, swapChain.extents.width, swapChain.extents.height, NULL, 0);
+    PrintRenderGraphStats(frameGraph);
 
     // Render pipeline setup
     u32 presentRenderPassColorOutputCount = 1;
@@ -1812,43 +5494,132 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
         {
             RENDER_PASS_LOAD_OP_CLEAR,
             RENDER_PASS_STORE_OP_STORE,
-            IMAGE_LAYOUT_UNDEFINED,
-            IMAGE_LAYOUT_PRESENT_SRC,
+            IMAGE_LAYOUT_COLOR_OUTPUT_OPTIMAL,
+            IMAGE_LAYOUT_COLOR_OUTPUT_OPTIMAL,
             IMAGE_FORMAT_BGRA8_SRGB,
         }
     };
-    // Each swap chain image is tied to the first color output of each frame in the present pass.
-    // This can probably be improved for clarity.
-    RenderPassFrameOutputs presentRenderPassFrameOutputs[swapChain.imageCount];
-    for(i32 i = 0; i < swapChain.imageCount; i++)
+    RenderPass presentRenderPass;
     {
-        for(i32 j = 0; j < presentRenderPassColorOutputCount; j++)
-        {
-            presentRenderPassFrameOutputs[i].apiOutputImageViews[j] = swapChain.apiImageViews[i];
-        }
-        //presentRenderPassFrameOutputs->apiDepthImageView = swapChain.apiDepthImageView;
-        presentRenderPassFrameOutputs[i].apiOutputImageViews[presentRenderPassColorOutputCount] = swapChain.apiDepthImageView;
+        // Frame outputs are copied to the render pass
+        ScratchScope scratchScope(GetThreadScratchArena());
+        RenderPassFrameOutputs* presentRenderPassFrameOutputs = ARENA_PUSH_ARRAY(scratchScope.arena, RenderPassFrameOutputs, swapChain.imageCount);
+        GetSwapChainFrameOutputs(&swapChain, frameGraph, &sceneImages, presentRenderPassColorOutputCount, presentRenderPassFrameOutputs);
+        presentRenderPass = CreateRenderPass(&ctx, 
+                swapChain.imageCount, swapChain.extents.width, swapChain.extents.height, presentRenderPassColorOutputCount,
+                presentRenderPassColorOutputInfo, presentRenderPassFrameOutputs, sceneSampleCount, DEPTH_RANGE_REVERSED);
     }
-    RenderPass presentRenderPass = CreateRenderPass(&ctx, 
-            swapChain.imageCount, swapChain.extents.width, swapChain.extents.height, 1,
-            presentRenderPassColorOutputInfo, presentRenderPassFrameOutputs);
+    scenePass.renderPass = &presentRenderPass;
 
-    ShaderAsset shader_TriangleVS = CreateShaderAsset(SHADER_PATH"first_triangle_vs.spv", SHADER_TYPE_VERTEX);
-    ShaderAsset shader_TrianglePS = CreateShaderAsset(SHADER_PATH"first_triangle_ps.spv", SHADER_TYPE_PIXEL);
-    InputAssemblyState defaultPassInputAssemblyState = {};
-    defaultPassInputAssemblyState.primitive = PRIMITIVE_TRIANGLE_LIST;
+    ShaderAsset shader_TriangleVS;
+    ShaderAsset shader_TrianglePS;
+    ShaderAsset shader_DepthPrepassVS;
+    if(assetArchive.data)
+    {
+        shader_TriangleVS = CreateShaderAssetFromArchive(&assetArchive, "first_triangle_vs.spv", SHADER_TYPE_VERTEX);
+        shader_TrianglePS = CreateShaderAssetFromArchive(&assetArchive, trianglePSName, SHADER_TYPE_PIXEL);
+        shader_DepthPrepassVS = CreateShaderAssetFromArchive(&assetArchive, "depth_prepass_vs.spv", SHADER_TYPE_VERTEX);
+    }
+#if SHADER_RUNTIME_COMPILATION
+    else
+    {
+        // Shader sources are compiled in parallel, only when changed since last run.
+        PlatformCreateDirectory(SHADER_CACHE_PATH);
+        ShaderCompiler shaderCompiler;
+        InitShaderCompiler(&shaderCompiler, SHADER_CACHE_PATH, SHADER_SOURCE_PATH);
+
+        ShaderCompileDesc shaderDescs[3] = {};
+        shaderDescs[0].sourcePath = SHADER_SOURCE_PATH"first_triangle.vert";
+        shaderDescs[0].stage = shaderc_vertex_shader;
+        shaderDescs[1].sourcePath = bindlessTextures ? SHADER_SOURCE_PATH"bindless_triangle.frag" : SHADER_SOURCE_PATH"first_triangle.frag";
+        shaderDescs[1].stage = shaderc_fragment_shader;
+        shaderDescs[2].sourcePath = SHADER_SOURCE_PATH"depth_prepass.vert";
+        shaderDescs[2].stage = shaderc_vertex_shader;
+        ShaderBytecode shaderBytecodes[ARR_LEN(shaderDescs)];
+
+        u64 compileStart = GetTimerTicks();
+        bool compiled = CompileShaders(&shaderCompiler, jobSystem, ARR_LEN(shaderDescs), shaderDescs, &resourceArena, shaderBytecodes);
+        ASSERT(compiled);
+        printf("[SHADER_COMPILER]: %u shaders in %.2f ms (%d cached, %d compiled)\n",
+                (u32)ARR_LEN(shaderDescs), TimerTicksToMs(GetTimerTicks() - compileStart),
+                shaderCompiler.cacheHits, shaderCompiler.cacheMisses);
+        DestroyShaderCompiler(&shaderCompiler);
+
+        shader_TriangleVS = CreateShaderAssetFromBytecode(shaderBytecodes[0], SHADER_TYPE_VERTEX);
+        shader_TrianglePS = CreateShaderAssetFromBytecode(shaderBytecodes[1], SHADER_TYPE_PIXEL);
+        shader_DepthPrepassVS = CreateShaderAssetFromBytecode(shaderBytecodes[2], SHADER_TYPE_VERTEX);
+    }
+#else
+    else
+    {
+        char trianglePSPath[256];
+        snprintf(trianglePSPath, sizeof(trianglePSPath), SHADER_PATH"%s", trianglePSName);
+        shader_TriangleVS = CreateShaderAsset(SHADER_PATH"first_triangle_vs.spv", SHADER_TYPE_VERTEX);
+        shader_TrianglePS = CreateShaderAsset(trianglePSPath, SHADER_TYPE_PIXEL);
+        shader_DepthPrepassVS = CreateShaderAsset(SHADER_PATH"depth_prepass_vs.spv", SHADER_TYPE_VERTEX);
+    }
+#endif
 
-    VertexFormat defaultPassVertexAttributeFormats[] = { VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32_FLOAT };
-    VertexLayout defaultPassVertexLayout = CreateVertexLayout(0, ARR_LEN(defaultPassVertexAttributeFormats), defaultPassVertexAttributeFormats);
+    // Descriptor layouts and push constants come from shader reflection.
+    // Set 0 holds per-frame resources, set 1 (bindless path) is the bindless texture table.
+    ShaderReflection defaultPassReflection;
+    ShaderReflection psReflection;
+    bool reflected = ReflectShader(shader_TriangleVS.bytecode, shader_TriangleVS.bytecodeSize, &defaultPassReflection)
+        && ReflectShader(shader_TrianglePS.bytecode, shader_TrianglePS.bytecodeSize, &psReflection)
+        && MergeShaderReflection(&defaultPassReflection, &psReflection);
+    ASSERT(reflected);
+    ASSERT(defaultPassReflection.setCount == (bindlessTextures ? 2 : 1));
+    ASSERT(!bindlessTextures || IsBindlessTextureSetCompatible(&defaultPassReflection.sets[1]));
+    ASSERT(defaultPassReflection.pushConstantRange.size <= sizeof(PushConstants));
+    InitShaderResources(&ctx, frameResources, RENDERER_MAX_FRAMES_IN_FLIGHT, &globalResourceData,
+            &defaultPassReflection.sets[0], checkerTexture);
+
+    PipelineRegistry* pipelineRegistry = ARENA_PUSH_STRUCT(&resourceArena, PipelineRegistry);
+    InitPipelineRegistry(pipelineRegistry);
+
+    GraphicsPipelineDesc defaultPassPipelineDesc = {};
+    defaultPassPipelineDesc.renderPass = &presentRenderPass;
+    defaultPassPipelineDesc.inputAssemblyState.primitive = PRIMITIVE_TRIANGLE_LIST;
+    defaultPassPipelineDesc.vs = shader_TriangleVS;
+    defaultPassPipelineDesc.ps = shader_TrianglePS;
+
+    defaultPassPipelineDesc.vertexLayout = hasMesh
+        ? CreateVertexLayout(0, meshBlob.header->attributeCount, meshVertexFormats)
+        : CreateVertexLayout(0, ARR_LEN(defaultVertexFormats), defaultVertexFormats);
+
+    defaultPassPipelineDesc.rasterizerState.fillMode = FILL_MODE_SOLID;
+    defaultPassPipelineDesc.rasterizerState.cullMode = CULL_MODE_BACK;
+    //defaultPassPipelineDesc.rasterizerState.cullMode = CULL_MODE_NONE;
+    defaultPassPipelineDesc.rasterizerState.frontFace = FRONT_FACE_CCW;
+
+    PipelineLayoutDesc* defaultPassLayout = &defaultPassPipelineDesc.layout;
+    defaultPassLayout->descriptorSetLayouts[defaultPassLayout->descriptorSetLayoutCount++] = globalResourceData.apiShaderDescriptorSetLayout;
+    if(bindlessTextures)
+    {
+        defaultPassLayout->descriptorSetLayouts[defaultPassLayout->descriptorSetLayoutCount++] = bindlessTextures->apiDescriptorSetLayout;
+    }
+    defaultPassLayout->pushConstantRange = defaultPassReflection.pushConstantRange;
 
-    RasterizerState defaultPassRasterizerState = {};
-    defaultPassRasterizerState.fillMode = FILL_MODE_SOLID;
-    defaultPassRasterizerState.cullMode = CULL_MODE_BACK;
-    //defaultPassRasterizerState.cullMode = CULL_MODE_NONE;
-    defaultPassRasterizerState.frontFace = FRONT_FACE_CCW;
-    GraphicsPipeline defaultPassPipeline = CreateGraphicsPipeline(&ctx, &presentRenderPass,
-            defaultPassInputAssemblyState, shader_TriangleVS, shader_TrianglePS, 
-            defaultPassVertexLayout, globalResourceData.apiShaderDescriptorSetLayout, defaultPassRasterizerState);
+    // Depth pre-pass: same layout and vertex stream, reading only positions and writing only depth.
+    // Color then only passes for the nearest surface, so each pixel is shaded once.
+    GraphicsPipeline* depthPrepassPipeline = NULL;
+    if(depthPrepass)
+    {
+        GraphicsPipelineDesc depthPrepassPipelineDesc = defaultPassPipelineDesc;
+        depthPrepassPipelineDesc.vs = shader_DepthPrepassVS;
+        depthPrepassPipelineDesc.ps = {};
+        depthPrepassPipelineDesc.vertexLayout.attributeCount = 1;   // Position comes first, stride is unchanged
+        depthPrepassPipeline = GetGraphicsPipeline(&ctx, pipelineRegistry, &depthPrepassPipelineDesc);
+        defaultPassPipelineDesc.depthState = { DEPTH_TEST_EQUAL, false };
+    }
+    GraphicsPipeline* defaultPassPipeline = GetGraphicsPipeline(&ctx, pipelineRegistry, &defaultPassPipelineDesc);
+    printf("[PIPELINE_CACHE]: %s cache, %u pipelines created in %.2f ms\n",
+            ctx.pipelineCacheWarm ? "Warm" : "Cold", ctx.pipelineCreationCount, ctx.pipelineCreationMs);
+    RenderQueue* renderQueue = ARENA_PUSH_STRUCT(&resourceArena, RenderQueue);
+    *renderQueue = {};
+    RenderQueueStats renderQueueStats = {};
+    scenePass.queue = renderQueue;
+    scenePass.stats = &renderQueueStats;
 
 
     FrameData frameData;
@@ -1858,9 +5629,18 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
     
     u32 currentFrame = 0;
     u32 inFlightFrame = 0;
+    DeferredDestructionQueue deferredDestruction = {};  // Objects replaced on resize, until their frames complete
+    PresentTiming presentTiming = {};
+    MemoryBudgetMonitor memoryMonitor;
+    bool memoryMonitorReady = InitMemoryBudgetMonitor(&memoryMonitor, memoryWarningPercent, memorySnapshotPath);
+    ASSERT(memoryMonitorReady);
+    u64 renderLoopStart = GetTimerTicks();
     while(!closeApp)
     {
+#if !RENDERER_HEADLESS
         ProcessWindowMessages();
+#endif
+        ArenaReset(&frameArena);
 
         // Indexing correct resources based on in-flight frame
         VkSemaphore renderSemaphore = ctx.apiRenderSemaphores[inFlightFrame];
@@ -1869,18 +5649,36 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
         VkCommandBuffer commandBuffer = ctx.apiCommandBuffers[inFlightFrame];
 
         //  Wait for previous frame to finish
+        u64 fenceWaitStart = GetTimerTicks();
         vkWaitForFences(ctx.apiDevice, 1, &renderFence, VK_TRUE, UINT64_MAX);
+        u64 fenceWaitTicks = GetTimerTicks() - fenceWaitStart;
+        PollPresentTiming(&ctx, &presentTiming, &swapChain);
+        //  Sets allocated the last time this frame was recorded are no longer in use
+        ResetDescriptorAllocator(&ctx, &frameResources[inFlightFrame].transientDescriptors);
+        //  The readback recorded the last time this frame was in flight is complete
+        if(readback) DeliverFrameReadback(&ctx, readback, inFlightFrame);
+        //  So is every frame before it, and what they used
+        FlushDeferredDestruction(&ctx, &deferredDestruction, currentFrame);
+        UpdateMemoryBudget(&ctx, &memoryMonitor, currentFrame);
 
         //  Acquire the next swap chain image to render to
         uint32_t currentSwapChainImage;
-        VkResult ret = vkAcquireNextImageKHR(ctx.apiDevice, swapChain.apiObject, UINT64_MAX, presentSemaphore, VK_NULL_HANDLE, &currentSwapChainImage);
+        u64 acquireStart = GetTimerTicks();
+        VkResult ret = AcquireSwapChainImage(&ctx, &swapChain, presentSemaphore, &currentSwapChainImage);
+        RecordAcquireWait(&presentTiming, fenceWaitTicks, GetTimerTicks() - acquireStart);
+#if !RENDERER_HEADLESS
         if(ret == VK_ERROR_OUT_OF_DATE_KHR)
         {
             wasResized = false;
-            OnResize(&ctx, &swapChain, &presentRenderPass);
+            OnResize(&ctx, &swapChain, frameGraph, &sceneImages, &presentRenderPass, &deferredDestruction, currentFrame);
+            ResetPresentTiming(&presentTiming);
             continue;
         }
-        else if(ret != VK_SUCCESS) ASSERT(0);
+        // Suboptimal images can still be presented: render this frame, and recreate after presenting it
+        bool recreateSwapChain = ret == VK_SUBOPTIMAL_KHR;
+        if(recreateSwapChain) ret = VK_SUCCESS;
+#endif
+        if(ret != VK_SUCCESS) ASSERT(0);
 
         // Reset render fence when work is to be submitted
         vkResetFences(ctx.apiDevice, 1, &renderFence);
@@ -1893,10 +5691,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
         f32 fov = TO_RAD(45.f);
         f32 aspect = (f32)windowWidth / (f32)windowHeight;
         f32 nearPlane = 0.1f;
-        f32 farPlane = 100.f;
 
         frameData.view = Transpose(LookAtMatrix(cameraPosition, cameraTarget, {0,1,0}));
-        frameData.proj = Transpose(PerspectiveProjectionMatrix(fov, aspect, nearPlane, farPlane));
+        frameData.proj = Transpose(InfiniteReversedZPerspectiveMatrix(fov, aspect, nearPlane));
 
         void* frameDataBufferMapping;
         vmaMapMemory(ctx.apiMemoryAllocator, frameResources[inFlightFrame].ub_FrameData.apiAllocation, &frameDataBufferMapping);
@@ -1912,54 +5709,11 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
         ret = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
         VK_ASSERT(ret);
 
-        // Begin render pass
-        VkRenderPassBeginInfo renderPassBeginInfo = {};
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.pNext = NULL;
-        renderPassBeginInfo.renderPass = presentRenderPass.apiObject;
-        renderPassBeginInfo.framebuffer = presentRenderPass.apiFramebuffers[currentSwapChainImage];
-        renderPassBeginInfo.renderArea.offset.x = 0;
-        renderPassBeginInfo.renderArea.offset.y = 0;
-        //renderPassBeginInfo.renderArea.extent = swapChainSupportDetails.extent;
-        renderPassBeginInfo.renderArea.extent = {presentRenderPass.outputWidth, presentRenderPass.outputHeight};
-        VkClearValue clearValues[2] = {0};
-        float flash = fabsf(sinf(currentFrame / 2000.f)) * 0.05f;
-        clearValues[0].color = {{flash, flash, flash, 1.0f}};
-        clearValues[1].depthStencil = {1.f, 0};
-        renderPassBeginInfo.clearValueCount = ARR_LEN(clearValues);
-        renderPassBeginInfo.pClearValues = clearValues;
-        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // Draw commands
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultPassPipeline.apiObject);
-
-        VkViewport viewport = {};
-        // Note: viewport y and height are flipped, to match OpenGL bottom-left instead of
-        // Vulkan's default top-left coordinate system.
-        viewport.x = 0.f;
-        //viewport.y = (f32)presentRenderPass.outputHeight;
-        viewport.y = 0.f;
-        viewport.width = (f32)presentRenderPass.outputWidth;
-        //viewport.height = -(f32)presentRenderPass.outputHeight;
-        viewport.height = (f32)presentRenderPass.outputHeight;
-        viewport.minDepth = 0.f;
-        viewport.maxDepth = 1.f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-        VkRect2D scissorRect;
-        scissorRect.offset = {0,0};
-        scissorRect.extent = {presentRenderPass.outputWidth, presentRenderPass.outputHeight};
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
-
-        VkDeviceSize bufferOffset = 0;
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &defaultTriangleVertexBuffer.apiObject, &bufferOffset);
-        vkCmdBindIndexBuffer(commandBuffer, defaultTriangleIndexBuffer.apiObject, 0, VK_INDEX_TYPE_UINT32);
-
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultPassPipeline.apiPipelineLayout, 0, 1,
-                &frameResources[inFlightFrame].apiFrameDescriptorSet, 0, NULL);
-
-        // Push constants
-        PushConstants objData = {};
-        objData.model = Identity();
+        // Per-object data for this frame
+        const u32 objectCount = 2 + crowdCount;
+        PushConstants* objData = ARENA_PUSH_ARRAY(&frameArena, PushConstants, objectCount);
+        v3f* objPositions = ARENA_PUSH_ARRAY(&frameArena, v3f, objectCount);
+        u32* objTextures = ARENA_PUSH_ARRAY(&frameArena, u32, objectCount);     // Index into textures
         f32 angle = (currentFrame / 2000.f);
         static v3f axis1 = Normalize(v3f{
                 RandomRange(-1.f, 1.f),
@@ -1969,18 +5723,93 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
                 RandomRange(-1.f, 1.f),
                 RandomRange(-1.f, 1.f),
                 RandomRange(-1.f, 1.f)});
-        objData.model = ScaleMatrix({0.5f, 0.5f, 0.5f}) * RotationMatrix(angle, axis1) * objData.model;
-        vkCmdPushConstants(commandBuffer, defaultPassPipeline.apiPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &objData);
+        objPositions[0] = {0, 0, 0};
+        objData[0].model = meshFitTransform * ScaleMatrix({0.5f, 0.5f, 0.5f}) * RotationMatrix(angle, axis1) * Identity();
+        objTextures[0] = 0;
+        objPositions[1] = {1, 0, -3};
+        objData[1].model = meshFitTransform * ScaleMatrix({0.5f, 0.5f, 0.5f}) * RotationMatrix(angle, axis2) * Transpose(TranslationMatrix(objPositions[1])) * Identity();
+        objTextures[1] = ARR_LEN(textures) - 1;
+        for(u32 i = 0; i < crowdCount; i++)
+        {
+            u32 column = i % SCENE_CROWD_COLUMNS;
+            u32 row = i / SCENE_CROWD_COLUMNS;
+            v3f* position = &objPositions[2 + i];
+            *position = { (column - (SCENE_CROWD_COLUMNS - 1) * 0.5f) * 1.5f, -1.5f, -6.f - row * 3.f };
+            objData[2 + i].model = meshFitTransform * ScaleMatrix({0.5f, 0.5f, 0.5f}) * RotationMatrix(angle + i, axis1) * Transpose(TranslationMatrix(*position)) * Identity();
+            objTextures[2 + i] = i % ARR_LEN(textures);
+        }
+        for(u32 i = 0; i < objectCount; i++)
+        {
+            objData[i].textureId = bindlessTextures ? textureIds[objTextures[i]] : 0;
+        }
+
+        // Draws go through the render queue, which sorts them by state and skips redundant binds.
+        // With bindless textures all objects share the same sets, draws only change the texture ID.
+        // Otherwise each texture drawn gets its own frame set, written this frame into the frame's transient allocator.
+        BeginRenderQueue(renderQueue, &frameArena, objectCount * sceneChunkCount * (depthPrepass ? 2 : 1));
+        u32 passPipeline = GetRenderPipelineIndex(renderQueue, defaultPassPipeline);
+        u32 prepassPipeline = depthPrepass ? GetRenderPipelineIndex(renderQueue, depthPrepassPipeline) : 0;
+        u32 textureBindings[ARR_LEN(textures)];
+        for(u32 i = 0; i < ARR_LEN(textures); i++) textureBindings[i] = MAX_U32;
+        if(bindlessTextures)
+        {
+            VkDescriptorSet passDescriptorSets[] =
+            {
+                frameResources[inFlightFrame].apiFrameDescriptorSet,
+                bindlessTextures->apiDescriptorSet,
+            };
+            u32 passBindings = GetRenderBindingsIndex(renderQueue, passDescriptorSets, ARR_LEN(passDescriptorSets));
+            for(u32 i = 0; i < ARR_LEN(textures); i++) textureBindings[i] = passBindings;
+        }
+        u32 passGeometry = GetRenderGeometryIndex(renderQueue, &sceneGeometry);
 
-        //vkCmdDraw(commandBuffer, defaultTriangleVertexBuffer.count, 1, 0, 0);
-        vkCmdDrawIndexed(commandBuffer, defaultTriangleIndexBuffer.count, 1, 0, 0, 0);
+        // LOD from the projected size of each level's error
+        f32 lodProjectionScale = presentRenderPass.outputHeight / (2.f * tanf(fov / 2.f));
+        for(i32 i = 0; i < objectCount; i++)
+        {
+            f32 distance = Len(objPositions[i] - cameraPosition);
+            u32 lodIndex = SelectMeshLod(sceneLods, sceneLodCount, distance, meshFitScale * 0.5f, lodProjectionScale, LOD_MAX_PIXEL_ERROR);
+            lodDrawCounts[lodIndex]++;
+            lodTrianglesDrawn += sceneLods[lodIndex].indexCount / 3;
+            lodFullDetailTriangles += sceneLods[0].indexCount / 3;
+
+            u32* passBindings = &textureBindings[objTextures[i]];
+            if(*passBindings == MAX_U32)
+            {
+                VkDescriptorSet textureSet = AllocateFrameDescriptorSet(&ctx, &frameResources[inFlightFrame], &globalResourceData, textures[objTextures[i]]);
+                *passBindings = GetRenderBindingsIndex(renderQueue, &textureSet, 1);
+            }
 
-        objData.model = ScaleMatrix({0.5f, 0.5f, 0.5f}) * RotationMatrix(angle, axis2) * Transpose(TranslationMatrix({1,0,-3})) * Identity();
-        vkCmdPushConstants(commandBuffer, defaultPassPipeline.apiPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &objData);
-        vkCmdDrawIndexed(commandBuffer, defaultTriangleIndexBuffer.count, 1, 0, 0, 0);
+            // Chunks keep indices 16 bit, each one is offset to its own vertices
+            for(u32 j = 0; j < sceneChunkCount; j++)
+            {
+                const MeshLod* lod = &sceneChunks[j].lods[lodIndex];
+                RenderDraw draw = { lod->indexCount, lod->firstIndex, (i32)sceneChunks[j].vertexOffset, &objData[i] };
+                f32 sortDepth = distance / SCENE_SORT_DISTANCE;
+                PushRenderDraw(renderQueue, SCENE_PASS_MAIN, passPipeline, *passBindings, passGeometry, sortDepth, draw);
+                if(depthPrepass) PushRenderDraw(renderQueue, SCENE_PASS_DEPTH_PREPASS, prepassPipeline, *passBindings, passGeometry, sortDepth, draw);
+            }
+        }
+        SortRenderQueue(renderQueue);
 
-        // End render pass
-        vkCmdEndRenderPass(commandBuffer);
+        // Frame graph records the passes, with the barriers compiled between them
+        scenePass.framebufferIndex = currentSwapChainImage;
+        float flash = fabsf(sinf(currentFrame / 2000.f)) * 0.05f;
+        scenePass.clearValues[0].color = {{flash, flash, flash, 1.0f}};
+        scenePass.clearValues[1].depthStencil = GetRenderPassDepthClearValue(&presentRenderPass);
+        scenePass.clearValues[2].color = scenePass.clearValues[0].color;
+        if(readback)
+        {
+            if(readback->width != swapChain.extents.width || readback->height != swapChain.extents.height)
+            {
+                ResizeFrameReadback(&ctx, readback, swapChain.extents.width, swapChain.extents.height, swapChain.format);
+            }
+            readbackPass.inFlightFrame = inFlightFrame;
+            readbackPass.frameIndex = currentFrame;
+        }
+        SetRenderGraphImage(frameGraph, sceneImages.color,
+                swapChain.apiImages[currentSwapChainImage], swapChain.apiImageViews[currentSwapChainImage]);
+        ExecuteRenderGraph(frameGraph, commandBuffer);
 
         // Finalize command buffer for submission
         ret = vkEndCommandBuffer(commandBuffer);
@@ -1993,54 +5822,128 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrev, PWSTR pCmdLine, int nC
         submitInfo.pCommandBuffers = &commandBuffer;
         VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         submitInfo.pWaitDstStageMask = &waitStage;
+#if !RENDERER_HEADLESS
         //      Wait for present semaphore, to ensure swap chain image is ready
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = &presentSemaphore;
         //      Signal render semaphore, to indicate render commands have all been executed
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = &renderSemaphore;
+#endif
+        //      Headless images are never acquired or presented, the render fence alone guards their reuse
         
+        u64 presentId = BeginPresentTiming(&ctx, &presentTiming, GetTimerTicks());
         ret = vkQueueSubmit(ctx.apiCommandQueue, 1, &submitInfo, renderFence);
         VK_ASSERT(ret);
 
         // Present image to window
-        VkPresentInfoKHR presentInfo = {};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-        presentInfo.pNext = NULL;
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = &swapChain.apiObject;
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &renderSemaphore;
-        presentInfo.pImageIndices = &currentSwapChainImage;
-        ret = vkQueuePresentKHR(ctx.apiCommandQueue, &presentInfo);
-        if(ret == VK_ERROR_OUT_OF_DATE_KHR || ret == VK_SUBOPTIMAL_KHR || wasResized)
+        ret = PresentSwapChainImage(&ctx, &swapChain, renderSemaphore, currentSwapChainImage, presentId);
+#if !RENDERER_HEADLESS
+        if(ret == VK_ERROR_OUT_OF_DATE_KHR || ret == VK_SUBOPTIMAL_KHR || wasResized || recreateSwapChain)
         {
           wasResized = false;
-          OnResize(&ctx, &swapChain, &presentRenderPass);
+          OnResize(&ctx, &swapChain, frameGraph, &sceneImages, &presentRenderPass, &deferredDestruction, currentFrame);
+          ResetPresentTiming(&presentTiming);
         }
-        else if(ret != VK_SUCCESS) ASSERT(0);
+        else
+#endif
+        if(ret != VK_SUCCESS) ASSERT(0);
 
         currentFrame++;
         inFlightFrame = currentFrame % RENDERER_MAX_FRAMES_IN_FLIGHT;
+        if(frameLimit && currentFrame >= frameLimit) closeApp = true;
     }
 
     // ======================================================================
     // Render cleanup
 
     vkDeviceWaitIdle(ctx.apiDevice);
+    FlushDeferredDestruction(&ctx, &deferredDestruction, MAX_U64);
+    f64 renderLoopMs = TimerTicksToMs(GetTimerTicks() - renderLoopStart);
+    printf("[FRAME_STATS]: %u frames in %.2f ms (%.2f ms/frame, %.1f fps)\n",
+            currentFrame, renderLoopMs, renderLoopMs / MAX(currentFrame, 1), currentFrame * 1000.0 / MAX(renderLoopMs, 1e-3));
+    PrintPresentTiming(&presentTiming, &swapChain);
+    if(memoryMonitor.snapshotFile) WriteMemorySnapshot(&ctx, &memoryMonitor, currentFrame);
+    PrintMemoryUsage(&ctx, &memoryMonitor);
+    DestroyMemoryBudgetMonitor(&memoryMonitor);
+    f64 statFrames = MAX(currentFrame, 1);
+    printf("[RENDER_QUEUE]: %.1f draws/frame, binds/frame (eliminated): pipeline %.1f (%.1f), descriptor sets %.1f (%.1f), geometry %.1f (%.1f)\n",
+            renderQueueStats.draws / statFrames,
+            renderQueueStats.pipelineBinds / statFrames, (renderQueueStats.draws - renderQueueStats.pipelineBinds) / statFrames,
+            renderQueueStats.descriptorSetBinds / statFrames, (renderQueueStats.draws - renderQueueStats.descriptorSetBinds) / statFrames,
+            renderQueueStats.geometryBinds / statFrames, (renderQueueStats.draws - renderQueueStats.geometryBinds) / statFrames);
+    printf("[LOD]: %.0f triangles/frame (%.0f at full detail), draws per LOD:",
+            (f64)lodTrianglesDrawn / MAX(currentFrame, 1), (f64)lodFullDetailTriangles / MAX(currentFrame, 1));
+    for(u32 i = 0; i < sceneLodCount; i++) printf(" %llu", (unsigned long long)lodDrawCounts[i]);
+    printf("\n");
+    if(readback)
+    {
+        FlushFrameReadback(&ctx, readback);
+        printf("[READBACK]: %u frames delivered, %.2f ms in sink on workers (%.2f ms/frame)\n",
+                readback->deliveredCount, readback->callbackMs, readback->callbackMs / MAX(readback->deliveredCount, 1));
+        printf("[FRAME_CAPTURE]: %u frames, %.2f MB written, %u failed\n",
+                captureSink.frameCount, (f64)captureSink.bytesWritten / (1024.0 * 1024.0), captureSink.failures);
+        DestroyFrameReadback(&ctx, readback);
+        DestroyCaptureSink(&captureSink);
+    }
+    SavePipelineCache(&ctx, PIPELINE_CACHE_PATH);
+    printf("[DESCRIPTORS]: %u cached sets (%u pools), transient peak %u sets (%u pools)\n",
+            globalResourceData.descriptorSetCache.count, globalResourceData.descriptorSetCache.allocator.poolCount,
+            frameResources[0].transientDescriptors.peakSets, frameResources[0].transientDescriptors.poolCount);
     DestroyShaderResources(&ctx, frameResources, RENDERER_MAX_FRAMES_IN_FLIGHT, &globalResourceData);
-    DestroyBuffer(&ctx, defaultTriangleVertexBuffer);
-    DestroyBuffer(&ctx, defaultTriangleIndexBuffer);
-    DestroyTexture(&ctx, checkerTexture);
-    DestroyGraphicsPipeline(&ctx, &defaultPassPipeline);
+    if(bindlessTextures)
+    {
+        DestroyBindlessTextureTable(&ctx, bindlessTextures);
+    }
+    FreeGeometry(&sceneGeometry, &sceneAllocation);
+    DestroyGeometryArena(&ctx, &sceneGeometry);
+    for(i32 i = 0; i < ARR_LEN(textures); i++)
+    {
+        DestroyTexture(&ctx, textures[i]);
+    }
+    printf("[PIPELINE_REGISTRY]: %u requests, %u pipelines, %u pipeline layouts\n",
+            pipelineRegistry->lookupCount, pipelineRegistry->pipelineCount, pipelineRegistry->layoutCount);
+    DestroyPipelineRegistry(&ctx, pipelineRegistry);
+    DestroyRenderGraph(&ctx, frameGraph);
     DestroyRenderPass(&ctx, &presentRenderPass);
     DestroySwapChain(&ctx, &swapChain);
     DestroyRenderContext(&ctx);
+    CloseAssetArchive(&assetArchive);
+    DestroyJobSystem(jobSystem);
+    PrintArenaStats(&resourceArena);
+    PrintArenaStats(&frameArena);
+    PrintArenaStats(GetThreadScratchArena());
+    DestroyArena(&frameArena);
+    DestroyArena(&resourceArena);
+#if !RENDERER_HEADLESS
     DestroyWindow(windowHandle);
+#endif
     return 0;
 }
 
-int main()
+#if !RENDERER_HEADLESS
+// Usage: app [--present vsync|mailbox|immediate|fifo-relaxed] [--images N] [--msaa N] [--depth-prepass]
+//            [--memory-warning PERCENT] [--memory-snapshot PATH]
+// Present policy (default mailbox), swap chain image count (default surface minimum + 1), samples per pixel (default 1),
+// depth pre-pass (default off), and memory budget warning and snapshots (see the headless main).
+int main(int argc, char** argv)
 {
+    for(i32 i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if(hasValue && strcmp(argv[i], "--present") == 0 && ParsePresentPolicy(argv[i + 1], &presentSettings.policy)) i++;
+        else if(hasValue && strcmp(argv[i], "--images") == 0) presentSettings.imageCount = (u32)atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--msaa") == 0) msaaSampleCount = (u32)atoi(argv[++i]);
+        else if(strcmp(argv[i], "--depth-prepass") == 0) depthPrepass = true;
+        else if(hasValue && strcmp(argv[i], "--memory-warning") == 0) memoryWarningPercent = (u32)atoi(argv[++i]);
+        else if(hasValue && strcmp(argv[i], "--memory-snapshot") == 0) memorySnapshotPath = argv[++i];
+        else
+        {
+            printf("Usage: %s [--present vsync|mailbox|immediate|fifo-relaxed] [--images N] [--msaa N] [--depth-prepass]"
+                    " [--memory-warning PERCENT] [--memory-snapshot PATH]\n", argv[0]);
+            return 1;
+        }
+    }
     return wWinMain(GetModuleHandle(NULL), NULL, GetCommandLineW(), SW_SHOWNORMAL);
 }
+#endif
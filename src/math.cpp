@@ -1,5 +1,10 @@
 #include <math.hpp>
 #include <string.h>
+#if _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 bool operator==(const v2f& a, const v2f& b)
 {
@@ -574,6 +579,24 @@ m4f PerspectiveProjectionMatrix(const f32& fovY, const f32& aspectRatio, const f
                                 // transposing when sending to shaders
 }
 
+// Reversed Z with the far plane at infinity, for a [0, 1] depth range: depth is nearPlane / view distance,
+// 1 at the near plane and towards 0 far away. Floats are densest near 0, which offsets the 1/z falloff,
+// so depth precision stays about even with distance. Needs depth cleared to 0 and a GREATER depth test.
+m4f InfiniteReversedZPerspectiveMatrix(const f32& fovY, const f32& aspectRatio, const f32& nearPlane)
+{
+    f32 focalLength = 1.f / tanf(fovY / 2.f);
+    m4f result =
+    {
+        focalLength / aspectRatio, 0, 0, 0,
+        0, focalLength, 0, 0,
+        0, 0, 0, -1,
+        0, 0, nearPlane, 0,
+    };
+    result.m11 *= -1;           // Same coordinate system conversion as PerspectiveProjectionMatrix
+    
+    return Transpose(result);
+}
+
 m4f OrthographicProjectionMatrix(const f32& left, const f32& right, const f32& bottom, const f32& top, const f32& nearPlane, const f32& farPlane)
 {
     m4f result =
@@ -4,6 +4,7 @@
 #include <float.h>
 
 typedef uint8_t     u8;
+typedef uint16_t    u16;
 typedef int         i32;
 typedef uint32_t    u32;
 typedef uint64_t    u64;
@@ -14,6 +15,7 @@ typedef double      f64;
 #define MAX_U16 (0xFFFF)
 #define MAX_U32 (0xFFFFFFFFUL)
 #define MAX_U64 (0xFFFFFFFFFFFFFFFFULL)
+#define MAX_I32 (0x7FFFFFFF)
 
 #define EPSILON_F32 FLT_EPSILON
 #define EPSILON_F64 DBL_EPSILON
@@ -172,6 +174,7 @@ v3f TransformDirection(const v3f& direction, const m4f& transform);
 
 m4f LookAtMatrix(const v3f& center, const v3f& target, const v3f& up);
 m4f PerspectiveProjectionMatrix(const f32& fovY, const f32& aspectRatio, const f32& nearPlane, const f32& farPlane);
+m4f InfiniteReversedZPerspectiveMatrix(const f32& fovY, const f32& aspectRatio, const f32& nearPlane);
 m4f OrthographicProjectionMatrix(const f32& left, const f32& right, const f32& bottom, const f32& top, const f32& nearPlane, const f32& farPlane);
 
 m4f VkViewMatrix(v3f center, v3f target, v3f up);
@@ -0,0 +1,100 @@
+#include <memory.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static u64 AlignUp(u64 value, u64 align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+void InitArena(Arena* arena, const char* name, u64 reserveSize)
+{
+    reserveSize = AlignUp(reserveSize, ARENA_COMMIT_CHUNK_SIZE);
+    u8* base = (u8*)PlatformReserveMemory(reserveSize);
+    if(!base)
+    {
+        printf("[MEMORY]: Failed to reserve %llu bytes for arena %s\n", (unsigned long long)reserveSize, name);
+        exit(-1);
+    }
+    *arena = {};
+    arena->name = name;
+    arena->base = base;
+    arena->reserved = reserveSize;
+}
+
+void DestroyArena(Arena* arena)
+{
+    if(arena->base) PlatformReleaseMemory(arena->base, arena->reserved);
+    *arena = {};
+}
+
+void* ArenaPush(Arena* arena, u64 size, u64 align)
+{
+    u64 start = AlignUp((u64)arena->base + arena->offset, align) - (u64)arena->base;
+    u64 end = start + size;
+    if(end > arena->reserved)
+    {
+        printf("[MEMORY]: Arena %s out of memory (%llu/%llu bytes)\n", arena->name, (unsigned long long)end, (unsigned long long)arena->reserved);
+        exit(-1);
+    }
+    if(end > arena->committed)
+    {
+        u64 newCommitted = MIN(AlignUp(end, ARENA_COMMIT_CHUNK_SIZE), arena->reserved);
+        if(!PlatformCommitMemory(arena->base + arena->committed, newCommitted - arena->committed))
+        {
+            printf("[MEMORY]: Arena %s failed to commit %llu bytes\n", arena->name, (unsigned long long)newCommitted);
+            exit(-1);
+        }
+        arena->committed = newCommitted;
+    }
+    arena->offset = end;
+    arena->peak = MAX(arena->peak, end);
+    return arena->base + start;
+}
+
+void* ArenaRealloc(Arena* arena, void* ptr, u64 oldSize, u64 newSize)
+{
+    if(!ptr) return ArenaPush(arena, newSize);
+    if((u8*)ptr + oldSize == arena->base + arena->offset)
+    {
+        // Last allocation, grow or shrink in place
+        u64 start = (u8*)ptr - arena->base;
+        arena->offset = start;
+        ArenaPush(arena, newSize, 1);
+        return ptr;
+    }
+    void* result = ArenaPush(arena, newSize);
+    memcpy(result, ptr, MIN(oldSize, newSize));
+    return result;
+}
+
+void ArenaReset(Arena* arena)
+{
+    arena->offset = 0;
+}
+
+void PrintArenaStats(Arena* arena)
+{
+    printf("[MEMORY]: Arena %-10s peak %8.2f KB, committed %8.2f KB, reserved %8.2f MB\n",
+            arena->name,
+            (f64)arena->peak / 1024.0,
+            (f64)arena->committed / 1024.0,
+            (f64)arena->reserved / (1024.0 * 1024.0));
+}
+
+struct ThreadScratchArena
+{
+    Arena arena;
+    ~ThreadScratchArena() { DestroyArena(&arena); }
+};
+
+Arena* GetThreadScratchArena()
+{
+    static thread_local ThreadScratchArena threadScratch;
+    if(!threadScratch.arena.base)
+    {
+        InitArena(&threadScratch.arena, "scratch", THREAD_SCRATCH_ARENA_RESERVE);
+    }
+    return &threadScratch.arena;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <platform.hpp>
+#include <math.hpp>
+
+// ========================================================
+// [MEMORY]
+// Linear (bump) arena allocators over reserved virtual memory.
+// Address space is reserved up front and committed in chunks as the arena grows,
+// so arenas can be sized generously without using physical memory.
+#define ARENA_COMMIT_CHUNK_SIZE     (64 * 1024)
+#define ARENA_DEFAULT_ALIGN         16
+
+#define KB(N) ((u64)(N) * 1024)
+#define MB(N) (KB(N) * 1024)
+#define GB(N) (MB(N) * 1024)
+
+struct Arena
+{
+    const char* name = NULL;
+    u8* base = NULL;
+    u64 reserved = 0;
+    u64 committed = 0;
+    u64 offset = 0;
+    u64 peak = 0;           // Highest offset reached since init
+};
+
+void InitArena(Arena* arena, const char* name, u64 reserveSize);
+void DestroyArena(Arena* arena);
+void* ArenaPush(Arena* arena, u64 size, u64 align = ARENA_DEFAULT_ALIGN);
+void* ArenaRealloc(Arena* arena, void* ptr, u64 oldSize, u64 newSize);     // Grows in place when ptr is the last allocation
+void ArenaReset(Arena* arena);
+void PrintArenaStats(Arena* arena);
+
+#define ARENA_PUSH_ARRAY(ARENA, TYPE, COUNT) ((TYPE*)ArenaPush((ARENA), sizeof(TYPE) * (COUNT), alignof(TYPE)))
+#define ARENA_PUSH_STRUCT(ARENA, TYPE) ARENA_PUSH_ARRAY(ARENA, TYPE, 1)
+
+// Saves arena offset on creation and rolls back to it when going out of scope.
+// Everything pushed to the arena inside the scope is freed at once.
+struct ScratchScope
+{
+    Arena* arena;
+    u64 offset;
+
+    ScratchScope(Arena* a) : arena(a), offset(a->offset) {}
+    ~ScratchScope() { arena->offset = offset; }
+};
+
+// Per-thread scratch arena, created on first use and released on thread exit.
+// Loaders use it for temporaries, always inside a ScratchScope.
+#define THREAD_SCRATCH_ARENA_RESERVE GB(1)
+Arena* GetThreadScratchArena();
@@ -0,0 +1,1810 @@
+#include <mesh.hpp>
+#include <hash.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static u64 MeshAlignUp(u64 value, u64 align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+// ========================================================
+// Welding and attributes
+
+static bool MeshVerticesEqual(const MeshVertex* a, const MeshVertex* b)
+{
+    return memcmp(a, b, sizeof(MeshVertex)) == 0;
+}
+
+u32 WeldMeshVertices(MeshData* mesh)
+{
+    if(!mesh->vertexCount) return 0;
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    // Open addressing table of unique vertex indices, MAX_U32 marks an empty slot
+    u32 capacity = 1;
+    while(capacity < mesh->vertexCount * 2) capacity <<= 1;
+    u32* slots = ARENA_PUSH_ARRAY(scratchScope.arena, u32, capacity);
+    memset(slots, 0xFF, capacity * sizeof(u32));
+    u32* remap = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->vertexCount);
+
+    // Unique vertices are compacted in place: the write position never passes the read position.
+    u32 uniqueCount = 0;
+    for(u32 i = 0; i < mesh->vertexCount; i++)
+    {
+        MeshVertex vertex = mesh->vertices[i];
+        f32* components = (f32*)&vertex;
+        for(u32 c = 0; c < sizeof(MeshVertex) / sizeof(f32); c++)
+        {
+            if(components[c] == 0) components[c] = 0;  // -0 and 0 weld together
+        }
+
+        u32 slot = (u32)Hash64(&vertex, sizeof(MeshVertex)) & (capacity - 1);
+        while(slots[slot] != MAX_U32 && !MeshVerticesEqual(&mesh->vertices[slots[slot]], &vertex))
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if(slots[slot] == MAX_U32)
+        {
+            slots[slot] = uniqueCount;
+            mesh->vertices[uniqueCount++] = vertex;
+        }
+        remap[i] = slots[slot];
+    }
+
+    for(u32 i = 0; i < mesh->indexCount; i++)
+    {
+        mesh->indices[i] = remap[mesh->indices[i]];
+    }
+    mesh->vertexCount = uniqueCount;
+    return uniqueCount;
+}
+
+void ComputeMeshNormals(MeshData* mesh)
+{
+    for(u32 i = 0; i < mesh->vertexCount; i++)
+    {
+        mesh->vertices[i].normal = {};
+    }
+    for(u32 i = 0; i + 2 < mesh->indexCount; i += 3)
+    {
+        MeshVertex* a = &mesh->vertices[mesh->indices[i + 0]];
+        MeshVertex* b = &mesh->vertices[mesh->indices[i + 1]];
+        MeshVertex* c = &mesh->vertices[mesh->indices[i + 2]];
+        // Unnormalized, so larger triangles weigh more
+        v3f faceNormal = Cross(b->position - a->position, c->position - a->position);
+        a->normal = a->normal + faceNormal;
+        b->normal = b->normal + faceNormal;
+        c->normal = c->normal + faceNormal;
+    }
+    for(u32 i = 0; i < mesh->vertexCount; i++)
+    {
+        v3f* normal = &mesh->vertices[i].normal;
+        f32 length = Len(*normal);
+        *normal = length > 0 ? *normal * (1.f / length) : v3f{0, 0, 1};
+    }
+}
+
+void GetMeshBounds(const MeshData* mesh, v3f* outMin, v3f* outMax)
+{
+    v3f boundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    v3f boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for(u32 i = 0; i < mesh->vertexCount; i++)
+    {
+        for(u32 c = 0; c < 3; c++)
+        {
+            boundsMin.data[c] = MIN(boundsMin.data[c], mesh->vertices[i].position.data[c]);
+            boundsMax.data[c] = MAX(boundsMax.data[c], mesh->vertices[i].position.data[c]);
+        }
+    }
+    if(!mesh->vertexCount) boundsMin = boundsMax = {};
+    *outMin = boundsMin;
+    *outMax = boundsMax;
+}
+
+// ========================================================
+// OBJ
+
+#define OBJ_MAX_LINE 4096
+
+// Copies the next line into line (null terminated) and returns the start of the one after it, or NULL when it's too long.
+static const char* ReadObjLine(const char* cursor, const char* end, char* line)
+{
+    u32 length = 0;
+    while(cursor < end && *cursor != '\n')
+    {
+        if(length == OBJ_MAX_LINE - 1) return NULL;
+        line[length++] = *cursor++;
+    }
+    if(length && line[length - 1] == '\r') length--;
+    line[length] = 0;
+    return cursor < end ? cursor + 1 : end;
+}
+
+// Splits the line in place on whitespace. Returns NULL after the last token.
+static char* NextObjToken(char** cursor)
+{
+    char* c = *cursor;
+    while(*c == ' ' || *c == '\t') c++;
+    if(!*c) return NULL;
+    char* token = c;
+    while(*c && *c != ' ' && *c != '\t') c++;
+    if(*c) *c++ = 0;
+    *cursor = c;
+    return token;
+}
+
+static bool ResolveObjIndex(i32 index, u32 count, u32* outIndex)
+{
+    i32 resolved = index > 0 ? index - 1 : (i32)count + index;
+    if(index == 0 || resolved < 0 || (u32)resolved >= count) return false;
+    *outIndex = (u32)resolved;
+    return true;
+}
+
+bool LoadObjMesh(const char* text, u64 size, Arena* arena, MeshData* outMesh)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+    const char* end = text + size;
+    char* line = ARENA_PUSH_ARRAY(scratchScope.arena, char, OBJ_MAX_LINE);
+
+    // First pass counts elements, so everything can be allocated up front.
+    u32 positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+    for(const char* cursor = text; cursor < end;)
+    {
+        cursor = ReadObjLine(cursor, end, line);
+        if(!cursor)
+        {
+            printf("[MESH]: OBJ line longer than %d characters\n", OBJ_MAX_LINE);
+            return false;
+        }
+        if(strncmp(line, "v ", 2) == 0) positionCount++;
+        else if(strncmp(line, "vt ", 3) == 0) texCoordCount++;
+        else if(strncmp(line, "vn ", 3) == 0) normalCount++;
+        else if(strncmp(line, "f ", 2) == 0)
+        {
+            u32 faceVertices = 0;
+            char* tokens = line + 2;
+            while(NextObjToken(&tokens)) faceVertices++;
+            if(faceVertices >= 3) cornerCount += (faceVertices - 2) * 3;
+        }
+    }
+    if(!cornerCount)
+    {
+        printf("[MESH]: OBJ has no faces\n");
+        return false;
+    }
+
+    v3f* positions = ARENA_PUSH_ARRAY(scratchScope.arena, v3f, positionCount);
+    v2f* texCoords = ARENA_PUSH_ARRAY(scratchScope.arena, v2f, texCoordCount);
+    v3f* normals = ARENA_PUSH_ARRAY(scratchScope.arena, v3f, normalCount);
+    MeshData mesh = {};
+    mesh.vertices = ARENA_PUSH_ARRAY(arena, MeshVertex, cornerCount);
+    mesh.indices = ARENA_PUSH_ARRAY(arena, u32, cornerCount);
+    positionCount = texCoordCount = normalCount = 0;
+    bool hasNormals = true;
+
+    for(const char* cursor = text; cursor < end;)
+    {
+        cursor = ReadObjLine(cursor, end, line);
+        if(strncmp(line, "v ", 2) == 0)
+        {
+            v3f* p = &positions[positionCount++];
+            *p = {};
+            sscanf(line + 2, "%f %f %f", &p->x, &p->y, &p->z);
+        }
+        else if(strncmp(line, "vt ", 3) == 0)
+        {
+            v2f* t = &texCoords[texCoordCount++];
+            *t = {};
+            sscanf(line + 3, "%f %f", &t->u, &t->v);
+            t->v = 1.f - t->v;  // OBJ has a bottom-left origin
+        }
+        else if(strncmp(line, "vn ", 3) == 0)
+        {
+            v3f* n = &normals[normalCount++];
+            *n = {};
+            sscanf(line + 3, "%f %f %f", &n->x, &n->y, &n->z);
+        }
+        else if(strncmp(line, "f ", 2) == 0)
+        {
+            MeshVertex first = {};
+            MeshVertex previous = {};
+            u32 faceVertex = 0;
+            char* tokens = line + 2;
+            for(char* token = NextObjToken(&tokens); token; token = NextObjToken(&tokens), faceVertex++)
+            {
+                // p, p/t, p//n or p/t/n. Indices are 1 based, negative ones are relative to the end.
+                i32 p = 0, t = 0, n = 0;
+                char* slash = NULL;
+                p = (i32)strtol(token, &slash, 10);
+                if(*slash == '/')
+                {
+                    if(slash[1] != '/') t = (i32)strtol(slash + 1, &slash, 10);
+                    else slash++;
+                    if(*slash == '/') n = (i32)strtol(slash + 1, &slash, 10);
+                }
+
+                MeshVertex vertex = {};
+                u32 index;
+                if(!ResolveObjIndex(p, positionCount, &index))
+                {
+                    printf("[MESH]: OBJ face references missing position %d\n", p);
+                    return false;
+                }
+                vertex.position = positions[index];
+                if(t && ResolveObjIndex(t, texCoordCount, &index)) vertex.texCoord = texCoords[index];
+                if(n && ResolveObjIndex(n, normalCount, &index)) vertex.normal = normals[index];
+                else hasNormals = false;
+
+                // Fan triangulation
+                if(faceVertex == 0) first = vertex;
+                else if(faceVertex >= 2)
+                {
+                    mesh.vertices[mesh.vertexCount++] = first;
+                    mesh.vertices[mesh.vertexCount++] = previous;
+                    mesh.vertices[mesh.vertexCount++] = vertex;
+                }
+                previous = vertex;
+            }
+        }
+    }
+
+    for(u32 i = 0; i < mesh.vertexCount; i++) mesh.indices[i] = i;
+    mesh.indexCount = mesh.vertexCount;
+    if(!hasNormals)
+    {
+        for(u32 i = 0; i < mesh.vertexCount; i++) mesh.vertices[i].normal = {};
+    }
+    WeldMeshVertices(&mesh);
+    if(!hasNormals) ComputeMeshNormals(&mesh);
+    *outMesh = mesh;
+    return true;
+}
+
+// ========================================================
+// JSON (just enough for glTF)
+
+enum JsonType
+{
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+};
+
+struct JsonValue
+{
+    JsonType type = JSON_NULL;
+    const char* key = NULL;         // Object members only
+    u32 keyLength = 0;
+    const char* string = NULL;      // Escapes are not decoded
+    u32 stringLength = 0;
+    f64 number = 0;
+    u32 childCount = 0;
+    JsonValue* firstChild = NULL;
+    JsonValue* next = NULL;
+};
+
+#define JSON_MAX_DEPTH 64
+
+struct JsonParser
+{
+    const char* cursor;
+    const char* end;
+    Arena* arena;
+    u32 depth;
+};
+
+static void SkipJsonWhitespace(JsonParser* parser)
+{
+    while(parser->cursor < parser->end
+            && (*parser->cursor == ' ' || *parser->cursor == '\t' || *parser->cursor == '\n' || *parser->cursor == '\r'))
+    {
+        parser->cursor++;
+    }
+}
+
+static bool ParseJsonString(JsonParser* parser, const char** outString, u32* outLength)
+{
+    if(parser->cursor >= parser->end || *parser->cursor != '"') return false;
+    const char* start = ++parser->cursor;
+    while(parser->cursor < parser->end && *parser->cursor != '"')
+    {
+        if(*parser->cursor == '\\') parser->cursor++;
+        parser->cursor++;
+    }
+    if(parser->cursor >= parser->end) return false;
+    *outString = start;
+    *outLength = (u32)(parser->cursor - start);
+    parser->cursor++;
+    return true;
+}
+
+static bool MatchJsonLiteral(JsonParser* parser, const char* literal)
+{
+    u64 length = strlen(literal);
+    if((u64)(parser->end - parser->cursor) < length || memcmp(parser->cursor, literal, length) != 0) return false;
+    parser->cursor += length;
+    return true;
+}
+
+static JsonValue* ParseJsonValue(JsonParser* parser)
+{
+    SkipJsonWhitespace(parser);
+    if(parser->cursor >= parser->end || parser->depth >= JSON_MAX_DEPTH) return NULL;
+    JsonValue* value = ARENA_PUSH_STRUCT(parser->arena, JsonValue);
+    *value = {};
+
+    char c = *parser->cursor;
+    if(c == '{' || c == '[')
+    {
+        bool isObject = c == '{';
+        char close = isObject ? '}' : ']';
+        value->type = isObject ? JSON_OBJECT : JSON_ARRAY;
+        parser->cursor++;
+        parser->depth++;
+        JsonValue** link = &value->firstChild;
+        SkipJsonWhitespace(parser);
+        if(parser->cursor < parser->end && *parser->cursor == close)
+        {
+            parser->cursor++;
+            parser->depth--;
+            return value;
+        }
+        while(true)
+        {
+            const char* key = NULL;
+            u32 keyLength = 0;
+            if(isObject)
+            {
+                SkipJsonWhitespace(parser);
+                if(!ParseJsonString(parser, &key, &keyLength)) return NULL;
+                SkipJsonWhitespace(parser);
+                if(parser->cursor >= parser->end || *parser->cursor++ != ':') return NULL;
+            }
+            JsonValue* child = ParseJsonValue(parser);
+            if(!child) return NULL;
+            child->key = key;
+            child->keyLength = keyLength;
+            *link = child;
+            link = &child->next;
+            value->childCount++;
+
+            SkipJsonWhitespace(parser);
+            if(parser->cursor >= parser->end) return NULL;
+            char separator = *parser->cursor++;
+            if(separator == close) break;
+            if(separator != ',') return NULL;
+        }
+        parser->depth--;
+    }
+    else if(c == '"')
+    {
+        value->type = JSON_STRING;
+        if(!ParseJsonString(parser, &value->string, &value->stringLength)) return NULL;
+    }
+    else if(MatchJsonLiteral(parser, "true")) value->type = JSON_TRUE;
+    else if(MatchJsonLiteral(parser, "false")) value->type = JSON_FALSE;
+    else if(MatchJsonLiteral(parser, "null")) value->type = JSON_NULL;
+    else
+    {
+        // Input is not null terminated, so the number is copied out for strtod
+        char number[64];
+        u32 length = 0;
+        while(parser->cursor < parser->end && length < sizeof(number) - 1 && *parser->cursor && strchr("+-0123456789.eE", *parser->cursor))
+        {
+            number[length++] = *parser->cursor++;
+        }
+        number[length] = 0;
+        char* numberEnd = NULL;
+        value->type = JSON_NUMBER;
+        value->number = strtod(number, &numberEnd);
+        if(!length || numberEnd != number + length) return NULL;
+    }
+    return value;
+}
+
+static const JsonValue* FindJsonMember(const JsonValue* object, const char* key)
+{
+    if(!object || object->type != JSON_OBJECT) return NULL;
+    u64 keyLength = strlen(key);
+    for(const JsonValue* child = object->firstChild; child; child = child->next)
+    {
+        if(child->keyLength == keyLength && memcmp(child->key, key, keyLength) == 0) return child;
+    }
+    return NULL;
+}
+
+static const JsonValue* GetJsonElement(const JsonValue* array, u32 index)
+{
+    if(!array || array->type != JSON_ARRAY || index >= array->childCount) return NULL;
+    const JsonValue* child = array->firstChild;
+    while(index--) child = child->next;
+    return child;
+}
+
+static f64 GetJsonNumber(const JsonValue* value, f64 defaultValue)
+{
+    return value && value->type == JSON_NUMBER ? value->number : defaultValue;
+}
+
+// Non-negative integer members (indices, counts, byte sizes). Missing members read as defaultValue, and members that
+// aren't a u32 as MAX_U32, which callers reject as out of range. Casting a negative or huge f64 to u32 is undefined.
+static u32 GetJsonU32(const JsonValue* value, u32 defaultValue)
+{
+    if(!value || value->type != JSON_NUMBER) return defaultValue;
+    if(!(value->number >= 0 && value->number < (f64)MAX_U32)) return MAX_U32;
+    return (u32)value->number;
+}
+
+static bool JsonStringEquals(const JsonValue* value, const char* str)
+{
+    return value && value->type == JSON_STRING && value->stringLength == strlen(str)
+        && memcmp(value->string, str, value->stringLength) == 0;
+}
+
+// ========================================================
+// glTF
+
+#define GLB_MAGIC           0x46546C67      // "glTF"
+#define GLB_CHUNK_JSON      0x4E4F534A      // "JSON"
+#define GLB_CHUNK_BIN       0x004E4942      // "BIN\0"
+#define GLTF_MAX_PATH       512
+
+#define GLTF_COMPONENT_I8   5120
+#define GLTF_COMPONENT_U8   5121
+#define GLTF_COMPONENT_I16  5122
+#define GLTF_COMPONENT_U16  5123
+#define GLTF_COMPONENT_U32  5125
+#define GLTF_COMPONENT_F32  5126
+#define GLTF_MODE_TRIANGLES 4
+
+struct GltfBuffer
+{
+    const u8* data;
+    u64 size;
+};
+
+struct GltfDocument
+{
+    const JsonValue* root;
+    GltfBuffer* buffers;
+    u32 bufferCount;
+};
+
+struct GltfAccessor
+{
+    const u8* data;
+    u32 count;
+    u32 componentType;
+    u32 componentCount;
+    u64 stride;
+    bool normalized;
+};
+
+static i32 DecodeBase64Char(char c)
+{
+    if(c >= 'A' && c <= 'Z') return c - 'A';
+    if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if(c >= '0' && c <= '9') return c - '0' + 52;
+    if(c == '+') return 62;
+    if(c == '/') return 63;
+    return -1;
+}
+
+static u64 DecodeBase64(const char* src, u64 srcLength, u8* dst)
+{
+    u64 size = 0;
+    u32 bits = 0;
+    i32 bitCount = 0;
+    for(u64 i = 0; i < srcLength; i++)
+    {
+        i32 value = DecodeBase64Char(src[i]);
+        if(value < 0) break;    // Padding
+        bits = (bits << 6) | (u32)value;
+        bitCount += 6;
+        if(bitCount >= 8)
+        {
+            bitCount -= 8;
+            dst[size++] = (u8)(bits >> bitCount);
+        }
+    }
+    return size;
+}
+
+static bool LoadGltfBuffer(const JsonValue* buffer, const GltfBuffer* glbChunk, const char* directory, Arena* arena, GltfBuffer* outBuffer)
+{
+    u64 byteLength = GetJsonU32(FindJsonMember(buffer, "byteLength"), 0);
+    if(byteLength == MAX_U32) return false;
+    const JsonValue* uri = FindJsonMember(buffer, "uri");
+    if(!uri)
+    {
+        // GLB binary chunk
+        if(!glbChunk->data || glbChunk->size < byteLength) return false;
+        *outBuffer = *glbChunk;
+        return true;
+    }
+    if(uri->type != JSON_STRING) return false;
+
+    const char dataPrefix[] = "data:";
+    if(uri->stringLength > sizeof(dataPrefix) - 1 && memcmp(uri->string, dataPrefix, sizeof(dataPrefix) - 1) == 0)
+    {
+        const char base64Tag[] = ";base64,";
+        const char* payload = NULL;
+        for(u32 i = 0; i + sizeof(base64Tag) - 1 <= uri->stringLength; i++)
+        {
+            if(memcmp(uri->string + i, base64Tag, sizeof(base64Tag) - 1) == 0)
+            {
+                payload = uri->string + i + sizeof(base64Tag) - 1;
+                break;
+            }
+        }
+        if(!payload) return false;
+        u64 payloadLength = uri->stringLength - (payload - uri->string);
+        u8* data = ARENA_PUSH_ARRAY(arena, u8, payloadLength * 3 / 4 + 3);
+        outBuffer->data = data;
+        outBuffer->size = DecodeBase64(payload, payloadLength, data);
+        return outBuffer->size >= byteLength;
+    }
+
+    char path[GLTF_MAX_PATH];
+    if(snprintf(path, sizeof(path), "%s/%.*s", directory, (i32)uri->stringLength, uri->string) >= (i32)sizeof(path)) return false;
+    FILE* file = fopen(path, "rb");
+    if(!file)
+    {
+        printf("[MESH]: Failed to open glTF buffer %s\n", path);
+        return false;
+    }
+    u8* data = ARENA_PUSH_ARRAY(arena, u8, byteLength);
+    bool result = fread(data, 1, byteLength, file) == byteLength;
+    fclose(file);
+    outBuffer->data = data;
+    outBuffer->size = byteLength;
+    return result;
+}
+
+static u32 GetGltfComponentSize(u32 componentType)
+{
+    switch(componentType)
+    {
+        case GLTF_COMPONENT_I8:
+        case GLTF_COMPONENT_U8: return 1;
+        case GLTF_COMPONENT_I16:
+        case GLTF_COMPONENT_U16: return 2;
+        case GLTF_COMPONENT_U32:
+        case GLTF_COMPONENT_F32: return 4;
+        default: return 0;
+    }
+}
+
+static bool GetGltfAccessor(const GltfDocument* doc, const JsonValue* accessorIndex, GltfAccessor* outAccessor)
+{
+    if(!accessorIndex) return false;
+    const JsonValue* accessor = GetJsonElement(FindJsonMember(doc->root, "accessors"), GetJsonU32(accessorIndex, MAX_U32));
+    if(!accessor) return false;
+    if(FindJsonMember(accessor, "sparse"))
+    {
+        printf("[MESH]: Sparse glTF accessors are not supported\n");
+        return false;
+    }
+    const JsonValue* view = GetJsonElement(FindJsonMember(doc->root, "bufferViews"), GetJsonU32(FindJsonMember(accessor, "bufferView"), MAX_U32));
+    if(!view) return false;
+    u32 bufferIndex = GetJsonU32(FindJsonMember(view, "buffer"), MAX_U32);
+    if(bufferIndex >= doc->bufferCount) return false;
+
+    const JsonValue* type = FindJsonMember(accessor, "type");
+    u32 componentCount = JsonStringEquals(type, "SCALAR") ? 1
+        : JsonStringEquals(type, "VEC2") ? 2
+        : JsonStringEquals(type, "VEC3") ? 3
+        : JsonStringEquals(type, "VEC4") ? 4 : 0;
+    u32 componentType = GetJsonU32(FindJsonMember(accessor, "componentType"), 0);
+    u32 componentSize = GetGltfComponentSize(componentType);
+    if(!componentCount || !componentSize) return false;
+
+    GltfAccessor result = {};
+    result.count = GetJsonU32(FindJsonMember(accessor, "count"), 0);
+    result.componentType = componentType;
+    result.componentCount = componentCount;
+    result.normalized = FindJsonMember(accessor, "normalized") && FindJsonMember(accessor, "normalized")->type == JSON_TRUE;
+    u64 elementSize = (u64)componentSize * componentCount;
+    result.stride = GetJsonU32(FindJsonMember(view, "byteStride"), (u32)elementSize);
+    u64 viewOffset = GetJsonU32(FindJsonMember(view, "byteOffset"), 0);
+    u64 viewLength = GetJsonU32(FindJsonMember(view, "byteLength"), 0);
+    u64 accessorOffset = GetJsonU32(FindJsonMember(accessor, "byteOffset"), 0);
+
+    const GltfBuffer* buffer = &doc->buffers[bufferIndex];
+    u64 accessedSize = result.count ? accessorOffset + result.stride * (result.count - 1) + elementSize : 0;
+    if(viewOffset + viewLength > buffer->size || accessedSize > viewLength) return false;
+    result.data = buffer->data + viewOffset + accessorOffset;
+    *outAccessor = result;
+    return true;
+}
+
+static f32 ReadGltfComponent(const GltfAccessor* accessor, u32 element, u32 component)
+{
+    const u8* src = accessor->data + element * accessor->stride;
+    f32 value = 0;
+    switch(accessor->componentType)
+    {
+        case GLTF_COMPONENT_F32: { f32 v; memcpy(&v, src + component * 4, 4); return v; }
+        case GLTF_COMPONENT_U32: { u32 v; memcpy(&v, src + component * 4, 4); return (f32)v; }
+        case GLTF_COMPONENT_U16: { u16 v; memcpy(&v, src + component * 2, 2); value = accessor->normalized ? v / 65535.f : v; } break;
+        case GLTF_COMPONENT_I16: { int16_t v; memcpy(&v, src + component * 2, 2); value = accessor->normalized ? MAX(v / 32767.f, -1.f) : v; } break;
+        case GLTF_COMPONENT_U8: { value = accessor->normalized ? src[component] / 255.f : src[component]; } break;
+        case GLTF_COMPONENT_I8: { int8_t v = (int8_t)src[component]; value = accessor->normalized ? MAX(v / 127.f, -1.f) : v; } break;
+    }
+    return value;
+}
+
+static u32 ReadGltfIndex(const GltfAccessor* accessor, u32 element)
+{
+    const u8* src = accessor->data + element * accessor->stride;
+    switch(accessor->componentType)
+    {
+        case GLTF_COMPONENT_U32: { u32 v; memcpy(&v, src, 4); return v; }
+        case GLTF_COMPONENT_U16: { u16 v; memcpy(&v, src, 2); return v; }
+        case GLTF_COMPONENT_U8: return *src;
+        default: return MAX_U32;
+    }
+}
+
+// A mesh placed in the scene by a node, with the node's world transform
+struct GltfMeshInstance
+{
+    const JsonValue* mesh;
+    m4f transform;
+};
+
+static m4f GetGltfNodeTransform(const JsonValue* node)
+{
+    m4f result = Identity();
+    const JsonValue* matrix = FindJsonMember(node, "matrix");
+    if(matrix && matrix->type == JSON_ARRAY && matrix->childCount == 16)
+    {
+        // glTF matrices are column major
+        u32 i = 0;
+        for(const JsonValue* element = matrix->firstChild; element; element = element->next, i++)
+        {
+            result.data[(i % 4) * 4 + i / 4] = (f32)GetJsonNumber(element, 0);
+        }
+        return result;
+    }
+
+    // Translation * rotation * scale, rotation is a unit quaternion (x, y, z, w)
+    const JsonValue* t = FindJsonMember(node, "translation");
+    const JsonValue* r = FindJsonMember(node, "rotation");
+    const JsonValue* s = FindJsonMember(node, "scale");
+    v3f translation = { (f32)GetJsonNumber(GetJsonElement(t, 0), 0), (f32)GetJsonNumber(GetJsonElement(t, 1), 0), (f32)GetJsonNumber(GetJsonElement(t, 2), 0) };
+    v4f q = Normalize(v4f{ (f32)GetJsonNumber(GetJsonElement(r, 0), 0), (f32)GetJsonNumber(GetJsonElement(r, 1), 0),
+            (f32)GetJsonNumber(GetJsonElement(r, 2), 0), (f32)GetJsonNumber(GetJsonElement(r, 3), 1) });
+    v3f scale = { (f32)GetJsonNumber(GetJsonElement(s, 0), 1), (f32)GetJsonNumber(GetJsonElement(s, 1), 1), (f32)GetJsonNumber(GetJsonElement(s, 2), 1) };
+    result.m00 = 1 - 2 * (q.y * q.y + q.z * q.z);
+    result.m01 = 2 * (q.x * q.y - q.z * q.w);
+    result.m02 = 2 * (q.x * q.z + q.y * q.w);
+    result.m10 = 2 * (q.x * q.y + q.z * q.w);
+    result.m11 = 1 - 2 * (q.x * q.x + q.z * q.z);
+    result.m12 = 2 * (q.y * q.z - q.x * q.w);
+    result.m20 = 2 * (q.x * q.z - q.y * q.w);
+    result.m21 = 2 * (q.y * q.z + q.x * q.w);
+    result.m22 = 1 - 2 * (q.x * q.x + q.y * q.y);
+    return TranslationMatrix(translation) * result * ScaleMatrix(scale);
+}
+
+// Walks the node hierarchy of the default scene (or of every root node, if there are no scenes) and lists
+// each node's mesh with the node's world transform. Files without nodes get every mesh untransformed.
+// Instances are allocated from arena.
+static bool GetGltfMeshInstances(const GltfDocument* doc, Arena* arena, GltfMeshInstance** outInstances, u32* outCount)
+{
+    const JsonValue* meshes = FindJsonMember(doc->root, "meshes");
+    const JsonValue* nodes = FindJsonMember(doc->root, "nodes");
+    u32 meshCount = meshes && meshes->type == JSON_ARRAY ? meshes->childCount : 0;
+    u32 nodeCount = nodes && nodes->type == JSON_ARRAY ? nodes->childCount : 0;
+    if(!nodeCount)
+    {
+        GltfMeshInstance* instances = ARENA_PUSH_ARRAY(arena, GltfMeshInstance, meshCount);
+        u32 i = 0;
+        for(const JsonValue* mesh = meshCount ? meshes->firstChild : NULL; mesh; mesh = mesh->next, i++)
+        {
+            instances[i] = { mesh, Identity() };
+        }
+        *outInstances = instances;
+        *outCount = meshCount;
+        return true;
+    }
+
+    // In a valid file every node has at most one parent, so each node is visited at most once.
+    // Visiting more nodes than there are means a cycle or a shared child.
+    struct NodeVisit
+    {
+        u32 node;
+        m4f parentTransform;
+    };
+    NodeVisit* stack = ARENA_PUSH_ARRAY(arena, NodeVisit, nodeCount);
+    u32 stackCount = 0;
+    u32 visitCount = 0;
+    const JsonValue* scenes = FindJsonMember(doc->root, "scenes");
+    if(scenes && scenes->type == JSON_ARRAY && scenes->childCount)
+    {
+        const JsonValue* scene = GetJsonElement(scenes, GetJsonU32(FindJsonMember(doc->root, "scene"), 0));
+        if(!scene)
+        {
+            printf("[MESH]: glTF default scene is out of range\n");
+            return false;
+        }
+        const JsonValue* roots = FindJsonMember(scene, "nodes");
+        for(const JsonValue* root = roots && roots->type == JSON_ARRAY ? roots->firstChild : NULL; root; root = root->next)
+        {
+            if(visitCount++ == nodeCount)
+            {
+                printf("[MESH]: glTF scene lists more root nodes than there are nodes\n");
+                return false;
+            }
+            stack[stackCount++] = { GetJsonU32(root, MAX_U32), Identity() };
+        }
+    }
+    else
+    {
+        bool* isChild = ARENA_PUSH_ARRAY(arena, bool, nodeCount);
+        memset(isChild, 0, nodeCount * sizeof(bool));
+        for(const JsonValue* node = nodes->firstChild; node; node = node->next)
+        {
+            const JsonValue* children = FindJsonMember(node, "children");
+            for(const JsonValue* child = children && children->type == JSON_ARRAY ? children->firstChild : NULL; child; child = child->next)
+            {
+                u32 childIndex = GetJsonU32(child, MAX_U32);
+                if(childIndex < nodeCount) isChild[childIndex] = true;
+            }
+        }
+        for(u32 i = 0; i < nodeCount; i++)
+        {
+            if(!isChild[i]) stack[stackCount++] = { i, Identity() };
+        }
+        visitCount = stackCount;
+    }
+
+    GltfMeshInstance* instances = ARENA_PUSH_ARRAY(arena, GltfMeshInstance, nodeCount);
+    u32 instanceCount = 0;
+    while(stackCount)
+    {
+        NodeVisit visit = stack[--stackCount];
+        const JsonValue* node = GetJsonElement(nodes, visit.node);
+        if(!node)
+        {
+            printf("[MESH]: glTF node %u out of range\n", visit.node);
+            return false;
+        }
+        m4f transform = visit.parentTransform * GetGltfNodeTransform(node);
+        const JsonValue* meshIndex = FindJsonMember(node, "mesh");
+        if(meshIndex)
+        {
+            const JsonValue* mesh = GetJsonElement(meshes, GetJsonU32(meshIndex, MAX_U32));
+            if(!mesh)
+            {
+                printf("[MESH]: glTF node %u has an invalid mesh\n", visit.node);
+                return false;
+            }
+            instances[instanceCount++] = { mesh, transform };
+        }
+        const JsonValue* children = FindJsonMember(node, "children");
+        for(const JsonValue* child = children && children->type == JSON_ARRAY ? children->firstChild : NULL; child; child = child->next)
+        {
+            if(visitCount++ == nodeCount)
+            {
+                printf("[MESH]: glTF node hierarchy is not a tree\n");
+                return false;
+            }
+            stack[stackCount++] = { GetJsonU32(child, MAX_U32), transform };
+        }
+    }
+    *outInstances = instances;
+    *outCount = instanceCount;
+    return true;
+}
+
+bool LoadGltfMesh(const u8* data, u64 size, const char* directory, Arena* arena, MeshData* outMesh)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+    const char* json = (const char*)data;
+    u64 jsonSize = size;
+    GltfBuffer glbChunk = {};
+
+    u32 magic = 0;
+    if(size >= 12) memcpy(&magic, data, 4);
+    if(magic == GLB_MAGIC)
+    {
+        // Header (magic, version, length), then chunks of (length, type, data). JSON first, optional BIN second.
+        u64 offset = 12;
+        json = NULL;
+        while(offset + 8 <= size)
+        {
+            u32 chunkLength, chunkType;
+            memcpy(&chunkLength, data + offset, 4);
+            memcpy(&chunkType, data + offset + 4, 4);
+            offset += 8;
+            if(offset + chunkLength > size) break;
+            if(chunkType == GLB_CHUNK_JSON && !json)
+            {
+                json = (const char*)data + offset;
+                jsonSize = chunkLength;
+            }
+            else if(chunkType == GLB_CHUNK_BIN && !glbChunk.data)
+            {
+                glbChunk = { data + offset, chunkLength };
+            }
+            offset += MeshAlignUp(chunkLength, 4);
+        }
+        if(!json)
+        {
+            printf("[MESH]: GLB has no JSON chunk\n");
+            return false;
+        }
+    }
+
+    JsonParser parser = { json, json + jsonSize, scratchScope.arena, 0 };
+    GltfDocument doc = {};
+    doc.root = ParseJsonValue(&parser);
+    if(!doc.root || doc.root->type != JSON_OBJECT)
+    {
+        printf("[MESH]: Invalid glTF JSON\n");
+        return false;
+    }
+
+    const JsonValue* buffers = FindJsonMember(doc.root, "buffers");
+    doc.bufferCount = buffers && buffers->type == JSON_ARRAY ? buffers->childCount : 0;
+    doc.buffers = ARENA_PUSH_ARRAY(scratchScope.arena, GltfBuffer, doc.bufferCount);
+    for(u32 i = 0; i < doc.bufferCount; i++)
+    {
+        if(!LoadGltfBuffer(GetJsonElement(buffers, i), &glbChunk, directory, scratchScope.arena, &doc.buffers[i]))
+        {
+            printf("[MESH]: Failed to load glTF buffer %u\n", i);
+            return false;
+        }
+    }
+
+    GltfMeshInstance* instances = NULL;
+    u32 instanceCount = 0;
+    if(!GetGltfMeshInstances(&doc, scratchScope.arena, &instances, &instanceCount)) return false;
+
+    // Two passes over all triangle primitives of all mesh instances: sizes first, then contents.
+    MeshData mesh = {};
+    bool hasNormals = true;
+    for(u32 pass = 0; pass < 2; pass++)
+    {
+        u32 vertexCount = 0;
+        u32 indexCount = 0;
+        for(u32 instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+        {
+            const GltfMeshInstance* instance = &instances[instanceIndex];
+            // Normals take the inverse transpose, and mirroring transforms flip the triangle winding
+            f32 determinant = Determinant(instance->transform);
+            m4f normalTransform = ABS(determinant) > EPSILON_F32 ? Transpose(Inverse(instance->transform)) : instance->transform;
+            bool flipWinding = determinant < 0;
+            const JsonValue* primitives = FindJsonMember(instance->mesh, "primitives");
+            for(const JsonValue* primitive = primitives ? primitives->firstChild : NULL; primitive; primitive = primitive->next)
+            {
+                if(GetJsonU32(FindJsonMember(primitive, "mode"), GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+                {
+                    if(pass == 0) printf("[MESH]: Skipping non triangle list glTF primitive\n");
+                    continue;
+                }
+                const JsonValue* attributes = FindJsonMember(primitive, "attributes");
+                GltfAccessor positions, normals, texCoords, indices;
+                if(!GetGltfAccessor(&doc, FindJsonMember(attributes, "POSITION"), &positions) || positions.componentCount != 3)
+                {
+                    printf("[MESH]: glTF primitive has no valid POSITION\n");
+                    return false;
+                }
+                bool primitiveHasNormals = GetGltfAccessor(&doc, FindJsonMember(attributes, "NORMAL"), &normals) && normals.componentCount == 3;
+                bool primitiveHasTexCoords = GetGltfAccessor(&doc, FindJsonMember(attributes, "TEXCOORD_0"), &texCoords) && texCoords.componentCount == 2;
+                const JsonValue* indicesIndex = FindJsonMember(primitive, "indices");
+                if(indicesIndex && (!GetGltfAccessor(&doc, indicesIndex, &indices) || indices.componentCount != 1))
+                {
+                    printf("[MESH]: glTF primitive has invalid indices\n");
+                    return false;
+                }
+                u32 primitiveIndexCount = indicesIndex ? indices.count : positions.count;
+                primitiveIndexCount -= primitiveIndexCount % 3;
+
+                if(pass == 1)
+                {
+                    for(u32 i = 0; i < positions.count; i++)
+                    {
+                        MeshVertex* vertex = &mesh.vertices[vertexCount + i];
+                        *vertex = {};
+                        for(u32 c = 0; c < 3; c++) vertex->position.data[c] = ReadGltfComponent(&positions, i, c);
+                        vertex->position = TransformPosition(vertex->position, instance->transform);
+                        if(primitiveHasNormals && i < normals.count)
+                        {
+                            for(u32 c = 0; c < 3; c++) vertex->normal.data[c] = ReadGltfComponent(&normals, i, c);
+                            vertex->normal = Normalize(TransformDirection(vertex->normal, normalTransform));
+                        }
+                        if(primitiveHasTexCoords && i < texCoords.count)
+                        {
+                            for(u32 c = 0; c < 2; c++) vertex->texCoord.data[c] = ReadGltfComponent(&texCoords, i, c);
+                        }
+                    }
+                    for(u32 i = 0; i < primitiveIndexCount; i++)
+                    {
+                        u32 index = indicesIndex ? ReadGltfIndex(&indices, i) : i;
+                        if(index >= positions.count)
+                        {
+                            printf("[MESH]: glTF index %u out of range\n", index);
+                            return false;
+                        }
+                        mesh.indices[indexCount + i] = vertexCount + index;
+                    }
+                    if(flipWinding)
+                    {
+                        for(u32 i = 0; i < primitiveIndexCount; i += 3)
+                        {
+                            u32 index = mesh.indices[indexCount + i + 1];
+                            mesh.indices[indexCount + i + 1] = mesh.indices[indexCount + i + 2];
+                            mesh.indices[indexCount + i + 2] = index;
+                        }
+                    }
+                }
+                hasNormals = hasNormals && primitiveHasNormals;
+                vertexCount += positions.count;
+                indexCount += primitiveIndexCount;
+            }
+        }
+
+        if(pass == 0)
+        {
+            if(!indexCount)
+            {
+                printf("[MESH]: glTF has no triangles\n");
+                return false;
+            }
+            mesh.vertices = ARENA_PUSH_ARRAY(arena, MeshVertex, vertexCount);
+            mesh.indices = ARENA_PUSH_ARRAY(arena, u32, indexCount);
+        }
+        mesh.vertexCount = vertexCount;
+        mesh.indexCount = indexCount;
+    }
+
+    if(!hasNormals)
+    {
+        for(u32 i = 0; i < mesh.vertexCount; i++) mesh.vertices[i].normal = {};
+    }
+    WeldMeshVertices(&mesh);
+    if(!hasNormals) ComputeMeshNormals(&mesh);
+    *outMesh = mesh;
+    return true;
+}
+
+// ========================================================
+// Optimization
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize)
+{
+    VertexCacheStats result = {};
+    if(!indexCount || !vertexCount) return result;
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    // FIFO cache as timestamps: a vertex is cached when fewer than cacheSize misses happened since its own.
+    u32* timestamps = ARENA_PUSH_ARRAY(scratchScope.arena, u32, vertexCount);
+    memset(timestamps, 0, vertexCount * sizeof(u32));
+    u32 time = cacheSize + 1;
+    u32 misses = 0;
+    for(u32 i = 0; i < indexCount; i++)
+    {
+        u32 v = indices[i];
+        if(time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            misses++;
+        }
+    }
+    result.acmr = (f32)misses / (indexCount / 3);
+    result.atvr = (f32)misses / vertexCount;
+    return result;
+}
+
+#define FORSYTH_CACHE_SIZE          32
+#define FORSYTH_MAX_VALENCE_SCORE   64
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_LAST_TRI_SCORE      0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+struct ForsythScoreTable
+{
+    f32 cache[FORSYTH_CACHE_SIZE];
+    f32 valence[FORSYTH_MAX_VALENCE_SCORE];
+};
+
+static ForsythScoreTable MakeForsythScoreTable()
+{
+    ForsythScoreTable result;
+    for(u32 i = 0; i < FORSYTH_CACHE_SIZE; i++)
+    {
+        // The last triangle's vertices get a fixed score, so the next triangle doesn't just reuse one edge of it
+        result.cache[i] = i < 3 ? FORSYTH_LAST_TRI_SCORE
+            : powf(1.f - (f32)(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+    }
+    result.valence[0] = 0;
+    for(u32 i = 1; i < FORSYTH_MAX_VALENCE_SCORE; i++)
+    {
+        // Favors vertices with few triangles left, so they get finished instead of leaving lone triangles behind
+        result.valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((f32)i, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+    return result;
+}
+
+static f32 GetForsythVertexScore(const ForsythScoreTable* table, i32 cachePosition, u32 valence)
+{
+    if(!valence) return -1.f;   // No triangles left
+    f32 result = cachePosition >= 0 ? table->cache[cachePosition] : 0;
+    return result + table->valence[MIN(valence, FORSYTH_MAX_VALENCE_SCORE - 1)];
+}
+
+void OptimizeVertexCache(u32* indices, u32 indexCount, u32 vertexCount)
+{
+    static const ForsythScoreTable scoreTable = MakeForsythScoreTable();
+    u32 triangleCount = indexCount / 3;
+    if(!triangleCount) return;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    Arena* scratch = scratchScope.arena;
+
+    // Vertex to triangle adjacency. Each vertex list only keeps the triangles that are not emitted yet, valence long.
+    u32* valence = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    u32* adjacencyOffset = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    u32* adjacency = ARENA_PUSH_ARRAY(scratch, u32, triangleCount * 3);
+    memset(valence, 0, vertexCount * sizeof(u32));
+    for(u32 i = 0; i < triangleCount * 3; i++) valence[indices[i]]++;
+    u32 offset = 0;
+    for(u32 v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffset[v] = offset;
+        offset += valence[v];
+        valence[v] = 0;
+    }
+    for(u32 t = 0; t < triangleCount; t++)
+    {
+        for(u32 c = 0; c < 3; c++)
+        {
+            u32 v = indices[t * 3 + c];
+            adjacency[adjacencyOffset[v] + valence[v]++] = t;
+        }
+    }
+
+    i32* cachePosition = ARENA_PUSH_ARRAY(scratch, i32, vertexCount);
+    f32* vertexScore = ARENA_PUSH_ARRAY(scratch, f32, vertexCount);
+    for(u32 v = 0; v < vertexCount; v++)
+    {
+        cachePosition[v] = -1;
+        vertexScore[v] = GetForsythVertexScore(&scoreTable, -1, valence[v]);
+    }
+    f32* triangleScore = ARENA_PUSH_ARRAY(scratch, f32, triangleCount);
+    u8* emitted = ARENA_PUSH_ARRAY(scratch, u8, triangleCount);
+    memset(emitted, 0, triangleCount);
+    i32 bestTriangle = -1;
+    f32 bestScore = -FLT_MAX;
+    for(u32 t = 0; t < triangleCount; t++)
+    {
+        const u32* tri = &indices[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if(triangleScore[t] > bestScore)
+        {
+            bestScore = triangleScore[t];
+            bestTriangle = (i32)t;
+        }
+    }
+
+    u32* output = ARENA_PUSH_ARRAY(scratch, u32, triangleCount * 3);
+    u32 cache[FORSYTH_CACHE_SIZE + 3];
+    u32 cacheCount = 0;
+    u32 scanCursor = 0;
+    for(u32 emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if(bestTriangle < 0)
+        {
+            // Nothing left around the cache: continue from the next triangle not emitted yet
+            while(emitted[scanCursor]) scanCursor++;
+            bestTriangle = (i32)scanCursor;
+        }
+        u32 t = (u32)bestTriangle;
+        const u32* tri = &indices[t * 3];
+        emitted[t] = 1;
+        memcpy(&output[emittedCount * 3], tri, 3 * sizeof(u32));
+
+        // Remove from adjacency
+        for(u32 c = 0; c < 3; c++)
+        {
+            u32 v = tri[c];
+            u32* list = &adjacency[adjacencyOffset[v]];
+            for(u32 i = 0; i < valence[v]; i++)
+            {
+                if(list[i] == t)
+                {
+                    list[i] = list[--valence[v]];
+                    break;
+                }
+            }
+        }
+
+        // LRU cache update: the triangle's vertices move to the front
+        u32 newCache[FORSYTH_CACHE_SIZE + 3];
+        u32 newCacheCount = 0;
+        for(u32 c = 0; c < 3; c++) newCache[newCacheCount++] = tri[c];
+        for(u32 i = 0; i < cacheCount; i++)
+        {
+            u32 v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCacheCount++] = v;
+        }
+
+        // Rescore everything that was or is in the cache, and pick the best triangle around it
+        bestTriangle = -1;
+        bestScore = -FLT_MAX;
+        for(u32 i = 0; i < newCacheCount; i++)
+        {
+            u32 v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (i32)i : -1;
+            f32 newScore = GetForsythVertexScore(&scoreTable, cachePosition[v], valence[v]);
+            f32 scoreDelta = newScore - vertexScore[v];
+            vertexScore[v] = newScore;
+            const u32* list = &adjacency[adjacencyOffset[v]];
+            for(u32 j = 0; j < valence[v]; j++)
+            {
+                u32 adjacent = list[j];
+                triangleScore[adjacent] += scoreDelta;
+                if(triangleScore[adjacent] > bestScore)
+                {
+                    bestScore = triangleScore[adjacent];
+                    bestTriangle = (i32)adjacent;
+                }
+            }
+        }
+        cacheCount = MIN(newCacheCount, FORSYTH_CACHE_SIZE);
+        memcpy(cache, newCache, cacheCount * sizeof(u32));
+    }
+
+    memcpy(indices, output, triangleCount * 3 * sizeof(u32));
+}
+
+struct OverdrawCluster
+{
+    f32 sortKey;
+    u32 firstTriangle;
+    u32 triangleCount;
+};
+
+static int CompareOverdrawClusters(const void* a, const void* b)
+{
+    const OverdrawCluster* ca = (const OverdrawCluster*)a;
+    const OverdrawCluster* cb = (const OverdrawCluster*)b;
+    if(ca->sortKey != cb->sortKey) return ca->sortKey > cb->sortKey ? -1 : 1;
+    return ca->firstTriangle < cb->firstTriangle ? -1 : 1;
+}
+
+// Cache misses of one triangle, FIFO timestamps as in AnalyzeVertexCache.
+static u32 SimulateTriangleMisses(const u32* tri, u32* timestamps, u32* time)
+{
+    u32 misses = 0;
+    for(u32 c = 0; c < 3; c++)
+    {
+        if(*time - timestamps[tri[c]] > MESH_VERTEX_CACHE_SIZE)
+        {
+            timestamps[tri[c]] = (*time)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+#define OVERDRAW_MIN_CLUSTER_SIZE 8     // Triangles
+
+void OptimizeOverdraw(u32* indices, u32 indexCount, const MeshVertex* vertices, u32 vertexCount, f32 threshold)
+{
+    u32 triangleCount = indexCount / 3;
+    if(!triangleCount) return;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    Arena* scratch = scratchScope.arena;
+    u32* timestamps = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    memset(timestamps, 0, vertexCount * sizeof(u32));
+    u32 time = MESH_VERTEX_CACHE_SIZE + 1;
+
+    // Hard boundaries: triangles where the cache-optimized order starts over (all three vertices miss).
+    u32* hardClusters = ARENA_PUSH_ARRAY(scratch, u32, triangleCount + 1);
+    u32 hardClusterCount = 0;
+    for(u32 t = 0; t < triangleCount; t++)
+    {
+        if(SimulateTriangleMisses(&indices[t * 3], timestamps, &time) == 3) hardClusters[hardClusterCount++] = t;
+    }
+    hardClusters[hardClusterCount] = triangleCount;
+
+    // Soft boundaries: split hard clusters further wherever starting over with a cold cache
+    // keeps the ACMR within threshold of the whole cluster's.
+    OverdrawCluster* clusters = ARENA_PUSH_ARRAY(scratch, OverdrawCluster, triangleCount);
+    u32 clusterCount = 0;
+    for(u32 h = 0; h < hardClusterCount; h++)
+    {
+        u32 start = hardClusters[h];
+        u32 end = hardClusters[h + 1];
+        time += MESH_VERTEX_CACHE_SIZE + 1;     // Flush
+        u32 clusterMisses = 0;
+        for(u32 t = start; t < end; t++) clusterMisses += SimulateTriangleMisses(&indices[t * 3], timestamps, &time);
+        f32 acmrThreshold = threshold * clusterMisses / (end - start);
+
+        time += MESH_VERTEX_CACHE_SIZE + 1;
+        u32 subStart = start;
+        u32 subMisses = 0;
+        for(u32 t = start; t < end; t++)
+        {
+            subMisses += SimulateTriangleMisses(&indices[t * 3], timestamps, &time);
+            u32 subCount = t + 1 - subStart;
+            if(t + 1 == end || (subCount >= OVERDRAW_MIN_CLUSTER_SIZE && end - (t + 1) >= OVERDRAW_MIN_CLUSTER_SIZE
+                        && subMisses <= acmrThreshold * subCount))
+            {
+                clusters[clusterCount++] = { 0, subStart, subCount };
+                subStart = t + 1;
+                subMisses = 0;
+                time += MESH_VERTEX_CACHE_SIZE + 1;
+            }
+        }
+    }
+
+    // Sort clusters facing away from the mesh center first: they tend to occlude the rest.
+    v3f meshCenter = {};
+    f32 meshArea = 0;
+    for(u32 t = 0; t < triangleCount; t++)
+    {
+        const u32* tri = &indices[t * 3];
+        v3f a = vertices[tri[0]].position, b = vertices[tri[1]].position, c = vertices[tri[2]].position;
+        f32 area = Len(Cross(b - a, c - a));
+        meshCenter = meshCenter + (a + b + c) * (area / 3.f);
+        meshArea += area;
+    }
+    meshCenter = meshArea > 0 ? meshCenter * (1.f / meshArea) : meshCenter;
+
+    for(u32 i = 0; i < clusterCount; i++)
+    {
+        OverdrawCluster* cluster = &clusters[i];
+        v3f center = {};
+        v3f normal = {};
+        f32 area = 0;
+        for(u32 t = cluster->firstTriangle; t < cluster->firstTriangle + cluster->triangleCount; t++)
+        {
+            const u32* tri = &indices[t * 3];
+            v3f a = vertices[tri[0]].position, b = vertices[tri[1]].position, c = vertices[tri[2]].position;
+            v3f faceNormal = Cross(b - a, c - a);
+            f32 faceArea = Len(faceNormal);
+            center = center + (a + b + c) * (faceArea / 3.f);
+            normal = normal + faceNormal;
+            area += faceArea;
+        }
+        f32 normalLength = Len(normal);
+        if(area > 0 && normalLength > 0)
+        {
+            center = center * (1.f / area);
+            cluster->sortKey = Dot(center - meshCenter, normal * (1.f / normalLength));
+        }
+    }
+    qsort(clusters, clusterCount, sizeof(OverdrawCluster), CompareOverdrawClusters);
+
+    u32* output = ARENA_PUSH_ARRAY(scratch, u32, triangleCount * 3);
+    u32 outputCount = 0;
+    for(u32 i = 0; i < clusterCount; i++)
+    {
+        memcpy(&output[outputCount], &indices[clusters[i].firstTriangle * 3], clusters[i].triangleCount * 3 * sizeof(u32));
+        outputCount += clusters[i].triangleCount * 3;
+    }
+    memcpy(indices, output, outputCount * sizeof(u32));
+}
+
+void OptimizeVertexFetch(MeshData* mesh)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u32* remap = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->vertexCount);
+    memset(remap, 0xFF, mesh->vertexCount * sizeof(u32));
+    MeshVertex* vertices = ARENA_PUSH_ARRAY(scratchScope.arena, MeshVertex, mesh->vertexCount);
+    u32 vertexCount = 0;
+    for(u32 i = 0; i < mesh->indexCount; i++)
+    {
+        u32 v = mesh->indices[i];
+        if(remap[v] == MAX_U32)
+        {
+            remap[v] = vertexCount;
+            vertices[vertexCount++] = mesh->vertices[v];
+        }
+        mesh->indices[i] = remap[v];
+    }
+    memcpy(mesh->vertices, vertices, vertexCount * sizeof(MeshVertex));
+    mesh->vertexCount = vertexCount;
+}
+
+u32 SplitMesh(const MeshData* mesh, u32 maxVertices, Arena* arena, MeshData** outChunks)
+{
+    maxVertices = MAX(maxVertices, 3);     // Room for any triangle
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u32 triangleCount = mesh->indexCount / 3;
+    // Chunk each vertex was last added to, and its index there
+    u32* vertexChunk = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->vertexCount);
+    u32* vertexLocalIndex = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->vertexCount);
+    memset(vertexChunk, 0xFF, mesh->vertexCount * sizeof(u32));
+    // Chunk local indices, and the source vertex of each chunk vertex (all chunks back to back)
+    u32* localIndices = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->indexCount);
+    u32* sourceVertices = ARENA_PUSH_ARRAY(scratchScope.arena, u32, mesh->indexCount);
+    u32* chunkFirstTriangle = ARENA_PUSH_ARRAY(scratchScope.arena, u32, triangleCount + 1);
+    u32* chunkVertexCount = ARENA_PUSH_ARRAY(scratchScope.arena, u32, triangleCount + 1);
+
+    u32 chunkCount = 1;
+    u32 sourceVertexCount = 0;
+    chunkFirstTriangle[0] = 0;
+    chunkVertexCount[0] = 0;
+    for(u32 t = 0; t < triangleCount; t++)
+    {
+        const u32* tri = &mesh->indices[t * 3];
+        u32 chunk = chunkCount - 1;
+        u32 newVertices = 0;
+        for(u32 k = 0; k < 3; k++)
+        {
+            bool repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+            if(!repeated && vertexChunk[tri[k]] != chunk) newVertices++;
+        }
+        if(chunkVertexCount[chunk] + newVertices > maxVertices)
+        {
+            chunk = chunkCount++;
+            chunkFirstTriangle[chunk] = t;
+            chunkVertexCount[chunk] = 0;
+        }
+        for(u32 k = 0; k < 3; k++)
+        {
+            u32 v = tri[k];
+            if(vertexChunk[v] != chunk)
+            {
+                vertexChunk[v] = chunk;
+                vertexLocalIndex[v] = chunkVertexCount[chunk]++;
+                sourceVertices[sourceVertexCount++] = v;
+            }
+            localIndices[t * 3 + k] = vertexLocalIndex[v];
+        }
+    }
+    chunkFirstTriangle[chunkCount] = triangleCount;
+
+    MeshData* chunks = ARENA_PUSH_ARRAY(arena, MeshData, chunkCount);
+    const u32* chunkSourceVertices = sourceVertices;
+    for(u32 i = 0; i < chunkCount; i++)
+    {
+        MeshData* chunk = &chunks[i];
+        *chunk = {};
+        chunk->vertexCount = chunkVertexCount[i];
+        chunk->indexCount = (chunkFirstTriangle[i + 1] - chunkFirstTriangle[i]) * 3;
+        chunk->vertices = ARENA_PUSH_ARRAY(arena, MeshVertex, MAX(chunk->vertexCount, 1));
+        chunk->indices = ARENA_PUSH_ARRAY(arena, u32, MAX(chunk->indexCount, 1));
+        for(u32 v = 0; v < chunk->vertexCount; v++) chunk->vertices[v] = mesh->vertices[chunkSourceVertices[v]];
+        memcpy(chunk->indices, &localIndices[chunkFirstTriangle[i] * 3], chunk->indexCount * sizeof(u32));
+        chunkSourceVertices += chunk->vertexCount;
+    }
+    *outChunks = chunks;
+    return chunkCount;
+}
+
+// ========================================================
+// Simplification
+
+// Sum of squared distances to a set of planes, as p^T A p + 2 b.p + c with A symmetric.
+// Planes are weighted by triangle area, and error is normalized by the total weight.
+struct Quadric
+{
+    f64 a00, a01, a02, a11, a12, a22;
+    f64 b0, b1, b2;
+    f64 c;
+    f64 weight;
+};
+
+static void AddQuadric(Quadric* q, const Quadric* other)
+{
+    f64* dst = (f64*)q;
+    const f64* src = (const f64*)other;
+    for(u32 i = 0; i < sizeof(Quadric) / sizeof(f64); i++) dst[i] += src[i];
+}
+
+static Quadric MakePlaneQuadric(v3f a, v3f b, v3f c)
+{
+    v3f normal = Cross(b - a, c - a);
+    f32 length = Len(normal);
+    Quadric result = {};
+    if(length <= 0) return result;
+    f64 area = length * 0.5;
+    f64 nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+    f64 d = -(nx * a.x + ny * a.y + nz * a.z);
+    result.a00 = area * nx * nx; result.a01 = area * nx * ny; result.a02 = area * nx * nz;
+    result.a11 = area * ny * ny; result.a12 = area * ny * nz;
+    result.a22 = area * nz * nz;
+    result.b0 = area * nx * d; result.b1 = area * ny * d; result.b2 = area * nz * d;
+    result.c = area * d * d;
+    result.weight = area;
+    return result;
+}
+
+static f64 EvaluateQuadric(const Quadric* q, v3f p)
+{
+    f64 x = p.x, y = p.y, z = p.z;
+    f64 result = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z
+        + 2 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z)
+        + 2 * (q->b0 * x + q->b1 * y + q->b2 * z)
+        + q->c;
+    return q->weight > 0 ? fabs(result) / q->weight : 0;
+}
+
+struct EdgeCollapse
+{
+    f64 cost;       // Squared distance
+    u32 from;
+    u32 to;
+};
+
+static int CompareEdgeCollapses(const void* a, const void* b)
+{
+    const EdgeCollapse* ea = (const EdgeCollapse*)a;
+    const EdgeCollapse* eb = (const EdgeCollapse*)b;
+    if(ea->cost != eb->cost) return ea->cost < eb->cost ? -1 : 1;
+    return ea->from < eb->from ? -1 : (ea->from > eb->from ? 1 : 0);
+}
+
+// Open addressing set of undirected edges between position groups, counting the triangles on each.
+struct EdgeTable
+{
+    u64* keys;      // MAX_U64 marks an empty slot
+    u32* counts;
+    u32 capacity;
+};
+
+static void AddEdge(EdgeTable* table, u32 a, u32 b)
+{
+    u64 key = a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+    u32 slot = (u32)HashCombine(key, key >> 29) & (table->capacity - 1);
+    while(table->keys[slot] != MAX_U64 && table->keys[slot] != key) slot = (slot + 1) & (table->capacity - 1);
+    table->keys[slot] = key;
+    table->counts[slot]++;
+}
+
+static u32 GetEdgeCount(const EdgeTable* table, u32 a, u32 b)
+{
+    u64 key = a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+    u32 slot = (u32)HashCombine(key, key >> 29) & (table->capacity - 1);
+    while(table->keys[slot] != MAX_U64)
+    {
+        if(table->keys[slot] == key) return table->counts[slot];
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return 0;
+}
+
+u32 SimplifyMesh(const u32* indices, u32 indexCount, const MeshVertex* vertices, u32 vertexCount,
+        u32 targetIndexCount, f32 targetError, u32* outIndices, f32* outError)
+{
+    memcpy(outIndices, indices, indexCount * sizeof(u32));
+    *outError = 0;
+    if(indexCount <= targetIndexCount || !vertexCount) return indexCount;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    Arena* scratch = scratchScope.arena;
+
+    // Position groups: vertices split by normals or texture coordinates share one position.
+    u32 capacity = 1;
+    while(capacity < vertexCount * 2) capacity <<= 1;
+    u32* slots = ARENA_PUSH_ARRAY(scratch, u32, capacity);
+    memset(slots, 0xFF, capacity * sizeof(u32));
+    u32* group = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    u32* groupSize = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    memset(groupSize, 0, vertexCount * sizeof(u32));
+    for(u32 v = 0; v < vertexCount; v++)
+    {
+        const v3f* position = &vertices[v].position;
+        u32 slot = (u32)Hash64(position, sizeof(v3f)) & (capacity - 1);
+        while(slots[slot] != MAX_U32 && memcmp(&vertices[slots[slot]].position, position, sizeof(v3f)) != 0)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if(slots[slot] == MAX_U32) slots[slot] = v;
+        group[v] = slots[slot];
+        groupSize[group[v]]++;
+    }
+
+    // Locked vertices never move: seams (more than one vertex at the position) and open borders (edges with one triangle).
+    u8* locked = ARENA_PUSH_ARRAY(scratch, u8, vertexCount);
+    for(u32 v = 0; v < vertexCount; v++) locked[v] = groupSize[group[v]] > 1;
+    EdgeTable edges = {};
+    edges.capacity = 1;
+    while(edges.capacity < indexCount * 2) edges.capacity <<= 1;
+    edges.keys = ARENA_PUSH_ARRAY(scratch, u64, edges.capacity);
+    edges.counts = ARENA_PUSH_ARRAY(scratch, u32, edges.capacity);
+    memset(edges.keys, 0xFF, edges.capacity * sizeof(u64));
+    memset(edges.counts, 0, edges.capacity * sizeof(u32));
+    for(u32 i = 0; i < indexCount; i += 3)
+    {
+        for(u32 e = 0; e < 3; e++) AddEdge(&edges, group[indices[i + e]], group[indices[i + (e + 1) % 3]]);
+    }
+    for(u32 i = 0; i < indexCount; i += 3)
+    {
+        for(u32 e = 0; e < 3; e++)
+        {
+            u32 a = indices[i + e];
+            u32 b = indices[i + (e + 1) % 3];
+            if(GetEdgeCount(&edges, group[a], group[b]) == 1) locked[a] = locked[b] = 1;
+        }
+    }
+
+    Quadric* quadrics = ARENA_PUSH_ARRAY(scratch, Quadric, vertexCount);
+    memset(quadrics, 0, vertexCount * sizeof(Quadric));
+    for(u32 i = 0; i < indexCount; i += 3)
+    {
+        Quadric plane = MakePlaneQuadric(vertices[indices[i]].position, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+        for(u32 c = 0; c < 3; c++) AddQuadric(&quadrics[indices[i + c]], &plane);
+    }
+
+    u32* adjacencyOffset = ARENA_PUSH_ARRAY(scratch, u32, vertexCount + 1);
+    u32* adjacency = ARENA_PUSH_ARRAY(scratch, u32, indexCount);
+    u32* remap = ARENA_PUSH_ARRAY(scratch, u32, vertexCount);
+    u8* touched = ARENA_PUSH_ARRAY(scratch, u8, vertexCount);
+    EdgeCollapse* collapses = ARENA_PUSH_ARRAY(scratch, EdgeCollapse, indexCount * 2);
+    f64 maxCost = (f64)targetError * targetError;
+    f64 reachedCost = 0;
+
+    // Passes of independent collapses (no two touch the same triangles), cheapest first
+    while(indexCount > targetIndexCount)
+    {
+        // Vertex to triangle adjacency for the current indices
+        memset(adjacencyOffset, 0, (vertexCount + 1) * sizeof(u32));
+        for(u32 i = 0; i < indexCount; i++) adjacencyOffset[outIndices[i] + 1]++;
+        for(u32 v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+        for(u32 i = 0; i < indexCount; i++) adjacency[adjacencyOffset[outIndices[i]]++] = i / 3;
+        for(u32 v = vertexCount; v > 0; v--) adjacencyOffset[v] = adjacencyOffset[v - 1];
+        adjacencyOffset[0] = 0;
+
+        u32 collapseCount = 0;
+        for(u32 i = 0; i < indexCount; i += 3)
+        {
+            for(u32 e = 0; e < 3; e++)
+            {
+                u32 a = outIndices[i + e];
+                u32 b = outIndices[i + (e + 1) % 3];
+                Quadric q = quadrics[a];
+                AddQuadric(&q, &quadrics[b]);
+                if(!locked[a]) collapses[collapseCount++] = { EvaluateQuadric(&q, vertices[b].position), a, b };
+                if(!locked[b]) collapses[collapseCount++] = { EvaluateQuadric(&q, vertices[a].position), b, a };
+            }
+        }
+        qsort(collapses, collapseCount, sizeof(EdgeCollapse), CompareEdgeCollapses);
+
+        // Each collapse removes about two triangles
+        u32 collapseLimit = (indexCount - targetIndexCount) / 6 + 1;
+        u32 applied = 0;
+        for(u32 v = 0; v < vertexCount; v++) remap[v] = v;
+        memset(touched, 0, vertexCount);
+        for(u32 c = 0; c < collapseCount && applied < collapseLimit; c++)
+        {
+            EdgeCollapse* collapse = &collapses[c];
+            if(collapse->cost > maxCost) break;
+            u32 from = collapse->from;
+            u32 to = collapse->to;
+            if(touched[from] || touched[to]) continue;
+
+            // Reject collapses that flip a remaining triangle around from
+            bool flips = false;
+            v3f target = vertices[to].position;
+            for(u32 j = adjacencyOffset[from]; j < adjacencyOffset[from + 1] && !flips; j++)
+            {
+                const u32* tri = &outIndices[adjacency[j] * 3];
+                if(group[tri[0]] == group[to] || group[tri[1]] == group[to] || group[tri[2]] == group[to]) continue;
+                v3f p[3], moved[3];
+                for(u32 k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[tri[k]].position;
+                    moved[k] = tri[k] == from ? target : p[k];
+                }
+                v3f before = Cross(p[1] - p[0], p[2] - p[0]);
+                v3f after = Cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = Dot(before, after) <= 0;
+            }
+            if(flips) continue;
+
+            // Everything around from is now stale for this pass
+            for(u32 j = adjacencyOffset[from]; j < adjacencyOffset[from + 1]; j++)
+            {
+                const u32* tri = &outIndices[adjacency[j] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            remap[from] = to;
+            AddQuadric(&quadrics[to], &quadrics[from]);
+            reachedCost = MAX(reachedCost, collapse->cost);
+            applied++;
+        }
+        if(!applied) break;
+
+        // Apply, dropping triangles that became degenerate
+        u32 newIndexCount = 0;
+        for(u32 i = 0; i < indexCount; i += 3)
+        {
+            u32 a = remap[outIndices[i]], b = remap[outIndices[i + 1]], c = remap[outIndices[i + 2]];
+            if(group[a] == group[b] || group[b] == group[c] || group[a] == group[c]) continue;
+            outIndices[newIndexCount++] = a;
+            outIndices[newIndexCount++] = b;
+            outIndices[newIndexCount++] = c;
+        }
+        indexCount = newIndexCount;
+    }
+
+    *outError = (f32)sqrt(reachedCost);
+    return indexCount;
+}
+
+u32 SelectMeshLod(const MeshLod* lods, u32 lodCount, f32 distance, f32 scale, f32 projectionScale, f32 maxPixelError)
+{
+    if(distance <= 0) return 0;
+    u32 result = 0;
+    for(u32 i = 1; i < lodCount; i++)
+    {
+        f32 pixelError = lods[i].error * scale * projectionScale / distance;
+        if(pixelError > maxPixelError) break;
+        result = i;
+    }
+    return result;
+}
+
+// ========================================================
+// Mesh blob
+
+static bool IsUnormVertexFormat(VertexFormat format)
+{
+    return format == VERTEX_FORMAT_R16G16_UNORM
+        || format == VERTEX_FORMAT_R8G8B8A8_UNORM
+        || format == VERTEX_FORMAT_A2B10G10R10_UNORM;
+}
+
+u64 WriteMeshBlob(const MeshData* chunks, u32 chunkCount, const VertexFormat* formats, Arena* arena, u8** outData, QuantizeError* outErrors)
+{
+    if(!chunkCount) return 0;
+    ScratchScope scratchScope(GetThreadScratchArena());
+    const VertexFormat sourceFormats[MESH_ATTRIBUTE_COUNT] = { VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_R32G32_FLOAT };
+    const u32 attributeCount = MESH_ATTRIBUTE_COUNT;
+
+    MeshBlobHeader header = {};
+    header.chunkCount = chunkCount;
+    header.indexSize = sizeof(u16);
+    for(u32 i = 0; i < chunkCount; i++)
+    {
+        header.vertexCount += chunks[i].vertexCount;
+        header.indexCount += chunks[i].indexCount;
+        header.lodCount = MAX(header.lodCount, MAX(chunks[i].lodCount, 1));
+        if(chunks[i].vertexCount > MESH_CHUNK_MAX_VERTICES) header.indexSize = sizeof(u32);
+    }
+
+    // All chunk vertices back to back, indices stay chunk local
+    MeshData merged = {};
+    merged.vertexCount = header.vertexCount;
+    merged.vertices = ARENA_PUSH_ARRAY(scratchScope.arena, MeshVertex, header.vertexCount);
+    u8* indexData = (u8*)ArenaPush(scratchScope.arena, (u64)header.indexCount * header.indexSize);
+    MeshBlobChunk* blobChunks = ARENA_PUSH_ARRAY(scratchScope.arena, MeshBlobChunk, chunkCount);
+    u32 vertexOffset = 0;
+    u32 indexOffset = 0;
+    for(u32 i = 0; i < chunkCount; i++)
+    {
+        const MeshData* chunk = &chunks[i];
+        MeshBlobChunk* blobChunk = &blobChunks[i];
+        *blobChunk = {};
+        blobChunk->vertexOffset = vertexOffset;
+        blobChunk->vertexCount = chunk->vertexCount;
+        memcpy(&merged.vertices[vertexOffset], chunk->vertices, chunk->vertexCount * sizeof(MeshVertex));
+        for(u32 j = 0; j < chunk->indexCount; j++)
+        {
+            if(header.indexSize == sizeof(u16)) ((u16*)indexData)[indexOffset + j] = (u16)chunk->indices[j];
+            else ((u32*)indexData)[indexOffset + j] = chunk->indices[j];
+        }
+        for(u32 j = 0; j < header.lodCount; j++)
+        {
+            MeshLod lod = { 0, chunk->indexCount, 0 };
+            if(chunk->lodCount) lod = chunk->lods[MIN(j, chunk->lodCount - 1)];
+            lod.firstIndex += indexOffset;
+            blobChunk->lods[j] = lod;
+            if(i == 0) header.lods[j] = { lod.firstIndex, 0, 0 };
+            header.lods[j].indexCount += lod.indexCount;
+            header.lods[j].error = MAX(header.lods[j].error, lod.error);
+        }
+        vertexOffset += chunk->vertexCount;
+        indexOffset += chunk->indexCount;
+    }
+
+    const MeshVertex* source = merged.vertices;
+    if(IsUnormVertexFormat(formats[1]))
+    {
+        MeshVertex* remapped = ARENA_PUSH_ARRAY(scratchScope.arena, MeshVertex, merged.vertexCount);
+        for(u32 i = 0; i < merged.vertexCount; i++)
+        {
+            remapped[i] = merged.vertices[i];
+            remapped[i].normal = remapped[i].normal * 0.5f + v3f{0.5f, 0.5f, 0.5f};
+        }
+        source = remapped;
+    }
+    u8* vertexData = NULL;
+    u64 vertexDataSize = QuantizeVertices((const u8*)source, merged.vertexCount, attributeCount,
+            sourceFormats, formats, scratchScope.arena, &vertexData, outErrors);
+
+    header.attributeCount = attributeCount;
+    for(u32 i = 0; i < attributeCount; i++)
+    {
+        header.attributeFormats[i] = formats[i];
+        header.vertexStride += vertexFormatSizeInBytes[formats[i]];
+    }
+    GetMeshBounds(&merged, &header.boundsMin, &header.boundsMax);
+    header.chunkDataOffset = MeshAlignUp(sizeof(MeshBlobHeader), MESH_BLOB_DATA_ALIGN);
+    header.vertexDataOffset = MeshAlignUp(header.chunkDataOffset + chunkCount * sizeof(MeshBlobChunk), MESH_BLOB_DATA_ALIGN);
+    header.vertexDataSize = vertexDataSize;
+    header.indexDataOffset = MeshAlignUp(header.vertexDataOffset + vertexDataSize, MESH_BLOB_DATA_ALIGN);
+    header.indexDataSize = (u64)header.indexCount * header.indexSize;
+
+    u64 size = header.indexDataOffset + header.indexDataSize;
+    u8* result = (u8*)ArenaPush(arena, size, MESH_BLOB_DATA_ALIGN);
+    memset(result, 0, size);
+    memcpy(result, &header, sizeof(header));
+    memcpy(result + header.chunkDataOffset, blobChunks, chunkCount * sizeof(MeshBlobChunk));
+    memcpy(result + header.vertexDataOffset, vertexData, vertexDataSize);
+    memcpy(result + header.indexDataOffset, indexData, header.indexDataSize);
+    *outData = result;
+    return size;
+}
+
+static u32 GetMeshBlobIndex(const void* indices, u32 indexSize, u32 i)
+{
+    return indexSize == sizeof(u16) ? ((const u16*)indices)[i] : ((const u32*)indices)[i];
+}
+
+bool ReadMeshBlob(const u8* data, u64 size, MeshBlob* outBlob)
+{
+    if(size < sizeof(MeshBlobHeader)) return false;
+    const MeshBlobHeader* header = (const MeshBlobHeader*)data;
+    if(header->magic != MESH_BLOB_MAGIC || header->version != MESH_BLOB_VERSION) return false;
+    if(!header->attributeCount || header->attributeCount > MESH_BLOB_MAX_ATTRIBUTES) return false;
+    u32 stride = 0;
+    for(u32 i = 0; i < header->attributeCount; i++)
+    {
+        if(header->attributeFormats[i] >= VERTEX_FORMAT_COUNT) return false;
+        stride += vertexFormatSizeInBytes[header->attributeFormats[i]];
+    }
+    if(stride != header->vertexStride) return false;
+    if(header->indexSize != sizeof(u16) && header->indexSize != sizeof(u32)) return false;
+    if(header->vertexDataSize != (u64)header->vertexCount * stride) return false;
+    if(header->indexDataSize != (u64)header->indexCount * header->indexSize || header->indexCount % 3) return false;
+    if(!header->chunkCount || header->chunkDataOffset > size || (u64)header->chunkCount * sizeof(MeshBlobChunk) > size - header->chunkDataOffset) return false;
+    if(header->vertexDataOffset > size || header->vertexDataSize > size - header->vertexDataOffset) return false;
+    if(header->indexDataOffset > size || header->indexDataSize > size - header->indexDataOffset) return false;
+    if(header->chunkDataOffset % alignof(MeshBlobChunk) || header->indexDataOffset % header->indexSize) return false;
+    if(!header->lodCount || header->lodCount > MESH_MAX_LODS) return false;
+    for(u32 i = 0; i < header->lodCount; i++)
+    {
+        const MeshLod* lod = &header->lods[i];
+        if(lod->indexCount % 3 || lod->firstIndex > header->indexCount || lod->indexCount > header->indexCount - lod->firstIndex) return false;
+    }
+
+    // Out of range indices would read past the chunk (or the vertex buffer) on the GPU
+    const MeshBlobChunk* chunks = (const MeshBlobChunk*)(data + header->chunkDataOffset);
+    const void* indices = data + header->indexDataOffset;
+    for(u32 i = 0; i < header->chunkCount; i++)
+    {
+        const MeshBlobChunk* chunk = &chunks[i];
+        if(chunk->vertexOffset > header->vertexCount || chunk->vertexCount > header->vertexCount - chunk->vertexOffset) return false;
+        for(u32 j = 0; j < header->lodCount; j++)
+        {
+            const MeshLod* lod = &chunk->lods[j];
+            if(lod->indexCount % 3 || lod->firstIndex > header->indexCount || lod->indexCount > header->indexCount - lod->firstIndex) return false;
+            if(j > 0 && lod->firstIndex == chunk->lods[j - 1].firstIndex && lod->indexCount == chunk->lods[j - 1].indexCount) continue;
+            for(u32 k = lod->firstIndex; k < lod->firstIndex + lod->indexCount; k++)
+            {
+                if(GetMeshBlobIndex(indices, header->indexSize, k) >= chunk->vertexCount) return false;
+            }
+        }
+    }
+
+    outBlob->header = header;
+    outBlob->chunks = chunks;
+    outBlob->vertexData = data + header->vertexDataOffset;
+    outBlob->indices = indices;
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <math.hpp>
+#include <memory.hpp>
+#include <vertex_format.hpp>
+
+// ========================================================
+// [MESH]
+// Mesh import (OBJ, glTF 2.0), vertex welding and reordering for the GPU, and the binary mesh blob
+// built offline by tools/mesh_builder and uploaded by the renderer as is.
+#define MESH_ATTRIBUTE_COUNT 3   // Position, normal, texture coordinates
+struct MeshVertex
+{
+    v3f position;
+    v3f normal;
+    v2f texCoord;
+};
+
+// Level of detail: a range of the mesh's index buffer. All levels share the same vertices.
+#define MESH_MAX_LODS 8
+struct MeshLod
+{
+    u32 firstIndex = 0;
+    u32 indexCount = 0;
+    f32 error = 0;              // Geometric deviation from the full detail mesh, in object space units
+};
+
+struct MeshData
+{
+    u32 vertexCount = 0;
+    u32 indexCount = 0;
+    MeshVertex* vertices = NULL;
+    u32* indices = NULL;        // Triangle list, all LODs back to back
+    u32 lodCount = 0;           // 0: the whole index buffer is a single level
+    MeshLod lods[MESH_MAX_LODS];
+};
+
+// Importers, output is allocated from arena (not the calling thread's scratch arena, which holds temporaries).
+// Polygons are triangulated as fans, texture coordinates have a top-left origin.
+// Vertices are welded, and missing normals are computed (smooth, area weighted).
+bool LoadObjMesh(const char* text, u64 size, Arena* arena, MeshData* outMesh);
+// .gltf (buffers in external files relative to directory, or base64 data URIs) or .glb.
+// All triangle primitives of the default scene's meshes are merged into one, baked with their nodes' world transforms.
+// Sparse accessors are not supported.
+bool LoadGltfMesh(const u8* data, u64 size, const char* directory, Arena* arena, MeshData* outMesh);
+
+// Merges bitwise identical vertices in place, through a hash map of vertex contents. Returns the new vertex count.
+u32 WeldMeshVertices(MeshData* mesh);
+void ComputeMeshNormals(MeshData* mesh);
+void GetMeshBounds(const MeshData* mesh, v3f* outMin, v3f* outMax);
+
+// Post-transform vertex cache efficiency, from a FIFO cache simulation.
+#define MESH_VERTEX_CACHE_SIZE 16
+struct VertexCacheStats
+{
+    f32 acmr = 0;       // Average cache miss ratio: vertex shader invocations per triangle (0.5 at best, 3 at worst)
+    f32 atvr = 0;       // Average transformed vertex ratio: vertex shader invocations per vertex (1 at best)
+};
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize = MESH_VERTEX_CACHE_SIZE);
+
+// Optimization passes, meant to run in this order. Temporaries come from the calling thread's scratch arena.
+// Reorders triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+void OptimizeVertexCache(u32* indices, u32 indexCount, u32 vertexCount);
+// Splits the cache-optimized triangle order into clusters and sorts them so outward facing clusters come first,
+// which makes the mesh occlude itself more. threshold (e.g. 1.05) is how much ACMR may grow from splitting clusters further.
+void OptimizeOverdraw(u32* indices, u32 indexCount, const MeshVertex* vertices, u32 vertexCount, f32 threshold);
+// Reorders vertices by first use, so vertex fetch walks memory linearly. Unreferenced vertices are dropped.
+void OptimizeVertexFetch(MeshData* mesh);
+
+// Largest vertex count that 16-bit indices can address.
+#define MESH_CHUNK_MAX_VERTICES 65536
+// Splits the triangles, in order, into chunks of at most maxVertices vertices each, with their own vertices and local indices.
+// Run OptimizeVertexCache first so chunks are spatially coherent; vertices on chunk boundaries are duplicated.
+// Chunks are allocated from arena. Returns the chunk count.
+u32 SplitMesh(const MeshData* mesh, u32 maxVertices, Arena* arena, MeshData** outChunks);
+
+// Quadric error metric simplification (Garland and Heckbert) by edge collapses onto existing vertices,
+// so simplified index buffers keep using the original vertices. Border and attribute seam vertices don't move.
+// Stops at targetIndexCount, or before a collapse would deviate more than targetError (object space units).
+// outIndices needs room for indexCount indices. Returns the new index count, outError gets the deviation reached.
+u32 SimplifyMesh(const u32* indices, u32 indexCount, const MeshVertex* vertices, u32 vertexCount,
+        u32 targetIndexCount, f32 targetError, u32* outIndices, f32* outError);
+
+// Coarsest level whose error projects to at most maxPixelError pixels.
+// distance and scale place the object in view space, projectionScale is screen height / (2 * tan(fovY / 2)).
+u32 SelectMeshLod(const MeshLod* lods, u32 lodCount, f32 distance, f32 scale, f32 projectionScale, f32 maxPixelError);
+
+// Binary mesh blob. Layout:
+//      MeshBlobHeader
+//      Chunks              MeshBlobChunk array, aligned to MESH_BLOB_DATA_ALIGN
+//      Vertex data         Interleaved, in attributeFormats, aligned to MESH_BLOB_DATA_ALIGN
+//      Index data          Triangle lists of all chunks and LODs, aligned to MESH_BLOB_DATA_ALIGN.
+//                          u16 when every chunk has at most MESH_CHUNK_MAX_VERTICES vertices, u32 otherwise.
+#define MESH_BLOB_MAGIC             0x4853454D      // "MESH"
+#define MESH_BLOB_VERSION           3
+#define MESH_BLOB_MAX_ATTRIBUTES    8
+#define MESH_BLOB_DATA_ALIGN        16
+
+// Vertex range with its own LOD chain. Indices are relative to vertexOffset (vkCmdDrawIndexed's vertexOffset).
+struct MeshBlobChunk
+{
+    u32 vertexOffset = 0;
+    u32 vertexCount = 0;
+    MeshLod lods[MESH_MAX_LODS];    // Chunks with a shorter chain repeat their coarsest level
+};
+
+struct MeshBlobHeader
+{
+    u32 magic = MESH_BLOB_MAGIC;
+    u32 version = MESH_BLOB_VERSION;
+    u32 vertexCount = 0;
+    u32 indexCount = 0;
+    u32 vertexStride = 0;
+    u32 attributeCount = 0;
+    u32 lodCount = 0;
+    u32 indexSize = 0;              // Bytes per index, 2 or 4
+    u32 chunkCount = 0;
+    u32 attributeFormats[MESH_BLOB_MAX_ATTRIBUTES] = {};    // VertexFormat, in MeshVertex order
+    v3f boundsMin = {};
+    v3f boundsMax = {};
+    MeshLod lods[MESH_MAX_LODS];    // Finest first. Over all chunks: largest error, total index count, first chunk's first index.
+    u64 chunkDataOffset = 0;        // From start of blob
+    u64 vertexDataOffset = 0;
+    u64 vertexDataSize = 0;
+    u64 indexDataOffset = 0;
+    u64 indexDataSize = 0;
+};
+
+// View over a blob that is already in memory.
+struct MeshBlob
+{
+    const MeshBlobHeader* header = NULL;
+    const MeshBlobChunk* chunks = NULL;
+    const u8* vertexData = NULL;
+    const void* indices = NULL;     // header->indexSize bytes each
+};
+
+// Writes chunks (e.g. from SplitMesh, or a single mesh) into one blob, allocated from arena (not the scratch one).
+// Vertices are quantized into formats (position, normal, texture coordinates). Returns the blob size.
+// Normals are stored as n * 0.5 + 0.5 in UNORM formats. outErrors has one entry per attribute, and is optional.
+u64 WriteMeshBlob(const MeshData* chunks, u32 chunkCount, const VertexFormat* formats, Arena* arena, u8** outData, QuantizeError* outErrors);
+bool ReadMeshBlob(const u8* data, u64 size, MeshBlob* outBlob);     // Validates header and data ranges
@@ -0,0 +1,227 @@
+#include <platform.hpp>
+#include <stdlib.h>
+#include <stdio.h>
+#if _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <intrin.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Threads are started through a trampoline, so both backends can share the same thread proc signature.
+struct PlatformThreadStart
+{
+    PlatformThreadProc proc;
+    void* data;
+};
+
+#if _WIN32
+
+void* PlatformReserveMemory(u64 size)
+{
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+}
+
+bool PlatformCommitMemory(void* ptr, u64 size)
+{
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void PlatformReleaseMemory(void* ptr, u64 size)
+{
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+static DWORD WINAPI PlatformThreadTrampoline(LPVOID param)
+{
+    PlatformThreadStart start = *(PlatformThreadStart*)param;
+    free(param);
+    start.proc(start.data);
+    return 0;
+}
+
+PlatformThread PlatformCreateThread(PlatformThreadProc proc, void* data)
+{
+    PlatformThreadStart* start = (PlatformThreadStart*)malloc(sizeof(PlatformThreadStart));
+    *start = { proc, data };
+    return CreateThread(NULL, 0, PlatformThreadTrampoline, start, 0, NULL);
+}
+
+void PlatformJoinThread(PlatformThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+u32 PlatformGetThreadId()
+{
+    return (u32)GetCurrentThreadId();
+}
+
+u32 PlatformGetProcessorCount()
+{
+    SYSTEM_INFO systemInfo = {};
+    GetSystemInfo(&systemInfo);
+    return (u32)systemInfo.dwNumberOfProcessors;
+}
+
+void PlatformYield()
+{
+    Sleep(0);
+}
+
+void PlatformInitMutex(PlatformMutex* mutex) { InitializeSRWLock(mutex); }
+void PlatformLockMutex(PlatformMutex* mutex) { AcquireSRWLockExclusive(mutex); }
+void PlatformUnlockMutex(PlatformMutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+void PlatformInitConditionVariable(PlatformConditionVariable* cv) { InitializeConditionVariable(cv); }
+void PlatformWaitConditionVariable(PlatformConditionVariable* cv, PlatformMutex* mutex) { SleepConditionVariableSRW(cv, mutex, INFINITE, 0); }
+void PlatformWakeOne(PlatformConditionVariable* cv) { WakeConditionVariable(cv); }
+void PlatformWakeAll(PlatformConditionVariable* cv) { WakeAllConditionVariable(cv); }
+
+i32 PlatformAtomicIncrement(volatile i32* value)
+{
+    return (i32)InterlockedIncrement((volatile LONG*)value);
+}
+
+u32 PlatformFindLowestSetBit(u64 value)
+{
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+}
+
+u32 PlatformFindHighestSetBit(u64 value)
+{
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+}
+
+bool PlatformCreateDirectory(const char* path)
+{
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool PlatformReplaceFile(const char* src, const char* dst)
+{
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+FILE* PlatformTakeStdout()
+{
+    fflush(stdout);
+    i32 fd = _dup(_fileno(stdout));
+    if(fd < 0) return NULL;
+    _dup2(_fileno(stderr), _fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    return _fdopen(fd, "wb");
+}
+
+#else
+
+void* PlatformReserveMemory(u64 size)
+{
+    void* result = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return result == MAP_FAILED ? NULL : result;
+}
+
+bool PlatformCommitMemory(void* ptr, u64 size)
+{
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void PlatformReleaseMemory(void* ptr, u64 size)
+{
+    munmap(ptr, size);
+}
+
+static void* PlatformThreadTrampoline(void* param)
+{
+    PlatformThreadStart start = *(PlatformThreadStart*)param;
+    free(param);
+    start.proc(start.data);
+    return NULL;
+}
+
+PlatformThread PlatformCreateThread(PlatformThreadProc proc, void* data)
+{
+    PlatformThreadStart* start = (PlatformThreadStart*)malloc(sizeof(PlatformThreadStart));
+    *start = { proc, data };
+    pthread_t result;
+    if(pthread_create(&result, NULL, PlatformThreadTrampoline, start) != 0)
+    {
+        printf("[PLATFORM]: Failed to create thread\n");
+        exit(-1);
+    }
+    return result;
+}
+
+void PlatformJoinThread(PlatformThread thread)
+{
+    pthread_join(thread, NULL);
+}
+
+u32 PlatformGetThreadId()
+{
+    return (u32)syscall(SYS_gettid);
+}
+
+u32 PlatformGetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+void PlatformYield()
+{
+    sched_yield();
+}
+
+void PlatformInitMutex(PlatformMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void PlatformLockMutex(PlatformMutex* mutex) { pthread_mutex_lock(mutex); }
+void PlatformUnlockMutex(PlatformMutex* mutex) { pthread_mutex_unlock(mutex); }
+void PlatformInitConditionVariable(PlatformConditionVariable* cv) { pthread_cond_init(cv, NULL); }
+void PlatformWaitConditionVariable(PlatformConditionVariable* cv, PlatformMutex* mutex) { pthread_cond_wait(cv, mutex); }
+void PlatformWakeOne(PlatformConditionVariable* cv) { pthread_cond_signal(cv); }
+void PlatformWakeAll(PlatformConditionVariable* cv) { pthread_cond_broadcast(cv); }
+
+i32 PlatformAtomicIncrement(volatile i32* value)
+{
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+u32 PlatformFindLowestSetBit(u64 value) { return (u32)__builtin_ctzll(value); }
+u32 PlatformFindHighestSetBit(u64 value) { return 63 - (u32)__builtin_clzll(value); }
+
+bool PlatformCreateDirectory(const char* path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool PlatformReplaceFile(const char* src, const char* dst)
+{
+    // rename is atomic on POSIX. Sync the data first, so the new name never points to unwritten contents.
+    i32 fd = open(src, O_RDONLY);
+    if(fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced && rename(src, dst) == 0;
+}
+
+FILE* PlatformTakeStdout()
+{
+    fflush(stdout);
+    i32 fd = dup(STDOUT_FILENO);
+    if(fd < 0) return NULL;
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    return fdopen(fd, "wb");
+}
+
+#endif
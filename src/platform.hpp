@@ -0,0 +1,59 @@
+#pragma once
+#include <stdio.h>
+#if _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <math.hpp>
+
+// ========================================================
+// [PLATFORM]
+// OS primitives used by the engine modules (memory, jobs, shader compiler), with Win32 and POSIX backends.
+// Window, surface and file mapping code is app specific and stays in main.cpp.
+
+// Virtual memory. Reserved ranges are inaccessible until committed.
+void* PlatformReserveMemory(u64 size);
+bool PlatformCommitMemory(void* ptr, u64 size);
+void PlatformReleaseMemory(void* ptr, u64 size);
+
+// Threads and synchronization
+typedef void (*PlatformThreadProc)(void* data);
+#if _WIN32
+typedef HANDLE              PlatformThread;
+typedef SRWLOCK             PlatformMutex;
+typedef CONDITION_VARIABLE  PlatformConditionVariable;
+#else
+typedef pthread_t           PlatformThread;
+typedef pthread_mutex_t     PlatformMutex;
+typedef pthread_cond_t      PlatformConditionVariable;
+#endif
+
+PlatformThread PlatformCreateThread(PlatformThreadProc proc, void* data);
+void PlatformJoinThread(PlatformThread thread);     // Waits for the thread to exit and releases it
+u32 PlatformGetThreadId();
+u32 PlatformGetProcessorCount();
+void PlatformYield();
+
+void PlatformInitMutex(PlatformMutex* mutex);
+void PlatformLockMutex(PlatformMutex* mutex);
+void PlatformUnlockMutex(PlatformMutex* mutex);
+void PlatformInitConditionVariable(PlatformConditionVariable* cv);
+void PlatformWaitConditionVariable(PlatformConditionVariable* cv, PlatformMutex* mutex);   // Mutex must be locked
+void PlatformWakeOne(PlatformConditionVariable* cv);
+void PlatformWakeAll(PlatformConditionVariable* cv);
+
+// Returns the incremented value.
+i32 PlatformAtomicIncrement(volatile i32* value);
+
+// Bit scans, value must not be 0.
+u32 PlatformFindLowestSetBit(u64 value);
+u32 PlatformFindHighestSetBit(u64 value);
+
+// Files
+bool PlatformCreateDirectory(const char* path);     // Also true if the directory already exists
+// Replaces dst with src, atomically when both are on the same volume.
+bool PlatformReplaceFile(const char* src, const char* dst);
+// Returns a binary stream on the process' original stdout, and points stdout at stderr from then on,
+// so logging can't corrupt data piped out of the app (e.g. video frames).
+FILE* PlatformTakeStdout();
@@ -0,0 +1,182 @@
+#include <range_allocator.hpp>
+#include <string.h>
+
+// Size class of a block. Classes split each power of two in SL_COUNT linear steps.
+static void MapRangeSize(u64 size, u32* outFl, u32* outSl)
+{
+    if(size < RANGE_ALLOCATOR_SL_COUNT)
+    {
+        *outFl = 0;
+        *outSl = (u32)size;
+        return;
+    }
+    u32 msb = PlatformFindHighestSetBit(size);
+    *outFl = msb - RANGE_ALLOCATOR_SL_LOG2 + 1;
+    *outSl = (u32)(size >> (msb - RANGE_ALLOCATOR_SL_LOG2)) - RANGE_ALLOCATOR_SL_COUNT;
+}
+
+static u32 NewRangeBlock(RangeAllocator* allocator)
+{
+    u32 index = allocator->unusedBlocks;
+    if(index != RANGE_BLOCK_NONE) allocator->unusedBlocks = allocator->blocks[index].nextFree;
+    return index;
+}
+
+static void ReleaseRangeBlock(RangeAllocator* allocator, u32 index)
+{
+    allocator->blocks[index] = {};
+    allocator->blocks[index].nextFree = allocator->unusedBlocks;
+    allocator->unusedBlocks = index;
+}
+
+static void InsertFreeBlock(RangeAllocator* allocator, u32 index)
+{
+    RangeBlock* block = &allocator->blocks[index];
+    u32 fl, sl;
+    MapRangeSize(block->size, &fl, &sl);
+    u32 head = allocator->freeHeads[fl][sl];
+    block->isFree = true;
+    block->prevFree = RANGE_BLOCK_NONE;
+    block->nextFree = head;
+    if(head != RANGE_BLOCK_NONE) allocator->blocks[head].prevFree = index;
+    allocator->freeHeads[fl][sl] = index;
+    allocator->slBitmaps[fl] |= 1u << sl;
+    allocator->flBitmap |= 1ull << fl;
+}
+
+static void RemoveFreeBlock(RangeAllocator* allocator, u32 index)
+{
+    RangeBlock* block = &allocator->blocks[index];
+    u32 fl, sl;
+    MapRangeSize(block->size, &fl, &sl);
+    if(block->prevFree != RANGE_BLOCK_NONE) allocator->blocks[block->prevFree].nextFree = block->nextFree;
+    else allocator->freeHeads[fl][sl] = block->nextFree;
+    if(block->nextFree != RANGE_BLOCK_NONE) allocator->blocks[block->nextFree].prevFree = block->prevFree;
+    if(allocator->freeHeads[fl][sl] == RANGE_BLOCK_NONE)
+    {
+        allocator->slBitmaps[fl] &= ~(1u << sl);
+        if(!allocator->slBitmaps[fl]) allocator->flBitmap &= ~(1ull << fl);
+    }
+    block->isFree = false;
+    block->prevFree = RANGE_BLOCK_NONE;
+    block->nextFree = RANGE_BLOCK_NONE;
+}
+
+// First block of a class where every block fits size, so no list is searched.
+static u32 FindFreeBlock(const RangeAllocator* allocator, u64 size)
+{
+    if(size >= RANGE_ALLOCATOR_SL_COUNT)
+    {
+        size += (1ull << (PlatformFindHighestSetBit(size) - RANGE_ALLOCATOR_SL_LOG2)) - 1;
+    }
+    u32 fl, sl;
+    MapRangeSize(size, &fl, &sl);
+    if(fl >= RANGE_ALLOCATOR_FL_COUNT) return RANGE_BLOCK_NONE;
+    u32 slMap = allocator->slBitmaps[fl] & (~0u << sl);
+    if(!slMap)
+    {
+        u64 flMap = fl + 1 < 64 ? allocator->flBitmap & (~0ull << (fl + 1)) : 0;
+        if(!flMap) return RANGE_BLOCK_NONE;
+        fl = PlatformFindLowestSetBit(flMap);
+        slMap = allocator->slBitmaps[fl];
+    }
+    sl = PlatformFindLowestSetBit(slMap);
+    return allocator->freeHeads[fl][sl];
+}
+
+void InitRangeAllocator(RangeAllocator* allocator, u64 size, u32 maxAllocations, Arena* arena)
+{
+    *allocator = {};
+    memset(allocator->freeHeads, 0xFF, sizeof(allocator->freeHeads));
+    allocator->size = size;
+    allocator->maxAllocations = maxAllocations;
+    u32 blockCount = maxAllocations * 2 + 1;
+    allocator->blocks = ARENA_PUSH_ARRAY(arena, RangeBlock, blockCount);
+    for(u32 i = blockCount; i > 0; i--) ReleaseRangeBlock(allocator, i - 1);
+
+    if(!size) return;
+    u32 first = NewRangeBlock(allocator);
+    allocator->blocks[first].offset = 0;
+    allocator->blocks[first].size = size;
+    InsertFreeBlock(allocator, first);
+}
+
+RangeAllocation AllocateRange(RangeAllocator* allocator, u64 size)
+{
+    RangeAllocation result = {};
+    size = MAX(size, 1);
+    if(allocator->allocationCount >= allocator->maxAllocations) return result;
+    u32 index = FindFreeBlock(allocator, size);
+    if(index == RANGE_BLOCK_NONE) return result;
+    RemoveFreeBlock(allocator, index);
+
+    // Remainder goes back to the free lists
+    RangeBlock* block = &allocator->blocks[index];
+    if(block->size > size)
+    {
+        u32 restIndex = NewRangeBlock(allocator);
+        RangeBlock* rest = &allocator->blocks[restIndex];
+        rest->offset = block->offset + size;
+        rest->size = block->size - size;
+        rest->prevPhysical = index;
+        rest->nextPhysical = block->nextPhysical;
+        if(block->nextPhysical != RANGE_BLOCK_NONE) allocator->blocks[block->nextPhysical].prevPhysical = restIndex;
+        block->nextPhysical = restIndex;
+        block->size = size;
+        InsertFreeBlock(allocator, restIndex);
+    }
+
+    allocator->allocatedSize += block->size;
+    allocator->allocationCount++;
+    result.offset = block->offset;
+    result.size = block->size;
+    result.block = index;
+    return result;
+}
+
+void FreeRange(RangeAllocator* allocator, RangeAllocation allocation)
+{
+    if(allocation.block == RANGE_BLOCK_NONE) return;
+    u32 index = allocation.block;
+    RangeBlock* block = &allocator->blocks[index];
+    allocator->allocatedSize -= block->size;
+    allocator->allocationCount--;
+
+    // Merge with free neighbours
+    u32 prev = block->prevPhysical;
+    if(prev != RANGE_BLOCK_NONE && allocator->blocks[prev].isFree)
+    {
+        RemoveFreeBlock(allocator, prev);
+        RangeBlock* prevBlock = &allocator->blocks[prev];
+        prevBlock->size += block->size;
+        prevBlock->nextPhysical = block->nextPhysical;
+        if(block->nextPhysical != RANGE_BLOCK_NONE) allocator->blocks[block->nextPhysical].prevPhysical = prev;
+        ReleaseRangeBlock(allocator, index);
+        index = prev;
+        block = prevBlock;
+    }
+    u32 next = block->nextPhysical;
+    if(next != RANGE_BLOCK_NONE && allocator->blocks[next].isFree)
+    {
+        RemoveFreeBlock(allocator, next);
+        RangeBlock* nextBlock = &allocator->blocks[next];
+        block->size += nextBlock->size;
+        block->nextPhysical = nextBlock->nextPhysical;
+        if(nextBlock->nextPhysical != RANGE_BLOCK_NONE) allocator->blocks[nextBlock->nextPhysical].prevPhysical = index;
+        ReleaseRangeBlock(allocator, next);
+    }
+    InsertFreeBlock(allocator, index);
+}
+
+u64 GetLargestFreeRange(const RangeAllocator* allocator)
+{
+    if(!allocator->flBitmap) return 0;
+    u32 fl = PlatformFindHighestSetBit(allocator->flBitmap);
+    u32 sl = PlatformFindHighestSetBit(allocator->slBitmaps[fl]);
+    u64 result = 0;
+    for(u32 i = allocator->freeHeads[fl][sl]; i != RANGE_BLOCK_NONE; i = allocator->blocks[i].nextFree)
+    {
+        result = MAX(result, allocator->blocks[i].size);
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <math.hpp>
+#include <memory.hpp>
+
+// ========================================================
+// [RANGE ALLOCATOR]
+// Suballocates ranges of a fixed size space (e.g. vertices of a GPU buffer) with a two level segregated fit
+// allocator (TLSF): allocation and free take constant time, and freed ranges merge with free neighbours right away.
+// Units are up to the caller. Only bookkeeping lives here, the space itself is never touched.
+#define RANGE_ALLOCATOR_SL_LOG2     4                                   // Second level classes per power of two
+#define RANGE_ALLOCATOR_SL_COUNT    (1 << RANGE_ALLOCATOR_SL_LOG2)
+#define RANGE_ALLOCATOR_FL_COUNT    (64 - RANGE_ALLOCATOR_SL_LOG2 + 1)  // Sizes below SL_COUNT share the first class
+#define RANGE_BLOCK_NONE            MAX_U32
+
+struct RangeBlock
+{
+    u64 offset = 0;
+    u64 size = 0;
+    u32 prevPhysical = RANGE_BLOCK_NONE;    // Neighbours in the space
+    u32 nextPhysical = RANGE_BLOCK_NONE;
+    u32 prevFree = RANGE_BLOCK_NONE;        // Free list of the block's size class. nextFree also links unused descriptors.
+    u32 nextFree = RANGE_BLOCK_NONE;
+    bool isFree = false;
+};
+
+struct RangeAllocation
+{
+    u64 offset = 0;
+    u64 size = 0;
+    u32 block = RANGE_BLOCK_NONE;           // RANGE_BLOCK_NONE when allocation failed
+};
+
+struct RangeAllocator
+{
+    u64 size = 0;
+    u64 allocatedSize = 0;
+    u32 allocationCount = 0;
+    u32 maxAllocations = 0;
+    RangeBlock* blocks = NULL;              // Descriptor pool, room for every allocation plus the free blocks between them
+    u32 unusedBlocks = RANGE_BLOCK_NONE;
+    u64 flBitmap = 0;                       // First level classes with free blocks
+    u32 slBitmaps[RANGE_ALLOCATOR_FL_COUNT] = {};
+    u32 freeHeads[RANGE_ALLOCATOR_FL_COUNT][RANGE_ALLOCATOR_SL_COUNT];
+};
+
+// Block descriptors for up to maxAllocations live allocations come from arena.
+void InitRangeAllocator(RangeAllocator* allocator, u64 size, u32 maxAllocations, Arena* arena);
+RangeAllocation AllocateRange(RangeAllocator* allocator, u64 size);
+void FreeRange(RangeAllocator* allocator, RangeAllocation allocation);
+u64 GetLargestFreeRange(const RangeAllocator* allocator);   // Compared to free space, shows fragmentation
@@ -0,0 +1,336 @@
+#include <shader_compiler.hpp>
+#include <hash.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void InitShaderCompiler(ShaderCompiler* compiler, const char* cacheDir, const char* includeDir)
+{
+    *compiler = {};
+    compiler->apiCompiler = shaderc_compiler_initialize();
+    if(!compiler->apiCompiler)
+    {
+        printf("[SHADER_COMPILER]: Failed to initialize shaderc\n");
+        exit(-1);
+    }
+    compiler->cacheDir = cacheDir;
+    compiler->includeDir = includeDir;
+}
+
+void DestroyShaderCompiler(ShaderCompiler* compiler)
+{
+    if(compiler->apiCompiler) shaderc_compiler_release(compiler->apiCompiler);
+    *compiler = {};
+}
+
+// Reads a whole file, NUL terminated so it can also be scanned as text.
+static u8* ReadShaderFile(Arena* arena, const char* path, u64* outSize, u64 align = 1)
+{
+    *outSize = 0;
+    FILE* file = fopen(path, "rb");
+    if(!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    u64 size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* result = (u8*)ArenaPush(arena, size + 1, align);
+    u64 bytesRead = fread(result, 1, size, file);
+    fclose(file);
+    if(bytesRead != size) return NULL;
+    result[size] = 0;
+    *outSize = size;
+    return result;
+}
+
+static bool FileExists(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if(!file) return false;
+    fclose(file);
+    return true;
+}
+
+// Same resolution rules are used for cache key hashing and by the shaderc include callback,
+// so the key always covers exactly the files the compiler sees.
+static bool ResolveShaderInclude(ShaderCompiler* compiler, const char* requested, const char* requesting, bool relative,
+        char* outPath)
+{
+    if(relative)
+    {
+        // Relative to the including file's directory first
+        const char* dirEnd = requesting;
+        for(const char* c = requesting; *c; c++)
+        {
+            if(*c == '/' || *c == '\\') dirEnd = c + 1;
+        }
+        snprintf(outPath, SHADER_MAX_PATH, "%.*s%s", (i32)(dirEnd - requesting), requesting, requested);
+        if(FileExists(outPath)) return true;
+    }
+    if(!compiler->includeDir) return false;
+    snprintf(outPath, SHADER_MAX_PATH, "%s%s", compiler->includeDir, requested);
+    return FileExists(outPath);
+}
+
+// Scans source text for #include directives and hashes the contents of every included file, recursively.
+// Includes that can't be resolved only hash their name: they may sit behind an inactive #if,
+// and if they are actually needed compilation fails anyway.
+static u64 HashShaderIncludes(ShaderCompiler* compiler, const char* path, const char* source, u32 depth, u64 hash)
+{
+    if(depth >= SHADER_MAX_INCLUDE_DEPTH) return hash;
+    const char* c = source;
+    while(*c)
+    {
+        // Start of line
+        while(*c == ' ' || *c == '\t') c++;
+        if(*c == '#')
+        {
+            c++;
+            while(*c == ' ' || *c == '\t') c++;
+            if(strncmp(c, "include", 7) == 0)
+            {
+                c += 7;
+                while(*c == ' ' || *c == '\t') c++;
+                char open = *c;
+                char close = open == '<' ? '>' : '"';
+                if(open == '<' || open == '"')
+                {
+                    const char* nameStart = ++c;
+                    while(*c && *c != close && *c != '\n') c++;
+                    char requested[SHADER_MAX_PATH];
+                    snprintf(requested, sizeof(requested), "%.*s", (i32)(c - nameStart), nameStart);
+
+                    char includePath[SHADER_MAX_PATH];
+                    hash = HashString(requested, hash);
+                    if(ResolveShaderInclude(compiler, requested, path, open == '"', includePath))
+                    {
+                        ScratchScope scratchScope(GetThreadScratchArena());
+                        u64 includeSize = 0;
+                        u8* include = ReadShaderFile(scratchScope.arena, includePath, &includeSize);
+                        if(include)
+                        {
+                            hash = Hash64(include, includeSize, hash);
+                            hash = HashShaderIncludes(compiler, includePath, (const char*)include, depth + 1, hash);
+                        }
+                    }
+                }
+            }
+        }
+        while(*c && *c != '\n') c++;
+        if(*c) c++;
+    }
+    return hash;
+}
+
+u64 GetShaderCacheKey(ShaderCompiler* compiler, ShaderCompileDesc* desc)
+{
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u64 sourceSize = 0;
+    u8* source = ReadShaderFile(scratchScope.arena, desc->sourcePath, &sourceSize);
+    if(!source) return 0;
+
+    u32 options[] =
+    {
+        SHADER_COMPILER_VERSION,
+        (u32)desc->stage,
+        desc->optimize,
+        desc->debugInfo,
+    };
+    u64 hash = Hash64(options, sizeof(options));
+    for(i32 i = 0; i < desc->defineCount; i++)
+    {
+        hash = HashString(desc->defines[i].name, hash);
+        hash = HashString(desc->defines[i].value ? desc->defines[i].value : "", hash);
+    }
+    hash = Hash64(source, sourceSize, hash);
+    hash = HashShaderIncludes(compiler, desc->sourcePath, (const char*)source, 0, hash);
+    return hash ? hash : 1;
+}
+
+static void GetShaderCachePath(ShaderCompiler* compiler, u64 key, char* outPath)
+{
+    snprintf(outPath, SHADER_MAX_PATH, "%s%016llx.spv", compiler->cacheDir, (unsigned long long)key);
+}
+
+// shaderc include callbacks. Compilation runs the callbacks on the compiling thread,
+// so results live in that thread's scratch arena and are released with its scope.
+static shaderc_include_result* ShaderIncludeResolve(void* userData, const char* requested, int type,
+        const char* requesting, size_t depth)
+{
+    ShaderCompiler* compiler = (ShaderCompiler*)userData;
+    Arena* scratch = GetThreadScratchArena();
+    shaderc_include_result* result = ARENA_PUSH_STRUCT(scratch, shaderc_include_result);
+    *result = {};
+
+    char* includePath = ARENA_PUSH_ARRAY(scratch, char, SHADER_MAX_PATH);
+    u64 includeSize = 0;
+    u8* include = NULL;
+    if(ResolveShaderInclude(compiler, requested, requesting, type == shaderc_include_type_relative, includePath))
+    {
+        include = ReadShaderFile(scratch, includePath, &includeSize);
+    }
+    if(!include)
+    {
+        // Failed inclusion: empty source name, error message as content
+        char* error = ARENA_PUSH_ARRAY(scratch, char, SHADER_MAX_PATH);
+        snprintf(error, SHADER_MAX_PATH, "Could not open include file %s", requested);
+        result->source_name = "";
+        result->content = error;
+        result->content_length = strlen(error);
+        return result;
+    }
+    result->source_name = includePath;
+    result->source_name_length = strlen(includePath);
+    result->content = (const char*)include;
+    result->content_length = includeSize;
+    return result;
+}
+
+static void ShaderIncludeRelease(void* userData, shaderc_include_result* result)
+{
+    // Nothing to do, freed with the compile's scratch scope
+}
+
+bool CompileShaderToCache(ShaderCompiler* compiler, ShaderCompileDesc* desc, u64* outKey)
+{
+    u64 key = GetShaderCacheKey(compiler, desc);
+    *outKey = key;
+    if(!key)
+    {
+        printf("[SHADER_COMPILER]: Failed to read %s\n", desc->sourcePath);
+        PlatformAtomicIncrement(&compiler->failures);
+        return false;
+    }
+    char cachePath[SHADER_MAX_PATH];
+    GetShaderCachePath(compiler, key, cachePath);
+    if(FileExists(cachePath))
+    {
+        PlatformAtomicIncrement(&compiler->cacheHits);
+        return true;
+    }
+    PlatformAtomicIncrement(&compiler->cacheMisses);
+
+    ScratchScope scratchScope(GetThreadScratchArena());
+    u64 sourceSize = 0;
+    u8* source = ReadShaderFile(scratchScope.arena, desc->sourcePath, &sourceSize);
+    if(!source)
+    {
+        printf("[SHADER_COMPILER]: Failed to read %s\n", desc->sourcePath);
+        PlatformAtomicIncrement(&compiler->failures);
+        return false;
+    }
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    for(i32 i = 0; i < desc->defineCount; i++)
+    {
+        ShaderDefine* define = &desc->defines[i];
+        shaderc_compile_options_add_macro_definition(options,
+                define->name, strlen(define->name),
+                define->value, define->value ? strlen(define->value) : 0);
+    }
+    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+    shaderc_compile_options_set_optimization_level(options,
+            desc->optimize ? shaderc_optimization_level_performance : shaderc_optimization_level_zero);
+    if(desc->debugInfo) shaderc_compile_options_set_generate_debug_info(options);
+    shaderc_compile_options_set_include_callbacks(options, ShaderIncludeResolve, ShaderIncludeRelease, compiler);
+
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler->apiCompiler,
+            (const char*)source, sourceSize, desc->stage, desc->sourcePath, "main", options);
+    shaderc_compile_options_release(options);
+
+    shaderc_compilation_status status = shaderc_result_get_compilation_status(result);
+    if(status != shaderc_compilation_status_success || shaderc_result_get_num_warnings(result))
+    {
+        printf("[SHADER_COMPILER]: %s\n", shaderc_result_get_error_message(result));
+    }
+    if(status != shaderc_compilation_status_success)
+    {
+        shaderc_result_release(result);
+        PlatformAtomicIncrement(&compiler->failures);
+        return false;
+    }
+
+    // Write to a per-thread temporary first, so a partially written file is never picked up as a cache hit.
+    // If another thread wins the rename, its output is identical and ours is discarded.
+    char tmpPath[SHADER_MAX_PATH];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.%lu.tmp", cachePath, (unsigned long)PlatformGetThreadId());
+    bool written = false;
+    FILE* file = fopen(tmpPath, "wb");
+    if(file)
+    {
+        u64 size = shaderc_result_get_length(result);
+        written = fwrite(shaderc_result_get_bytes(result), 1, size, file) == size;
+        written = (fclose(file) == 0) && written;
+    }
+    shaderc_result_release(result);
+    if(!written || rename(tmpPath, cachePath) != 0)
+    {
+        remove(tmpPath);
+        if(!FileExists(cachePath))
+        {
+            printf("[SHADER_COMPILER]: Failed to write %s\n", cachePath);
+            PlatformAtomicIncrement(&compiler->failures);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool LoadCachedShader(ShaderCompiler* compiler, u64 key, Arena* arena, ShaderBytecode* outBytecode)
+{
+    char cachePath[SHADER_MAX_PATH];
+    GetShaderCachePath(compiler, key, cachePath);
+    outBytecode->data = ReadShaderFile(arena, cachePath, &outBytecode->size, alignof(u32));
+    return outBytecode->data != NULL;
+}
+
+bool CompileShader(ShaderCompiler* compiler, ShaderCompileDesc* desc, Arena* arena, ShaderBytecode* outBytecode)
+{
+    *outBytecode = {};
+    u64 key = 0;
+    if(!CompileShaderToCache(compiler, desc, &key)) return false;
+    return LoadCachedShader(compiler, key, arena, outBytecode);
+}
+
+struct ShaderCompileJob
+{
+    ShaderCompiler* compiler = NULL;
+    ShaderCompileDesc* desc = NULL;
+    u64 key = 0;
+    bool success = false;
+};
+
+static void ShaderCompileJobProc(void* data)
+{
+    ShaderCompileJob* job = (ShaderCompileJob*)data;
+    job->success = CompileShaderToCache(job->compiler, job->desc, &job->key);
+}
+
+bool CompileShaders(ShaderCompiler* compiler, JobSystem* jobSystem, u32 count, ShaderCompileDesc* descs,
+        Arena* arena, ShaderBytecode* outBytecodes)
+{
+    // Job data is rolled back with the scratch scope, so arena can't be this thread's scratch arena.
+    ScratchScope scratchScope(GetThreadScratchArena());
+
+    // Workers only fill the disk cache, bytecode is then loaded on this thread
+    // since arenas are not thread safe.
+    ShaderCompileJob* jobs = ARENA_PUSH_ARRAY(scratchScope.arena, ShaderCompileJob, count);
+    for(i32 i = 0; i < count; i++)
+    {
+        jobs[i] = {};
+        jobs[i].compiler = compiler;
+        jobs[i].desc = &descs[i];
+        PushJob(jobSystem, ShaderCompileJobProc, &jobs[i]);
+    }
+    WaitForJobs(jobSystem);
+
+    bool result = true;
+    for(i32 i = 0; i < count; i++)
+    {
+        outBytecodes[i] = {};
+        if(!jobs[i].success || !LoadCachedShader(compiler, jobs[i].key, arena, &outBytecodes[i]))
+        {
+            result = false;
+        }
+    }
+    return result;
+}
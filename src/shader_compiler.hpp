@@ -0,0 +1,64 @@
+#pragma once
+#include <math.hpp>
+#include <memory.hpp>
+#include <jobs.hpp>
+#include <shaderc/shaderc.h>
+
+// ========================================================
+// [SHADER COMPILER]
+// Runtime GLSL to SPIR-V compilation through shaderc, backed by a content-addressed disk cache.
+// The cache key hashes the source, every (recursively) included file, the stage, defines and
+// compile options, so unchanged shaders are loaded from <cacheDir>/<key>.spv and never recompiled.
+#define SHADER_COMPILER_VERSION     1       // Bump to invalidate all cached SPIR-V
+#define SHADER_MAX_DEFINES          16
+#define SHADER_MAX_INCLUDE_DEPTH    16
+#define SHADER_MAX_PATH             256
+
+struct ShaderDefine
+{
+    const char* name = NULL;
+    const char* value = NULL;       // NULL defines the macro with no value
+};
+
+// One permutation of a shader source.
+struct ShaderCompileDesc
+{
+    const char* sourcePath = NULL;
+    shaderc_shader_kind stage = shaderc_vertex_shader;
+    u32 defineCount = 0;
+    ShaderDefine defines[SHADER_MAX_DEFINES];
+    bool optimize = false;
+    bool debugInfo = true;
+};
+
+struct ShaderBytecode
+{
+    u8* data = NULL;
+    u64 size = 0;
+};
+
+struct ShaderCompiler
+{
+    shaderc_compiler_t apiCompiler = NULL;      // Safe to use from multiple threads at once
+    const char* cacheDir = NULL;                // Must end with a path separator
+    const char* includeDir = NULL;              // Searched for #include <...>, and for "..." not found next to the includer
+
+    // Stats
+    volatile i32 cacheHits = 0;
+    volatile i32 cacheMisses = 0;
+    volatile i32 failures = 0;
+};
+
+void InitShaderCompiler(ShaderCompiler* compiler, const char* cacheDir, const char* includeDir);
+void DestroyShaderCompiler(ShaderCompiler* compiler);
+
+// Returns 0 if the source or one of its includes can't be read.
+u64 GetShaderCacheKey(ShaderCompiler* compiler, ShaderCompileDesc* desc);
+// Compiles to the disk cache if there is no entry for the shader yet. Thread safe.
+bool CompileShaderToCache(ShaderCompiler* compiler, ShaderCompileDesc* desc, u64* outKey);
+// Compiles (or loads from cache) a single shader, bytecode is allocated from arena.
+bool CompileShader(ShaderCompiler* compiler, ShaderCompileDesc* desc, Arena* arena, ShaderBytecode* outBytecode);
+// Compiles a set of shaders/permutations in parallel on the job system, then loads all of them.
+// Returns false if any of them failed, failed entries are left empty.
+bool CompileShaders(ShaderCompiler* compiler, JobSystem* jobSystem, u32 count, ShaderCompileDesc* descs,
+        Arena* arena, ShaderBytecode* outBytecodes);
@@ -0,0 +1,61 @@
+#include <shader_optimizer.hpp>
+#include <spirv-tools/optimizer.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define SPIRV_MAGIC             0x07230203
+#define SPIRV_HEADER_WORDS      5
+
+u32 CountSpirvInstructions(ShaderBytecode bytecode)
+{
+    const u32* words = (const u32*)bytecode.data;
+    u64 wordCount = bytecode.size / sizeof(u32);
+    if(wordCount < SPIRV_HEADER_WORDS || words[0] != SPIRV_MAGIC) return 0;
+
+    // Each instruction's first word holds its word count in the high 16 bits.
+    u32 result = 0;
+    u64 i = SPIRV_HEADER_WORDS;
+    while(i < wordCount)
+    {
+        u32 instructionWords = words[i] >> 16;
+        if(!instructionWords) return 0;
+        i += instructionWords;
+        result++;
+    }
+    return i == wordCount ? result : 0;
+}
+
+bool OptimizeShader(ShaderBytecode bytecode, bool stripDebugInfo, Arena* arena,
+        ShaderBytecode* outBytecode, ShaderOptimizeStats* outStats)
+{
+    *outStats = {};
+    outStats->instructionCountBefore = CountSpirvInstructions(bytecode);
+    outStats->sizeBefore = bytecode.size;
+
+    spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_1);
+    optimizer.SetMessageConsumer([](spv_message_level_t level, const char* source,
+                const spv_position_t& position, const char* message)
+            {
+                if(level > SPV_MSG_WARNING) return;
+                printf("[SHADER_OPTIMIZER]: %s (word %llu)\n", message, (unsigned long long)position.index);
+            });
+    if(stripDebugInfo)
+    {
+        // Before the performance passes, so names and line info don't hold on to dead code.
+        optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+        optimizer.RegisterPass(spvtools::CreateStripNonSemanticInfoPass());
+    }
+    optimizer.RegisterPerformancePasses();
+
+    std::vector<u32> optimized;
+    if(!optimizer.Run((const u32*)bytecode.data, bytecode.size / sizeof(u32), &optimized)) return false;
+
+    outBytecode->size = optimized.size() * sizeof(u32);
+    outBytecode->data = (u8*)ArenaPush(arena, outBytecode->size, alignof(u32));
+    memcpy(outBytecode->data, optimized.data(), outBytecode->size);
+
+    outStats->instructionCountAfter = CountSpirvInstructions(*outBytecode);
+    outStats->sizeAfter = outBytecode->size;
+    return true;
+}
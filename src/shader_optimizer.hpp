@@ -0,0 +1,23 @@
+#pragma once
+#include <math.hpp>
+#include <memory.hpp>
+#include <shader_compiler.hpp>
+
+// ========================================================
+// [SHADER OPTIMIZER]
+// Release stage for SPIR-V: spirv-tools performance passes, optionally stripping debug info.
+// Kept apart from the shader compiler so the app doesn't link spirv-tools, only tools/shader_builder does.
+struct ShaderOptimizeStats
+{
+    u32 instructionCountBefore = 0;
+    u32 instructionCountAfter = 0;
+    u64 sizeBefore = 0;
+    u64 sizeAfter = 0;
+};
+
+// Number of instructions in a SPIR-V module, 0 if the module is malformed.
+u32 CountSpirvInstructions(ShaderBytecode bytecode);
+
+// Optimized bytecode is allocated from arena. On failure the input is left untouched and false is returned.
+bool OptimizeShader(ShaderBytecode bytecode, bool stripDebugInfo, Arena* arena,
+        ShaderBytecode* outBytecode, ShaderOptimizeStats* outStats);
@@ -0,0 +1,193 @@
+#include <shader_reflection.hpp>
+#include <spirv_cross/spirv_cross_c.h>
+#include <stdio.h>
+
+struct ReflectedResourceType
+{
+    spvc_resource_type resourceType;
+    VkDescriptorType descriptorType;
+};
+static ReflectedResourceType reflectedResourceTypes[] =
+{
+    {SPVC_RESOURCE_TYPE_UNIFORM_BUFFER,     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER},
+    {SPVC_RESOURCE_TYPE_STORAGE_BUFFER,     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+    {SPVC_RESOURCE_TYPE_SAMPLED_IMAGE,      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER},
+    {SPVC_RESOURCE_TYPE_SEPARATE_IMAGE,     VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE},
+    {SPVC_RESOURCE_TYPE_SEPARATE_SAMPLERS,  VK_DESCRIPTOR_TYPE_SAMPLER},
+    {SPVC_RESOURCE_TYPE_STORAGE_IMAGE,      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+};
+
+static VkShaderStageFlagBits GetReflectedStage(SpvExecutionModel model)
+{
+    switch(model)
+    {
+        case SpvExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+        case SpvExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case SpvExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: return VK_SHADER_STAGE_ALL;
+    }
+}
+
+// Keeps bindings sorted, so identical sets always produce identical binding arrays (and layout hashes).
+static bool AddReflectedBinding(ShaderReflectionSet* set, VkDescriptorSetLayoutBinding binding, bool isRuntimeArray)
+{
+    i32 insert = set->bindingCount;
+    for(i32 i = 0; i < set->bindingCount; i++)
+    {
+        VkDescriptorSetLayoutBinding* existing = &set->bindings[i];
+        if(existing->binding == binding.binding)
+        {
+            if(existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount) return false;
+            existing->stageFlags |= binding.stageFlags;
+            return true;
+        }
+        if(existing->binding > binding.binding)
+        {
+            insert = i;
+            break;
+        }
+    }
+    if(set->bindingCount >= SHADER_REFLECTION_MAX_BINDINGS) return false;
+    for(i32 i = set->bindingCount; i > insert; i--)
+    {
+        set->bindings[i] = set->bindings[i - 1];
+        set->isRuntimeArray[i] = set->isRuntimeArray[i - 1];
+    }
+    set->bindings[insert] = binding;
+    set->isRuntimeArray[insert] = isRuntimeArray;
+    set->bindingCount++;
+    return true;
+}
+
+bool ReflectShader(const u8* bytecode, u64 bytecodeSize, ShaderReflection* outReflection)
+{
+    *outReflection = {};
+    spvc_context context = NULL;
+    if(spvc_context_create(&context) != SPVC_SUCCESS) return false;
+
+    bool result = false;
+    spvc_parsed_ir ir = NULL;
+    spvc_compiler compiler = NULL;
+    spvc_resources resources = NULL;
+    if(spvc_context_parse_spirv(context, (const SpvId*)bytecode, bytecodeSize / sizeof(SpvId), &ir) != SPVC_SUCCESS
+            || spvc_context_create_compiler(context, SPVC_BACKEND_NONE, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler) != SPVC_SUCCESS
+            || spvc_compiler_create_shader_resources(compiler, &resources) != SPVC_SUCCESS)
+    {
+        printf("[SHADER_REFLECTION]: %s\n", spvc_context_get_last_error_string(context));
+        spvc_context_destroy(context);
+        return false;
+    }
+    VkShaderStageFlagBits stage = GetReflectedStage(spvc_compiler_get_execution_model(compiler));
+
+    result = true;
+    for(i32 t = 0; t < sizeof(reflectedResourceTypes) / sizeof(reflectedResourceTypes[0]); t++)
+    {
+        const spvc_reflected_resource* list = NULL;
+        size_t count = 0;
+        spvc_resources_get_resource_list_for_type(resources, reflectedResourceTypes[t].resourceType, &list, &count);
+        for(i32 i = 0; i < count; i++)
+        {
+            u32 set = spvc_compiler_get_decoration(compiler, list[i].id, SpvDecorationDescriptorSet);
+            if(set >= SHADER_REFLECTION_MAX_SETS)
+            {
+                printf("[SHADER_REFLECTION]: %s uses set %u, max is %u\n", list[i].name, set, SHADER_REFLECTION_MAX_SETS - 1);
+                result = false;
+                continue;
+            }
+
+            // Arrays of descriptors: literal size, or 0 for runtime (unsized) arrays.
+            u32 descriptorCount = 1;
+            spvc_type type = spvc_compiler_get_type_handle(compiler, list[i].type_id);
+            for(u32 d = 0; d < spvc_type_get_num_array_dimensions(type); d++)
+            {
+                if(!spvc_type_array_dimension_is_literal(type, d))
+                {
+                    printf("[SHADER_REFLECTION]: %s is sized by a specialization constant, not supported\n", list[i].name);
+                    result = false;
+                }
+                descriptorCount *= spvc_type_get_array_dimension(type, d);
+            }
+
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding = spvc_compiler_get_decoration(compiler, list[i].id, SpvDecorationBinding);
+            binding.descriptorType = reflectedResourceTypes[t].descriptorType;
+            binding.descriptorCount = descriptorCount;
+            binding.stageFlags = stage;
+            if(!AddReflectedBinding(&outReflection->sets[set], binding, descriptorCount == 0))
+            {
+                printf("[SHADER_REFLECTION]: Conflicting or too many bindings in set %u\n", set);
+                result = false;
+                continue;
+            }
+            outReflection->setCount = MAX(outReflection->setCount, set + 1);
+        }
+    }
+
+    // Only one push constant block per stage. Range covers the whole block from offset 0.
+    const spvc_reflected_resource* pushConstants = NULL;
+    size_t pushConstantCount = 0;
+    spvc_resources_get_resource_list_for_type(resources, SPVC_RESOURCE_TYPE_PUSH_CONSTANT, &pushConstants, &pushConstantCount);
+    if(pushConstantCount)
+    {
+        size_t size = 0;
+        spvc_compiler_get_declared_struct_size(compiler, spvc_compiler_get_type_handle(compiler, pushConstants[0].base_type_id), &size);
+        outReflection->pushConstantRange.stageFlags = stage;
+        outReflection->pushConstantRange.offset = 0;
+        outReflection->pushConstantRange.size = (u32)size;
+    }
+
+    spvc_context_destroy(context);
+    return result;
+}
+
+bool MergeShaderReflection(ShaderReflection* dst, ShaderReflection* src)
+{
+    for(i32 s = 0; s < src->setCount; s++)
+    {
+        ShaderReflectionSet* srcSet = &src->sets[s];
+        for(i32 b = 0; b < srcSet->bindingCount; b++)
+        {
+            if(!AddReflectedBinding(&dst->sets[s], srcSet->bindings[b], srcSet->isRuntimeArray[b])) return false;
+        }
+    }
+    dst->setCount = MAX(dst->setCount, src->setCount);
+
+    // Single range for all stages, sized for the largest block
+    if(src->pushConstantRange.size)
+    {
+        dst->pushConstantRange.stageFlags |= src->pushConstantRange.stageFlags;
+        dst->pushConstantRange.size = MAX(dst->pushConstantRange.size, src->pushConstantRange.size);
+    }
+    return true;
+}
+
+bool HasRuntimeArray(ShaderReflectionSet* set)
+{
+    for(i32 i = 0; i < set->bindingCount; i++)
+    {
+        if(set->isRuntimeArray[i]) return true;
+    }
+    return false;
+}
+
+u32 GetDescriptorPoolSizes(ShaderReflectionSet* set, u32 setCount, VkDescriptorPoolSize* outPoolSizes)
+{
+    u32 result = 0;
+    for(i32 i = 0; i < set->bindingCount; i++)
+    {
+        VkDescriptorSetLayoutBinding* binding = &set->bindings[i];
+        if(!binding->descriptorCount) continue;     // Runtime arrays are sized by whoever creates their layout
+        i32 match = -1;
+        for(i32 j = 0; j < result; j++)
+        {
+            if(outPoolSizes[j].type == binding->descriptorType) match = j;
+        }
+        if(match == -1)
+        {
+            match = result++;
+            outPoolSizes[match] = { binding->descriptorType, 0 };
+        }
+        outPoolSizes[match].descriptorCount += binding->descriptorCount * setCount;
+    }
+    return result;
+}
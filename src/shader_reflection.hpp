@@ -0,0 +1,33 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <math.hpp>
+
+// ========================================================
+// [SHADER REFLECTION]
+// Descriptor bindings and push constants read from SPIR-V through spirv_cross,
+// so descriptor set layouts, pipeline layouts and pool sizes don't have to be written by hand.
+#define SHADER_REFLECTION_MAX_SETS      4
+#define SHADER_REFLECTION_MAX_BINDINGS  16
+
+struct ShaderReflectionSet
+{
+    u32 bindingCount = 0;
+    VkDescriptorSetLayoutBinding bindings[SHADER_REFLECTION_MAX_BINDINGS];     // Sorted by binding, no immutable samplers
+    bool isRuntimeArray[SHADER_REFLECTION_MAX_BINDINGS];                       // Unsized array, descriptorCount is 0
+};
+
+struct ShaderReflection
+{
+    u32 setCount = 0;       // Highest used set + 1, sets in between may be empty
+    ShaderReflectionSet sets[SHADER_REFLECTION_MAX_SETS];
+    VkPushConstantRange pushConstantRange = {};     // Size 0 if no stage uses push constants
+};
+
+// Stage is taken from the module's entry point.
+bool ReflectShader(const u8* bytecode, u64 bytecodeSize, ShaderReflection* outReflection);
+// Merges src into dst, combining stage flags of bindings used by both.
+// Returns false if stages declare the same binding differently.
+bool MergeShaderReflection(ShaderReflection* dst, ShaderReflection* src);
+bool HasRuntimeArray(ShaderReflectionSet* set);
+// Exact pool sizes for allocating setCount sets with this layout. Returns pool size count.
+u32 GetDescriptorPoolSizes(ShaderReflectionSet* set, u32 setCount, VkDescriptorPoolSize* outPoolSizes);
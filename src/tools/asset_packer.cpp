@@ -0,0 +1,238 @@
+// Asset packer: builds a packed asset archive (see asset_archive.hpp) from loose files.
+// Usage: asset_packer [-c] <output archive> <input files...>
+//      -c      Compress entries when that makes them smaller. Shaders are always stored
+//              uncompressed so they can be consumed in place from the mapped archive.
+// Entries are named after the input file name, without directories.
+// Shaders (.spv) and meshes (.mesh) are stored as is, images are decoded and stored as pre-baked RGBA8 pixels.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <math.hpp>
+#include <hash.hpp>
+#include <asset_archive.hpp>
+
+#include <hash.cpp>
+#include <asset_archive.cpp>
+
+struct PackerInput
+{
+    const char* path;
+    AssetArchiveEntry entry;
+    u8* data;           // Blob as stored in the archive
+};
+
+static const char* GetFileName(const char* path)
+{
+    const char* result = path;
+    for(const char* c = path; *c; c++)
+    {
+        if(*c == '/' || *c == '\\') result = c + 1;
+    }
+    return result;
+}
+
+static bool HasExtension(const char* path, const char* ext)
+{
+    u64 pathLen = strlen(path);
+    u64 extLen = strlen(ext);
+    return pathLen >= extLen && strcmp(path + pathLen - extLen, ext) == 0;
+}
+
+static u8* ReadWholeFile(const char* path, u64* outSize)
+{
+    FILE* file = fopen(path, "rb");
+    if(!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    u64 size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    u8* data = (u8*)malloc(size ? size : 1);
+    if(fread(data, 1, size, file) != size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *outSize = size;
+    return data;
+}
+
+static int CompareEntries(const void* a, const void* b)
+{
+    const PackerInput* ia = (const PackerInput*)a;
+    const PackerInput* ib = (const PackerInput*)b;
+    if(ia->entry.nameHash != ib->entry.nameHash) return ia->entry.nameHash < ib->entry.nameHash ? -1 : 1;
+    return strcmp(ia->entry.name, ib->entry.name);
+}
+
+static bool LoadInput(PackerInput* input, bool compress)
+{
+    const char* name = GetFileName(input->path);
+    if(strlen(name) >= ASSET_ARCHIVE_MAX_NAME)
+    {
+        fprintf(stderr, "Asset name too long: %s\n", name);
+        return false;
+    }
+    AssetArchiveEntry* entry = &input->entry;
+    *entry = {};
+    strncpy(entry->name, name, ASSET_ARCHIVE_MAX_NAME);
+    entry->nameHash = HashString(entry->name);
+
+    u8* blob = NULL;
+    u64 blobSize = 0;
+    if(HasExtension(name, ".spv"))
+    {
+        entry->type = ASSET_TYPE_SHADER;
+        blob = ReadWholeFile(input->path, &blobSize);
+        compress = false;
+    }
+    else if(HasExtension(name, ".png") || HasExtension(name, ".jpg")
+            || HasExtension(name, ".tga") || HasExtension(name, ".bmp"))
+    {
+        entry->type = ASSET_TYPE_TEXTURE;
+        i32 width, height, channels;
+        u8* pixels = stbi_load(input->path, &width, &height, &channels, STBI_rgb_alpha);
+        if(pixels)
+        {
+            AssetTextureHeader textureHeader = {};
+            textureHeader.width = (u32)width;
+            textureHeader.height = (u32)height;
+            textureHeader.channels = (u32)channels;
+            textureHeader.bytesPerPixel = 4;
+            u64 pixelsSize = (u64)width * (u64)height * 4;
+            blobSize = sizeof(AssetTextureHeader) + pixelsSize;
+            blob = (u8*)malloc(blobSize);
+            memcpy(blob, &textureHeader, sizeof(AssetTextureHeader));
+            memcpy(blob + sizeof(AssetTextureHeader), pixels, pixelsSize);
+            stbi_image_free(pixels);
+        }
+    }
+    else if(HasExtension(name, ".mesh"))
+    {
+        entry->type = ASSET_TYPE_MESH;
+        blob = ReadWholeFile(input->path, &blobSize);
+    }
+    else
+    {
+        entry->type = ASSET_TYPE_RAW;
+        blob = ReadWholeFile(input->path, &blobSize);
+    }
+    if(!blob)
+    {
+        fprintf(stderr, "Failed to load asset: %s\n", input->path);
+        return false;
+    }
+
+    entry->contentHash = Hash64(blob, blobSize);
+    entry->uncompressedSize = blobSize;
+    entry->size = blobSize;
+    entry->compression = ASSET_COMPRESSION_NONE;
+    input->data = blob;
+
+    if(compress && blobSize)
+    {
+        u64 compressedCapacity = AssetCompressBound(blobSize);
+        u8* compressed = (u8*)malloc(compressedCapacity);
+        u64 compressedSize = AssetCompress(blob, blobSize, compressed, compressedCapacity);
+        // Only worth it if it saves a meaningful amount, since compressed entries can't be used in place.
+        if(compressedSize && compressedSize < blobSize - blobSize / 8)
+        {
+            entry->compression = ASSET_COMPRESSION_LZ;
+            entry->size = compressedSize;
+            input->data = compressed;
+            free(blob);
+        }
+        else free(compressed);
+    }
+    return true;
+}
+
+static u64 AlignUp(u64 value, u64 align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+int main(int argc, char** argv)
+{
+    bool compress = false;
+    i32 argStart = 1;
+    if(argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        compress = true;
+        argStart++;
+    }
+    if(argc - argStart < 2)
+    {
+        fprintf(stderr, "Usage: asset_packer [-c] <output archive> <input files...>\n");
+        return 1;
+    }
+    const char* outputPath = argv[argStart];
+    u32 inputCount = (u32)(argc - argStart - 1);
+    PackerInput* inputs = (PackerInput*)calloc(inputCount, sizeof(PackerInput));
+    for(u32 i = 0; i < inputCount; i++)
+    {
+        inputs[i].path = argv[argStart + 1 + i];
+        if(!LoadInput(&inputs[i], compress)) return 1;
+    }
+    qsort(inputs, inputCount, sizeof(PackerInput), CompareEntries);
+    for(u32 i = 1; i < inputCount; i++)
+    {
+        if(strcmp(inputs[i].entry.name, inputs[i - 1].entry.name) == 0)
+        {
+            fprintf(stderr, "Duplicate asset name: %s\n", inputs[i].entry.name);
+            return 1;
+        }
+    }
+
+    // Assign blob offsets after header and table of contents
+    AssetArchiveHeader header = {};
+    header.entryCount = inputCount;
+    header.tocOffset = sizeof(AssetArchiveHeader);
+    u64 offset = AlignUp(header.tocOffset + inputCount * sizeof(AssetArchiveEntry), ASSET_ARCHIVE_BLOB_ALIGN);
+    for(u32 i = 0; i < inputCount; i++)
+    {
+        inputs[i].entry.offset = offset;
+        offset = AlignUp(offset + inputs[i].entry.size, ASSET_ARCHIVE_BLOB_ALIGN);
+    }
+    header.fileSize = offset;
+
+    FILE* out = fopen(outputPath, "wb");
+    if(!out)
+    {
+        fprintf(stderr, "Failed to open output: %s\n", outputPath);
+        return 1;
+    }
+    static const u8 padding[ASSET_ARCHIVE_BLOB_ALIGN] = {};
+    fwrite(&header, sizeof(header), 1, out);
+    for(u32 i = 0; i < inputCount; i++)
+    {
+        fwrite(&inputs[i].entry, sizeof(AssetArchiveEntry), 1, out);
+    }
+    u64 written = header.tocOffset + inputCount * sizeof(AssetArchiveEntry);
+    for(u32 i = 0; i < inputCount; i++)
+    {
+        fwrite(padding, 1, inputs[i].entry.offset - written, out);
+        fwrite(inputs[i].data, 1, inputs[i].entry.size, out);
+        written = inputs[i].entry.offset + inputs[i].entry.size;
+    }
+    fwrite(padding, 1, header.fileSize - written, out);
+    fclose(out);
+
+    u64 totalUncompressed = 0;
+    for(u32 i = 0; i < inputCount; i++)
+    {
+        AssetArchiveEntry* entry = &inputs[i].entry;
+        printf("%-40s %10llu -> %10llu bytes%s\n", entry->name,
+                (unsigned long long)entry->uncompressedSize, (unsigned long long)entry->size,
+                entry->compression == ASSET_COMPRESSION_LZ ? " (lz)" : "");
+        totalUncompressed += entry->uncompressedSize;
+        free(inputs[i].data);
+    }
+    printf("Packed %u assets into %s: %llu bytes (%llu uncompressed)\n", inputCount, outputPath,
+            (unsigned long long)header.fileSize, (unsigned long long)totalUncompressed);
+    free(inputs);
+    return 0;
+}
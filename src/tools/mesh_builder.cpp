@@ -0,0 +1,250 @@
+// Mesh builder: imports a mesh, welds and optimizes it for the GPU, and writes a mesh blob (see mesh.hpp).
+// Usage: mesh_builder [--no-optimize] [--no-split] [--overdraw-threshold T] [--lods N] [--lod-error E] <input .obj/.gltf/.glb> <output .mesh>
+//      --no-optimize           Keep the imported triangle and vertex order, to compare against.
+//      --no-split              Keep meshes over 64k vertices whole, with 32 bit indices.
+//      --overdraw-threshold    ACMR growth allowed when reordering for overdraw (default 1.05).
+//      --lods                  Levels of detail, including the full detail one (default 4, 1 disables simplification).
+//                              Each level targets half the triangles of the previous one.
+//      --lod-error             Largest deviation allowed for the coarsest level, relative to the mesh size (default 0.05).
+// Vertices are stored as float positions, packed 10:10:10:2 normals and half float texture coordinates (20 bytes).
+// Vertex cache efficiency (ACMR/ATVR) is reported before and after optimizing.
+// Indices are 16 bit when the mesh has at most 64k vertices. Larger meshes are split into chunks that fit,
+// unless the vertices duplicated along chunk boundaries cost more than the index bytes saved.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.hpp>
+#include <platform.hpp>
+#include <memory.hpp>
+#include <hash.hpp>
+#include <vertex_format.hpp>
+#include <mesh.hpp>
+
+#include <math.cpp>
+#include <platform.cpp>
+#include <memory.cpp>
+#include <hash.cpp>
+#include <vertex_format.cpp>
+#include <mesh.cpp>
+
+#define MESH_BUILDER_MAX_PATH 512
+
+static bool HasExtension(const char* path, const char* ext)
+{
+    u64 pathLen = strlen(path);
+    u64 extLen = strlen(ext);
+    return pathLen >= extLen && strcmp(path + pathLen - extLen, ext) == 0;
+}
+
+// Null terminated, so text formats can be parsed in place.
+static u8* ReadWholeFile(Arena* arena, const char* path, u64* outSize)
+{
+    FILE* file = fopen(path, "rb");
+    if(!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    u64 size = (u64)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    u8* data = ARENA_PUSH_ARRAY(arena, u8, size + 1);
+    bool result = fread(data, 1, size, file) == size;
+    fclose(file);
+    data[size] = 0;
+    *outSize = size;
+    return result ? data : NULL;
+}
+
+struct LodSettings
+{
+    u32 lodCount;
+    f32 lodError;
+    f32 maxError;
+    bool optimize;
+    f32 overdrawThreshold;
+};
+
+static void PrintVertexCacheStats(const char* label, const MeshData* mesh)
+{
+    VertexCacheStats fifo16 = AnalyzeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount, 16);
+    VertexCacheStats fifo32 = AnalyzeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount, 32);
+    printf("%-8s ACMR %.3f, ATVR %.3f (16 entry FIFO) | ACMR %.3f, ATVR %.3f (32 entry FIFO)\n",
+            label, fifo16.acmr, fifo16.atvr, fifo32.acmr, fifo32.atvr);
+}
+
+// Optimizes mesh and appends its LOD chain to its indices, each level simplified from the previous one.
+// Errors add up along the chain, so each level's error bounds its deviation from full detail.
+static void BuildMeshLods(MeshData* mesh, const LodSettings* settings, Arena* arena)
+{
+    PrintVertexCacheStats("Before:", mesh);
+    if(settings->optimize)
+    {
+        OptimizeVertexCache(mesh->indices, mesh->indexCount, mesh->vertexCount);
+        OptimizeOverdraw(mesh->indices, mesh->indexCount, mesh->vertices, mesh->vertexCount, settings->overdrawThreshold);
+        PrintVertexCacheStats("After:", mesh);
+    }
+
+    // Every level, accepted or not, is written after the last accepted one and is at most the full index count.
+    // Levels can stall well above half the previous one, so only that bound holds.
+    u32* lodIndices = ARENA_PUSH_ARRAY(arena, u32, (u64)mesh->indexCount * settings->lodCount);
+    memcpy(lodIndices, mesh->indices, mesh->indexCount * sizeof(u32));
+    mesh->lods[0] = { 0, mesh->indexCount, 0 };
+    mesh->lodCount = 1;
+    while(mesh->lodCount < settings->lodCount)
+    {
+        const MeshLod* previous = &mesh->lods[mesh->lodCount - 1];
+        u32 target = (previous->indexCount / 6) * 3;
+        MeshLod lod = {};
+        lod.firstIndex = previous->firstIndex + previous->indexCount;
+        f32 error = 0;
+        lod.indexCount = SimplifyMesh(&lodIndices[previous->firstIndex], previous->indexCount, mesh->vertices, mesh->vertexCount,
+                target, settings->maxError - previous->error, &lodIndices[lod.firstIndex], &error);
+        // Not worth a level when simplification stalls (error budget spent, or everything left is locked)
+        if(!lod.indexCount || lod.indexCount > previous->indexCount - previous->indexCount / 5) break;
+        lod.error = previous->error + error;
+        if(settings->optimize) OptimizeVertexCache(&lodIndices[lod.firstIndex], lod.indexCount, mesh->vertexCount);
+        mesh->lods[mesh->lodCount++] = lod;
+    }
+    mesh->indices = lodIndices;
+    mesh->indexCount = mesh->lods[mesh->lodCount - 1].firstIndex + mesh->lods[mesh->lodCount - 1].indexCount;
+    if(settings->optimize) OptimizeVertexFetch(mesh);
+    for(u32 i = 0; i < mesh->lodCount; i++)
+    {
+        const MeshLod* lod = &mesh->lods[i];
+        VertexCacheStats stats = AnalyzeVertexCache(&mesh->indices[lod->firstIndex], lod->indexCount, mesh->vertexCount);
+        printf("LOD %u:    %u triangles, error %.6f (%.3f%% of size), ACMR %.3f\n", i, lod->indexCount / 3, lod->error,
+                settings->maxError > 0 ? 100.f * lod->error * settings->lodError / settings->maxError : 0.f, stats.acmr);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool optimize = true;
+    bool split = true;
+    f32 overdrawThreshold = 1.05f;
+    u32 lodCount = 4;
+    f32 lodError = 0.05f;
+    i32 argStart = 1;
+    while(argStart < argc && strncmp(argv[argStart], "--", 2) == 0)
+    {
+        if(strcmp(argv[argStart], "--no-optimize") == 0) optimize = false;
+        else if(strcmp(argv[argStart], "--no-split") == 0) split = false;
+        else if(strcmp(argv[argStart], "--overdraw-threshold") == 0 && argStart + 1 < argc) overdrawThreshold = (f32)atof(argv[++argStart]);
+        else if(strcmp(argv[argStart], "--lods") == 0 && argStart + 1 < argc) lodCount = (u32)atoi(argv[++argStart]);
+        else if(strcmp(argv[argStart], "--lod-error") == 0 && argStart + 1 < argc) lodError = (f32)atof(argv[++argStart]);
+        else break;
+        argStart++;
+    }
+    if(argc - argStart != 2)
+    {
+        fprintf(stderr, "Usage: mesh_builder [--no-optimize] [--no-split] [--overdraw-threshold T] [--lods N] [--lod-error E] <input .obj/.gltf/.glb> <output .mesh>\n");
+        return 1;
+    }
+    const char* inputPath = argv[argStart];
+    const char* outputPath = argv[argStart + 1];
+
+    lodCount = CLAMP(lodCount, 1, MESH_MAX_LODS);
+
+    Arena arena;
+    InitArena(&arena, "mesh_builder", GB(16));
+    u64 inputSize = 0;
+    u8* input = ReadWholeFile(&arena, inputPath, &inputSize);
+    if(!input)
+    {
+        fprintf(stderr, "Failed to read input: %s\n", inputPath);
+        return 1;
+    }
+
+    MeshData mesh = {};
+    bool loaded = false;
+    if(HasExtension(inputPath, ".obj"))
+    {
+        loaded = LoadObjMesh((const char*)input, inputSize, &arena, &mesh);
+    }
+    else if(HasExtension(inputPath, ".gltf") || HasExtension(inputPath, ".glb"))
+    {
+        char directory[MESH_BUILDER_MAX_PATH];
+        snprintf(directory, sizeof(directory), "%s", inputPath);
+        char* lastSlash = NULL;
+        for(char* c = directory; *c; c++)
+        {
+            if(*c == '/' || *c == '\\') lastSlash = c;
+        }
+        if(lastSlash) *lastSlash = 0;
+        else snprintf(directory, sizeof(directory), ".");
+        loaded = LoadGltfMesh(input, inputSize, directory, &arena, &mesh);
+    }
+    else
+    {
+        fprintf(stderr, "Unknown mesh format: %s\n", inputPath);
+        return 1;
+    }
+    if(!loaded)
+    {
+        fprintf(stderr, "Failed to import: %s\n", inputPath);
+        return 1;
+    }
+    printf("Imported %s: %u vertices, %u triangles\n", inputPath, mesh.vertexCount, mesh.indexCount / 3);
+
+    const VertexFormat formats[] = { VERTEX_FORMAT_R32G32B32_FLOAT, VERTEX_FORMAT_A2B10G10R10_UNORM, VERTEX_FORMAT_R16G16_FLOAT };
+    u32 vertexStride = 0;
+    for(u32 i = 0; i < MESH_ATTRIBUTE_COUNT; i++) vertexStride += vertexFormatSizeInBytes[formats[i]];
+
+    LodSettings lodSettings = {};
+    lodSettings.lodCount = lodCount;
+    lodSettings.lodError = lodError;
+    lodSettings.optimize = optimize;
+    lodSettings.overdrawThreshold = overdrawThreshold;
+    v3f boundsMin, boundsMax;
+    GetMeshBounds(&mesh, &boundsMin, &boundsMax);
+    v3f extents = boundsMax - boundsMin;
+    lodSettings.maxError = lodError * MAX(extents.x, MAX(extents.y, extents.z));
+
+    // Chunks over 64k vertices need 32 bit indices
+    MeshData* chunks = &mesh;
+    u32 chunkCount = 1;
+    if(split && mesh.vertexCount > MESH_CHUNK_MAX_VERTICES)
+    {
+        if(optimize) OptimizeVertexCache(mesh.indices, mesh.indexCount, mesh.vertexCount);
+        MeshData* splitChunks = NULL;
+        u32 splitChunkCount = SplitMesh(&mesh, MESH_CHUNK_MAX_VERTICES, &arena, &splitChunks);
+        u64 splitVertexCount = 0;
+        for(u32 i = 0; i < splitChunkCount; i++) splitVertexCount += splitChunks[i].vertexCount;
+        u64 duplicatedBytes = (splitVertexCount - mesh.vertexCount) * vertexStride;
+        u64 savedBytes = (u64)mesh.indexCount * (sizeof(u32) - sizeof(u16));
+        printf("Split:   %u chunks, %llu duplicated vertices (%llu bytes) for %llu index bytes saved%s\n", splitChunkCount,
+                (unsigned long long)(splitVertexCount - mesh.vertexCount), (unsigned long long)duplicatedBytes,
+                (unsigned long long)savedBytes, duplicatedBytes < savedBytes ? "" : ", not worth it");
+        if(duplicatedBytes < savedBytes)
+        {
+            chunks = splitChunks;
+            chunkCount = splitChunkCount;
+        }
+    }
+    for(u32 i = 0; i < chunkCount; i++)
+    {
+        if(chunkCount > 1) printf("Chunk %u: %u vertices, %u triangles\n", i, chunks[i].vertexCount, chunks[i].indexCount / 3);
+        BuildMeshLods(&chunks[i], &lodSettings, &arena);
+    }
+
+    const char* attributeNames[] = { "position", "normal", "texcoord" };
+    QuantizeError errors[MESH_ATTRIBUTE_COUNT];
+    u8* blob = NULL;
+    u64 blobSize = WriteMeshBlob(chunks, chunkCount, formats, &arena, &blob, errors);
+    for(u32 i = 0; i < MESH_ATTRIBUTE_COUNT; i++)
+    {
+        printf("%-8s %s: max error %.6f, rms %.6f, %u clamped\n", attributeNames[i], vertexFormatNames[formats[i]],
+                errors[i].maxError, errors[i].rmsError, errors[i].clampedCount);
+    }
+
+    FILE* out = fopen(outputPath, "wb");
+    if(!out || fwrite(blob, 1, blobSize, out) != blobSize)
+    {
+        fprintf(stderr, "Failed to write output: %s\n", outputPath);
+        return 1;
+    }
+    fclose(out);
+    const MeshBlobHeader* header = (const MeshBlobHeader*)blob;
+    printf("Wrote %s: %llu bytes (%u byte vertices, %u bit indices, %u chunks)\n", outputPath, (unsigned long long)blobSize,
+            header->vertexStride, header->indexSize * 8, header->chunkCount);
+    DestroyArena(&arena);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Shader builder: compiles GLSL sources for release, running the spirv-tools optimizer on the output.
+// Usage: shader_builder [-g] <output dir> <source files...>
+//      -g      Keep debug info (stripped by default).
+// Sources are compiled with the same options as the app's debug runtime compilation (see shader_compiler.hpp),
+// then optimized. Output files follow the app's naming: name.vert -> name_vs.spv, name.frag -> name_ps.spv.
+// Prints instruction count and size before/after optimization for every shader.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <math.hpp>
+#include <platform.hpp>
+#include <memory.hpp>
+#include <jobs.hpp>
+#include <hash.hpp>
+#include <shader_compiler.hpp>
+#include <shader_optimizer.hpp>
+
+#include <platform.cpp>
+#include <memory.cpp>
+#include <jobs.cpp>
+#include <hash.cpp>
+#include <shader_compiler.cpp>
+#include <shader_optimizer.cpp>
+
+static bool HasExtension(const char* path, const char* ext)
+{
+    u64 pathLen = strlen(path);
+    u64 extLen = strlen(ext);
+    return pathLen >= extLen && strcmp(path + pathLen - extLen, ext) == 0;
+}
+
+static bool WriteWholeFile(const char* path, ShaderBytecode bytecode)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    bool result = fwrite(bytecode.data, 1, bytecode.size, file) == bytecode.size;
+    return (fclose(file) == 0) && result;
+}
+
+int main(int argc, char** argv)
+{
+    bool stripDebugInfo = true;
+    i32 argIndex = 1;
+    if(argIndex < argc && strcmp(argv[argIndex], "-g") == 0)
+    {
+        stripDebugInfo = false;
+        argIndex++;
+    }
+    if(argc - argIndex < 2)
+    {
+        printf("Usage: shader_builder [-g] <output dir> <source files...>\n");
+        return 1;
+    }
+    const char* outputDir = argv[argIndex++];
+
+    char cacheDir[SHADER_MAX_PATH];
+    snprintf(cacheDir, sizeof(cacheDir), "%s/shader_cache/", outputDir);
+    PlatformCreateDirectory(outputDir);
+    PlatformCreateDirectory(cacheDir);
+
+    ShaderCompiler compiler;
+    InitShaderCompiler(&compiler, cacheDir, NULL);
+    Arena arena;
+    InitArena(&arena, "shader_builder", GB(1));
+
+    printf("%-40s %12s %12s %12s %12s\n", "shader", "instr before", "instr after", "bytes before", "bytes after");
+    ShaderOptimizeStats totals = {};
+    i32 failures = 0;
+    for(; argIndex < argc; argIndex++)
+    {
+        const char* sourcePath = argv[argIndex];
+        ScratchScope scope(&arena);
+
+        ShaderCompileDesc desc = {};
+        desc.sourcePath = sourcePath;
+        const char* suffix = NULL;
+        if(HasExtension(sourcePath, ".vert"))
+        {
+            desc.stage = shaderc_vertex_shader;
+            suffix = "_vs.spv";
+        }
+        else if(HasExtension(sourcePath, ".frag"))
+        {
+            desc.stage = shaderc_fragment_shader;
+            suffix = "_ps.spv";
+        }
+        else
+        {
+            printf("[SHADER_BUILDER]: Unknown shader stage for %s\n", sourcePath);
+            failures++;
+            continue;
+        }
+
+        ShaderBytecode bytecode;
+        ShaderBytecode optimized;
+        ShaderOptimizeStats stats;
+        if(!CompileShader(&compiler, &desc, &arena, &bytecode)
+                || !OptimizeShader(bytecode, stripDebugInfo, &arena, &optimized, &stats))
+        {
+            printf("[SHADER_BUILDER]: Failed to build %s\n", sourcePath);
+            failures++;
+            continue;
+        }
+
+        // Output name: source file name without extension, plus stage suffix
+        const char* name = sourcePath;
+        for(const char* c = sourcePath; *c; c++)
+        {
+            if(*c == '/' || *c == '\\') name = c + 1;
+        }
+        const char* ext = strrchr(name, '.');
+        char outputPath[SHADER_MAX_PATH];
+        snprintf(outputPath, sizeof(outputPath), "%s/%.*s%s", outputDir, (i32)(ext - name), name, suffix);
+        if(!WriteWholeFile(outputPath, optimized))
+        {
+            printf("[SHADER_BUILDER]: Failed to write %s\n", outputPath);
+            failures++;
+            continue;
+        }
+
+        printf("%-40s %12u %12u %12llu %12llu\n", outputPath,
+                stats.instructionCountBefore, stats.instructionCountAfter, (unsigned long long)stats.sizeBefore, (unsigned long long)stats.sizeAfter);
+        totals.instructionCountBefore += stats.instructionCountBefore;
+        totals.instructionCountAfter += stats.instructionCountAfter;
+        totals.sizeBefore += stats.sizeBefore;
+        totals.sizeAfter += stats.sizeAfter;
+    }
+    printf("%-40s %12u %12u %12llu %12llu\n", "total",
+            totals.instructionCountBefore, totals.instructionCountAfter, (unsigned long long)totals.sizeBefore, (unsigned long long)totals.sizeAfter);
+
+    DestroyArena(&arena);
+    DestroyShaderCompiler(&compiler);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+#include <vertex_format.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+u32 vertexFormatSizeInBytes[] =
+{
+    8,
+    12,
+    16,
+    4,
+    8,
+    4,
+    8,
+    4,
+    4,
+    4,
+    4,
+};
+static_assert(sizeof(vertexFormatSizeInBytes) / sizeof(u32) == VERTEX_FORMAT_COUNT, "Missing vertex format size");
+
+u32 vertexFormatComponentCount[] =
+{
+    2,
+    3,
+    4,
+    2,
+    4,
+    2,
+    4,
+    2,
+    4,
+    4,
+    4,
+};
+static_assert(sizeof(vertexFormatComponentCount) / sizeof(u32) == VERTEX_FORMAT_COUNT, "Missing vertex format component count");
+
+const char* vertexFormatNames[] =
+{
+    "R32G32_FLOAT",
+    "R32G32B32_FLOAT",
+    "R32G32B32A32_FLOAT",
+    "R16G16_FLOAT",
+    "R16G16B16A16_FLOAT",
+    "R16G16_SNORM",
+    "R16G16B16A16_SNORM",
+    "R16G16_UNORM",
+    "R8G8B8A8_UNORM",
+    "R8G8B8A8_SNORM",
+    "A2B10G10R10_UNORM",
+};
+static_assert(sizeof(vertexFormatNames) / sizeof(const char*) == VERTEX_FORMAT_COUNT, "Missing vertex format name");
+
+static bool IsFloat32Format(VertexFormat format)
+{
+    return format == VERTEX_FORMAT_R32G32_FLOAT
+        || format == VERTEX_FORMAT_R32G32B32_FLOAT
+        || format == VERTEX_FORMAT_R32G32B32A32_FLOAT;
+}
+
+// Four floats to half floats with round to nearest even, handling subnormals, infinities and NaNs.
+// Results are sign extended to 32 bits, so _mm_packs_epi32 narrows them without saturating.
+static __m128i FloatToHalf4(__m128 f)
+{
+    const __m128i signMask = _mm_set1_epi32((i32)0x80000000u);
+    const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);                    // Anything above rounds to infinity
+    const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);                 // Smallest float that is a normal half
+    const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));      // Rebias exponent, add rounding
+    const __m128i nanBit = _mm_set1_epi32(0x200);
+    const __m128i infinity = _mm_set1_epi32(0x7C00);
+
+    __m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), f);
+    __m128 absF = _mm_xor_ps(f, sign);
+    __m128i absI = _mm_castps_si128(absF);
+    __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+    __m128i isRegular = _mm_cmpgt_epi32(f16Max, absI);
+    __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absI);
+    __m128i special = _mm_or_si128(_mm_and_si128(isNan, nanBit), infinity);
+
+    // Subnormal results: let the float adder align and round the mantissa
+    __m128 subnormalF = _mm_add_ps(absF, _mm_castsi128_ps(subnormalMagic));
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(subnormalF), subnormalMagic);
+
+    // Normal results: bias towards rounding up when the half mantissa is odd (ties to even)
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absI, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absI, normalBias), mantissaOdd), 13);
+
+    __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    __m128i result = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+    return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+f32 HalfToFloat(u16 value)
+{
+    u32 sign = (u32)(value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1F;
+    u32 mantissa = value & 0x3FF;
+    f32 result;
+    if(exponent == 0) result = ldexpf((f32)mantissa, -24);
+    else if(exponent == 31) result = mantissa ? NAN : INFINITY;
+    else result = ldexpf((f32)(mantissa | 0x400), (i32)exponent - 25);
+    return sign ? -result : result;
+}
+
+// Decodes one attribute the same way the input assembler does.
+static void DecodeVertexAttribute(VertexFormat format, const u8* src, f32* out)
+{
+    u32 components = vertexFormatComponentCount[format];
+    switch(format)
+    {
+        case VERTEX_FORMAT_R32G32_FLOAT:
+        case VERTEX_FORMAT_R32G32B32_FLOAT:
+        case VERTEX_FORMAT_R32G32B32A32_FLOAT:
+        {
+            memcpy(out, src, components * sizeof(f32));
+        } break;
+        case VERTEX_FORMAT_R16G16_FLOAT:
+        case VERTEX_FORMAT_R16G16B16A16_FLOAT:
+        {
+            for(u32 i = 0; i < components; i++) out[i] = HalfToFloat(((const u16*)src)[i]);
+        } break;
+        case VERTEX_FORMAT_R16G16_SNORM:
+        case VERTEX_FORMAT_R16G16B16A16_SNORM:
+        {
+            for(u32 i = 0; i < components; i++) out[i] = MAX(((const int16_t*)src)[i] / 32767.f, -1.f);
+        } break;
+        case VERTEX_FORMAT_R16G16_UNORM:
+        {
+            for(u32 i = 0; i < components; i++) out[i] = ((const u16*)src)[i] / 65535.f;
+        } break;
+        case VERTEX_FORMAT_R8G8B8A8_UNORM:
+        {
+            for(u32 i = 0; i < components; i++) out[i] = src[i] / 255.f;
+        } break;
+        case VERTEX_FORMAT_R8G8B8A8_SNORM:
+        {
+            for(u32 i = 0; i < components; i++) out[i] = MAX(((const int8_t*)src)[i] / 127.f, -1.f);
+        } break;
+        case VERTEX_FORMAT_A2B10G10R10_UNORM:
+        {
+            u32 packed;
+            memcpy(&packed, src, sizeof(packed));
+            out[0] = (packed & 0x3FF) / 1023.f;
+            out[1] = ((packed >> 10) & 0x3FF) / 1023.f;
+            out[2] = ((packed >> 20) & 0x3FF) / 1023.f;
+            out[3] = (packed >> 30) / 3.f;
+        } break;
+        default: break;
+    }
+}
+
+// Counts source components that had to be clamped into [lo, hi].
+static u32 CountClamped(__m128 v, __m128 clamped, u32 srcComponents)
+{
+    u32 mask = (u32)_mm_movemask_ps(_mm_cmpneq_ps(v, clamped)) & ((1u << srcComponents) - 1);
+    u32 result = 0;
+    for(; mask; mask &= mask - 1) result++;
+    return result;
+}
+
+void QuantizeVertexAttribute(VertexFormat format, const f32* src, u32 srcComponents, u64 srcStride, u32 count,
+        u8* dst, u64 dstStride, QuantizeError* outError)
+{
+    srcComponents = MIN(srcComponents, 4);
+    QuantizeError error = {};
+    f64 squaredErrorSum = 0;
+    for(u32 i = 0; i < count; i++)
+    {
+        const f32* attribute = (const f32*)((const u8*)src + i * srcStride);
+        u8* out = dst + i * dstStride;
+        f32 values[4] = { 0, 0, 0, 1 };
+        memcpy(values, attribute, srcComponents * sizeof(f32));
+        __m128 v = _mm_loadu_ps(values);
+
+        switch(format)
+        {
+            case VERTEX_FORMAT_R32G32_FLOAT:
+            case VERTEX_FORMAT_R32G32B32_FLOAT:
+            case VERTEX_FORMAT_R32G32B32A32_FLOAT:
+            {
+                memcpy(out, values, vertexFormatSizeInBytes[format]);
+            } break;
+            case VERTEX_FORMAT_R16G16_FLOAT:
+            case VERTEX_FORMAT_R16G16B16A16_FLOAT:
+            {
+                __m128i packed = _mm_packs_epi32(FloatToHalf4(v), _mm_setzero_si128());
+                if(format == VERTEX_FORMAT_R16G16_FLOAT) *(i32*)out = _mm_cvtsi128_si32(packed);
+                else _mm_storel_epi64((__m128i*)out, packed);
+            } break;
+            case VERTEX_FORMAT_R16G16_SNORM:
+            case VERTEX_FORMAT_R16G16B16A16_SNORM:
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+                error.clampedCount += CountClamped(v, clamped, srcComponents);
+                __m128i scaled = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(32767.f)));
+                __m128i packed = _mm_packs_epi32(scaled, _mm_setzero_si128());
+                if(format == VERTEX_FORMAT_R16G16_SNORM) *(i32*)out = _mm_cvtsi128_si32(packed);
+                else _mm_storel_epi64((__m128i*)out, packed);
+            } break;
+            case VERTEX_FORMAT_R16G16_UNORM:
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+                error.clampedCount += CountClamped(v, clamped, srcComponents);
+                // No unsigned 32 -> 16 pack in SSE2: bias into signed range, pack, then flip the top bit back
+                __m128i scaled = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(65535.f)));
+                __m128i biased = _mm_sub_epi32(scaled, _mm_set1_epi32(32768));
+                __m128i packed = _mm_xor_si128(_mm_packs_epi32(biased, _mm_setzero_si128()), _mm_set1_epi16((short)0x8000));
+                *(i32*)out = _mm_cvtsi128_si32(packed);
+            } break;
+            case VERTEX_FORMAT_R8G8B8A8_UNORM:
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+                error.clampedCount += CountClamped(v, clamped, srcComponents);
+                __m128i scaled = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(255.f)));
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(scaled, _mm_setzero_si128()), _mm_setzero_si128());
+                *(i32*)out = _mm_cvtsi128_si32(packed);
+            } break;
+            case VERTEX_FORMAT_R8G8B8A8_SNORM:
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+                error.clampedCount += CountClamped(v, clamped, srcComponents);
+                __m128i scaled = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(127.f)));
+                __m128i packed = _mm_packs_epi16(_mm_packs_epi32(scaled, _mm_setzero_si128()), _mm_setzero_si128());
+                *(i32*)out = _mm_cvtsi128_si32(packed);
+            } break;
+            case VERTEX_FORMAT_A2B10G10R10_UNORM:
+            {
+                __m128 clamped = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+                error.clampedCount += CountClamped(v, clamped, srcComponents);
+                u32 scaled[4];
+                _mm_storeu_si128((__m128i*)scaled, _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_setr_ps(1023.f, 1023.f, 1023.f, 3.f))));
+                u32 packed = scaled[0] | (scaled[1] << 10) | (scaled[2] << 20) | (scaled[3] << 30);
+                memcpy(out, &packed, sizeof(packed));
+            } break;
+            default:
+            {
+                printf("[VERTEX_FORMAT]: Unsupported quantization format %d\n", format);
+                exit(-1);
+            } break;
+        }
+
+        f32 decoded[4] = {};
+        DecodeVertexAttribute(format, out, decoded);
+        for(u32 c = 0; c < srcComponents; c++)
+        {
+            f32 e = ABS(decoded[c] - values[c]);
+            error.maxError = MAX(error.maxError, e);
+            squaredErrorSum += (f64)e * e;
+        }
+    }
+
+    u64 componentCount = (u64)count * srcComponents;
+    error.rmsError = componentCount ? sqrt(squaredErrorSum / componentCount) : 0;
+    if(outError) *outError = error;
+}
+
+u64 QuantizeVertices(const u8* src, u32 vertexCount, u32 attributeCount, const VertexFormat* srcFormats,
+        const VertexFormat* dstFormats, Arena* arena, u8** outVertices, QuantizeError* outErrors)
+{
+    u64 srcStride = 0;
+    u64 dstStride = 0;
+    for(u32 i = 0; i < attributeCount; i++)
+    {
+        if(!IsFloat32Format(srcFormats[i]))
+        {
+            printf("[VERTEX_FORMAT]: Quantization source attribute %u must be 32-bit float, got %s\n", i, vertexFormatNames[srcFormats[i]]);
+            exit(-1);
+        }
+        srcStride += vertexFormatSizeInBytes[srcFormats[i]];
+        dstStride += vertexFormatSizeInBytes[dstFormats[i]];
+    }
+
+    u64 size = dstStride * vertexCount;
+    u8* result = ARENA_PUSH_ARRAY(arena, u8, size);
+    u64 srcOffset = 0;
+    u64 dstOffset = 0;
+    for(u32 i = 0; i < attributeCount; i++)
+    {
+        QuantizeVertexAttribute(dstFormats[i], (const f32*)(src + srcOffset), vertexFormatComponentCount[srcFormats[i]], srcStride,
+                vertexCount, result + dstOffset, dstStride, outErrors ? &outErrors[i] : NULL);
+        srcOffset += vertexFormatSizeInBytes[srcFormats[i]];
+        dstOffset += vertexFormatSizeInBytes[dstFormats[i]];
+    }
+
+    *outVertices = result;
+    return size;
+}
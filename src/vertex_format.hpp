@@ -0,0 +1,48 @@
+#pragma once
+#include <math.hpp>
+#include <memory.hpp>
+
+// ========================================================
+// [VERTEX FORMAT]
+// Vertex attribute formats, and SIMD (SSE2) quantization of float vertex data into the compact ones.
+// Compact formats are decoded to float by the input assembler, so shaders keep their float inputs.
+// Formats with fewer components than the shader input are fine (missing components read as 0, w as 1);
+// all formats here are mandatory for vertex buffers in Vulkan.
+enum VertexFormat
+{
+    VERTEX_FORMAT_R32G32_FLOAT,
+    VERTEX_FORMAT_R32G32B32_FLOAT,
+    VERTEX_FORMAT_R32G32B32A32_FLOAT,
+    VERTEX_FORMAT_R16G16_FLOAT,
+    VERTEX_FORMAT_R16G16B16A16_FLOAT,
+    VERTEX_FORMAT_R16G16_SNORM,             // [-1, 1]
+    VERTEX_FORMAT_R16G16B16A16_SNORM,
+    VERTEX_FORMAT_R16G16_UNORM,             // [0, 1], e.g. texture coordinates
+    VERTEX_FORMAT_R8G8B8A8_UNORM,           // e.g. vertex colors
+    VERTEX_FORMAT_R8G8B8A8_SNORM,
+    VERTEX_FORMAT_A2B10G10R10_UNORM,        // Packed 10:10:10:2, [0, 1]. Normals are stored as n * 0.5 + 0.5.
+    VERTEX_FORMAT_COUNT,
+};
+extern u32 vertexFormatSizeInBytes[VERTEX_FORMAT_COUNT];
+extern u32 vertexFormatComponentCount[VERTEX_FORMAT_COUNT];
+extern const char* vertexFormatNames[VERTEX_FORMAT_COUNT];
+
+struct QuantizeError
+{
+    f32 maxError = 0;       // Largest absolute difference between a source component and its decoded value
+    f64 rmsError = 0;
+    u32 clampedCount = 0;   // Components outside of the format's range
+};
+
+// Converts count attributes of srcComponents floats each (srcStride bytes apart) into format, dstStride bytes apart.
+// Missing destination components are filled with 0, and 1 for the 4th (e.g. color alpha).
+// Error is measured on the source components, after decoding the quantized values back to float.
+void QuantizeVertexAttribute(VertexFormat format, const f32* src, u32 srcComponents, u64 srcStride, u32 count,
+        u8* dst, u64 dstStride, QuantizeError* outError);
+
+// Converts interleaved float vertices (attributes in srcFormats) into interleaved dstFormats vertices, allocated from arena.
+// Returns the size of the output in bytes. outErrors has one entry per attribute, and is optional.
+u64 QuantizeVertices(const u8* src, u32 vertexCount, u32 attributeCount, const VertexFormat* srcFormats,
+        const VertexFormat* dstFormats, Arena* arena, u8** outVertices, QuantizeError* outErrors);
+
+f32 HalfToFloat(u16 value);